@@ -345,6 +345,19 @@ TPORT_DLL su_strlst_t const *tport_delivered_from_subjects(tport_t *tp,
 /** Check if the given subject string is found in su_strlst_t */
 TPORT_DLL int tport_subject_search(char const *, su_strlst_t const *);
 
+/** TLS handshake statistics, see tport_tls_stats(). */
+typedef struct {
+  unsigned long tls_handshakes;	/**< Completed handshakes */
+  unsigned long tls_resumed;	/**< Completed handshakes resuming a session */
+  unsigned long tls_failed;	/**< Failed handshakes */
+  unsigned long tls_latency;	/**< Sum of handshake latencies in ms */
+  unsigned      tls_latency_max;/**< Slowest handshake in ms */
+  unsigned      tls_pending;	/**< Handshakes running in threads */
+} tport_tls_stats_t;
+
+/** Get TLS handshake statistics summed over primary transports */
+TPORT_DLL int tport_tls_stats(tport_t const *self, tport_tls_stats_t *stats);
+
 /** Check if transport named is already resolved */
 TPORT_DLL int tport_name_is_resolved(tp_name_t const *);
 
@@ -224,6 +224,28 @@ TPORT_DLL extern tag_typedef_t tptag_tls_timeout;
 TPORT_DLL extern tag_typedef_t tptag_tls_timeout_ref;
 #define TPTAG_TLS_TIMEOUT_REF(x) tptag_tls_timeout_ref, tag_uint_vr(&(x))
 
+TPORT_DLL extern tag_typedef_t tptag_tls_session_cache;
+#define TPTAG_TLS_SESSION_CACHE(x) tptag_tls_session_cache, tag_uint_v((x))
+
+TPORT_DLL extern tag_typedef_t tptag_tls_session_cache_ref;
+#define TPTAG_TLS_SESSION_CACHE_REF(x) \
+             tptag_tls_session_cache_ref, tag_uint_vr(&(x))
+
+TPORT_DLL extern tag_typedef_t tptag_tls_session_tickets;
+#define TPTAG_TLS_SESSION_TICKETS(x) tptag_tls_session_tickets, tag_bool_v((x))
+
+TPORT_DLL extern tag_typedef_t tptag_tls_session_tickets_ref;
+#define TPTAG_TLS_SESSION_TICKETS_REF(x) \
+             tptag_tls_session_tickets_ref, tag_bool_vr(&(x))
+
+TPORT_DLL extern tag_typedef_t tptag_tls_handshake_threads;
+#define TPTAG_TLS_HANDSHAKE_THREADS(x) \
+             tptag_tls_handshake_threads, tag_uint_v((x))
+
+TPORT_DLL extern tag_typedef_t tptag_tls_handshake_threads_ref;
+#define TPTAG_TLS_HANDSHAKE_THREADS_REF(x) \
+             tptag_tls_handshake_threads_ref, tag_uint_vr(&(x))
+
 TPORT_DLL extern tag_typedef_t tptag_tls_passphrase;
 #define TPTAG_TLS_PASSPHRASE(x)  tptag_tls_passphrase, tag_str_v(x)
 
@@ -646,10 +646,11 @@ static int init_test(tp_test_t *tt)
 		     TAG_END()),
 	 0);
 
-    /* Bind tls server transport */
+    /* Bind tls server transport, running handshakes in threads */
     TEST(tport_tbind(tt->tt_srv_tports, tlsname, transports,
 		     TPTAG_SERVER(1),
 		     TPTAG_CERTIFICATE(srcdir),
+		     TPTAG_TLS_HANDSHAKE_THREADS(2),
 		     TAG_END()),
 	 0);
   }
@@ -1264,6 +1265,260 @@ void tls_error_callback(tp_stack_t *tt, tp_client_t *client,
   }
 }
 
+#if defined(SO_REUSEPORT)
+/* Send datagrams from several sources to a UDP transport served by a
+   thread pool, and measure how many messages per second get through */
+static int threadpool_test(tp_test_t *tt)
+{
+  tp_name_t myname[1] = {{ "*", "*", "*", "*", NULL }};
+  char const * transports[] = { "udp", NULL };
+  unsigned const threads[] = { 1, 2, 4, 8 };
+  enum { N = 20000, SOURCES = 16, WINDOW = 32 };
+  su_socket_t sources[SOURCES];
+  msg_iovec_t iov[16];
+  char data[2048];
+  size_t len = 0;
+  isize_t i, veclen;
+  unsigned t, k;
+  msg_t *msg;
+
+  BEGIN();
+
+  /* Serialize a test message once, it is sent as raw datagrams */
+  TEST(new_test_msg(tt, &msg, "threadpool", 1, 512), 0);
+  TEST_1(msg_prepare(msg) > 0);
+  TEST_1((veclen = msg_iovec(msg, iov, 16)) > 0 && veclen <= 16);
+  for (i = 0; i < veclen; i++) {
+    TEST_1(len + iov[i].mv_len <= sizeof data);
+    memcpy(data + len, iov[i].mv_base, iov[i].mv_len);
+    len += iov[i].mv_len;
+  }
+  msg_destroy(msg);
+
+  for (k = 0; k < SOURCES; k++)
+    TEST_1((sources[k] = su_socket(AF_INET, SOCK_DGRAM, 0)) != INVALID_SOCKET);
+
+  myname->tpn_host = "127.0.0.1";
+  myname->tpn_ident = "threadpool";
+
+  for (t = 0; t < sizeof threads / sizeof threads[0]; t++) {
+    tport_t *mr, *tp;
+    su_addrinfo_t const *ai;
+    su_time_t started, progress;
+    double elapsed;
+    int sent = 0, received, lost;
+
+    TEST_1(mr = tport_tcreate(tt, tp_test_class, tt->tt_root,
+			      TPTAG_THRPSIZE(threads[t]),
+			      TPTAG_THRPRQSIZE(WINDOW),
+			      TAG_END()));
+    TEST(tport_tbind(mr, myname, transports, TPTAG_SERVER(1), TAG_END()), 0);
+    TEST_1(tp = tport_primaries(mr));
+    TEST_1(ai = tport_get_address(tp));
+
+    if (t == 0) {
+      /* Another pool must not be able to share the address with us */
+      tport_t *mr2;
+      tp_name_t taken[1];
+      char port[8];
+
+      *taken = *myname;
+      snprintf(port, sizeof port, "%u",
+	       ntohs(((su_sockaddr_t *)ai->ai_addr)->su_port));
+      taken->tpn_port = port;
+
+      TEST_1(mr2 = tport_tcreate(tt, tp_test_class, tt->tt_root,
+				 TPTAG_THRPSIZE(2), TAG_END()));
+      TEST_1(tport_tbind(mr2, taken, transports, TPTAG_SERVER(1),
+			 TAG_END()) < 0);
+      tport_destroy(mr2);
+    }
+
+    tt->tt_received = 0;
+    tt->tt_status = 0;
+    started = progress = su_now();
+    received = lost = 0;
+
+    while (tt->tt_received + lost < N) {
+      /* Keep a bounded number of messages in flight */
+      while (sent < N && sent - tt->tt_received - lost < WINDOW) {
+	TEST_1(su_sendto(sources[sent % SOURCES], data, len, 0,
+			 (void *)ai->ai_addr, (socklen_t)ai->ai_addrlen) == len);
+	sent++;
+      }
+
+      su_root_step(tt->tt_root, 1);
+
+      if (tt->tt_received != received)
+	received = tt->tt_received, progress = su_now();
+      else if (su_time_diff(su_now(), progress) >= 1.0)
+	/* Kernel dropped the rest of the window */
+	lost = sent > received ? sent - received : 0, progress = su_now();
+
+      TEST_1(su_time_diff(su_now(), started) < 60.0);
+    }
+
+    /* The window keeps the socket buffers from overflowing on loopback */
+    TEST(lost, 0);
+
+    elapsed = su_time_diff(su_now(), started);
+
+    if (tt->tt_flags & tst_verbatim)
+      printf("threadpool: %u threads received %u messages in %.3f s "
+	     "(%.0f msgs/sec)\n", threads[t], (unsigned)tt->tt_received,
+	     elapsed, elapsed > 0 ? tt->tt_received / elapsed : 0.0);
+
+    msg_destroy(tt->tt_rmsg), tt->tt_rmsg = NULL;
+    tport_destroy(mr);
+  }
+
+  for (k = 0; k < SOURCES; k++)
+    su_close(sources[k]);
+
+  END();
+}
+#else
+static int threadpool_test(tp_test_t *tt)
+{
+  return 0;
+}
+#endif
+
+#if HAVE_SOFIA_NTH && HAVE_SOCKETPAIR
+#include "ws.h"
+
+static wsh_t ws_test_wsh[1];
+
+/* Check WebSocket framing and measure its throughput */
+static int ws_framing_test(tp_test_t *tt)
+{
+  enum { LOOPS = 20000, SIZE = 1400 };
+  wsh_t *wsh = ws_test_wsh;
+  uint8_t const mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+  uint8_t payload[SIZE], masked[SIZE], out[SIZE];
+  uint8_t frame[SIZE + 14], echo[SIZE + 14], hdr[14];
+  ws_iovec_t iov[3];
+  ws_opcode_t oc;
+  uint8_t *data;
+  int sv[2];
+  size_t i, n, len, offset;
+  ssize_t r;
+  su_time_t started;
+  double elapsed;
+
+  BEGIN();
+
+  for (i = 0; i < SIZE; i++)
+    payload[i] = (uint8_t)(i * 7 + 1);
+
+  /* Word-sized unmasking must match the byte-by-byte definition */
+  for (len = 0; len < 40; len++) {
+    for (offset = 0; offset < 4; offset++) {
+      for (i = 0; i < len; i++)
+	echo[i] = payload[i] ^ mask[(offset + i) % 4];
+      ws_unmask(out, payload, len, mask, offset);
+      TEST_M(out, echo, len);
+    }
+  }
+
+  /* Unmasking in pieces, as done over the message iovec */
+  ws_unmask(masked, payload, SIZE, mask, 0);
+  ws_unmask(out, masked, 13, mask, 0);
+  ws_unmask(out + 13, masked + 13, SIZE - 13, mask, 13);
+  TEST_M(out, payload, SIZE);
+
+  TEST(ws_frame_header(hdr, WSOC_TEXT, 125), 2);
+  TEST(hdr[0], 0x81); TEST(hdr[1], 125);
+  TEST(ws_frame_header(hdr, WSOC_TEXT, 126), 4);
+  TEST(hdr[1], 126); TEST(hdr[2], 0); TEST(hdr[3], 126);
+  TEST(ws_frame_header(hdr, WSOC_BINARY, 0x10000), 10);
+  TEST(hdr[0], 0x82); TEST(hdr[1], 127);
+  TEST_M(hdr + 2, "\0\0\0\0\0\1\0\0", 8);
+
+  TEST(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+
+  memset(wsh, 0, sizeof *wsh);
+  wsh->sock = sv[0];
+  wsh->buflen = sizeof wsh->buffer;
+  wsh->handshake = 1;
+
+  /* Header and all chunks go out as a single frame */
+  iov[0].iov_base = payload, iov[0].iov_len = 100;
+  iov[1].iov_base = payload + 100, iov[1].iov_len = 200;
+  iov[2].iov_base = payload + 300, iov[2].iov_len = SIZE - 300;
+  TEST(ws_write_framev(wsh, WSOC_TEXT, iov, 3), SIZE);
+  for (n = 0; n < SIZE + 4; n += r)
+    TEST_1((r = recv(sv[1], echo + n, SIZE + 4 - n, 0)) > 0);
+  TEST(echo[0], 0x81); TEST(echo[1], 126);
+  TEST((echo[2] << 8) | echo[3], SIZE);
+  TEST_M(echo + 4, payload, SIZE);
+
+  /* Masked frame from client */
+  len = 0;
+  frame[len++] = 0x81, frame[len++] = 0x80 | 126;
+  frame[len++] = SIZE >> 8, frame[len++] = SIZE & 0xff;
+  memcpy(frame + len, mask, 4), len += 4;
+  memcpy(frame + len, masked, SIZE), len += SIZE;
+
+  /* Payload is left masked for the caller */
+  TEST(send(sv[1], frame, len, 0), (ssize_t)len);
+  TEST(ws_read_frame_masked(wsh, &oc, &data), SIZE);
+  TEST(oc, WSOC_TEXT);
+  TEST(wsh->masked, 1);
+  TEST_M(data, masked, SIZE);
+  ws_unmask(out, data, SIZE, wsh->mask, 0);
+  TEST_M(out, payload, SIZE);
+
+  TEST(send(sv[1], frame, len, 0), (ssize_t)len);
+  TEST(ws_read_frame(wsh, &oc, &data), SIZE);
+  TEST(wsh->masked, 0);
+  TEST_M(data, payload, SIZE);
+
+  started = su_now();
+  for (i = 0; i < LOOPS; i++)
+    ws_unmask(out, masked, SIZE, mask, 0);
+  elapsed = su_time_diff(su_now(), started);
+  TEST_M(out, payload, SIZE);
+
+  if (tt->tt_flags & tst_verbatim)
+    printf("ws: unmasked %u x %u bytes in %.3f s (%.0f MB/sec)\n",
+	   LOOPS, SIZE, elapsed,
+	   elapsed > 0 ? (double)LOOPS * SIZE / elapsed / 1e6 : 0.0);
+
+  /* Echo frames: read and unmask, then write back */
+  started = su_now();
+  for (i = 0; i < LOOPS; i++) {
+    if (send(sv[1], frame, len, 0) != (ssize_t)len ||
+	ws_read_frame_masked(wsh, &oc, &data) != SIZE)
+      break;
+    ws_unmask(out, data, SIZE, wsh->mask, 0);
+    if (ws_write_frame(wsh, WSOC_TEXT, out, SIZE) != SIZE)
+      break;
+    for (n = 0; n < SIZE + 4; n += r)
+      if ((r = recv(sv[1], echo + n, SIZE + 4 - n, 0)) <= 0)
+	break;
+    if (n != SIZE + 4)
+      break;
+  }
+  elapsed = su_time_diff(su_now(), started);
+  TEST(i, LOOPS);
+  TEST_M(echo + 4, payload, SIZE);
+
+  if (tt->tt_flags & tst_verbatim)
+    printf("ws: echoed %u frames of %u bytes in %.3f s (%.0f frames/sec)\n",
+	   LOOPS, SIZE, elapsed, elapsed > 0 ? LOOPS / elapsed : 0.0);
+
+  su_close(sv[0]), su_close(sv[1]);
+
+  END();
+}
+#else
+static int ws_framing_test(tp_test_t *tt)
+{
+  return 0;
+}
+#endif
+
 static int tls_test(tp_test_t *tt)
 {
   BEGIN();
@@ -1275,6 +1530,7 @@ static int tls_test(tp_test_t *tt)
   char ident[16];
   tport_t *tp, *tp0;
   struct called called[1] = {{ 0, 0, 0, 0 }};
+  tport_tls_stats_t stats[1];
 
   TEST_S(dst->tpn_proto, "tls");
 
@@ -1354,6 +1610,15 @@ static int tls_test(tp_test_t *tt)
   TEST_1(!check_msg(tt, tt->tt_rmsg, "tls-last"));
   msg_destroy(tt->tt_rmsg), tt->tt_rmsg = NULL;
 
+  /* Both connections were accepted by the handshake threads */
+  TEST(tport_tls_stats(tt->tt_srv_tports, stats), 0);
+  TEST_1(stats->tls_handshakes >= 2);
+  TEST(stats->tls_failed, 0);
+  TEST(stats->tls_pending, 0);
+
+  TEST(tport_tls_stats(tt->tt_tports, stats), 0);
+  TEST_1(stats->tls_handshakes >= 2);
+
   tport_decref(&tp0);
 
   /* Wait until notifications -
@@ -1663,6 +1928,8 @@ int main(int argc, char *argv[])
   tstflags |= tst_verbatim;
 #endif
 
+  tt->tt_flags = tstflags;
+
 #if HAVE_ALARM
   if (!no_alarm) {
     signal(SIGALRM, sig_alarm);
@@ -1689,6 +1956,8 @@ int main(int argc, char *argv[])
     retval |= tcp_test(tt); fflush(stdout);
     retval |= test_incomplete(tt); fflush(stdout);
     retval |= reuse_test(tt); fflush(stdout);
+    retval |= threadpool_test(tt); fflush(stdout);
+    retval |= ws_framing_test(tt); fflush(stdout);
     retval |= tls_test(tt); fflush(stdout);
     if (0)			/* Not yet working... */
       retval |= stun_test(tt); fflush(stdout);
@@ -276,6 +276,16 @@ int tport_is_verified(tport_t const *self)
   return tport_has_tls(self) && self->tp_is_connected && self->tp_verified;
 }
 
+#if !HAVE_TLS
+/** Get TLS handshake statistics (not available without TLS) */
+int tport_tls_stats(tport_t const *self, tport_tls_stats_t *stats)
+{
+  if (stats)
+    memset(stats, 0, sizeof *stats);
+  return su_seterrno(ENOSYS);
+}
+#endif
+
 /** Return true if transport is being updated. */
 int tport_is_updating(tport_t const *self)
 {
@@ -503,6 +513,10 @@ tport_t *tport_tcreate(tp_stack_t *stack,
   if (!mr)
     return NULL;
 
+#if SU_HAVE_PTHREADS
+  pthread_mutex_init(mr->mr_primaries_mutex, NULL);
+#endif
+
   SU_DEBUG_7(("%s(): %p\n", "tport_create", (void *)mr));
 
   mr->mr_stack = stack;
@@ -585,6 +599,10 @@ void tport_destroy(tport_t *self)
   if (mr->mr_timer)
     su_timer_destroy(mr->mr_timer), mr->mr_timer = NULL;
 
+#if SU_HAVE_PTHREADS
+  pthread_mutex_destroy(mr->mr_primaries_mutex);
+#endif
+
   su_home_zap(mr->mr_home);
 }
 
@@ -629,7 +647,9 @@ tport_primary_t *tport_alloc_primary(tport_master_t *mr,
 		(void *)pri));
   }
 
+  TPORT_PRIMARIES_LOCK(mr);
   *next = pri;
+  TPORT_PRIMARIES_UNLOCK(mr);
   tp = pri->pri_primary;
 
   if (!tp)
@@ -675,12 +695,14 @@ void tport_zap_primary(tport_primary_t *pri)
     tport_zap_secondary(pri->pri_closed);
 
   /* We have just a single-linked list for primary transports */
+  TPORT_PRIMARIES_LOCK(pri->pri_master);
   for (prip = &pri->pri_master->mr_primaries;
        *prip != pri;
        prip = &(*prip)->pri_next)
     assert(*prip);
 
   *prip = pri->pri_next;
+  TPORT_PRIMARIES_UNLOCK(pri->pri_master);
 
   tport_zap_secondary((tport_t *)pri);
 }
@@ -1124,7 +1146,7 @@ void tport_zap_secondary(tport_t *self)
   tport_stun_server_remove_socket(self);
 #endif
 
-  if (self->tp_index)
+  if (self->tp_index && self->tp_index != -1)
     su_root_deregister(mr->mr_root, self->tp_index);
   self->tp_index = 0;
   if (self->tp_socket != INVALID_SOCKET)
@@ -1314,7 +1336,7 @@ int tport_set_params(tport_t *self,
     tpp->tpp_timeout = 100;
   if (tpp->tpp_drop > 1000)
     tpp->tpp_drop = 1000;
-  if (tpp->tpp_thrprqsize > 0)
+  if (tpp->tpp_thrprqsize == 0)
     tpp->tpp_thrprqsize = tpp0->tpp_thrprqsize;
   if (tpp->tpp_sigcomp_lifetime != 0 && tpp->tpp_sigcomp_lifetime < 30)
     tpp->tpp_sigcomp_lifetime = 30;
@@ -1614,9 +1636,12 @@ int tport_bind_server(tport_master_t *mr,
   su_addrinfo_t *ai, *res = NULL;
   unsigned port, port0, port1, old;
   unsigned short step = 0;
+  unsigned thrpsize = mr->mr_params->tpp_thrpsize;
 
   bind6only_check(mr);
 
+  tl_gets(tags, TPTAG_THRPSIZE_REF(thrpsize), TAG_END());
+
   (void)hostname;
 
   SU_DEBUG_5(("%s(%p) to " TPN_FORMAT "\n",
@@ -1681,6 +1706,12 @@ int tport_bind_server(tport_master_t *mr,
       if (!vtable)
 	continue;
 
+#if defined(SO_REUSEPORT)
+      /* Receive UDP with a pool of threads */
+      if (vtable == &tport_udp_vtable && thrpsize > 0)
+	vtable = &tport_threadpool_vtable;
+#endif
+
       tport_addrinfo_copy(ainfo, su, sizeof su, ai);
       ainfo->ai_canonname = (char *)canon;
       su->su_port = htons(port);
@@ -2119,7 +2150,8 @@ void tport_close(tport_t *self)
   else if (self->tp_socket != -1)
     shutdown(self->tp_socket, 2);
 
-  if (self->tp_index)
+  /* tp_index is -1 while a TLS handshake step runs in a thread */
+  if (self->tp_index && self->tp_index != -1)
     su_root_deregister(self->tp_master->mr_root, self->tp_index);
   self->tp_index = 0;
 #if SU_HAVE_BSDSOCK
@@ -63,6 +63,15 @@
 
 #include <sofia-sip/su_debug.h>
 
+#if SU_HAVE_PTHREADS
+#include <pthread.h>
+#define TPORT_PRIMARIES_LOCK(mr) pthread_mutex_lock((mr)->mr_primaries_mutex)
+#define TPORT_PRIMARIES_UNLOCK(mr) pthread_mutex_unlock((mr)->mr_primaries_mutex)
+#else
+#define TPORT_PRIMARIES_LOCK(mr) ((void)0)
+#define TPORT_PRIMARIES_UNLOCK(mr) ((void)0)
+#endif
+
 #if !defined(MSG_NOSIGNAL) || defined(__CYGWIN__) || defined(SYMBIAN)
 #undef MSG_NOSIGNAL
 #define MSG_NOSIGNAL (0)
@@ -306,6 +315,11 @@ struct tport_master {
   su_socket_t         mr_capt_sock;
   char               *mr_capt_name;	/**< Servername for capturing received/sent data */  
   tport_primary_t    *mr_primaries;        /**< List of primary contacts */
+#if SU_HAVE_PTHREADS
+  /** Only the stack thread changes mr_primaries, this lets other threads
+   *  walk it, see tport_tls_stats() */
+  pthread_mutex_t     mr_primaries_mutex[1];
+#endif
 
   tport_params_t      mr_params[1];
 
@@ -309,6 +309,53 @@ tag_typedef_t tptag_tls_version = UINTTAG_TYPEDEF(tls_version);
  */
 tag_typedef_t tptag_tls_timeout = UINTTAG_TYPEDEF(tls_timeout);
 
+/**@def TPTAG_TLS_SESSION_CACHE(x)
+ *
+ * Sets the size of the TLS server session cache.
+ *
+ * Clients reconnecting within TPTAG_TLS_TIMEOUT() can resume their
+ * session from the cache with an abbreviated handshake. The value 0
+ * disables the cache. The default value is 20480 sessions.
+ *
+ * Use with tport_tbind(), nua_create(), nta_agent_create(),
+ * nta_agent_add_tport(), nth_engine_create(), or initial nth_site_create().
+ *
+ * @NEW_UNRELEASED.
+ */
+tag_typedef_t tptag_tls_session_cache = UINTTAG_TYPEDEF(tls_session_cache);
+
+/**@def TPTAG_TLS_SESSION_TICKETS(x)
+ *
+ * Enables or disables TLS session tickets (RFC 5077).
+ *
+ * With session tickets the session state is kept by the client, and the
+ * server can resume sessions without a cache entry. Enabled by default.
+ *
+ * Use with tport_tbind(), nua_create(), nta_agent_create(),
+ * nta_agent_add_tport(), nth_engine_create(), or initial nth_site_create().
+ *
+ * @NEW_UNRELEASED.
+ */
+tag_typedef_t tptag_tls_session_tickets = BOOLTAG_TYPEDEF(tls_session_tickets);
+
+/**@def TPTAG_TLS_HANDSHAKE_THREADS(x)
+ *
+ * Sets the number of threads running TLS handshakes.
+ *
+ * The public key operations of a TLS handshake take milliseconds each. If
+ * the value is non-zero, the handshakes are run by a pool of threads and
+ * the stack thread keeps processing messages while many clients connect
+ * at once. When using OpenSSL before 1.1.0, the application must install
+ * the OpenSSL locking callbacks. The default value is 0, which runs
+ * handshakes in the stack thread.
+ *
+ * Use with tport_tbind(), nua_create(), nta_agent_create(),
+ * nta_agent_add_tport(), nth_engine_create(), or initial nth_site_create().
+ *
+ * @NEW_UNRELEASED.
+ */
+tag_typedef_t tptag_tls_handshake_threads = UINTTAG_TYPEDEF(tls_handshake_threads);
+
 /**@def TPTAG_TLS_VERIFY_PEER(x)
  * @par Depreciated:
  *    Alias for TPTAG_TLS_VERIFY_POLICY(TPTLS_VERIFY_IN|TPTLS_VERIFY_OUT)
@@ -511,12 +558,15 @@ tag_typedef_t tptag_udp_wmem = UINTTAG_TYPEDEF(udp_wmem);
  *
  * Determines the number of threads in the pool.
  *
- * The thread pools can have multiple threads receiving, uncompressing,
- * parsing, compressing, and sending messages.
+ * When nonzero, a primary UDP transport bound as server opens one extra
+ * socket per thread on the same address with SO_REUSEPORT. Each thread
+ * receives and parses messages from its socket and passes them to the
+ * stack thread. Messages are sent by the stack thread.
  *
  * This is a parameter suitable for tuning.
  *
- * @note Thread pools are currently broken.
+ * @note Only available on platforms supporting SO_REUSEPORT. SigComp and
+ * STUN are not supported on the sockets serviced by the thread pool.
  *
  * Use with tport_tcreate(), tport_tbind(), tport_set_params(), nua_create(),
  * nta_agent_create(), nta_agent_add_tport(), nth_engine_create(), or
@@ -22,7 +22,19 @@
  *
  */
 
-/**@CFILE tport_threadpool.c Multithreading transport
+/**@CFILE tport_threadpool.c Multithreading UDP receive
+ *
+ * When TPTAG_THRPSIZE() is nonzero, the primary UDP transport binds its
+ * socket with SO_REUSEPORT and opens one more socket for each worker
+ * thread on the same address. The kernel distributes incoming datagrams
+ * over the sockets by hashing the source and destination addresses, so
+ * all messages from a given peer, and with them every message belonging
+ * to its transactions and dialogs, are received in order by the same
+ * worker. Workers receive and parse the messages and pass them to the
+ * stack thread, which runs the transaction layer as before. Messages are
+ * always sent by the stack thread through the primary socket.
+ *
+ * SigComp and STUN are not supported by the worker threads.
  *
  * See tport.docs for more detailed description of tport interface.
  *
@@ -36,13 +48,14 @@
 
 #undef HAVE_SIGCOMP
 
-#define SU_ROOT_MAGIC_T         struct tport_threadpool
+#define SU_ROOT_MAGIC_T         struct threadpool
 #define SU_WAKEUP_ARG_T         struct tport_s
 #define SU_MSG_ARG_T            union tport_su_msg_arg
 
 #include "tport_internal.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <assert.h>
 #include <errno.h>
@@ -55,8 +68,15 @@
 static char const __func__[] = "tport_threadpool";
 #endif
 
+#if defined(SO_REUSEPORT)
+
+#include <pthread.h>
+
 /* ==== Thread pools =================================================== */
 
+/** Maximum number of datagrams a worker receives per wakeup */
+#define THRP_RECV_BATCH 64
+
 typedef struct threadpool threadpool_t;
 
 typedef struct {
@@ -70,47 +90,39 @@ struct threadpool
   /* Shared */
   su_clone_r thrp_clone;
   tport_threadpool_t *thrp_tport;
+  su_socket_t thrp_socket;	/**< Worker socket bound with SO_REUSEPORT */
 
-  int        thrp_killing; /* Threadpool is being killed */
+  int volatile thrp_killing; /* Threadpool is being killed, THRP_LOAD() */
 
   /* Private variables */
   su_root_t    *thrp_root;
   int           thrp_reg;
-  struct sigcomp_compartment *thrp_compartment;
-  su_msg_r   thrp_rmsg;
+  int           thrp_yield;
 
-  /* Slave thread counters */
-  int        thrp_r_sent;
-  int        thrp_s_recv;
+  /* Queue counters, shared by worker and stack: use THRP_INC()/THRP_LOAD() */
+  unsigned volatile thrp_r_sent;
+  unsigned volatile thrp_r_recv;
 
+  /* Worker thread counters */
   unsigned   thrp_rcvd_msgs;
   unsigned   thrp_rcvd_bytes;
-
-  /* Master thread counters */
-  int        thrp_s_sent;
-  int        thrp_r_recv;
-
-  int        thrp_yield;
 };
 
+/* Counters crossing between the worker and the stack thread */
+#define THRP_INC(x) (__sync_add_and_fetch(&(x), 1))
+#define THRP_LOAD(x) (__sync_add_and_fetch(&(x), 0))
+#define THRP_STORE(x, v) ((void)__sync_lock_test_and_set(&(x), (v)))
+
 typedef struct
 {
   threadpool_t *tpd_thrp;
-  int  tpd_errorcode;
   msg_t *tpd_msg;
   su_time_t tpd_when;
-  unsigned tpd_mtu;
-#if HAVE_SIGCOMP
-  struct sigcomp_compartment *tpd_cc;
-#endif
-  struct sigcomp_udvm *tpd_udvm;
-  socklen_t tpd_namelen;
-  su_sockaddr_t tpd_name[1];
+  size_t tpd_bytes;
 } thrp_udp_deliver_t;
 
 union tport_su_msg_arg
 {
-  threadpool_t   *thrp;
   thrp_udp_deliver_t thrp_udp_deliver[1];
 };
 
@@ -121,12 +133,6 @@ int tport_threadpool_init_primary(tport_primary_t *,
 				  char const **return_culprit);
 static void tport_threadpool_deinit_primary(tport_primary_t *pri);
 
-static int tport_thread_send(tport_t *tp,
-			     msg_t *msg,
-			     tp_name_t const *tpn,
-			     struct sigcomp_compartment *cc,
-			     unsigned mtu);
-
 tport_vtable_t const tport_threadpool_vtable =
 {
   /* vtp_name 		     */ "udp",
@@ -136,7 +142,7 @@ tport_vtable_t const tport_threadpool_vtable =
   /* vtp_deinit_primary      */ tport_threadpool_deinit_primary,
   /* vtp_wakeup_pri          */ NULL,
   /* vtp_connect             */ NULL,
-  /* vtp_secondary_size      */ 0, /* No secondary transports! */
+  /* vtp_secondary_size      */ sizeof (tport_t),
   /* vtp_init_secondary      */ NULL,
   /* vtp_deinit_secondary    */ NULL,
   /* vtp_shutdown            */ NULL,
@@ -145,42 +151,36 @@ tport_vtable_t const tport_threadpool_vtable =
   /* vtp_recv                */ tport_recv_dgram,
   /* vtp_send                */ tport_send_dgram,
   /* vtp_deliver             */ NULL,
-  /* vtp_prepare             */ tport_thread_send,
+  /* vtp_prepare             */ NULL,
   /* vtp_keepalive           */ NULL,
   /* vtp_stun_response       */ NULL,
   /* vtp_next_secondary_timer*/ NULL,
   /* vtp_secondary_timer     */ NULL,
 };
 
+static int thrp_udp_socket(threadpool_t *thrp,
+			   tport_t *tp,
+			   tagi_t const *tags,
+			   char const **return_culprit);
 static int thrp_udp_init(su_root_t *, threadpool_t *);
 static void thrp_udp_deinit(su_root_t *, threadpool_t *);
 static int thrp_udp_event(threadpool_t *thrp,
-			    su_wait_t *w,
-			    tport_t *_tp);
-static int thrp_udp_recv_deliver(threadpool_t *thrp,
-				 tport_t const *tp,
-				 thrp_udp_deliver_t *tpd,
-				 int events);
-static int thrp_udp_recv(threadpool_t *thrp, thrp_udp_deliver_t *tpd);
-#if HAVE_SIGCOMP
-static int thrp_udvm_decompress(threadpool_t *thrp,
-				thrp_udp_deliver_t *tpd);
-#endif
+			  su_wait_t *w,
+			  tport_t *tp);
+static int thrp_udp_recv_deliver(threadpool_t *thrp, tport_t *tp);
+static ssize_t thrp_udp_recv(threadpool_t *thrp, tport_t *tp,
+			     msg_t **return_msg);
 static void thrp_udp_deliver(threadpool_t *thrp,
 			     su_msg_r msg,
 			     union tport_su_msg_arg *arg);
 static void thrp_udp_deliver_report(threadpool_t *thrp,
 				    su_msg_r m,
 				    union tport_su_msg_arg *arg);
-static void thrp_udp_send(threadpool_t *thrp,
-			  su_msg_r msg,
-			  union tport_su_msg_arg *arg);
-static void thrp_udp_send_report(threadpool_t *thrp,
-				 su_msg_r msg,
-				 union tport_su_msg_arg *arg);
 
+/** Mutex serializing message dumps and captures from worker threads */
+static pthread_mutex_t thrp_log_mutex[1] = { PTHREAD_MUTEX_INITIALIZER };
 
-/** Launch threads in the tport pool. */
+/** Open worker sockets and launch threads in the tport pool. */
 int tport_threadpool_init_primary(tport_primary_t *pri,
 				  tp_name_t tpn[1],
 				  su_addrinfo_t *ai,
@@ -190,7 +190,7 @@ int tport_threadpool_init_primary(tport_primary_t *pri,
   tport_threadpool_t *tptp = (tport_threadpool_t *)pri;
   tport_t *tp = pri->pri_primary;
   threadpool_t *thrp;
-  int i, N = tp->tp_params->tpp_thrpsize;
+  unsigned i, N = tp->tp_params->tpp_thrpsize;
 
   assert(ai->ai_socktype == SOCK_DGRAM);
 
@@ -200,36 +200,41 @@ int tport_threadpool_init_primary(tport_primary_t *pri,
   if (N == 0)
     return 0;
 
-  thrp = su_zalloc(tp->tp_home, (sizeof *thrp) * N);
+  /* Messages from a worker may still be queued for the stack thread
+     after the primary is gone, so keep the pool in the master home */
+  thrp = su_zalloc(pri->pri_master->mr_home, (sizeof *thrp) * N);
   if (!thrp)
-    return -1;
-
-  su_setblocking(tp->tp_socket, 0);
+    return *return_culprit = "alloc", -1;
 
   tptp->tptp_pool = thrp;
-  tptp->tptp_poolsize = N;
+
+  for (i = 0; i < N; i++)
+    thrp[i].thrp_socket = INVALID_SOCKET;
 
   for (i = 0; i < N; i++) {
-#if HAVE_SIGCOMP
-    if (tport_has_sigcomp(tp))
-      thrp[i].thrp_compartment = tport_primary_compartment(tp->tp_master);
-#endif
     thrp[i].thrp_tport = tptp;
+
+    if (thrp_udp_socket(thrp + i, tp, tags, return_culprit) < 0)
+      return -1;
+
     if (su_clone_start(pri->pri_master->mr_root,
 		       thrp[i].thrp_clone,
 		       thrp + i,
 		       thrp_udp_init,
-		       thrp_udp_deinit) < 0)
-      goto error;
+		       thrp_udp_deinit) < 0) {
+      /* A clone whose init failed has closed it in thrp_udp_deinit(),
+	 one that never started has not */
+      if (thrp[i].thrp_socket != INVALID_SOCKET)
+	su_close(thrp[i].thrp_socket), thrp[i].thrp_socket = INVALID_SOCKET;
+      return *return_culprit = "su_clone_start", -1;
+    }
+
+    tptp->tptp_poolsize = i + 1;
   }
 
-  tp->tp_events = 0;
+  SU_DEBUG_5(("%s(%p): %u receive threads\n", __func__, (void *)pri, N));
 
   return 0;
-
- error:
-  assert(!"tport_launch_threadpool");
-  return -1;
 }
 
 /** Kill threads in the tport pool.
@@ -241,66 +246,130 @@ void tport_threadpool_deinit_primary(tport_primary_t *pri)
 {
   tport_threadpool_t *tptp = (tport_threadpool_t *)pri;
   threadpool_t *thrp = tptp->tptp_pool;
-  int i, N = pri->tptp_poolsize;
+  unsigned i, N = tptp->tptp_poolsize;
 
   if (!thrp)
     return;
 
-  /* Prevent application from using these. */
+  /* Drop messages still queued for the stack. */
   for (i = 0; i < N; i++)
-    thrp[i].thrp_killing = 1;
+    THRP_STORE(thrp[i].thrp_killing, 1);
 
-  /* Stop every task in the threadpool. */
+  /* Stop every task in the threadpool, they close their sockets. */
   for (i = 0; i < N; i++)
     su_clone_wait(pri->pri_master->mr_root, thrp[i].thrp_clone);
 
-  su_free(pri->pri_home, tptp), tptp->tptp_pool = NULL;
+  tptp->tptp_pool = NULL;
   tptp->tptp_poolsize = 0;
 
-  SU_DEBUG_3(("%s(%p): zapped threadpool\n", __func__, pri));
+  SU_DEBUG_3(("%s(%p): zapped threadpool\n", __func__, (void *)pri));
+}
+
+/** Open a worker socket bound to the same address as the primary. */
+static int thrp_udp_socket(threadpool_t *thrp,
+			   tport_t *tp,
+			   tagi_t const *tags,
+			   char const **return_culprit)
+{
+  su_sockaddr_t su[1];
+  socklen_t sulen = sizeof su;
+  unsigned rmem = 0;
+  int const one = 1;
+  su_socket_t s;
+
+  memset(su, 0, sizeof su);
+
+  if (getsockname(tp->tp_socket, &su->su_sa, &sulen) == SOCKET_ERROR)
+    return *return_culprit = "getsockname", -1;
+
+  s = su_socket(su->su_family, SOCK_DGRAM, IPPROTO_UDP);
+  if (s == INVALID_SOCKET)
+    return *return_culprit = "socket", -1;
+
+  if (setsockopt(s, SOL_SOCKET, SO_REUSEPORT, (void *)&one, sizeof one) < 0) {
+    su_close(s);
+    return *return_culprit = "setsockopt(SO_REUSEPORT)", -1;
+  }
+
+#if SU_HAVE_IN6 && defined(IPV6_V6ONLY)
+  if (su->su_family == AF_INET6) {
+    /* Must match the primary socket for the kernel to group them */
+    int v6only = 0;
+    socklen_t v6len = sizeof v6only;
+
+    if (getsockopt(tp->tp_socket, IPPROTO_IPV6, IPV6_V6ONLY,
+		   (void *)&v6only, &v6len) == 0)
+      setsockopt(s, IPPROTO_IPV6, IPV6_V6ONLY, (void *)&v6only, sizeof v6only);
+  }
+#endif
+
+  if (bind(s, &su->su_sa, sulen) == SOCKET_ERROR) {
+    su_close(s);
+    return *return_culprit = "bind", -1;
+  }
+
+  tl_gets(tags, TPTAG_UDP_RMEM_REF(rmem), TAG_END());
+
+  if (rmem != 0 &&
+#if HAVE_SO_RCVBUFFORCE
+      setsockopt(s, SOL_SOCKET, SO_RCVBUFFORCE, (void *)&rmem, sizeof rmem) < 0 &&
+#endif
+      setsockopt(s, SOL_SOCKET, SO_RCVBUF, (void *)&rmem, sizeof rmem) < 0) {
+    SU_DEBUG_3(("setsockopt(SO_RCVBUF): %s\n",
+		su_strerror(su_errno())));
+  }
+
+  su_setblocking(s, 0);
+
+  thrp->thrp_socket = s;
+
+  return 0;
 }
 
 static int thrp_udp_init(su_root_t *root, threadpool_t *thrp)
 {
-  tport_t *tp = thrp->thrp_tport->tptp_primary->pri_primary;
+  tport_t *tp = thrp->thrp_tport->tptp_primary.pri_primary;
   su_wait_t wait[1];
 
   assert(tp);
 
   thrp->thrp_root = root;
 
-  if (su_wait_create(wait, tp->tp_socket, SU_WAIT_IN | SU_WAIT_ERR) < 0)
+  if (su_wait_create(wait, thrp->thrp_socket, SU_WAIT_IN) < 0)
     return -1;
 
   thrp->thrp_reg = su_root_register(root, wait, thrp_udp_event, tp, 0);
 
-  if (thrp->thrp_reg  == -1)
+  if (thrp->thrp_reg == -1) {
+    su_wait_destroy(wait);
     return -1;
+  }
 
   return 0;
 }
 
 static void thrp_udp_deinit(su_root_t *root, threadpool_t *thrp)
 {
-  if (thrp->thrp_reg)
+  if (thrp->thrp_reg > 0)
     su_root_deregister(root, thrp->thrp_reg), thrp->thrp_reg = 0;
-  su_msg_destroy(thrp->thrp_rmsg);
+
+  if (thrp->thrp_socket != INVALID_SOCKET)
+    su_close(thrp->thrp_socket), thrp->thrp_socket = INVALID_SOCKET;
 }
 
+/** Stop receiving until the stack has caught up. */
 su_inline void
 thrp_yield(threadpool_t *thrp)
 {
-  tport_t *tp = thrp->thrp_tport->tptp_primary->pri_primary;
-  su_root_eventmask(thrp->thrp_root, thrp->thrp_reg, tp->tp_socket, 0);
+  su_root_eventmask(thrp->thrp_root, thrp->thrp_reg, thrp->thrp_socket, 0);
   thrp->thrp_yield = 1;
 }
 
 su_inline void
 thrp_gain(threadpool_t *thrp)
 {
-  tport_t *tp = thrp->thrp_tport->tptp_primary->pri_primary;
-  int events = SU_WAIT_IN | SU_WAIT_ERR;
-  su_root_eventmask(thrp->thrp_root, thrp->thrp_reg, tp->tp_socket, events);
+  su_root_eventmask(thrp->thrp_root, thrp->thrp_reg, thrp->thrp_socket,
+		    SU_WAIT_IN);
   thrp->thrp_yield = 0;
 }
 
@@ -308,278 +377,178 @@ static int thrp_udp_event(threadpool_t *thrp,
 			  su_wait_t *w,
 			  tport_t *tp)
 {
+  int i;
+
 #if HAVE_POLL
-  assert(w->fd == tp->tp_socket);
+  assert(w->fd == thrp->thrp_socket);
 #endif
 
-  for (;;) {
-    thrp_udp_deliver_t *tpd;
-    int events;
-
-    if (!*thrp->thrp_rmsg) {
-      if (su_msg_create(thrp->thrp_rmsg,
-			su_root_parent(thrp->thrp_root),
-			su_root_task(thrp->thrp_root),
-			thrp_udp_deliver,
-			sizeof (*tpd)) == -1) {
-	SU_DEBUG_1(("thrp_udp_event(%p): su_msg_create(): %s\n", thrp,
-		    strerror(errno)));
-	return 0;
-      }
-    }
-
-    tpd = su_msg_data(thrp->thrp_rmsg)->thrp_udp_deliver; assert(tpd);
-    tpd->tpd_thrp = thrp;
-
-    events = su_wait_events(w, tp->tp_socket);
-    if (!events)
-      return 0;
-
-    thrp_udp_recv_deliver(thrp, tp, tpd, events);
-
-    if (*thrp->thrp_rmsg) {
-      SU_DEBUG_7(("thrp_udp_event(%p): no msg sent\n", thrp));
-      tpd = su_msg_data(thrp->thrp_rmsg)->thrp_udp_deliver;
-      memset(tpd, 0, sizeof *tpd);
-      return 0;
-    }
-
-    if (thrp->thrp_yield || (thrp->thrp_s_sent - thrp->thrp_s_recv) > 0)
-      return 0;
+  if (!(su_wait_events(w, thrp->thrp_socket) & SU_WAIT_IN))
+    return 0;
 
-    su_wait(w, 1, 0);
+  for (i = 0; i < THRP_RECV_BATCH && !thrp->thrp_yield; i++) {
+    if (thrp_udp_recv_deliver(thrp, tp) < 0)
+      break;
   }
+
+  return 0;
 }
 
-static int thrp_udp_recv_deliver(threadpool_t *thrp,
-				 tport_t const *tp,
-				 thrp_udp_deliver_t *tpd,
-				 int events)
+/** Receive and parse one datagram, then pass it to the stack thread.
+ *
+ * @retval -1 socket has no more data (or an error occurred)
+ * @retval 0  datagram was dropped
+ * @retval 1  message was passed to the stack thread
+ */
+static int thrp_udp_recv_deliver(threadpool_t *thrp, tport_t *tp)
 {
-  unsigned qlen = thrp->thrp_r_sent - thrp->thrp_r_recv;
-
-  SU_DEBUG_7(("thrp_udp_event(%p): events%s%s%s%s for %p\n", thrp,
-	      events & SU_WAIT_IN ? " IN" : "",
-	      events & SU_WAIT_HUP ? " HUP" : "",
-	      events & SU_WAIT_OUT ? " OUT" : "",
-	      events & SU_WAIT_ERR ? " ERR" : "",
-	      tpd));
-
-  if (events & SU_WAIT_ERR) {
-    tpd->tpd_errorcode = tport_udp_error(tp, tpd->tpd_name);
-    if (tpd->tpd_errorcode) {
-      if (thrp->thrp_yield)
-	su_msg_report(thrp->thrp_rmsg, thrp_udp_deliver_report);
-      tpd->tpd_when = su_now();
-      su_msg_send(thrp->thrp_rmsg);
-      thrp->thrp_r_sent++;
-      return 0;
-    }
+  msg_t *msg = NULL;
+  su_msg_r m = SU_MSG_R_INIT;
+  thrp_udp_deliver_t *tpd;
+  unsigned qlen;
+  ssize_t n;
+
+  n = thrp_udp_recv(thrp, tp, &msg);
+
+  if (n < 0) {
+    int error = su_errno();
+    if (!su_is_blocking(error))
+      SU_DEBUG_3(("%s(%p): recvfrom(): %s (%d)\n", __func__, (void *)thrp,
+		  su_strerror(error), error));
+    return -1;
   }
+  else if (n == 0 || msg == NULL)
+    return 0;
 
-  if (events & SU_WAIT_IN) {
-    if (thrp_udp_recv(thrp, tpd) < 0) {
-      tpd->tpd_errorcode = su_errno();
-      assert(tpd->tpd_errorcode);
-      if (su_is_blocking(tpd->tpd_errorcode))
-	return 0;
-    }
-    else if (tpd->tpd_msg) {
-      int n = msg_extract(tpd->tpd_msg); (void)n;
+  /* Parse the message here, a datagram is always complete */
+  if (msg_extract(msg) == 0)
+    msg_mark_as_complete(msg, MSG_FLG_ERROR);
 
-      thrp->thrp_rcvd_msgs++;
-      thrp->thrp_rcvd_bytes += msg_size(tpd->tpd_msg);
-    }
+  if (su_msg_create(m,
+		    su_root_parent(thrp->thrp_root),
+		    su_root_task(thrp->thrp_root),
+		    thrp_udp_deliver,
+		    sizeof (*tpd)) == -1) {
+    SU_DEBUG_1(("%s(%p): su_msg_create(): %s\n", __func__, (void *)thrp,
+		su_strerror(su_errno())));
+    msg_destroy(msg);
+    return 0;
+  }
 
-#if HAVE_SIGCOMP
-    if (tpd->tpd_udvm && !tpd->tpd_msg)
-      sigcomp_udvm_free(tpd->tpd_udvm), tpd->tpd_udvm = NULL;
-#endif
+  tpd = su_msg_data(m)->thrp_udp_deliver; assert(tpd);
+  tpd->tpd_thrp = thrp;
+  tpd->tpd_msg = msg;
+  tpd->tpd_when = su_now();
+  tpd->tpd_bytes = (size_t)n;
 
-    assert(!tpd->tpd_msg || !tpd->tpd_errorcode);
+  thrp->thrp_rcvd_msgs++;
+  thrp->thrp_rcvd_bytes += (unsigned)n;
 
-    if (tpd->tpd_msg || tpd->tpd_errorcode) {
-      if (qlen >= tp->tp_params->tpp_thrprqsize) {
-	SU_DEBUG_7(("tport recv queue %i: %u\n",
-		    (int)(thrp - tp->tp_pri->tptp_pool), qlen));
-	thrp_yield(thrp);
-      }
+  qlen = THRP_INC(thrp->thrp_r_sent) - THRP_LOAD(thrp->thrp_r_recv);
 
-      if (qlen >= tp->tp_params->tpp_thrprqsize / 2)
-	su_msg_report(thrp->thrp_rmsg, thrp_udp_deliver_report);
-      tpd->tpd_when = su_now();
-      su_msg_send(thrp->thrp_rmsg);
-      thrp->thrp_r_sent++;
-      return 0;
-    }
+  if (qlen >= tp->tp_params->tpp_thrprqsize) {
+    /* Resume once the stack has processed this message */
+    SU_DEBUG_7(("tport recv queue %u: %u\n",
+		(unsigned)(thrp - thrp->thrp_tport->tptp_pool), qlen));
+    thrp_yield(thrp);
+    su_msg_report(m, thrp_udp_deliver_report);
   }
 
-  return 0;
-}
-
-#include <pthread.h>
+  su_msg_send(m);
 
-/** Mutex for reading from socket */
-static pthread_mutex_t mutex[1] = { PTHREAD_MUTEX_INITIALIZER };
+  return 1;
+}
 
 /** Receive a UDP packet by threadpool. */
 static
-int thrp_udp_recv(threadpool_t *thrp, thrp_udp_deliver_t *tpd)
+ssize_t thrp_udp_recv(threadpool_t *thrp, tport_t *tp, msg_t **return_msg)
 {
-  tport_t const *tp = thrp->thrp_tport->pri_primary;
-  unsigned char sample[2];
-  int N;
-  int s = tp->tp_socket;
-
-  pthread_mutex_lock(mutex);
+  msg_t *msg = NULL;
+  msg_iovec_t iovec[msg_n_fragments] = {{ 0 }};
+  su_addrinfo_t *ai;
+  su_sockaddr_t *from;
+  socklen_t fromlen;
+  ssize_t n, N, veclen;
+  uint8_t sample[1];
+  su_socket_t s = thrp->thrp_socket;
 
   /* Simulate packet loss */
   if (tp->tp_params->tpp_drop &&
-      su_randint(0, 1000) < tp->tp_params->tpp_drop) {
-    recv(s, sample, 1, 0);
-    pthread_mutex_unlock(mutex);
-    SU_DEBUG_3(("tport(%p): simulated packet loss!\n", tp));
+      (unsigned)su_randint(0, 1000) < tp->tp_params->tpp_drop) {
+    if (su_recv(s, sample, 1, 0) < 0)
+      return -1;
+    SU_DEBUG_3(("tport(%p): simulated packet loss!\n", (void *)tp));
     return 0;
   }
 
-  /* Peek for first two bytes in message:
-     determine if this is stun, sigcomp or sip
-  */
-  N = recv(s, sample, sizeof sample, MSG_PEEK | MSG_TRUNC);
-
-  if (N < 0) {
-    if (su_is_blocking(su_errno()))
-      N = 0;
-  }
-  else if (N <= 1) {
-    SU_DEBUG_1(("%s(%p): runt of %u bytes\n", "thrp_udp_recv", thrp, N));
-    recv(s, sample, sizeof sample, 0);
-    N = 0;
+  N = (ssize_t)su_getmsgsize(s);
+  if (N == -1)
+    return -1;
+  if (N == 0) {
+    /* Either nothing to read or a zero-length datagram at the head */
+    if (su_recv(s, sample, 1, MSG_PEEK) < 0)
+      return -1;
+    if ((N = (ssize_t)su_getmsgsize(s)) <= 0) {
+      su_recv(s, sample, 1, 0);
+      SU_DEBUG_3(("tport(%p): zero length packet\n", (void *)tp));
+      return 0;
+    }
   }
-#if !HAVE_MSG_TRUNC
-  else if ((N = su_getmsgsize(tp->tp_socket)) < 0)
-    ;
-#endif
-  else if ((sample[0] & 0xf8) == 0xf8) {
-#if HAVE_SIGCOMP
-    if (thrp->thrp_compartment) {
-      struct sigcomp_buffer *input;
-      void *data;
-      int dlen;
-
-      tpd->tpd_udvm =
-	sigcomp_udvm_create_for_compartment(thrp->thrp_compartment);
-      input = sigcomp_udvm_input_buffer(tpd->tpd_udvm, N); assert(input);
-
-      data = input->b_data + input->b_avail;
-      dlen = input->b_size - input->b_avail;
-
-      if (dlen < N)
-	dlen = 0;
 
-      tpd->tpd_namelen = sizeof(tpd->tpd_name);
-
-      dlen = recvfrom(tp->tp_socket, data, dlen, 0,
-		      &tpd->tpd_name->su_sa, &tpd->tpd_namelen);
-
-      SU_CANONIZE_SOCKADDR(tpd->tpd_name);
-
-      if (dlen < N) {
-	su_seterrno(EMSGSIZE);		/* Protocol error */
-	N = -1;
-      } else if (dlen == -1)
-	N = -1;
-      else {
-	input->b_avail += dlen;
-	input->b_complete = 1;
+  veclen = tport_recv_iovec(tp, &msg, iovec, N, 1);
+  if (veclen == -1) {
+    /* Drop it, we would spin on it otherwise */
+    su_recv(s, sample, 1, 0);
+    msg_destroy(msg);
+    return 0;
+  }
 
-	pthread_mutex_unlock(mutex);
+  ai = msg_addrinfo(msg);
+  from = (su_sockaddr_t *)ai->ai_addr, fromlen = (socklen_t)(ai->ai_addrlen);
 
-	N = thrp_udvm_decompress(thrp, tpd);
+  n = su_vrecv(s, iovec, veclen, 0, from, &fromlen);
 
-	if (N == -1)
-	  /* Do not report decompression errors as ICMP errors */
-	  memset(tpd->tpd_name, 0, tpd->tpd_namelen);
+  ai->ai_addrlen = fromlen;
 
-	return N;
-      }
-      pthread_mutex_unlock(mutex);
-      return N;
-    }
-#endif
-    recv(s, sample, 1, 0);
-    pthread_mutex_unlock(mutex);
-    /* XXX - send NACK ? */
-    su_seterrno(EBADMSG);
-    N = -1;
+  if (n == SOCKET_ERROR) {
+    int error = su_errno();
+    msg_destroy(msg);
+    su_seterrno(error);
+    return -1;
   }
-  else {
-    /* receive as usual */
-    N = tport_recv_dgram_r(tp, &tpd->tpd_msg, N);
+  else if (n <= 1) {
+    SU_DEBUG_1(("%s(%p): runt of "MOD_ZD" bytes\n", __func__, (void *)thrp, n));
+    msg_destroy(msg);
+    return 0;
   }
 
-  pthread_mutex_unlock(mutex);
+  SU_CANONIZE_SOCKADDR(from);
 
-  return N;
-}
-
-#if HAVE_SIGCOMP
-static
-int thrp_udvm_decompress(threadpool_t *thrp, thrp_udp_deliver_t *tpd)
-{
-  struct sigcomp_udvm *udvm = tpd->tpd_udvm;
-  struct sigcomp_buffer *output;
-  msg_iovec_t iovec[msg_n_fragments] = {{ 0 }};
-  su_addrinfo_t *ai;
-  tport_t *tp = thrp->thrp_tport->pri_primary;
-  size_t n, m, i, dlen;
-  int eos;
-  void *data;
-  ssize_t veclen;
-
-  output = sigcomp_udvm_output_buffer(udvm, -1);
-
-  if (sigcomp_udvm_decompress(udvm, output, NULL) < 0) {
-    int error = sigcomp_udvm_errno(udvm);
-    SU_DEBUG_3(("%s: UDVM error %d: %s\n", __func__,
-		error, sigcomp_udvm_strerror(udvm)));
-    su_seterrno(EREMOTEIO);
-    return -1;
+  if (tp->tp_master->mr_dump_file || tp->tp_master->mr_capt_sock) {
+    pthread_mutex_lock(thrp_log_mutex);
+    if (tp->tp_master->mr_dump_file)
+      tport_dump_iovec(tp, msg, n, iovec, veclen, "recv", "from");
+    if (tp->tp_master->mr_capt_sock)
+      tport_capt_msg(tp, msg, n, iovec, veclen, "recv");
+    pthread_mutex_unlock(thrp_log_mutex);
   }
 
-  data = output->b_data + output->b_used;
-  dlen = output->b_avail - output->b_used;
-  /* XXX - if a message is larger than default output size... */
-  eos = output->b_complete; assert(output->b_complete);
-
-  veclen = tport_recv_iovec(tp, &tpd->tpd_msg, iovec, dlen, eos);
-
-  if (veclen <= 0) {
-    n = -1;
-  } else {
-    for (i = 0, n = 0; i < veclen; i++) {
-      m = iovec[i].mv_len; assert(dlen >= n + m);
-      memcpy(iovec[i].mv_base, data + n, m);
-      n += m;
-    }
-    assert(dlen == n);
-
-    msg_recv_commit(tpd->tpd_msg, dlen, eos);    /* Mark buffer as used */
+  *sample = *((uint8_t *)iovec[0].mv_base);
 
-    /* Message address */
-    ai = msg_addrinfo(tpd->tpd_msg);
-    ai->ai_flags |= TP_AI_COMPRESSED;
-    ai->ai_family = tpd->tpd_name->su_sa.sa_family;
-    ai->ai_socktype = SOCK_DGRAM;
-    ai->ai_protocol = IPPROTO_UDP;
-    memcpy(ai->ai_addr, tpd->tpd_name, ai->ai_addrlen = tpd->tpd_namelen);
+  /* Commit received data into buffer. This may relocate iovec contents */
+  msg_recv_commit(msg, n, 1);
 
-    SU_DEBUG_9(("%s(%p): sigcomp msg sz = %d\n", __func__, tp, n));
+  if ((sample[0] & 0xf8) == 0xf8 || sample[0] == 0 || sample[0] == 1) {
+    SU_DEBUG_5(("%s(%p): SigComp or STUN message dropped\n",
+		__func__, (void *)thrp));
+    msg_destroy(msg);
+    return 0;
   }
 
+  *return_msg = msg;
+
   return n;
 }
-#endif
 
 /** Deliver message from threadpool to the stack
  *
@@ -592,227 +561,41 @@ void thrp_udp_deliver(su_root_magic_t *magic,
 {
   thrp_udp_deliver_t *tpd = arg->thrp_udp_deliver;
   threadpool_t *thrp = tpd->tpd_thrp;
-  tport_t *tp = thrp->thrp_tport->pri_primary;
-  su_time_t now = su_now();
+  tport_t *tp;
 
   assert(magic != thrp);
 
-  thrp->thrp_r_recv++;
+  THRP_INC(thrp->thrp_r_recv);
 
-  if (thrp->thrp_killing) {
-#if HAVE_SIGCOMP
-    sigcomp_udvm_free(tpd->tpd_udvm), tpd->tpd_udvm = NULL;
-#endif
+  if (THRP_LOAD(thrp->thrp_killing)) {
     msg_destroy(tpd->tpd_msg);
     return;
   }
 
+  tp = thrp->thrp_tport->tptp_primary.pri_primary;
+
   SU_DEBUG_7(("thrp_udp_deliver(%p): got %p delay %f\n",
-	      thrp, tpd, 1000 * su_time_diff(now, tpd->tpd_when)));
+	      (void *)thrp, (void *)tpd,
+	      1000 * su_time_diff(su_now(), tpd->tpd_when)));
 
-  if (tpd->tpd_errorcode)
-    tport_error_report(tp, tpd->tpd_errorcode, tpd->tpd_name);
-  else if (tpd->tpd_msg) {
-    tport_deliver(tp, tpd->tpd_msg, NULL, &tpd->tpd_udvm, tpd->tpd_when);
-    tp->tp_rlogged = NULL;
-  }
+  tport_recv_bytes(tp, tpd->tpd_bytes, tpd->tpd_bytes);
+  tp->tp_rtime = tpd->tpd_when;
 
-#if HAVE_SIGCOMP
-  if (tpd->tpd_udvm) {
-    sigcomp_udvm_free(tpd->tpd_udvm), tpd->tpd_udvm = NULL;
-  }
-#endif
+  tport_deliver(tp, tpd->tpd_msg, NULL, NULL, tpd->tpd_when);
+  tp->tp_rlogged = NULL;
 }
 
+/** Stack has processed the message that made the worker yield.
+ *
+ * @note Executed by the worker thread.
+ */
 static
 void thrp_udp_deliver_report(threadpool_t *thrp,
 			     su_msg_r m,
 			     union tport_su_msg_arg *arg)
 {
-  if (thrp->thrp_yield) {
-    int qlen = thrp->thrp_r_sent - thrp->thrp_r_recv;
-    int qsize = thrp->thrp_tport->pri_params->tpp_thrprqsize;
-    if (qlen == 0 || qlen < qsize / 2)
-      thrp_gain(thrp);
-  }
-}
-
-/** Send a message to network using threadpool.
- *
- * @note Executed by stack thread only.
- */
-static
-int tport_thread_send(tport_t *tp,
-		      msg_t *msg,
-		      tp_name_t const *tpn,
-		      struct sigcomp_compartment *cc,
-		      unsigned mtu)
-{
-
-  threadpool_t *thrp = tp->tp_pri->tptp_pool;
-  thrp_udp_deliver_t *tpd;
-  int i, N = tp->tp_pri->tptp_poolsize;
-  su_msg_r m;
-  unsigned totalqlen = 0;
-  unsigned qlen;
-
-  if (!tp->tp_pri->tptp_pool)
-    return tport_prepare_and_send(tp, msg, tpn, cc, mtu);
-
-  SU_DEBUG_9(("tport_thread_send()\n"));
-
-  if (thrp->thrp_killing)
-    return (su_seterrno(ECHILD)), -1;
-
-  qlen = totalqlen = thrp->thrp_s_sent - thrp->thrp_s_recv;
-
-  /* Select thread with shortest queue */
-  for (i = 1; i < N; i++) {
-    threadpool_t *other = tp->tp_pri->tptp_pool + i;
-    unsigned len = other->thrp_s_sent - other->thrp_s_recv;
-
-    if (len < qlen ||
-	(len == qlen && (other->thrp_s_sent - thrp->thrp_s_sent) < 0))
-      thrp = other, qlen = len;
-
-    totalqlen += len;
-  }
-
-  if (totalqlen >= N * tp->tp_params->tpp_qsize)
-    SU_DEBUG_3(("tport send queue: %u (shortest %u)\n", totalqlen, qlen));
-
-  if (su_msg_create(m,
-		    su_clone_task(thrp->thrp_clone),
-		    su_root_task(tp->tp_master->mr_root),
-		    thrp_udp_send,
-		    sizeof (*tpd)) != su_success) {
-    SU_DEBUG_1(("thrp_udp_event(%p): su_msg_create(): %s\n", thrp,
-		strerror(errno)));
-    return -1;
-  }
-
-  tpd = su_msg_data(m)->thrp_udp_deliver;
-  tpd->tpd_thrp = thrp;
-  tpd->tpd_when = su_now();
-  tpd->tpd_mtu = mtu;
-  tpd->tpd_msg = msg_ref_create(msg);
-
-#if HAVE_SIGCOMP
-  tpd->tpd_cc = cc;
-#endif
-
-  su_msg_report(m, thrp_udp_send_report);
-
-  if (su_msg_send(m) == su_success) {
-    thrp->thrp_s_sent++;
-    return 0;
-  }
-
-  msg_ref_destroy(msg);
-  return -1;
-}
-
-/** thrp_udp_send() is run by threadpool to send the message. */
-static
-void thrp_udp_send(threadpool_t *thrp,
-		   su_msg_r m,
-		   union tport_su_msg_arg *arg)
-{
-  thrp_udp_deliver_t *tpd = arg->thrp_udp_deliver;
-  tport_t *tp = thrp->thrp_tport->pri_primary;
-  msg_t *msg = tpd->tpd_msg;
-  msg_iovec_t *iov, auto_iov[40], *iov0 = NULL;
-  int iovlen, iovused, n;
-
-  assert(thrp == tpd->tpd_thrp);
-
-  thrp->thrp_s_recv++;
-
-  {
-    double delay = 1000 * su_time_diff(su_now(), tpd->tpd_when);
-    if (delay > 100)
-      SU_DEBUG_3(("thrp_udp_deliver(%p): got %p delay %f\n", thrp, tpd, delay));
-    else
-      SU_DEBUG_7(("thrp_udp_deliver(%p): got %p delay %f\n", thrp, tpd, delay));
-  }
-
-  if (!msg) {
-    tpd->tpd_errorcode = EINVAL;
-    return;
-  }
-
-  /* Prepare message for sending - i.e., encode it */
-  if (msg_prepare(msg) < 0) {
-    tpd->tpd_errorcode = errno;
-    return;
-  }
-
-  if (tpd->tpd_mtu != 0 && msg_size(msg) > tpd->tpd_mtu) {
-    tpd->tpd_errorcode = EMSGSIZE;
-    return;
-  }
-
-  /* Use initially the I/O vector from stack */
-  iov = auto_iov, iovlen = sizeof(auto_iov)/sizeof(auto_iov[0]);
-
-  /* Get a iovec for message contents */
-  for (;;) {
-    iovused = msg_iovec(msg, iov, iovlen);
-    if (iovused <= iovlen)
-      break;
-
-    iov = iov0 = realloc(iov0, sizeof(*iov) * iovused);
-    iovlen = iovused;
-
-    if (iov0 == NULL) {
-      tpd->tpd_errorcode = errno;
-      return;
-    }
-  }
-
-  assert(iovused > 0);
-
-  tpd->tpd_when = su_now();
-
-  if (0)
-    ;
-#if HAVE_SIGCOMP
-  else if (tpd->tpd_cc) {
-    tport_sigcomp_t sc[1] = {{ NULL }};
-
-    n = tport_sigcomp_vsend(tp, msg, iov, iovused, tpd->tpd_cc, sc);
-  }
-#endif
-  else
-    n = tport_send_dgram(tp, msg, iov, iovused);
-
-  if (n == -1)
-    tpd->tpd_errorcode = su_errno();
-
-  if (iov0)
-    free(iov0);
+  if (thrp->thrp_yield && !THRP_LOAD(thrp->thrp_killing))
+    thrp_gain(thrp);
 }
 
-static
-void thrp_udp_send_report(su_root_magic_t *magic,
-			  su_msg_r msg,
-			  union tport_su_msg_arg *arg)
-{
-  thrp_udp_deliver_t *tpd = arg->thrp_udp_deliver;
-  threadpool_t *thrp = tpd->tpd_thrp;
-  tport_t *tp = thrp->thrp_tport->pri_primary;
-
-  assert(magic != thrp);
-
-  SU_DEBUG_7(("thrp_udp_send_report(%p): got %p delay %f\n",
-	      thrp, tpd, 1000 * su_time_diff(su_now(), tpd->tpd_when)));
-
-  if (tp->tp_master->mr_log)
-    tport_log_msg(tp, tpd->tpd_msg, "sent", "to", tpd->tpd_when);
-
-  if (tpd->tpd_errorcode)
-    tport_error_report(tp, tpd->tpd_errorcode, msg_addr(tpd->tpd_msg));
-
-  msg_ref_destroy(tpd->tpd_msg);
-
-}
+#endif /* SO_REUSEPORT */
@@ -35,6 +35,7 @@
 
 #define OPENSSL_NO_KRB5 oh-no
 #define SU_WAKEUP_ARG_T  struct tport_s
+#define SU_MSG_ARG_T     union tport_su_msg_arg
 
 #include <sofia-sip/su_types.h>
 #include <sofia-sip/su.h>
@@ -56,6 +57,9 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #if HAVE_FUNC
 #elif HAVE_FUNCTION
@@ -89,6 +93,19 @@ static int once;
 
 #include "tport_tls.h"
 
+/** Handshake step run by a handshake thread */
+typedef struct tls_handshake_s {
+  tport_t *hs_tport;		/* NULL if transport has been closed */
+  tls_t   *hs_tls;
+  int      hs_accept;
+  int      hs_status;		/* Result of SSL_get_error() */
+} tls_handshake_t;
+
+union tport_su_msg_arg
+{
+  tls_handshake_t *hs;
+};
+
 char const tls_version[] = OPENSSL_VERSION_TEXT;
 static int tls_ex_data_idx = -1; /* see SSL_get_ex_new_index(3ssl) */
 
@@ -336,6 +353,19 @@ int tls_init_context(tls_t *tls, tls_issues_t const *ti)
     SSL_CTX_set_options(tls->ctx, SSL_OP_NO_TLSv1_2);
   SSL_CTX_sess_set_remove_cb(tls->ctx, NULL);
   SSL_CTX_set_timeout(tls->ctx, ti->timeout);
+
+  /* Let reconnecting clients skip the public key operations */
+  if (ti->session_cache) {
+    SSL_CTX_set_session_cache_mode(tls->ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(tls->ctx, ti->session_cache);
+  }
+  else
+    SSL_CTX_set_session_cache_mode(tls->ctx, SSL_SESS_CACHE_OFF);
+#ifdef SSL_OP_NO_TICKET
+  if (!ti->session_tickets)
+    SSL_CTX_set_options(tls->ctx, SSL_OP_NO_TICKET);
+#endif
+
   /* CRIME (CVE-2012-4929) mitigation */
   SSL_CTX_set_options(tls->ctx, SSL_OP_NO_COMPRESSION);
 
@@ -904,10 +934,305 @@ int tls_events(tls_t const *tls, int mask)
     ((mask & SU_WAIT_OUT) ? tls->write_events : 0);
 }
 
-int tls_connect(su_root_magic_t *magic, su_wait_t *w, tport_t *self)
+/** Account a finished handshake in primary transport statistics. */
+static void tls_handshake_stats(tport_t *self, tls_t *tls, int ok)
+{
+  tport_tls_t *tlstp = (tport_tls_t *)self;
+  tport_tls_stats_t *stats = ((tport_tls_primary_t *)self->tp_pri)->tlspri_stats;
+  su_duration_t latency;
+
+  if (!ok) {
+    TLS_STAT_ADD(stats->tls_failed, 1);
+    return;
+  }
+
+  latency = su_duration(su_now(), tlstp->tlstp_started);
+  if (latency < 0)
+    latency = 0;
+
+  TLS_STAT_ADD(stats->tls_handshakes, 1);
+  if (SSL_session_reused(tls->con))
+    TLS_STAT_ADD(stats->tls_resumed, 1);
+  TLS_STAT_ADD(stats->tls_latency, latency);
+  for (;;) {
+    unsigned max = TLS_STAT_GET(stats->tls_latency_max);
+    if ((unsigned)latency <= max ||
+	__sync_bool_compare_and_swap(&stats->tls_latency_max, max,
+				     (unsigned)latency))
+      break;
+  }
+}
+
+/** Register connecting transport for events. */
+static int tls_handshake_events(tport_t *self, int events)
 {
   tport_master_t *mr = self->tp_master;
+  su_wait_t wait[1] = {SU_WAIT_INIT};
+
+  self->tp_events = events;
+
+  if (self->tp_index != -1) {
+    su_root_eventmask(mr->mr_root, self->tp_index,
+		      self->tp_socket, self->tp_events);
+    return 0;
+  }
+
+  /* Handshake thread is done, start polling again */
+  if (su_wait_create(wait, self->tp_socket, self->tp_events) == -1)
+    return -1;
+
+  self->tp_index = su_root_register(mr->mr_root, wait, tls_connect, self, 0);
+  if (self->tp_index == -1) {
+    su_wait_destroy(wait);
+    return -1;
+  }
+
+  return 0;
+}
+
+/** Process result from SSL_accept() or SSL_connect(). */
+static int tls_handshake_status(tport_t *self, tls_t *tls, int status)
+{
+  switch (status) {
+    case SSL_ERROR_WANT_READ:
+      /* OpenSSL is waiting for the peer to send handshake data */
+      if (tls_handshake_events(self, SU_WAIT_IN | SU_WAIT_ERR | SU_WAIT_HUP) < 0)
+	break;
+      return 0;
+
+    case SSL_ERROR_WANT_WRITE:
+      /* OpenSSL is waiting for the peer to receive handshake data */
+      if (tls_handshake_events(self, SU_WAIT_IN | SU_WAIT_ERR | SU_WAIT_HUP |
+			       SU_WAIT_OUT) < 0)
+	break;
+      return 0;
+
+    case SSL_ERROR_NONE:
+      /* TLS Handshake complete */
+      status = tls_post_connection_check(self, tls);
+      if ( status == X509_V_OK ) {
+        su_wait_t wait[1] = {SU_WAIT_INIT};
+        tport_master_t *mr = self->tp_master;
+
+	tls_handshake_stats(self, tls, 1);
+
+	if (tls_get_socket(tls) != self->tp_socket) {
+	  /* Drop the socket used by the handshake thread */
+	  BIO *bio = BIO_new_socket(self->tp_socket, BIO_NOCLOSE);
+	  if (bio)
+	    SSL_set_bio(tls->con, bio, bio), tls->bio_con = bio;
+	}
+
+        if (self->tp_index != -1)
+          su_root_deregister(mr->mr_root, self->tp_index);
+        self->tp_index = -1;
+        self->tp_events = SU_WAIT_IN | SU_WAIT_ERR | SU_WAIT_HUP;
+
+        if ((su_wait_create(wait, self->tp_socket, self->tp_events) == -1) ||
+           ((self->tp_index = su_root_register(mr->mr_root, wait, tport_wakeup,
+                                                         self, 0)) == -1)) {
+          tport_close(self);
+          tport_set_secondary_timer(self);
+          return 0;
+        }
+
+        tls->read_events = SU_WAIT_IN;
+        tls->write_events = 0;
+        self->tp_is_connected = 1;
+        self->tp_verified = tls->x509_verified;
+        self->tp_subjects = tls->subjects;
+
+        if (tport_has_queued(self))
+          tport_send_event(self);
+        else
+          tport_set_secondary_timer(self);
+
+        return 0;
+      }
+      break;
+
+    default:
+      {
+        char errbuf[64];
+        ERR_error_string_n(status, errbuf, 64);
+        SU_DEBUG_3(("%s(%p): TLS setup failed (%s)\n",
+                    __func__, (void *)self, errbuf));
+      }
+      break;
+  }
+
+  /* TLS Handshake Failed or Peer Certificate did not Verify */
+  tls_handshake_stats(self, tls, 0);
+  tport_close(self);
+  tport_set_secondary_timer(self);
+
+  return 0;
+}
+
+/** Run a handshake step in a handshake thread. */
+static void tls_handshake_run(su_root_magic_t *magic,
+			      su_msg_r msg,
+			      union tport_su_msg_arg *arg)
+{
+  tls_handshake_t *hs = arg->hs;
+  tls_t *tls = hs->hs_tls;
+  int ret;
+
+  ERR_clear_error();
+  ret = hs->hs_accept ? SSL_accept(tls->con) : SSL_connect(tls->con);
+  hs->hs_status = SSL_get_error(tls->con, ret);
+}
+
+/** Continue with the handshake in the stack thread. */
+static void tls_handshake_done(su_root_magic_t *magic,
+			       su_msg_r msg,
+			       union tport_su_msg_arg *arg)
+{
+  tls_handshake_t *hs = arg->hs;
+  tport_t *self = hs->hs_tport;
+
+  if (self == NULL) {
+    /* Transport was closed during the handshake, see tls_handshake_detach() */
+    tls_free(hs->hs_tls);
+  }
+  else {
+    tport_tls_t *tlstp = (tport_tls_t *)self;
+    tport_tls_primary_t *tlspri = (tport_tls_primary_t *)self->tp_pri;
+
+    tlstp->tlstp_handshake = NULL;
+    TLS_STAT_ADD(tlspri->tlspri_stats->tls_pending, -1);
+
+    tls_handshake_status(self, hs->hs_tls, hs->hs_status);
+  }
+
+  free(hs);
+}
+
+/** Send the next handshake step to a handshake thread.
+ *
+ * The transport is not polled until the thread is done, and the SSL
+ * object is not touched by the stack thread meanwhile.
+ *
+ * @retval 0 when step was sent
+ * @retval -1 upon an error
+ */
+static int tls_handshake_offload(tport_t *self, tls_t *tls)
+{
   tport_tls_t *tlstp = (tport_tls_t *)self;
+  tport_tls_primary_t *tlspri = (tport_tls_primary_t *)self->tp_pri;
+  tport_master_t *mr = self->tp_master;
+  su_msg_r m = SU_MSG_R_INIT;
+  tls_handshake_t *hs;
+  unsigned i;
+
+  /* The thread needs a socket of its own: if the transport is closed
+     before the thread is done, the descriptor must not get reused */
+  if (tls_get_socket(tls) == self->tp_socket) {
+#if SU_HAVE_BSDSOCK
+    su_socket_t s = dup(self->tp_socket);
+    BIO *bio;
+
+    if (s == INVALID_SOCKET)
+      return -1;
+
+    if (!(bio = BIO_new_socket(s, BIO_CLOSE))) {
+      su_close(s);
+      return -1;
+    }
+
+    SSL_set_bio(tls->con, bio, bio);
+    tls->bio_con = bio;
+#else
+    return -1;
+#endif
+  }
+
+  if (!(hs = calloc(1, sizeof *hs)))
+    return -1;
+
+  i = tlspri->tlspri_next++ % tlspri->tlspri_nthreads;
+
+  if (su_msg_create(m,
+		    su_clone_task(tlspri->tlspri_threads[i]),
+		    su_root_task(mr->mr_root),
+		    tls_handshake_run,
+		    sizeof hs) == -1) {
+    free(hs);
+    return -1;
+  }
+
+  hs->hs_tport = self;
+  hs->hs_tls = tls;
+  hs->hs_accept = self->tp_accepted;
+  su_msg_data(m)->hs = hs;
+
+  if (su_msg_report(m, tls_handshake_done) == -1 || su_msg_send(m) == -1) {
+    su_msg_destroy(m);
+    free(hs);
+    return -1;
+  }
+
+  if (self->tp_index != -1)
+    su_root_deregister(mr->mr_root, self->tp_index);
+  self->tp_index = -1;
+  self->tp_events = 0;
+
+  tlstp->tlstp_handshake = hs;
+  TLS_STAT_ADD(tlspri->tlspri_stats->tls_pending, 1);
+
+  return 0;
+}
+
+/** Hand the TLS context of a closed transport over to handshake thread.
+ *
+ * The context is freed when the handshake step is done.
+ */
+void tls_handshake_detach(tport_tls_t *tlstp)
+{
+  tport_tls_primary_t *tlspri = (tport_tls_primary_t *)tlstp->tlstp_tp->tp_pri;
+  tls_handshake_t *hs = tlstp->tlstp_handshake;
+
+  if (!hs)
+    return;
+
+  hs->hs_tport = NULL;
+  tlstp->tlstp_handshake = NULL;
+  tlstp->tlstp_context = NULL;
+  TLS_STAT_ADD(tlspri->tlspri_stats->tls_pending, -1);
+}
+
+/** Start threads running TLS handshakes for primary transport. */
+int tls_init_handshake_threads(tport_tls_primary_t *tlspri, unsigned n)
+{
+  tport_master_t *mr = tlspri->tlspri_pri->pri_master;
+  unsigned i;
+
+  if (n == 0)
+    return 0;
+
+  tlspri->tlspri_threads = su_zalloc(tlspri->tlspri_pri->pri_home,
+				     n * (sizeof *tlspri->tlspri_threads));
+  if (!tlspri->tlspri_threads)
+    return -1;
+
+  for (i = 0; i < n; i++) {
+    if (su_clone_start(mr->mr_root, tlspri->tlspri_threads[i],
+		       NULL, NULL, NULL) < 0)
+      break;
+  }
+
+  tlspri->tlspri_nthreads = i;
+
+  SU_DEBUG_5(("%s(%p): %u TLS handshake threads\n", __func__,
+	      (void *)tlspri, i));
+
+  return i == n ? 0 : -1;
+}
+
+int tls_connect(su_root_magic_t *magic, su_wait_t *w, tport_t *self)
+{
+  tport_tls_t *tlstp = (tport_tls_t *)self;
+  tport_tls_primary_t *tlspri = (tport_tls_primary_t *)self->tp_pri;
   tls_t *tls;
   int events = su_wait_events(w, self->tp_socket);
   int error;
@@ -946,69 +1271,14 @@ int tls_connect(su_root_magic_t *magic, su_wait_t *w, tport_t *self)
   }
 
   if (self->tp_is_connected == 0) {
-    int ret, status;
-
-    ret = self->tp_accepted ? SSL_accept(tls->con) : SSL_connect(tls->con);
-    status = SSL_get_error(tls->con, ret);
-
-    switch (status) {
-      case SSL_ERROR_WANT_READ:
-        /* OpenSSL is waiting for the peer to send handshake data */
-        self->tp_events = SU_WAIT_IN | SU_WAIT_ERR | SU_WAIT_HUP;
-        su_root_eventmask(mr->mr_root, self->tp_index,
-		          self->tp_socket, self->tp_events);
-        return 0;
-
-      case SSL_ERROR_WANT_WRITE:
-        /* OpenSSL is waiting for the peer to receive handshake data */
-        self->tp_events = SU_WAIT_IN | SU_WAIT_ERR | SU_WAIT_HUP | SU_WAIT_OUT;
-        su_root_eventmask(mr->mr_root, self->tp_index,
-                           self->tp_socket, self->tp_events);
-        return 0;
-
-      case SSL_ERROR_NONE:
-        /* TLS Handshake complete */
-	status = tls_post_connection_check(self, tls);
-        if ( status == X509_V_OK ) {
-          su_wait_t wait[1] = {SU_WAIT_INIT};
-          tport_master_t *mr = self->tp_master;
+    int ret;
 
-          su_root_deregister(mr->mr_root, self->tp_index);
-          self->tp_index = -1;
-          self->tp_events = SU_WAIT_IN | SU_WAIT_ERR | SU_WAIT_HUP;
-
-          if ((su_wait_create(wait, self->tp_socket, self->tp_events) == -1) ||
-             ((self->tp_index = su_root_register(mr->mr_root, wait, tport_wakeup,
-                                                           self, 0)) == -1)) {
-            tport_close(self);
-            tport_set_secondary_timer(self);
-	    return 0;
-          }
-
-          tls->read_events = SU_WAIT_IN;
-          tls->write_events = 0;
-          self->tp_is_connected = 1;
-	  self->tp_verified = tls->x509_verified;
-	  self->tp_subjects = tls->subjects;
-
-	  if (tport_has_queued(self))
-            tport_send_event(self);
-          else
-            tport_set_secondary_timer(self);
+    if (tlspri->tlspri_nthreads && tls_handshake_offload(self, tls) == 0)
+      return 0;
 
-          return 0;
-	}
-	break;
+    ret = self->tp_accepted ? SSL_accept(tls->con) : SSL_connect(tls->con);
 
-      default:
-        {
-	  char errbuf[64];
-	  ERR_error_string_n(status, errbuf, 64);
-          SU_DEBUG_3(("%s(%p): TLS setup failed (%s)\n",
-					  __func__, (void *)self, errbuf));
-        }
-        break;
-    }
+    return tls_handshake_status(self, tls, SSL_get_error(tls->con, ret));
   }
 
   /* TLS Handshake Failed or Peer Certificate did not Verify */
@@ -66,19 +66,31 @@ typedef struct tls_issues_s {
   int   version;	/* For tls1, version is 1. When ssl3/ssl2 is
 			 * used, it is 0. */
   unsigned timeout;	/* Maximum session lifetime in seconds */
+  unsigned session_cache; /* Size of server session cache, 0 disables */
+  int   session_tickets; /* If non-zero, issue RFC 5077 session tickets */
 } tls_issues_t;
 
 typedef struct tport_tls_s {
   tport_t  tlstp_tp[1];
   tls_t   *tlstp_context;
   char    *tlstp_buffer;
+  su_time_t tlstp_started;	/* When handshake started */
+  struct tls_handshake_s *tlstp_handshake; /* Handshake running in thread */
 } tport_tls_t;
 
 typedef struct tport_tls_primary_s {
   tport_primary_t tlspri_pri[1];
   tls_t *tlspri_master;
+  su_clone_r *tlspri_threads;	/* Handshake threads */
+  unsigned tlspri_nthreads;
+  unsigned tlspri_next;		/* Next handshake thread to use */
+  tport_tls_stats_t tlspri_stats[1]; /* Use TLS_STAT_ADD()/TLS_STAT_GET() */
 } tport_tls_primary_t;
 
+/* Statistics are read by tport_tls_stats() from any thread */
+#define TLS_STAT_ADD(x, n) ((void)__sync_add_and_fetch(&(x), (n)))
+#define TLS_STAT_GET(x) (__sync_add_and_fetch(&(x), 0))
+
 tls_t *tls_init_master(tls_issues_t *tls_issues);
 tls_t *tls_init_secondary(tls_t *tls_master, int sock, int accept);
 void tls_free(tls_t *tls);
@@ -89,6 +101,8 @@ int tls_want_read(tls_t *tls, int events);
 int tls_pending(tls_t const *tls);
 
 int tls_connect(su_root_magic_t *magic, su_wait_t *w, tport_t *self);
+int tls_init_handshake_threads(tport_tls_primary_t *tlspri, unsigned n);
+void tls_handshake_detach(tport_tls_t *tlstp);
 ssize_t tls_write(tls_t *tls, void *buf, size_t size);
 int tls_want_write(tls_t *tls, int events);
 
@@ -183,6 +183,9 @@ static int tport_tls_init_master(tport_primary_t *pri,
   char const *tls_ciphers = NULL;
   unsigned tls_version = 1;
   unsigned tls_timeout = 300;
+  unsigned tls_session_cache = 20480;
+  int tls_session_tickets = 1;
+  unsigned tls_handshake_threads = 0;
   unsigned tls_verify = 0;
   char const *passphrase = NULL;
   unsigned tls_policy = TPTLS_VERIFY_NONE;
@@ -202,6 +205,9 @@ static int tport_tls_init_master(tport_primary_t *pri,
 	  TPTAG_TLS_CIPHERS_REF(tls_ciphers),
 	  TPTAG_TLS_VERSION_REF(tls_version),
 	  TPTAG_TLS_TIMEOUT_REF(tls_timeout),
+	  TPTAG_TLS_SESSION_CACHE_REF(tls_session_cache),
+	  TPTAG_TLS_SESSION_TICKETS_REF(tls_session_tickets),
+	  TPTAG_TLS_HANDSHAKE_THREADS_REF(tls_handshake_threads),
 	  TPTAG_TLS_VERIFY_PEER_REF(tls_verify),
 	  TPTAG_TLS_PASSPHRASE_REF(passphrase),
 	  TPTAG_TLS_VERIFY_POLICY_REF(tls_policy),
@@ -234,6 +240,8 @@ static int tport_tls_init_master(tport_primary_t *pri,
     if (tls_ciphers) ti.ciphers = su_strdup(autohome, tls_ciphers);
     ti.version = tls_version;
     ti.timeout = tls_timeout;
+    ti.session_cache = tls_session_cache;
+    ti.session_tickets = tls_session_tickets;
     ti.CApath = su_strdup(autohome, path);
 
     SU_DEBUG_9(("%s(%p): tls key = %s\n", __func__, (void *)pri, ti.key));
@@ -266,6 +274,9 @@ static int tport_tls_init_master(tport_primary_t *pri,
                   __func__, (void *)pri, buf));
   }
 
+  if (tls_init_handshake_threads(tlspri, tls_handshake_threads) < 0)
+    return *return_culprit = "tls_init_handshake_threads", -1;
+
   if (tls_subjects)
     pri->pri_primary->tp_subjects = su_strlst_dup(pri->pri_home, tls_subjects);
   pri->pri_has_tls = 1;
@@ -276,6 +287,12 @@ static int tport_tls_init_master(tport_primary_t *pri,
 static void tport_tls_deinit_primary(tport_primary_t *pri)
 {
   tport_tls_primary_t *tlspri = (tport_tls_primary_t *)pri;
+  unsigned i;
+
+  for (i = 0; i < tlspri->tlspri_nthreads; i++)
+    su_clone_wait(pri->pri_master->mr_root, tlspri->tlspri_threads[i]);
+  tlspri->tlspri_nthreads = 0;
+
   tls_free(tlspri->tlspri_master), tlspri->tlspri_master = NULL;
 }
 
@@ -294,6 +311,8 @@ static int tport_tls_init_secondary(tport_t *self, int socket, int accepted,
   if (!tlstp->tlstp_context)
     return *return_reason = "tls_init_slave", -1;
 
+  tlstp->tlstp_started = su_now();
+
   return 0;
 }
 
@@ -301,6 +320,9 @@ static void tport_tls_deinit_secondary(tport_t *self)
 {
   tport_tls_t *tlstp = (tport_tls_t *)self;
 
+  /* Context is freed after the handshake thread is done with it */
+  tls_handshake_detach(tlstp);
+
   /* XXX - PPe: does the tls_shutdown zap everything but socket? */
   if (tlstp->tlstp_context != NULL)
     tls_free(tlstp->tlstp_context);
@@ -697,3 +719,50 @@ sys_error:
   su_seterrno(err);
   return NULL;
 }
+
+/** Get TLS handshake statistics.
+ *
+ * Sum the handshake counters of the TLS primary transports belonging to
+ * the master transport of @a self.
+ *
+ * @retval 0 when successful
+ * @retval -1 upon an error
+ *
+ * @NEW_UNRELEASED
+ */
+int tport_tls_stats(tport_t const *self, tport_tls_stats_t *stats)
+{
+  tport_primary_t *pri;
+
+  if (self == NULL || stats == NULL)
+    return su_seterrno(EINVAL);
+
+  memset(stats, 0, sizeof *stats);
+
+  /* Not necessarily called from the stack thread */
+  TPORT_PRIMARIES_LOCK(self->tp_master);
+
+  for (pri = self->tp_master->mr_primaries; pri; pri = pri->pri_next) {
+    tport_tls_stats_t *st;
+    unsigned max;
+
+    if (pri->pri_vtable != &tport_tls_vtable &&
+	pri->pri_vtable != &tport_tls_client_vtable)
+      continue;
+
+    st = ((tport_tls_primary_t *)pri)->tlspri_stats;
+
+    stats->tls_handshakes += TLS_STAT_GET(st->tls_handshakes);
+    stats->tls_resumed += TLS_STAT_GET(st->tls_resumed);
+    stats->tls_failed += TLS_STAT_GET(st->tls_failed);
+    stats->tls_latency += TLS_STAT_GET(st->tls_latency);
+    max = TLS_STAT_GET(st->tls_latency_max);
+    if (max > stats->tls_latency_max)
+      stats->tls_latency_max = max;
+    stats->tls_pending += TLS_STAT_GET(st->tls_pending);
+  }
+
+  TPORT_PRIMARIES_UNLOCK(self->tp_master);
+
+  return 0;
+}
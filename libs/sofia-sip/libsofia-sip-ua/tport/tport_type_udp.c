@@ -119,6 +119,36 @@ tport_vtable_t const tport_udp_vtable =
 
 static void tport_check_trunc(tport_t *tp, su_addrinfo_t *ai);
 
+#if defined(SO_REUSEPORT)
+/** Check that nobody is bound to the address yet.
+ *
+ * With SO_REUSEPORT our bind would succeed even when another profile or
+ * process already has the address, and the kernel would then split the
+ * traffic between us. A plain bind fails in that case, as it did before
+ * the thread pool.
+ */
+static int tport_udp_address_in_use(su_addrinfo_t const *ai)
+{
+  su_sockaddr_t const *su = (su_sockaddr_t const *)ai->ai_addr;
+  su_socket_t probe;
+  int in_use;
+
+  if (su->su_port == 0)
+    return 0;			/* the kernel picks a free port for us */
+
+  probe = su_socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+  if (probe == INVALID_SOCKET)
+    return 0;
+
+  in_use = bind(probe, ai->ai_addr, (socklen_t)ai->ai_addrlen) == -1 &&
+    su_errno() == EADDRINUSE;
+
+  su_close(probe);
+
+  return in_use;
+}
+#endif
+
 int tport_udp_init_primary(tport_primary_t *pri,
 			   tp_name_t tpn[1],
 			   su_addrinfo_t *ai,
@@ -139,6 +169,17 @@ int tport_udp_init_primary(tport_primary_t *pri,
 
   pri->pri_primary->tp_socket = s;
 
+#if defined(SO_REUSEPORT)
+  /* Worker sockets of the thread pool share the address with us */
+  if (pri->pri_params->tpp_thrpsize > 0) {
+    if (tport_udp_address_in_use(ai))
+      return *return_culprit = "bind", -1;
+
+    if (setsockopt(s, SOL_SOCKET, SO_REUSEPORT, (void *)&one, sizeof one) < 0)
+      return *return_culprit = "setsockopt(SO_REUSEPORT)", -1;
+  }
+#endif
+
   if (tport_bind_socket(s, ai, return_culprit) < 0)
     return -1;
 
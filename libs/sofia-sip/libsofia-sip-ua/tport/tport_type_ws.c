@@ -214,7 +214,7 @@ int tport_recv_stream_ws(tport_t *self)
 	  return -1;
   }
 
-  N = ws_read_frame(&wstp->ws, &oc, &data);
+  N = ws_read_frame_masked(&wstp->ws, &oc, &data);
 
   if (N == -2) {
 	  return 2;
@@ -241,9 +241,13 @@ int tport_recv_stream_ws(tport_t *self)
 
   msg_set_address(msg, self->tp_addr, self->tp_addrlen);
 
+  /* Unmask while copying, so the payload is touched only once */
   for (i = 0, n = 0; i < veclen; i++) {
     m = iovec[i].mv_len; assert(N >= n + m);
-    memcpy(iovec[i].mv_base, data + n, m);
+    if (wstp->ws.masked)
+      ws_unmask(iovec[i].mv_base, data + n, m, wstp->ws.mask, n);
+    else
+      memcpy(iovec[i].mv_base, data + n, m);
     n += m;
   }
 
@@ -259,73 +263,37 @@ int tport_recv_stream_ws(tport_t *self)
   return 1;
 }
 
-/** Send to stream */
+/** Send to stream.
+ *
+ * The message is sent as a single text frame. The message fragments are
+ * passed to the frame writer as they are, so that the frame header and
+ * payload are written with one system call without copying.
+ */
 ssize_t tport_send_stream_ws(tport_t const *self, msg_t *msg,
 			  msg_iovec_t iov[],
 			  size_t iovlen)
 {
-  size_t i, j, n, m, size = 0;
+  size_t i, size = 0;
   ssize_t nerror;
   tport_ws_t *wstp = (tport_ws_t *)self;
 
-  enum { WSBUFSIZE = 2048 };
+  for (i = 0; i < iovlen; i++)
+    size += iov[i].siv_len;
 
-  for (i = 0; i < iovlen; i = j) {
-    char *buf = wstp->wstp_buffer;
-    unsigned wsbufsize = WSBUFSIZE;
+  /* msg_iovec_t has the layout of struct iovec (WSABUF on Windows) */
+  nerror = ws_write_framev(&wstp->ws, WSOC_TEXT,
+			   (ws_iovec_t const *)iov, (int)iovlen);
 
-    if (i + 1 == iovlen) {
-		buf = NULL;		/* Don't bother copying single chunk */
-	}
+  SU_DEBUG_9(("tport_ws_writevec: vec %p %p %lu ("MOD_ZD")\n",
+	      (void *)&wstp->ws, (void *)iov[0].siv_base, (LU)size,
+	      nerror));
 
-    if (buf &&
-		(char *)iov[i].siv_base - buf < WSBUFSIZE &&
-		(char *)iov[i].siv_base - buf >= 0) {
-		wsbufsize = buf + WSBUFSIZE - (char *)iov[i].siv_base;
-		assert(wsbufsize <= WSBUFSIZE);
-    }
-
-    for (j = i, m = 0; buf && j < iovlen; j++) {
-		if (m + iov[j].siv_len > wsbufsize) {
-			break;
-		}
-		if (buf + m != iov[j].siv_base) {
-			memcpy(buf + m, iov[j].siv_base, iov[j].siv_len);
-		}
-		m += iov[j].siv_len; iov[j].siv_len = 0;
-    }
-	
-    if (j == i) {
-      buf = iov[i].siv_base, m = iov[i].siv_len, j++;
-	} else {
-      iov[j].siv_base = buf, iov[j].siv_len = m;
-	}
-
-	nerror = ws_feed_buf(&wstp->ws, buf, m);
-	
-    SU_DEBUG_9(("tport_ws_writevec: vec %p %p %lu ("MOD_ZD")\n",
-		(void *)&wstp->ws, (void *)iov[i].siv_base, (LU)iov[i].siv_len,
-		nerror));
-
-    if (nerror == -1) {
-      int err = su_errno();
-      if (su_is_blocking(err))
-	break;
-      SU_DEBUG_3(("ws_write: %s\n", strerror(err)));
-      return -1;
-    }
-
-    n = (size_t)nerror;
-    size += n;
-
-    /* Return if the write buffer is full for now */
-    if (n != m)
-      break;
+  if (nerror < 0) {
+    int err = su_errno();
+    SU_DEBUG_3(("ws_write: %s\n", strerror(err)));
+    return -1;
   }
 
-  ws_send_buf(&wstp->ws, WSOC_TEXT);
-
-
   return size;
 }
 
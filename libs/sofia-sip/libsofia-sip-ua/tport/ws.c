@@ -550,7 +550,36 @@ ssize_t ws_close(wsh_t *wsh, int16_t reason)
 	
 }
 
-ssize_t ws_read_frame(wsh_t *wsh, ws_opcode_t *oc, uint8_t **data)
+/* XOR len bytes of src with the 4-byte mask key into dst, a machine word
+ * at a time. offset is the position of src within the frame payload, so
+ * that a payload can be unmasked in several pieces. dst may be src. */
+void ws_unmask(void *dst, void const *src, size_t len, uint8_t const mask[4], size_t offset)
+{
+	uint8_t *d = dst;
+	uint8_t const *s = src;
+	uint8_t key[8];
+	uint64_t k, w;
+	size_t i;
+
+	for (i = 0; i < 8; i++) {
+		key[i] = mask[(offset + i) & 3];
+	}
+
+	memcpy(&k, key, sizeof(k));
+
+	/* Unaligned-safe word loop, compilers turn it into SIMD */
+	for (i = 0; i + 8 <= len; i += 8) {
+		memcpy(&w, s + i, sizeof(w));
+		w ^= k;
+		memcpy(d + i, &w, sizeof(w));
+	}
+
+	for (; i < len; i++) {
+		d[i] = s[i] ^ key[i & 7];
+	}
+}
+
+static ssize_t ws_read_frame_internal(wsh_t *wsh, ws_opcode_t *oc, uint8_t **data, int unmask)
 {
 	
 	ssize_t need = 2;
@@ -560,6 +589,7 @@ ssize_t ws_read_frame(wsh_t *wsh, ws_opcode_t *oc, uint8_t **data)
 	need = 2;
 	maskp = NULL;
 	*data = NULL;
+	wsh->masked = 0;
 
 	if (wsh->down) {
 		return -1;
@@ -613,7 +643,8 @@ ssize_t ws_read_frame(wsh_t *wsh, ws_opcode_t *oc, uint8_t **data)
 			wsh->payload = &wsh->buffer[2];
 
 			if (wsh->plen == 127) {
-				uint64_t *u64;
+				uint64_t u64 = 0;
+				int i;
 
 				need += 8;
 
@@ -623,10 +654,19 @@ ssize_t ws_read_frame(wsh_t *wsh, ws_opcode_t *oc, uint8_t **data)
 					return ws_close(wsh, WS_PROTO_ERR);
 				}
 
-				u64 = (uint64_t *) wsh->payload;
+				for (i = 0; i < 8; i++) {
+					u64 = (u64 << 8) | (uint8_t)wsh->payload[i];
+				}
+
 				wsh->payload += 8;
 
-				wsh->plen = ntohl((u_long)*u64);
+				if (u64 > (uint64_t)wsh->buflen) {
+					/* too big - protocol err */
+					*oc = WSOC_CLOSE;
+					return ws_close(wsh, WS_DATA_TOO_BIG);
+				}
+
+				wsh->plen = (ssize_t)u64;
 
 			} else if (wsh->plen == 126) {
 				uint16_t *u16;
@@ -680,13 +720,16 @@ ssize_t ws_read_frame(wsh_t *wsh, ws_opcode_t *oc, uint8_t **data)
 			}
 			
 			if (mask && maskp) {
-				ssize_t i;
+				memcpy(wsh->mask, maskp, 4);
 
-				for (i = 0; i < wsh->datalen; i++) {
-					wsh->payload[i] ^= maskp[i % 4];
+				if (unmask || *oc == WSOC_PING) {
+					ws_unmask(wsh->payload, wsh->payload, wsh->rplen, wsh->mask, 0);
+				} else {
+					/* Caller unmasks while copying the payload out */
+					wsh->masked = 1;
 				}
 			}
-			
+
 
 			if (*oc == WSOC_PING) {
 				ws_write_frame(wsh, WSOC_PONG, wsh->payload, wsh->rplen);
@@ -713,6 +756,19 @@ ssize_t ws_read_frame(wsh_t *wsh, ws_opcode_t *oc, uint8_t **data)
 	}
 }
 
+ssize_t ws_read_frame(wsh_t *wsh, ws_opcode_t *oc, uint8_t **data)
+{
+	return ws_read_frame_internal(wsh, oc, data, 1);
+}
+
+/* Like ws_read_frame(), but leave the payload masked. If wsh->masked is
+ * set, the caller must unmask the payload with ws_unmask() and wsh->mask,
+ * which lets it unmask while copying the payload into its own buffer. */
+ssize_t ws_read_frame_masked(wsh_t *wsh, ws_opcode_t *oc, uint8_t **data)
+{
+	return ws_read_frame_internal(wsh, oc, data, 0);
+}
+
 ssize_t ws_feed_buf(wsh_t *wsh, void *data, size_t bytes)
 {
 
@@ -743,51 +799,152 @@ ssize_t ws_send_buf(wsh_t *wsh, ws_opcode_t oc)
 }
 
 
-ssize_t ws_write_frame(wsh_t *wsh, ws_opcode_t oc, void *data, size_t bytes)
+/* Encode a frame header for an unmasked, final frame into hdr; return its length */
+size_t ws_frame_header(uint8_t hdr[14], ws_opcode_t oc, size_t bytes)
 {
-	uint8_t hdr[14] = { 0 };
 	size_t hlen = 2;
 
-	if (wsh->down) {
-		return -1;
-	}
-
-	//printf("WRITE[%ld]-----------------------------:\n[%s]\n-----------------------------------\n", bytes, (char *) data);
-
 	hdr[0] = (uint8_t)(oc | 0x80);
 
 	if (bytes < 126) {
 		hdr[1] = (uint8_t)bytes;
 	} else if (bytes < 0x10000) {
-		uint16_t *u16;
-
 		hdr[1] = 126;
+		hdr[2] = (uint8_t)(bytes >> 8);
+		hdr[3] = (uint8_t)bytes;
 		hlen += 2;
-
-		u16 = (uint16_t *) &hdr[2];
-		*u16 = htons((uint16_t) bytes);
-
 	} else {
-		uint64_t *u64;
+		uint64_t u64 = bytes;
+		int i;
 
 		hdr[1] = 127;
+
+		for (i = 7; i >= 0; i--) {
+			hdr[2 + i] = (uint8_t)u64;
+			u64 >>= 8;
+		}
+
 		hlen += 8;
-		
-		u64 = (uint64_t *) &hdr[2];
-		*u64 = htonl(bytes);
 	}
 
-	if (ws_raw_write(wsh, (void *) &hdr[0], hlen) != (ssize_t)hlen) {
+	return hlen;
+}
+
+#ifndef _MSC_VER
+/* Write whole iovec with writev(), resuming after partial writes */
+static ssize_t ws_raw_writev(wsh_t *wsh, struct iovec *v, int n)
+{
+	ssize_t r, total = 0;
+
+	while (n > 0) {
+		r = writev(wsh->sock, v, n);
+
+		if (r < 0) {
+			if (xp_is_blocking(xp_errno())) {
+				continue;
+			}
+			return -1;
+		}
+
+		total += r;
+
+		while (n > 0 && (size_t)r >= v->iov_len) {
+			r -= v->iov_len;
+			v++, n--;
+		}
+
+		if (n > 0) {
+			v->iov_base = (char *)v->iov_base + r;
+			v->iov_len -= r;
+		}
+	}
+
+	return total;
+}
+#endif
+
+/* Send payload in iov as a single frame. On plain sockets the header and
+ * payload chunks go out with one writev(). With TLS they are gathered
+ * into wbuffer and sent with one SSL_write(), so that each frame is
+ * also a single TLS record. */
+ssize_t ws_write_framev(wsh_t *wsh, ws_opcode_t oc, ws_iovec_t const *iov, int iovcnt)
+{
+	uint8_t hdr[14];
+	size_t hlen, bytes = 0;
+	int i;
+
+	if (wsh->down) {
 		return -1;
 	}
 
-	if (ws_raw_write(wsh, data, bytes) != (ssize_t)bytes) {
-		return -2;
+	for (i = 0; i < iovcnt; i++) {
+		bytes += iov[i].iov_len;
 	}
-	
+
+	hlen = ws_frame_header(hdr, oc, bytes);
+
+#ifndef _MSC_VER
+	if (!wsh->ssl && iovcnt < WS_IOV_MAX) {
+		struct iovec v[WS_IOV_MAX];
+
+		v[0].iov_base = hdr;
+		v[0].iov_len = hlen;
+
+		for (i = 0; i < iovcnt; i++) {
+			v[i + 1] = iov[i];
+		}
+
+		if (ws_raw_writev(wsh, v, iovcnt + 1) != (ssize_t)(hlen + bytes)) {
+			return -1;
+		}
+
+		return bytes;
+	}
+#endif
+
+	if (hlen + bytes <= sizeof(wsh->wbuffer)) {
+		char *p = wsh->wbuffer + hlen + bytes;
+
+		/* Back to front, payload may already be in wbuffer (ws_send_buf) */
+		for (i = iovcnt - 1; i >= 0; i--) {
+			p -= iov[i].iov_len;
+			memmove(p, iov[i].iov_base, iov[i].iov_len);
+		}
+
+		memcpy(wsh->wbuffer, hdr, hlen);
+
+		if (ws_raw_write(wsh, wsh->wbuffer, hlen + bytes) != (ssize_t)(hlen + bytes)) {
+			return -1;
+		}
+
+		return bytes;
+	}
+
+	if (ws_raw_write(wsh, hdr, hlen) != (ssize_t)hlen) {
+		return -1;
+	}
+
+	for (i = 0; i < iovcnt; i++) {
+		if (ws_raw_write(wsh, iov[i].iov_base, iov[i].iov_len) != (ssize_t)iov[i].iov_len) {
+			return -2;
+		}
+	}
+
 	return bytes;
 }
 
+ssize_t ws_write_frame(wsh_t *wsh, ws_opcode_t oc, void *data, size_t bytes)
+{
+	ws_iovec_t iov[1];
+
+	//printf("WRITE[%ld]-----------------------------:\n[%s]\n-----------------------------------\n", bytes, (char *) data);
+
+	iov->iov_base = data;
+	iov->iov_len = bytes;
+
+	return ws_write_framev(wsh, oc, iov, 1);
+}
+
 #ifdef _MSC_VER
 
 int xp_errno(void)
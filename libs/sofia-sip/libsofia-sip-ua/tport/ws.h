@@ -22,6 +22,9 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <errno.h>
+#ifndef _MSC_VER
+#include <sys/uio.h>
+#endif
 //#include "sha1.h"
 #include <openssl/ssl.h>
 
@@ -51,6 +54,19 @@ extern struct ws_globals_s ws_globals;
 typedef int ws_socket_t;
 #define ws_sock_invalid -1
 
+#ifndef _MSC_VER
+typedef struct iovec ws_iovec_t;
+#else
+/* Same layout as WSABUF */
+typedef struct {
+	unsigned long iov_len;
+	void *iov_base;
+} ws_iovec_t;
+#endif
+
+/* Maximum number of payload chunks sent with a single writev() */
+#define WS_IOV_MAX 64
+
 
 typedef enum {
 	WS_NONE = 0,
@@ -83,6 +99,8 @@ typedef struct wsh_s {
 	uint8_t down;
 	int secure;
 	uint8_t close_sock;
+	uint8_t masked;
+	uint8_t mask[4];
 } wsh_t;
 
 ssize_t ws_send_buf(wsh_t *wsh, ws_opcode_t oc);
@@ -92,7 +110,11 @@ ssize_t ws_feed_buf(wsh_t *wsh, void *data, size_t bytes);
 ssize_t ws_raw_read(wsh_t *wsh, void *data, size_t bytes);
 ssize_t ws_raw_write(wsh_t *wsh, void *data, size_t bytes);
 ssize_t ws_read_frame(wsh_t *wsh, ws_opcode_t *oc, uint8_t **data);
+ssize_t ws_read_frame_masked(wsh_t *wsh, ws_opcode_t *oc, uint8_t **data);
 ssize_t ws_write_frame(wsh_t *wsh, ws_opcode_t oc, void *data, size_t bytes);
+ssize_t ws_write_framev(wsh_t *wsh, ws_opcode_t oc, ws_iovec_t const *iov, int iovcnt);
+size_t ws_frame_header(uint8_t hdr[14], ws_opcode_t oc, size_t bytes);
+void ws_unmask(void *dst, void const *src, size_t len, uint8_t const mask[4], size_t offset);
 int ws_init(wsh_t *wsh, ws_socket_t sock, SSL_CTX *ssl_ctx, int close_sock);
 ssize_t ws_close(wsh_t *wsh, int16_t reason);
 void ws_destroy(wsh_t *wsh);
@@ -128,6 +128,11 @@ struct t30_state_s
     /*! \brief An opaque pointer supplied in document callbacks. */
     void *document_user_data;
 
+    /*! \brief The handler TIFF writing of received pages is deferred to, if any. */
+    t4_rx_deferred_handler_t rx_deferred_handler;
+    /*! \brief An opaque pointer supplied to the deferred TIFF write handler. */
+    void *rx_deferred_user_data;
+
     /*! \brief The handler for changes to the receive mode */
     t30_set_handler_t set_rx_type_handler;
     /*! \brief An opaque pointer passed to the handler for changes to the receive mode */
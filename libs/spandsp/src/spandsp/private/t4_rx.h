@@ -144,6 +144,11 @@ struct t4_rx_state_s
     /*! \brief All TIFF file specific state information for the T.4 context. */
     t4_rx_tiff_state_t tiff;
 
+    /*! \brief The handler which TIFF writing is deferred to, if any. */
+    t4_rx_deferred_handler_t deferred_handler;
+    /*! \brief An opaque pointer passed to the deferred handler. */
+    void *deferred_user_data;
+
     /*! \brief Error and flow logging control */
     logging_state_t logging;
 };
@@ -420,6 +420,14 @@ SPAN_DECLARE(const char *) t30_get_rx_model(t30_state_t *s);
     \param stop_page The maximum page to receive. -1 for no restriction. */
 SPAN_DECLARE(void) t30_set_rx_file(t30_state_t *s, const char *file, int stop_page);
 
+/*! Hand the TIFF writing of received pages to a handler, instead of doing it
+    in the middle of the signal processing. See t4_rx_set_deferred_handler().
+    \brief Set a deferred TIFF write handler for received documents.
+    \param s The T.30 context.
+    \param handler The handler, or NULL to write in place.
+    \param user_data An opaque pointer passed to the handler. */
+SPAN_DECLARE(void) t30_set_rx_deferred_handler(t30_state_t *s, t4_rx_deferred_handler_t handler, void *user_data);
+
 /*! Specify the file name of the next TIFF file to be transmitted by a T.30
     context.
     \brief Set next transmit file name.
@@ -396,6 +396,19 @@ typedef struct
     int line_image_size;
 } t4_stats_t;
 
+/*!
+    A finished page, or the closing of the file, of a T.4 receive context in deferred
+    mode. It carries everything needed to write it to the TIFF file later.
+*/
+typedef struct t4_rx_deferred_s t4_rx_deferred_t;
+
+/*! \brief Deferred TIFF write handler. It takes ownership of the job, and must have
+           t4_rx_deferred_run() called on it, in the order the jobs of the context were handed over.
+    \param user_data An opaque pointer.
+    \param job The job.
+    \return 0 if the job was taken, -1 to have it written straight away. */
+typedef int (*t4_rx_deferred_handler_t)(void *user_data, t4_rx_deferred_t *job);
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -430,6 +443,18 @@ SPAN_DECLARE(int) t4_rx_end_page(t4_rx_state_t *s);
     \return 0 for success, otherwise -1. */
 SPAN_DECLARE(int) t4_rx_set_row_write_handler(t4_rx_state_t *s, t4_row_write_handler_t handler, void *user_data);
 
+/*! \brief Hand the TIFF writing of finished pages, and the closing of the file, to a handler
+           instead of doing it in t4_rx_end_page() and t4_rx_release(). Set it after t4_rx_init().
+    \param s The T.4 receive context.
+    \param handler The handler, or NULL to write in place.
+    \param user_data An opaque pointer passed to the handler. */
+SPAN_DECLARE(void) t4_rx_set_deferred_handler(t4_rx_state_t *s, t4_rx_deferred_handler_t handler, void *user_data);
+
+/*! \brief Write a job handed to a deferred TIFF write handler, and free it.
+    \param job The job.
+    \return 0 for success, otherwise -1. */
+SPAN_DECLARE(int) t4_rx_deferred_run(t4_rx_deferred_t *job);
+
 /*! \brief Set the encoding for the received data.
     \param s The T.4 context.
     \param encoding The encoding.
@@ -2805,6 +2805,7 @@ static int process_rx_dcs(t30_state_t *s, const uint8_t *msg, int len)
             send_dcn(s);
             return -1;
         }
+        t4_rx_set_deferred_handler(&s->t4.rx, s->rx_deferred_handler, s->rx_deferred_user_data);
         s->operation_in_progress = OPERATION_IN_PROGRESS_T4_RX;
     }
     if (!(s->iaf & T30_IAF_MODE_NO_TCF))
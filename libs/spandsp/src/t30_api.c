@@ -625,6 +625,13 @@ SPAN_DECLARE(void) t30_set_rx_file(t30_state_t *s, const char *file, int stop_pa
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) t30_set_rx_deferred_handler(t30_state_t *s, t4_rx_deferred_handler_t handler, void *user_data)
+{
+    s->rx_deferred_handler = handler;
+    s->rx_deferred_user_data = user_data;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) t30_set_tx_file(t30_state_t *s, const char *file, int start_page, int stop_page)
 {
     strncpy(s->tx_file, file, sizeof(s->tx_file));
@@ -704,6 +704,83 @@ static int write_tiff_image(t4_rx_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+struct t4_rx_deferred_s
+{
+    /*! \brief True to close the file, false to write a page to it. */
+    bool close;
+    /*! \brief The receive context as it was when the job was handed over. The image
+               buffers belong to the job. */
+    t4_rx_state_t state;
+};
+
+static int close_tiff_output_file(t4_rx_state_t *s);
+
+/* Take the state of the context, with its image buffers, and hand it to the deferred
+   handler. The live context starts the next page with fresh buffers. */
+static int defer_tiff_job(t4_rx_state_t *s, bool close)
+{
+    t4_rx_deferred_t *job;
+
+    if ((job = (t4_rx_deferred_t *) span_alloc(sizeof(*job))) == NULL)
+        return -1;
+    job->close = close;
+    memcpy(&job->state, s, sizeof(*s));
+    if (close)
+    {
+        s->tiff.tiff_file = NULL;
+        s->tiff.file = NULL;
+        job->state.tiff.image_buffer = NULL;
+        job->state.tiff.image_size = 0;
+        job->state.tiff.image_buffer_size = 0;
+    }
+    else
+    {
+        s->tiff.image_buffer = NULL;
+        s->tiff.image_size = 0;
+        s->tiff.image_buffer_size = 0;
+        if (s->current_decoder == 0)
+        {
+            s->decoder.no_decoder.buf = NULL;
+            s->decoder.no_decoder.buf_len = 0;
+            s->decoder.no_decoder.buf_ptr = 0;
+        }
+    }
+    if (s->deferred_handler(s->deferred_user_data, job) < 0)
+        t4_rx_deferred_run(job);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_rx_deferred_run(t4_rx_deferred_t *job)
+{
+    t4_rx_state_t *s;
+    int ret;
+
+    s = &job->state;
+    if (job->close)
+    {
+        ret = close_tiff_output_file(s);
+    }
+    else
+    {
+        ret = write_tiff_image(s);
+        if (s->current_decoder == 0  &&  s->decoder.no_decoder.buf)
+            span_free(s->decoder.no_decoder.buf);
+        if (s->tiff.image_buffer)
+            span_free(s->tiff.image_buffer);
+    }
+    span_free(job);
+    return ret;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) t4_rx_set_deferred_handler(t4_rx_state_t *s, t4_rx_deferred_handler_t handler, void *user_data)
+{
+    s->deferred_handler = handler;
+    s->deferred_user_data = user_data;
+}
+/*- End of function --------------------------------------------------------*/
+
 static int close_tiff_output_file(t4_rx_state_t *s)
 {
     int i;
@@ -744,7 +821,12 @@ static int close_tiff_output_file(t4_rx_state_t *s)
 static void tiff_rx_release(t4_rx_state_t *s)
 {
     if (s->tiff.tiff_file)
-        close_tiff_output_file(s);
+    {
+        if (s->deferred_handler)
+            defer_tiff_job(s, true);
+        else
+            close_tiff_output_file(s);
+    }
     if (s->tiff.image_buffer)
     {
         span_free(s->tiff.image_buffer);
@@ -1304,7 +1386,19 @@ SPAN_DECLARE(int) t4_rx_end_page(t4_rx_state_t *s)
     if (length == 0)
         return -1;
 
-    if (s->tiff.tiff_file)
+    if (s->tiff.tiff_file  &&  s->deferred_handler)
+    {
+        /* The same test write_tiff_image() starts with, the rest of it is left to the handler */
+        if (s->decoder.no_decoder.buf_ptr <= 0  &&  (s->tiff.image_buffer == NULL  ||  s->tiff.image_size <= 0))
+        {
+            s->tiff.image_size = 0;
+            return 0;
+        }
+        s->tiff.pages_in_file = s->current_page + 1;
+        defer_tiff_job(s, false);
+        s->current_page++;
+    }
+    else if (s->tiff.tiff_file)
     {
         if (write_tiff_image(s) == 0)
             s->current_page++;
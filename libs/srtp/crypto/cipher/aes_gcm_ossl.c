@@ -188,6 +188,7 @@ err_status_t aes_gcm_openssl_context_init (aes_gcm_ctx_t *c, const uint8_t *key)
     debug_print(mod_aes_gcm, "key:  %s", v128_hex_string((v128_t*)&c->key));
 
     EVP_CIPHER_CTX_cleanup(&c->ctx);
+    c->key_set = 0;
 
     return (err_status_ok);
 }
@@ -222,8 +223,18 @@ err_status_t aes_gcm_openssl_set_iv (aes_gcm_ctx_t *c, void *iv,
         break;
     }
 
-    if (!EVP_CipherInit_ex(&c->ctx, evp, NULL, (const unsigned char*)&c->key.v8,
-                           NULL, (c->dir == direction_encrypt ? 1 : 0))) {
+    /*
+     * expand the key on the first call only, afterwards just switch the
+     * direction and keep the key schedule for the rest of the stream
+     */
+    if (!c->key_set) {
+        if (!EVP_CipherInit_ex(&c->ctx, evp, NULL, (const unsigned char*)&c->key.v8,
+                               NULL, (c->dir == direction_encrypt ? 1 : 0))) {
+            return (err_status_init_fail);
+        }
+        c->key_set = 1;
+    } else if (!EVP_CipherInit_ex(&c->ctx, NULL, NULL, NULL, NULL,
+                                  (c->dir == direction_encrypt ? 1 : 0))) {
         return (err_status_init_fail);
     }
 
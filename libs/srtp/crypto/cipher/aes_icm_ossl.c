@@ -250,6 +250,7 @@ err_status_t aes_icm_openssl_context_init (aes_icm_ctx_t *c, const uint8_t *key)
     debug_print(mod_aes_icm, "offset: %s", v128_hex_string(&c->offset));
 
     EVP_CIPHER_CTX_cleanup(&c->ctx);
+    c->key_set = 0;
 
     return err_status_ok;
 }
@@ -258,6 +259,10 @@ err_status_t aes_icm_openssl_context_init (aes_icm_ctx_t *c, const uint8_t *key)
 /*
  * aes_icm_set_iv(c, iv) sets the counter value to the exor of iv with
  * the offset
+ *
+ * the key is expanded into the EVP context on the first call only, later
+ * calls just load the new counter so the key schedule is reused for every
+ * packet of the stream
  */
 err_status_t aes_icm_openssl_set_iv (aes_icm_ctx_t *c, void *iv, int dir)
 {
@@ -285,8 +290,14 @@ err_status_t aes_icm_openssl_set_iv (aes_icm_ctx_t *c, void *iv, int dir)
         break;
     }
 
-    if (!EVP_EncryptInit_ex(&c->ctx, evp,
-                            NULL, c->key.v8, c->counter.v8)) {
+    if (!c->key_set) {
+        if (!EVP_EncryptInit_ex(&c->ctx, evp, NULL, c->key.v8, NULL)) {
+            return err_status_fail;
+        }
+        c->key_set = 1;
+    }
+
+    if (!EVP_EncryptInit_ex(&c->ctx, NULL, NULL, NULL, c->counter.v8)) {
         return err_status_fail;
     } else {
         return err_status_ok;
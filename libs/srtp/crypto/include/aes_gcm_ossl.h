@@ -54,6 +54,7 @@ typedef struct {
   v256_t   key;
   int      key_size;
   int      tag_len;
+  int      key_set;   /* ctx holds the key schedule */
   EVP_CIPHER_CTX ctx;
   cipher_direction_t dir;
 } aes_gcm_ctx_t;
@@ -63,6 +63,7 @@ typedef struct {
     v128_t offset;                 /* initial offset value             */
     v256_t key;
     int key_size;
+    int key_set;                   /* ctx holds the key schedule       */
     EVP_CIPHER_CTX ctx;
 } aes_icm_ctx_t;
 
@@ -86,6 +86,15 @@ srtp_do_timing(const srtp_policy_t *policy);
 void
 srtp_do_rejection_timing(const srtp_policy_t *policy);
 
+double
+srtp_packets_per_second(int msg_len_octets, const srtp_policy_t *policy);
+
+void
+err_check(err_status_t s);
+
+void
+srtp_do_packet_timing(const srtp_policy_t *policy);
+
 err_status_t
 srtp_test(const srtp_policy_t *policy);
 
@@ -108,8 +117,9 @@ extern uint8_t test_key[46];
 
 void
 usage(char *prog_name) {
-  printf("usage: %s [ -t ][ -c ][ -v ][-d <debug_module> ]* [ -l ]\n"
+  printf("usage: %s [ -t ][ -p ][ -c ][ -v ][-d <debug_module> ]* [ -l ]\n"
          "  -t         run timing test\n"
+         "  -p         run protect/unprotect packet rate test\n"
 	 "  -r         run rejection timing test\n"
          "  -c         run codec timing test\n"
          "  -v         run validation tests\n"
@@ -146,6 +156,7 @@ int
 main (int argc, char *argv[]) {
   int q;
   unsigned do_timing_test    = 0;
+  unsigned do_packet_timing  = 0;
   unsigned do_rejection_test = 0;
   unsigned do_codec_timing   = 0;
   unsigned do_validation     = 0;
@@ -180,13 +191,16 @@ main (int argc, char *argv[]) {
 
   /* process input arguments */
   while (1) {
-    q = getopt_s(argc, argv, "trcvld:");
+    q = getopt_s(argc, argv, "tprcvld:");
     if (q == -1) 
       break;
     switch (q) {
     case 't':
       do_timing_test = 1;
       break;
+    case 'p':
+      do_packet_timing = 1;
+      break;
     case 'r':
       do_rejection_test = 1;
       break;
@@ -212,7 +226,7 @@ main (int argc, char *argv[]) {
   }
 
   if (!do_validation && !do_timing_test && !do_codec_timing 
-      && !do_list_mods && !do_rejection_test)
+      && !do_list_mods && !do_rejection_test && !do_packet_timing)
     usage(argv[0]);
 
   if (do_list_mods) {
@@ -327,6 +341,17 @@ main (int argc, char *argv[]) {
     }
   }
 
+  if (do_packet_timing) {
+    const srtp_policy_t **policy = policy_array;
+    
+    /* loop over policies, run packet rate test for each */
+    while (*policy != NULL) {
+      srtp_print_policy(*policy);
+      srtp_do_packet_timing(*policy);
+      policy++;
+    }
+  }
+
   if (do_rejection_test) {
     const srtp_policy_t **policy = policy_array;
     
@@ -487,6 +512,29 @@ srtp_do_rejection_timing(const srtp_policy_t *policy) {
 
 }
 
+void
+srtp_do_packet_timing(const srtp_policy_t *policy) {
+  static const int payloads[] = { 20, 160, 320, 1200, 0 };
+  int i;
+  double pps;
+
+  /*
+   * each packet is protected by one context and unprotected by another,
+   * as a call's media would be on the way out and in.  A call is
+   * counted as one 50 packet per second stream in each direction.
+   */
+  printf("# testing srtp protect+unprotect packet rate:\r\n");
+  printf("# payload (octets)\tpackets per second\tcalls per core\r\n");
+
+  for (i = 0; payloads[i]; i++) {
+    pps = srtp_packets_per_second(payloads[i], policy);
+    printf("%d\t\t\t%f\t\t%d\r\n", payloads[i], pps, (int)(pps / 50));
+  }
+
+  printf("\r\n\r\n");
+
+}
+
 
 #define MAX_MSG_LEN 1024
 
@@ -558,6 +606,60 @@ srtp_bits_per_second(int msg_len_octets, const srtp_policy_t *policy) {
                   num_trials * CLOCKS_PER_SEC / timer;   
 }
 
+double
+srtp_packets_per_second(int msg_len_octets, const srtp_policy_t *policy) {
+  srtp_t srtp_sender, srtp_rcvr;
+  srtp_policy_t rcvr_policy;
+  srtp_hdr_t *mesg;
+  int i;
+  clock_t timer;
+  int num_trials = 100000;
+  int len;
+  uint32_t ssrc;
+
+  memcpy(&rcvr_policy, policy, sizeof(srtp_policy_t));
+  if (policy->ssrc.type == ssrc_any_outbound) {
+    rcvr_policy.ssrc.type = ssrc_any_inbound;
+  }
+
+  err_check(srtp_create(&srtp_sender, policy));
+  err_check(srtp_create(&srtp_rcvr, &rcvr_policy));
+
+  if (policy->ssrc.type != ssrc_specific) {
+    ssrc = 0xdeadbeef;
+  } else {
+    ssrc = policy->ssrc.value;
+  }
+
+  mesg = srtp_create_test_packet(msg_len_octets, ssrc);
+  if (mesg == NULL)
+    return 0.0;   /* indicate failure by returning zero */
+
+  timer = clock();
+  for (i=0; i < num_trials; i++) {
+    len = msg_len_octets + 12;  /* add in rtp header length */
+
+    /* protect and unprotect in place, leaving the plaintext packet */
+    err_check(srtp_protect(srtp_sender, mesg, &len));
+    err_check(srtp_unprotect(srtp_rcvr, mesg, &len));
+
+    /* increment message number */
+    {
+      /* hack sequence to avoid problems with macros for htons/ntohs on some systems */
+      short new_seq = ntohs(mesg->seq) + 1;
+      mesg->seq = htons(new_seq);
+    }
+  }
+  timer = clock() - timer;
+
+  free(mesg);
+
+  err_check(srtp_dealloc(srtp_sender));
+  err_check(srtp_dealloc(srtp_rcvr));
+
+  return (double) num_trials * CLOCKS_PER_SEC / timer;
+}
+
 double
 srtp_rejections_per_second(int msg_len_octets, const srtp_policy_t *policy) {
   srtp_ctx_t *srtp;
@@ -100,14 +100,52 @@ typedef enum {
 	SSF_READ_CODEC_RESET = (1 << 7),
 	SSF_WRITE_CODEC_RESET = (1 << 8),
 	SSF_DESTROYABLE = (1 << 9),
-	SSF_MEDIA_BUG_TAP_ONLY = (1 << 10)
+	SSF_MEDIA_BUG_TAP_ONLY = (1 << 10),
+	SSF_THREAD_RELEASED = (1 << 11)
 } switch_session_flag_t;
 
 
+typedef enum {
+	SWITCH_MEDIA_TAP_READ = 0,
+	SWITCH_MEDIA_TAP_WRITE = 1
+} switch_media_tap_dir_t;
+
+#define SWITCH_MEDIA_TAP_FRAMES 128
+#define SWITCH_MEDIA_TAP_LAYOUTS 3
+
+/* One direction of the audio of a session, copied in once per frame for all the media bugs
+   reading it. head counts the bytes ever written, each bug reads at its own cursor behind it.
+   Nothing is copied in while there are no readers. */
+typedef struct switch_media_tap_ring_s {
+	uint8_t *data;
+	uint32_t size;
+	switch_atomic_t head;
+	switch_atomic_t readers;
+} switch_media_tap_ring_t;
+
+/* The last frame mixed by a media bug, handed as is to bugs asking for the same span of both rings in the same layout */
+typedef struct switch_media_tap_view_s {
+	uint8_t valid;
+	uint32_t read_pos;
+	uint32_t read_len;
+	uint32_t write_pos;
+	uint32_t write_len;
+	uint32_t bytes;
+	uint32_t datalen;
+	uint8_t data[SWITCH_RECOMMENDED_BUFFER_SIZE * 2];
+} switch_media_tap_view_t;
+
+typedef struct switch_media_tap_s {
+	switch_media_tap_ring_t ring[2];
+	switch_mutex_t *view_mutex;
+	switch_media_tap_view_t views[SWITCH_MEDIA_TAP_LAYOUTS];
+} switch_media_tap_t;
+
 struct switch_core_session {
 	switch_memory_pool_t *pool;
 	switch_thread_t *thread;
 	switch_thread_id_t thread_id;
+	switch_thread_data_t *thread_data;
 	switch_endpoint_interface_t *endpoint_interface;
 	switch_size_t id;
 	switch_session_flag_t flags;
@@ -152,6 +190,7 @@ struct switch_core_session {
 	switch_queue_t *private_event_queue_pri;
 	switch_thread_rwlock_t *bug_rwlock;
 	switch_media_bug_t *bugs;
+	switch_media_tap_t *media_tap;
 	switch_app_log_t *app_log;
 	uint32_t stack_count;
 
@@ -182,8 +221,10 @@ struct switch_core_session {
 };
 
 struct switch_media_bug {
-	switch_buffer_t *raw_write_buffer;
+	/* Only for a bug demuxing its read stream, the others read the session's media tap */
 	switch_buffer_t *raw_read_buffer;
+	switch_atomic_t tap_pos[2];
+	uint8_t tap_attached[2];
 	switch_frame_t *read_replace_frame_in;
 	switch_frame_t *read_replace_frame_out;
 	switch_frame_t *write_replace_frame_in;
@@ -192,7 +233,6 @@ struct switch_media_bug {
 	switch_frame_t *native_write_frame;
 	switch_media_bug_callback_t callback;
 	switch_mutex_t *read_mutex;
-	switch_mutex_t *write_mutex;
 	switch_core_session_t *session;
 	void *user_data;
 	uint32_t flags;
@@ -301,6 +341,7 @@ struct switch_session_manager {
 	int busy;
 	int popping;
 	int starting;
+	int released;
 };
 
 extern struct switch_session_manager session_manager;
@@ -312,5 +353,10 @@ void switch_core_sqldb_stop(void);
 void switch_core_session_init(switch_memory_pool_t *pool);
 void switch_core_session_uninit(void);
 void switch_core_state_machine_init(switch_memory_pool_t *pool);
+void switch_ivr_phrase_init(switch_memory_pool_t *pool);
+void switch_ivr_phrase_shutdown(void);
+switch_bool_t switch_core_session_run_releasable(switch_core_session_t *session);
+uint32_t switch_core_media_tap_write(switch_core_session_t *session, switch_media_tap_dir_t dir, const void *data, uint32_t datalen);
+void switch_core_media_tap_skip(switch_media_bug_t *bug, switch_media_tap_dir_t dir, uint32_t datalen);
 switch_memory_pool_t *switch_core_memory_init(void);
 void switch_core_memory_stop(void);
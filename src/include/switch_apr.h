@@ -1304,6 +1304,11 @@ SWITCH_DECLARE(switch_status_t) switch_mcast_interface(switch_socket_t *sock, sw
 #define SWITCH_POLLHUP 0x020			/**< Hangup occurred */
 #define SWITCH_POLLNVAL 0x040		/**< Descriptior invalid */
 
+/**
+ * Pollset flags
+ */
+#define SWITCH_POLLSET_THREADSAFE 0x001	/**< Adding or removing a descriptor is thread safe */
+
 /**
  * Setup a pollset object
  * @param pollset  The pointer in which to return the newly created object 
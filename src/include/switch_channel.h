@@ -306,8 +306,51 @@ SWITCH_DECLARE(switch_status_t) switch_channel_get_scope_variables(switch_channe
 SWITCH_DECLARE(const char *) switch_channel_get_variable_dup(switch_channel_t *channel, const char *varname, switch_bool_t dup, int idx);
 #define switch_channel_get_variable(_c, _v) switch_channel_get_variable_dup(_c, _v, SWITCH_TRUE, -1)
 
+/*!
+  \brief Copy a variable of the channel itself into a pool, without falling back to the caller profile or the global variables
+  \param channel channel to retrieve variable from
+  \param varname the name of the variable
+  \param pool the pool to copy the value into
+  \return a copy of the value or NULL
+*/
+SWITCH_DECLARE(const char *) switch_channel_get_variable_pdup(switch_channel_t *channel, const char *varname, switch_memory_pool_t *pool);
+
 SWITCH_DECLARE(switch_status_t) switch_channel_get_variables(switch_channel_t *channel, switch_event_t **event);
 
+/*!
+  \brief Called when a variable is not found on the channel, so the endpoint can create it on demand
+  \param channel the channel
+  \param varname the name of the variable being looked up
+  \param user_data the data given to switch_channel_set_variable_resolver
+  \return SWITCH_STATUS_SUCCESS if the variable has been set on the channel
+  \note The resolver runs with the variable lock of the channel held and must only set variables of that channel
+*/
+typedef switch_status_t (*switch_channel_variable_resolver_t)(switch_channel_t *channel, const char *varname, void *user_data);
+
+/*!
+  \brief Install a resolver for variables the channel does not have yet, NULL removes it
+  \param channel the channel
+  \param resolver the resolver
+  \param user_data passed to the resolver
+*/
+SWITCH_DECLARE(void) switch_channel_set_variable_resolver(switch_channel_t *channel, switch_channel_variable_resolver_t resolver, void *user_data);
+
+/*!
+  \brief Called when the state, running state or call state of a channel changes or it hangs up
+  \param channel the channel
+  \param user_data the data given to switch_channel_set_watcher
+  \note The watcher runs in whatever thread made the change and must not block
+*/
+typedef void (*switch_channel_watcher_t)(switch_channel_t *channel, void *user_data);
+
+/*!
+  \brief Install a watcher on the channel, NULL removes it. Once removed it is not running and won't be called again.
+  \param channel the channel
+  \param watcher the watcher
+  \param user_data passed to the watcher
+*/
+SWITCH_DECLARE(void) switch_channel_set_watcher(switch_channel_t *channel, switch_channel_watcher_t watcher, void *user_data);
+
 SWITCH_DECLARE(switch_status_t) switch_channel_pass_callee_id(switch_channel_t *channel, switch_channel_t *other_channel);
 
 /*!
@@ -595,6 +638,27 @@ SWITCH_DECLARE(void) switch_channel_event_set_data(_In_ switch_channel_t *channe
 SWITCH_DECLARE(void) switch_channel_event_set_basic_data(_In_ switch_channel_t *channel, _In_ switch_event_t *event);
 SWITCH_DECLARE(void) switch_channel_event_set_extended_data(_In_ switch_channel_t *channel, _In_ switch_event_t *event);
 
+/*!
+  \brief Fire a CALL_UPDATE event for a channel
+  \param channel channel the update is about
+  \param direction SEND when the callee id went out to the far end, RECV when it came in
+  \param sent_name the callee id name that was sent (SEND only)
+  \param sent_number the callee id number that was sent (SEND only)
+*/
+SWITCH_DECLARE(void) switch_channel_fire_call_update(_In_ switch_channel_t *channel, _In_ const char *direction,
+													 _In_opt_z_ const char *sent_name, _In_opt_z_ const char *sent_number);
+
+/*!
+  \brief Copy what the last CALL_UPDATE event of a channel said into a pool
+  \param channel channel to look at
+  \param pool the pool to copy the values into
+  \param direction the direction of the update or NULL
+  \param sent_name the callee id name that was sent or NULL
+  \param sent_number the callee id number that was sent or NULL
+*/
+SWITCH_DECLARE(void) switch_channel_get_call_update(_In_ switch_channel_t *channel, _In_ switch_memory_pool_t *pool,
+													const char **direction, const char **sent_name, const char **sent_number);
+
 /*!
   \brief Expand varaibles in a string based on the variables in a paticular channel
   \param channel channel to expand the variables from
@@ -949,6 +949,25 @@ SWITCH_DECLARE(uint32_t) switch_core_session_hupall_matching_var_ans(_In_ const
 SWITCH_DECLARE(switch_console_callback_match_t *) switch_core_session_findall_matching_var(const char *var_name, const char *var_val);
 #define switch_core_session_hupall_matching_var(_vn, _vv, _c) switch_core_session_hupall_matching_var_ans(_vn, _vv, _c, SHT_UNANSWERED | SHT_ANSWERED)
 SWITCH_DECLARE(switch_console_callback_match_t *) switch_core_session_findall(void);
+
+typedef enum {
+	SCR_CHANNELS,
+	SCR_CALLS,
+	SCR_BRIDGED_CALLS,
+	SCR_DETAILED_CALLS,
+	SCR_DETAILED_BRIDGED_CALLS
+} switch_channel_rows_t;
+
+/*! 
+  \brief Walk the live sessions as rows shaped like the core db channels table or the basic_calls/detailed_calls views
+  \param type which table or view to produce
+  \param like optional filter, a LIKE pattern (% and _) matched against uuid, name, cid_name, cid_num and presence_data
+  \param callback called once per row with the same column names the core db would return, NULL to only count
+  \param pArg user data for the callback
+  \return the number of rows
+*/
+SWITCH_DECLARE(uint32_t) switch_core_session_channel_rows(switch_channel_rows_t type, const char *like,
+														  switch_core_db_callback_func_t callback, void *pArg);
 /*! 
   \brief Hangup all sessions that belong to an endpoint
   \param endpoint_interface The endpoint interface 
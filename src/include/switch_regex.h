@@ -50,6 +50,23 @@ SWITCH_DECLARE(int) switch_regex_copy_substring(const char *subject, int *ovecto
 SWITCH_DECLARE(void) switch_regex_free(void *data);
 
 SWITCH_DECLARE(int) switch_regex_perform(const char *field, const char *expression, switch_regex_t **new_re, int *ovector, uint32_t olen);
+
+/*!
+ \brief Compile an expression the way switch_regex_perform() does, including _ast patterns and /regex/flags
+ \param expression The regular expression
+ \return The compiled expression to be freed with switch_regex_free() or NULL on error
+*/
+SWITCH_DECLARE(switch_regex_t *) switch_regex_compile_expression(const char *expression);
+
+/*!
+ \brief Match a string against an expression compiled once with switch_regex_compile_expression()
+ \param re The compiled expression, it may be shared by several threads
+ \param field The string to find a match in
+ \param ovector The vector receiving the substring offsets
+ \param olen The number of elements in ovector
+ \return The match count as switch_regex_perform() returns it, 0 if there was no match
+*/
+SWITCH_DECLARE(int) switch_regex_exec(switch_regex_t *re, const char *field, int *ovector, uint32_t olen);
 SWITCH_DECLARE(void) switch_perform_substitution(switch_regex_t *re, int match_count, const char *data, const char *field_data,
 												 char *substituted, switch_size_t len, int *ovector);
 
@@ -342,6 +342,9 @@ SWITCH_DECLARE(switch_status_t) switch_xml_init(_In_ switch_memory_pool_t *pool,
 
 SWITCH_DECLARE(switch_status_t) switch_xml_reload(const char **err);
 
+///\brief forget the preprocessed includes kept for reloads so the next one reads every file again
+SWITCH_DECLARE(void) switch_xml_clear_preprocess_cache(void);
+
 SWITCH_DECLARE(switch_status_t) switch_xml_destroy(void);
 
 ///\brief retrieve the core XML root node
@@ -349,6 +352,15 @@ SWITCH_DECLARE(switch_status_t) switch_xml_destroy(void);
 ///\note this will cause a readlock on the root until it's released with \see switch_xml_free
 SWITCH_DECLARE(switch_xml_t) switch_xml_root(void);
 
+///\brief tell whether the core xml root was replaced
+///\return a number changing every time a new root is set
+SWITCH_DECLARE(uint32_t) switch_xml_root_generation(void);
+
+///\brief check if a search function is bound to a section
+///\param section the name of the section
+///\return SWITCH_TRUE if lookups in the section may be answered by a binding rather than the root
+SWITCH_DECLARE(switch_bool_t) switch_xml_section_bound(const char *section);
+
 ///\brief locate an xml pointer in the core registry
 ///\param section the section to look in
 ///\param tag_name the type of tag in that section
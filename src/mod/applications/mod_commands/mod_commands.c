@@ -2551,6 +2551,10 @@ SWITCH_STANDARD_API(reload_xml_function)
 {
 	const char *err = "";
 
+	if (!zstr(cmd) && !strcasecmp(cmd, "full")) {
+		switch_xml_clear_preprocess_cache();
+	}
+
 	switch_xml_reload(&err);
 	stream->write_function(stream, "+OK [%s]\n", err);
 
@@ -4323,6 +4327,347 @@ SWITCH_STANDARD_API(originate_function)
 	return status;
 }
 
+#define ORIGINATE_BENCH_SYNTAX "<legs> [<answer_ms>]"
+SWITCH_STANDARD_API(originate_bench_function)
+{
+	switch_core_session_t *caller_session = NULL;
+	switch_call_cause_t cause = SWITCH_CAUSE_NORMAL_CLEARING;
+	switch_stream_handle_t dial = { 0 };
+	char *mycmd = NULL, *argv[2] = { 0 };
+	int argc, legs, answer_ms = 2000, x;
+	switch_time_t start, elapsed;
+	switch_status_t status;
+#ifndef WIN32
+	clock_t cpu;
+#endif
+
+	if (zstr(cmd)) {
+		stream->write_function(stream, "-USAGE: %s\n", ORIGINATE_BENCH_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	mycmd = strdup(cmd);
+	switch_assert(mycmd);
+	argc = switch_separate_string(mycmd, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+
+	if (argc < 1 || (legs = atoi(argv[0])) < 1) {
+		stream->write_function(stream, "-USAGE: %s\n", ORIGINATE_BENCH_SYNTAX);
+		goto done;
+	}
+
+	if (argc > 1 && (answer_ms = atoi(argv[1])) < 0) {
+		answer_ms = 0;
+	}
+
+	/* Every leg rings, only the last one answers; the others ring until the winner hangs them up */
+	SWITCH_STANDARD_STREAM(dial);
+	dial.write_function(&dial, "{ignore_early_media=true}");
+
+	for (x = 1; x < legs; x++) {
+		dial.write_function(&dial, "loopback/m:^:ring_ready^sleep:%d^hangup/default/inline,", answer_ms + 60000);
+	}
+
+	dial.write_function(&dial, "loopback/m:^:ring_ready^sleep:%d^answer^park/default/inline", answer_ms);
+
+#ifndef WIN32
+	cpu = clock();
+#endif
+	start = switch_micro_time_now();
+
+	status = switch_ivr_originate(NULL, &caller_session, &cause, (char *) dial.data, (answer_ms / 1000) + 30,
+								  NULL, NULL, NULL, NULL, NULL, SOF_NONE, NULL);
+
+	elapsed = switch_micro_time_now() - start;
+
+	stream->write_function(stream, "%s legs: %d answer after: %dms elapsed: %" SWITCH_TIME_T_FMT "ms overshoot: %" SWITCH_TIME_T_FMT "ms",
+						   status == SWITCH_STATUS_SUCCESS && caller_session ? "+OK" : "-ERR", legs, answer_ms,
+						   elapsed / 1000, (elapsed / 1000) - answer_ms);
+#ifndef WIN32
+	stream->write_function(stream, " cpu: %ldms", (long) ((clock() - cpu) * 1000 / CLOCKS_PER_SEC));
+#endif
+	stream->write_function(stream, " idle: %.2f%% cause: %s\n", switch_core_idle_cpu(), switch_channel_cause2str(cause));
+
+	if (caller_session) {
+		switch_channel_hangup(switch_core_session_get_channel(caller_session), SWITCH_CAUSE_NORMAL_CLEARING);
+		switch_core_session_rwunlock(caller_session);
+	}
+
+	switch_safe_free(dial.data);
+
+  done:
+	switch_safe_free(mycmd);
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define SQL_STMT_CACHE_TEST_SYNTAX "[<core db name>]"
+typedef struct {
+	switch_core_db_t *db;
+	int hold_ms;
+} sql_lock_holder_t;
+
+static void *SWITCH_THREAD_FUNC sql_lock_holder_run(switch_thread_t *thread, void *obj)
+{
+	sql_lock_holder_t *holder = (sql_lock_holder_t *) obj;
+
+	switch_yield(holder->hold_ms * 1000);
+	switch_core_db_exec(holder->db, "commit", NULL, NULL, NULL);
+
+	return NULL;
+}
+
+/* Run a statement often enough to be cached, then again while another connection holds the
+   database locked: it has to wait for the lock like an uncached one instead of failing. */
+SWITCH_STANDARD_API(sql_stmt_cache_test_function)
+{
+	const char *dsn = zstr(cmd) ? "sql_stmt_cache_test" : cmd;
+	switch_cache_db_handle_t *dbh = NULL;
+	switch_memory_pool_t *pool = NULL;
+	switch_thread_t *thread = NULL;
+	switch_threadattr_t *thd_attr = NULL;
+	switch_status_t st;
+	sql_lock_holder_t holder = { 0 };
+	char *update = "update stmt_cache_test set n=n+1 where id=1";
+	char *err = NULL, count[32] = "";
+	switch_time_t start, waited = 0;
+	int i, ok = 1;
+
+	if (switch_cache_db_get_db_handle_dsn(&dbh, dsn) != SWITCH_STATUS_SUCCESS || switch_cache_db_get_type(dbh) != SCDB_TYPE_CORE_DB) {
+		stream->write_function(stream, "-ERR %s is not a core db\n", dsn);
+		goto done;
+	}
+
+	switch_cache_db_execute_sql(dbh, "drop table if exists stmt_cache_test", NULL);
+	switch_cache_db_execute_sql(dbh, "create table stmt_cache_test (id integer, n integer)", NULL);
+	switch_cache_db_execute_sql(dbh, "insert into stmt_cache_test values(1,0)", NULL);
+
+	/* the second run prepares it for the cache, the third is served from it */
+	for (i = 0; i < 3; i++) {
+		ok &= switch_cache_db_execute_sql(dbh, update, NULL) == SWITCH_STATUS_SUCCESS;
+	}
+
+	if (!(holder.db = switch_core_db_open_file(dsn)) || switch_core_db_exec(holder.db, "begin exclusive", NULL, NULL, NULL) != SWITCH_CORE_DB_OK) {
+		stream->write_function(stream, "-ERR Cannot lock %s\n", dsn);
+		goto done;
+	}
+
+	holder.hold_ms = 500;
+	switch_core_new_memory_pool(&pool);
+	switch_threadattr_create(&thd_attr, pool);
+	switch_thread_create(&thread, thd_attr, sql_lock_holder_run, &holder, pool);
+
+	start = switch_micro_time_now();
+	ok &= switch_cache_db_execute_sql(dbh, update, &err) == SWITCH_STATUS_SUCCESS;
+	waited = switch_micro_time_now() - start;
+
+	switch_thread_join(&st, thread);
+
+	switch_cache_db_execute_sql2str(dbh, "select n from stmt_cache_test where id=1", count, sizeof(count), NULL);
+	ok &= atoi(count) == 4;
+
+	switch_cache_db_execute_sql(dbh, "drop table stmt_cache_test", NULL);
+
+	stream->write_function(stream, "%s count: %s (expected 4) waited for the lock: %" SWITCH_TIME_T_FMT "us%s%s\n",
+						   ok ? "+OK" : "-ERR", count, waited, err ? " error: " : "", switch_str_nil(err));
+
+  done:
+	switch_safe_free(err);
+
+	if (holder.db) {
+		switch_core_db_close(holder.db);
+	}
+
+	if (pool) {
+		switch_core_destroy_memory_pool(&pool);
+	}
+
+	switch_cache_db_release_db_handle(&dbh);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define PORT_ALLOC_BENCH_SYNTAX "<ports> [<iterations>] [<spare>]"
+SWITCH_STANDARD_API(port_alloc_bench_function)
+{
+	switch_core_port_allocator_t *alloc = NULL;
+	switch_port_t *held = NULL;
+	char *mycmd = NULL, *argv[3] = { 0 };
+	int argc, ports, iterations = 100000, spare = 4, fill, i, x, failed = 0;
+	switch_time_t start, fill_time, churn_time;
+
+	if (zstr(cmd)) {
+		stream->write_function(stream, "-USAGE: %s\n", PORT_ALLOC_BENCH_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	mycmd = strdup(cmd);
+	switch_assert(mycmd);
+	argc = switch_separate_string(mycmd, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+
+	/* even ports from 16384 up, as many as fit below 65535 */
+	if (argc < 1 || (ports = atoi(argv[0])) < 2 || ports > 24576) {
+		stream->write_function(stream, "-USAGE: %s (2 to 24576 ports)\n", PORT_ALLOC_BENCH_SYNTAX);
+		goto done;
+	}
+
+	if (argc > 1 && (iterations = atoi(argv[1])) < 1) {
+		iterations = 1;
+	}
+
+	if (argc > 2) {
+		spare = atoi(argv[2]);
+	}
+
+	if (spare < 1 || spare >= ports) {
+		spare = 1;
+	}
+
+	if (switch_core_port_allocator_new("127.0.0.1", 16384, (switch_port_t) (16384 + (ports - 1) * 2), SPF_EVEN, &alloc) != SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "-ERR Cannot create port allocator\n");
+		goto done;
+	}
+
+	switch_zmalloc(held, ports * sizeof(*held));
+
+	/* Run the range down to a few spare ports, then keep freeing and requesting one at a time */
+	fill = ports - spare;
+	start = switch_micro_time_now();
+
+	for (i = 0; i < fill; i++) {
+		if (switch_core_port_allocator_request_port(alloc, &held[i]) != SWITCH_STATUS_SUCCESS) {
+			failed++;
+		}
+	}
+
+	fill_time = switch_micro_time_now() - start;
+	start = switch_micro_time_now();
+
+	for (x = 0; x < iterations; x++) {
+		i = rand() % fill;
+
+		if (held[i]) {
+			switch_core_port_allocator_free_port(alloc, held[i]);
+		}
+
+		if (switch_core_port_allocator_request_port(alloc, &held[i]) != SWITCH_STATUS_SUCCESS) {
+			failed++;
+		}
+	}
+
+	churn_time = switch_micro_time_now() - start;
+
+	stream->write_function(stream, "+OK ports: %d spare: %d fill: %" SWITCH_TIME_T_FMT "us churn: %d in %" SWITCH_TIME_T_FMT "us (%.1fns each) failed: %d\n",
+						   ports, spare, fill_time, iterations, churn_time, (double) churn_time * 1000 / iterations, failed);
+
+	switch_safe_free(held);
+	switch_core_port_allocator_destroy(&alloc);
+
+  done:
+	switch_safe_free(mycmd);
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* Threads and resident set of this process, from /proc */
+static switch_status_t proc_self_usage(int *threads, long *rss_kb)
+{
+#ifdef __linux__
+	FILE *fp;
+	char line[256];
+	int found = 0;
+
+	if (!(fp = fopen("/proc/self/status", "r"))) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (!strncmp(line, "Threads:", 8)) {
+			*threads = atoi(line + 8);
+			found++;
+		} else if (!strncmp(line, "VmRSS:", 6)) {
+			*rss_kb = atol(line + 6);
+			found++;
+		}
+	}
+
+	fclose(fp);
+
+	return found == 2 ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_FALSE;
+#else
+	return SWITCH_STATUS_FALSE;
+#endif
+}
+
+#define SESSION_THREAD_BENCH_SYNTAX "<calls> [<b leg app>]"
+/* Hold up <calls> answered loopback calls and report what each costs in threads and RSS. The a legs
+   hibernate (signal only), the b legs run <b leg app>, park by default. Compare with session-thread-release on and off. */
+SWITCH_STANDARD_API(session_thread_bench_function)
+{
+	switch_core_session_t **held = NULL;
+	switch_call_cause_t cause;
+	char *mycmd = NULL, *argv[2] = { 0 }, *dial = NULL;
+	const char *app = "park";
+	int argc, calls, up = 0, x;
+	int threads_before = 0, threads_after = 0;
+	long rss_before = 0, rss_after = 0;
+
+	if (zstr(cmd)) {
+		stream->write_function(stream, "-USAGE: %s\n", SESSION_THREAD_BENCH_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	mycmd = strdup(cmd);
+	switch_assert(mycmd);
+	argc = switch_separate_string(mycmd, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+
+	if (argc < 1 || (calls = atoi(argv[0])) < 1 || calls > 10000) {
+		stream->write_function(stream, "-USAGE: %s (1 to 10000 calls)\n", SESSION_THREAD_BENCH_SYNTAX);
+		goto done;
+	}
+
+	if (argc > 1 && !zstr(argv[1])) {
+		app = argv[1];
+	}
+
+	if (proc_self_usage(&threads_before, &rss_before) != SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "-ERR Cannot read /proc/self/status\n");
+		goto done;
+	}
+
+	switch_zmalloc(held, calls * sizeof(*held));
+	dial = switch_mprintf("loopback/m:^:answer^%s/default/inline", app);
+
+	for (x = 0; x < calls; x++) {
+		switch_core_session_t *session = NULL;
+
+		if (switch_ivr_originate(NULL, &session, &cause, dial, 10, NULL, NULL, NULL, NULL, NULL, SOF_NONE, NULL) != SWITCH_STATUS_SUCCESS || !session) {
+			stream->write_function(stream, "-ERR call %d failed: %s\n", x + 1, switch_channel_cause2str(cause));
+			break;
+		}
+
+		switch_channel_set_state(switch_core_session_get_channel(session), CS_HIBERNATE);
+		held[up++] = session;
+	}
+
+	/* let the legs settle into their states and give back what they can */
+	switch_yield(1000000);
+	proc_self_usage(&threads_after, &rss_after);
+
+	stream->write_function(stream, "%s calls: %d b leg: %s session-thread-release: %s threads: %d -> %d (%.2f per call) rss: %ldkB -> %ldkB (%.1fkB per call)\n",
+						   up == calls ? "+OK" : "-ERR", up, app, switch_core_test_flag(SCF_SESSION_THREAD_RELEASE) ? "true" : "false",
+						   threads_before, threads_after, up ? (double) (threads_after - threads_before) / up : 0.0,
+						   rss_before, rss_after, up ? (double) (rss_after - rss_before) / up : 0.0);
+
+	for (x = 0; x < up; x++) {
+		switch_channel_hangup(switch_core_session_get_channel(held[x]), SWITCH_CAUSE_NORMAL_CLEARING);
+		switch_core_session_rwunlock(held[x]);
+	}
+
+  done:
+	switch_safe_free(held);
+	switch_safe_free(dial);
+	switch_safe_free(mycmd);
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_STANDARD_API(sched_del_function)
 {
 	uint32_t cnt = 0;
@@ -4814,13 +5159,31 @@ SWITCH_STANDARD_API(coalesce_function)
 	return status;
 }
 
+/* Channel and call listings come from the session table, they do not need the core db */
+static void show_channel_rows(switch_channel_rows_t rows, const char *like, switch_core_db_callback_func_t callback, struct holder *holder)
+{
+	if (holder->justcount) {
+		char count[25];
+		char *argv[1] = { count };
+		char *names[1] = { "count(*)" };
+
+		switch_snprintf(count, sizeof(count), "%u", switch_core_session_channel_rows(rows, like, NULL, NULL));
+		callback(holder, 1, argv, names);
+	} else {
+		switch_core_session_channel_rows(rows, like, callback, holder);
+	}
+}
+
 #define SHOW_SYNTAX "codec|endpoint|application|api|dialplan|file|timer|calls [count]|channels [count|like <match string>]|calls|detailed_calls|bridged_calls|detailed_bridged_calls|aliases|complete|chat|management|modules|nat_map|say|interfaces|interface_types|tasks|limits|status"
 SWITCH_STANDARD_API(show_function)
 {
 	char sql[1024];
-	char *errmsg;
-	switch_cache_db_handle_t *db;
+	char *errmsg = NULL;
+	switch_cache_db_handle_t *db = NULL;
 	struct holder holder = { 0 };
+	switch_channel_rows_t rows = SCR_CHANNELS;
+	int use_rows = 0;
+	char *like = NULL;
 	int help = 0;
 	char *mydata = NULL, *argv[6] = { 0 };
 	char *command = NULL, *as = NULL;
@@ -4834,16 +5197,6 @@ SWITCH_STANDARD_API(show_function)
 	set_format(holder.format, stream);
 	html = holder.format->html; /* html is just a shortcut */
 
-	if (!(cflags & SCF_USE_SQL)) {
-		stream->write_function(stream, "-ERR SQL disabled, no data available!\n");
-		return SWITCH_STATUS_SUCCESS;
-	}
-
-	if (switch_core_db_handle(&db) != SWITCH_STATUS_SUCCESS) {
-		stream->write_function(stream, "%s", "-ERR Database error!\n");
-		return SWITCH_STATUS_SUCCESS;
-	}
-
 	holder.justcount = 0;
 
 	if (cmd && *cmd && (mydata = strdup(cmd))) {
@@ -4943,9 +5296,9 @@ SWITCH_STANDARD_API(show_function)
 		}
 
 		if (!strcasecmp(command, "calls")) {
-			sprintf(sql, "select * from basic_calls where hostname='%s' order by call_created_epoch", switch_core_get_switchname());
+			use_rows = 1;
+			rows = SCR_CALLS;
 			if (argv[1] && !strcasecmp(argv[1], "count")) {
-				sprintf(sql, "select count(*) from basic_calls where hostname='%s'", switch_core_get_switchname());
 				holder.justcount = 1;
 				if (argv[3] && !strcasecmp(argv[2], "as")) {
 					as = argv[3];
@@ -4961,49 +5314,42 @@ SWITCH_STANDARD_API(show_function)
 				}
 			}
 		} else if (!strcasecmp(command, "channels") && argv[1] && !strcasecmp(argv[1], "like")) {
+			use_rows = 1;
+			rows = SCR_CHANNELS;
 			if (argv[2]) {
-				char *p;
-				for (p = argv[2]; p && *p; p++) {
-					if (*p == '\'' || *p == ';') {
-						*p = ' ';
-					}
-				}
 				if (strchr(argv[2], '%')) {
-					sprintf(sql,
-						"select * from channels where hostname='%s' and uuid like '%s' or name like '%s' or cid_name like '%s' or cid_num like '%s' or presence_data like '%s' order by created_epoch",
-						switch_core_get_switchname(), argv[2], argv[2], argv[2], argv[2], argv[2]);
+					like = strdup(argv[2]);
 				} else {
-					sprintf(sql,
-						"select * from channels where hostname='%s' and uuid like '%%%s%%' or name like '%%%s%%' or cid_name like '%%%s%%' or cid_num like '%%%s%%' or presence_data like '%%%s%%' order by created_epoch",
-						switch_core_get_switchname(), argv[2], argv[2], argv[2], argv[2], argv[2]);
+					like = switch_mprintf("%%%s%%", argv[2]);
 				}
 				if (argv[4] && !strcasecmp(argv[3], "as")) {
 					as = argv[4];
 				}
-			} else {
-				sprintf(sql, "select * from channels where hostname='%s' order by created_epoch", switch_core_get_switchname());
 			}
 		} else if (!strcasecmp(command, "channels")) {
-			sprintf(sql, "select * from channels where hostname='%s' order by created_epoch", switch_core_get_switchname());
+			use_rows = 1;
+			rows = SCR_CHANNELS;
 			if (argv[1] && !strcasecmp(argv[1], "count")) {
-				sprintf(sql, "select count(*) from channels where hostname='%s'", switch_core_get_switchname());
 				holder.justcount = 1;
 				if (argv[3] && !strcasecmp(argv[2], "as")) {
 					as = argv[3];
 				}
 			}
 		} else if (!strcasecmp(command, "detailed_calls")) {
-			sprintf(sql, "select * from detailed_calls where hostname='%s' order by created_epoch", switch_core_get_switchname());
+			use_rows = 1;
+			rows = SCR_DETAILED_CALLS;
 			if (argv[2] && !strcasecmp(argv[1], "as")) {
 				as = argv[2];
 			}
 		} else if (!strcasecmp(command, "bridged_calls")) {
-			sprintf(sql, "select * from basic_calls where b_uuid is not null and hostname='%s' order by created_epoch", switch_core_get_switchname());
+			use_rows = 1;
+			rows = SCR_BRIDGED_CALLS;
 			if (argv[2] && !strcasecmp(argv[1], "as")) {
 				as = argv[2];
 			}
 		} else if (!strcasecmp(command, "detailed_bridged_calls")) {
-			sprintf(sql, "select * from detailed_calls where b_uuid is not null and hostname='%s' order by created_epoch", switch_core_get_switchname());
+			use_rows = 1;
+			rows = SCR_DETAILED_BRIDGED_CALLS;
 			if (argv[2] && !strcasecmp(argv[1], "as")) {
 				as = argv[2];
 			}
@@ -5014,6 +5360,18 @@ SWITCH_STANDARD_API(show_function)
 		}
 	}
 
+	if (!use_rows) {
+		if (!(cflags & SCF_USE_SQL)) {
+			stream->write_function(stream, "-ERR SQL disabled, no data available!\n");
+			goto end;
+		}
+
+		if (switch_core_db_handle(&db) != SWITCH_STATUS_SUCCESS) {
+			stream->write_function(stream, "%s", "-ERR Database error!\n");
+			goto end;
+		}
+	}
+
 	holder.stream = stream;
 	holder.count = 0;
 
@@ -5040,7 +5398,11 @@ SWITCH_STANDARD_API(show_function)
 				holder.delim = ",";
 			}
 		}
-		switch_cache_db_execute_sql_callback(db, sql, show_callback, &holder, &errmsg);
+		if (use_rows) {
+			show_channel_rows(rows, like, show_callback, &holder);
+		} else {
+			switch_cache_db_execute_sql_callback(db, sql, show_callback, &holder, &errmsg);
+		}
 		if (html) {
 			holder.stream->write_function(holder.stream, "</table>");
 		}
@@ -5056,7 +5418,11 @@ SWITCH_STANDARD_API(show_function)
 			stream->write_function(stream, "%s%u total.%s", nl, holder.count, nl);
 		}
 	} else if (!strcasecmp(as, "xml")) {
-		switch_cache_db_execute_sql_callback(db, sql, show_as_xml_callback, &holder, &errmsg);
+		if (use_rows) {
+			show_channel_rows(rows, like, show_as_xml_callback, &holder);
+		} else {
+			switch_cache_db_execute_sql_callback(db, sql, show_as_xml_callback, &holder, &errmsg);
+		}
 
 		if (errmsg) {
 			stream->write_function(stream, "-ERR SQL error [%s]\n", errmsg);
@@ -5084,7 +5450,11 @@ SWITCH_STANDARD_API(show_function)
 		}
 	} else if (!strcasecmp(as, "json")) {
 
-		switch_cache_db_execute_sql_callback(db, sql, show_as_json_callback, &holder, &errmsg);
+		if (use_rows) {
+			show_channel_rows(rows, like, show_as_json_callback, &holder);
+		} else {
+			switch_cache_db_execute_sql_callback(db, sql, show_as_json_callback, &holder, &errmsg);
+		}
 
 		if (errmsg) {
 			stream->write_function(stream, "-ERR SQL Error [%s]\n", errmsg);
@@ -5129,6 +5499,7 @@ SWITCH_STANDARD_API(show_function)
   end:
 
 	switch_safe_free(mydata);
+	switch_safe_free(like);
 
 	if (db) {
 		switch_cache_db_release_db_handle(&db);
@@ -6592,12 +6963,14 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "msleep", "Sleep N milliseconds", msleep_function, "<milliseconds>");
 	SWITCH_ADD_API(commands_api_interface, "nat_map", "Manage NAT", nat_map_function, "[status|republish|reinit] | [add|del] <port> [tcp|udp] [static]");
 	SWITCH_ADD_API(commands_api_interface, "originate", "Originate a call", originate_function, ORIGINATE_SYNTAX);
+	SWITCH_ADD_API(commands_api_interface, "originate_bench", "Time an originate of ringing loopback legs", originate_bench_function, ORIGINATE_BENCH_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "pause", "Pause media on a channel", pause_function, PAUSE_SYNTAX);
+	SWITCH_ADD_API(commands_api_interface, "port_alloc_bench", "Time the port allocator close to exhaustion", port_alloc_bench_function, PORT_ALLOC_BENCH_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "quote_shell_arg", "Quote/escape a string for use on shell command line", quote_shell_arg_function, "<data>");
 	SWITCH_ADD_API(commands_api_interface, "regex", "Evaluate a regex", regex_function, "<data>|<pattern>[|<subst string>][n|b]");
 	SWITCH_ADD_API(commands_api_interface, "reloadacl", "Reload XML", reload_acl_function, "");
 	SWITCH_ADD_API(commands_api_interface, "reload", "Reload module", reload_function, UNLOAD_SYNTAX);
-	SWITCH_ADD_API(commands_api_interface, "reloadxml", "Reload XML", reload_xml_function, "");
+	SWITCH_ADD_API(commands_api_interface, "reloadxml", "Reload XML", reload_xml_function, "[full]");
 	SWITCH_ADD_API(commands_api_interface, "replace", "Replace a string", replace_function, "<data>|<string1>|<string2>");
 	SWITCH_ADD_API(commands_api_interface, "say_string", "", say_string_function, SAY_STRING_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "sched_api", "Schedule an api command", sched_api_function, SCHED_SYNTAX);
@@ -6605,8 +6978,10 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "sched_del", "Delete a scheduled task", sched_del_function, "<task_id>|<group_id>");
 	SWITCH_ADD_API(commands_api_interface, "sched_hangup", "Schedule a running call to hangup", sched_hangup_function, SCHED_HANGUP_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "sched_transfer", "Schedule a transfer for a running call", sched_transfer_function, SCHED_TRANSFER_SYNTAX);
+	SWITCH_ADD_API(commands_api_interface, "session_thread_bench", "Measure threads and RSS per held loopback call", session_thread_bench_function, SESSION_THREAD_BENCH_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "show", "Show various reports", show_function, SHOW_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "sql_escape", "Escape a string to prevent sql injection", sql_escape, SQL_ESCAPE_SYNTAX);
+	SWITCH_ADD_API(commands_api_interface, "sql_stmt_cache_test", "Check cached core db statements wait for a locked database", sql_stmt_cache_test_function, SQL_STMT_CACHE_TEST_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "status", "Show current status", status_function, "");
 	SWITCH_ADD_API(commands_api_interface, "strftime_tz", "Display formatted time of timezone", strftime_tz_api_function, "<timezone_name> [<epoch>|][format string]");
 	SWITCH_ADD_API(commands_api_interface, "stun", "Execute STUN lookup", stun_function, "<stun_server>[:port] [<source_ip>[:<source_port]]");
@@ -6749,6 +7124,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	switch_console_set_complete("add nat_map status");
 	switch_console_set_complete("add reload ::console::list_loaded_modules");
 	switch_console_set_complete("add reloadacl reloadxml");
+	switch_console_set_complete("add reloadxml full");
 	switch_console_set_complete("add show aliases");
 	switch_console_set_complete("add show api");
 	switch_console_set_complete("add show application");
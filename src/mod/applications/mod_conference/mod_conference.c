@@ -67,6 +67,10 @@ static int EC = 0;
 #define CONF_DBUFFER_SIZE CONF_BUFFER_SIZE
 #define CONF_DBUFFER_MAX 0
 #define CONF_CHAT_PROTO "conf"
+/* packets a video viewer may fall behind before it starts dropping them */
+#define CONF_VIDEO_QUEUE_LEN 256
+/* least time between two keyframe requests to the video floor holder, in ms */
+#define CONF_VIDEO_REFRESH_INTERVAL 1000
 
 #ifndef MIN
 #define MIN(a, b) ((a)<(b)?(a):(b))
@@ -213,7 +217,8 @@ typedef enum {
 	CFLAG_VID_FLOOR_LOCK = (1 << 19),
 	CFLAG_JSON_EVENTS = (1 << 20),
 	CFLAG_LIVEARRAY_SYNC = (1 << 21),
-	CFLAG_CONF_RESTART_AUTO_RECORD = (1 << 22)
+	CFLAG_CONF_RESTART_AUTO_RECORD = (1 << 22),
+	CFLAG_SINGLE_THREAD_MEMBERS = (1 << 23)
 } conf_flag_t;
 
 typedef enum {
@@ -297,6 +302,34 @@ struct vid_helper {
 	int up;
 };
 
+/* A member receiving the video of the floor holder, with its own queue and writer thread so a slow
+   viewer only falls behind itself. Shared by the member and the snapshots listing it, the last ref frees it. */
+typedef struct conference_video_viewer {
+	switch_memory_pool_t *pool;
+	switch_atomic_t refs;
+	switch_core_session_t *session;
+	switch_queue_t *queue;
+	switch_thread_t *thread;
+	volatile int running;
+	volatile int want_refresh;
+	uint32_t dropped;
+} conference_video_viewer_t;
+
+/* The viewers of a conference as of the last member change, replaced as a whole under member_mutex */
+typedef struct conference_video_snapshot {
+	switch_atomic_t refs;
+	int count;
+	conference_video_viewer_t *viewers[1];
+} conference_video_snapshot_t;
+
+/* One video packet of the floor holder, queued to every viewer and copied out by each before writing */
+typedef struct conference_video_packet {
+	switch_atomic_t refs;
+	switch_frame_t frame;
+	int data_offset;
+	uint8_t buf[1];
+} conference_video_packet_t;
+
 struct conference_obj;
 
 /* Record Node */
@@ -382,6 +415,9 @@ typedef struct conference_obj {
 	int record_count;
 	int min_recording_participants;
 	int video_running;
+	conference_video_snapshot_t *video_snapshot;
+	switch_thread_cond_t *video_cond;
+	switch_mutex_t *video_cond_mutex;
 	int ivr_dtmf_timeout;
 	int ivr_input_timeout;
 	uint32_t eflags;
@@ -483,6 +519,7 @@ struct conference_member {
 	char *kicked_sound;
 	switch_queue_t *dtmf_queue;
 	switch_thread_t *input_thread;
+	conference_video_viewer_t *video_viewer;
 	cJSON *json;
 	cJSON *status_field;
 	uint8_t loop_loop;
@@ -516,6 +553,9 @@ static switch_status_t conference_add_member(conference_obj_t *conference, confe
 static switch_status_t conference_del_member(conference_obj_t *conference, conference_member_t *member);
 static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, void *obj);
 static void *SWITCH_THREAD_FUNC conference_video_thread_run(switch_thread_t *thread, void *obj);
+static void conference_video_viewer_start(conference_member_t *member);
+static void conference_video_viewer_stop(conference_member_t *member);
+static void conference_video_snapshot_rebuild(conference_obj_t *conference);
 static void conference_loop_output(conference_member_t *member);
 static uint32_t conference_stop_file(conference_obj_t *conference, file_stop_t stop);
 static switch_status_t conference_play_file(conference_obj_t *conference, char *file, uint32_t leadin, switch_channel_t *channel, uint8_t async);
@@ -2040,12 +2080,20 @@ static void conference_set_video_floor_holder(conference_obj_t *conference, conf
 
 		switch_channel_set_flag(imember->channel, CF_VIDEO_BREAK);
 		switch_core_session_kill_channel(imember->session, SWITCH_SIG_BREAK);
-		switch_core_session_refresh_video(imember->session);
+
+		/* the floor holder was asked above already */
+		if (imember != conference->video_floor_holder) {
+			switch_core_session_refresh_video(imember->session);
+		}
 	}
 
 	switch_set_flag(conference, CFLAG_FLOOR_CHANGE);
 	switch_mutex_unlock(conference->mutex);
 
+	switch_mutex_lock(conference->video_cond_mutex);
+	switch_thread_cond_signal(conference->video_cond);
+	switch_mutex_unlock(conference->video_cond_mutex);
+
 	if (test_eflag(conference, EFLAG_FLOOR_CHANGE)) {
 		switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT);
 		conference_add_event_data(conference, event);
@@ -2227,6 +2275,10 @@ static switch_status_t conference_del_member(conference_obj_t *conference, confe
 		last = imember;
 	}
 
+	if (member->video_viewer) {
+		conference_video_snapshot_rebuild(conference);
+	}
+
 	switch_thread_rwlock_unlock(member->rwlock);
 	
 	/* Close Unused Handles */
@@ -2319,6 +2371,9 @@ static switch_status_t conference_del_member(conference_obj_t *conference, confe
 	send_json_event(conference);
 
 	switch_mutex_unlock(conference->mutex);
+
+	conference_video_viewer_stop(member);
+
 	status = SWITCH_STATUS_SUCCESS;
 
 	return status;
@@ -2384,17 +2439,252 @@ static void *SWITCH_THREAD_FUNC conference_video_bridge_thread_run(switch_thread
 }
 
 
+static conference_video_packet_t *conference_video_packet_create(switch_frame_t *frame)
+{
+	conference_video_packet_t *packet;
+	uint8_t *pstart = frame->packet, *dstart = frame->data;
+	uint32_t extra = 0;
+	int data_offset = -1;
+
+	if (dstart && pstart && dstart >= pstart && dstart < pstart + frame->packetlen) {
+		data_offset = (int) (dstart - pstart);
+	} else if (dstart && frame->datalen) {
+		data_offset = frame->packetlen;
+		extra = frame->datalen;
+	}
+
+	switch_zmalloc(packet, sizeof(*packet) + frame->packetlen + extra);
+
+	packet->frame = *frame;
+	/* the floor holder may be gone by the time a viewer writes this */
+	packet->frame.codec = NULL;
+	packet->data_offset = data_offset;
+
+	if (pstart && frame->packetlen) {
+		memcpy(packet->buf, pstart, frame->packetlen);
+	}
+
+	if (extra) {
+		memcpy(packet->buf + frame->packetlen, dstart, extra);
+	}
+
+	switch_atomic_set(&packet->refs, 1);
+
+	return packet;
+}
+
+static void conference_video_packet_release(conference_video_packet_t *packet)
+{
+	if (!switch_atomic_dec(&packet->refs)) {
+		free(packet);
+	}
+}
+
+static void conference_video_viewer_release(conference_video_viewer_t *viewer)
+{
+	void *pop;
+	switch_memory_pool_t *pool;
+
+	if (switch_atomic_dec(&viewer->refs)) {
+		return;
+	}
+
+	while (switch_queue_trypop(viewer->queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		if (pop) {
+			conference_video_packet_release((conference_video_packet_t *) pop);
+		}
+	}
+
+	pool = viewer->pool;
+	switch_core_destroy_memory_pool(&pool);
+}
+
+/* Writes the queued packets to the viewer. The write path rewrites the rtp header (and encrypts) in place,
+   so every viewer works on its own copy. */
+static void *SWITCH_THREAD_FUNC conference_video_viewer_run(switch_thread_t *thread, void *obj)
+{
+	conference_video_viewer_t *viewer = (conference_video_viewer_t *) obj;
+	switch_channel_t *channel = switch_core_session_get_channel(viewer->session);
+	conference_video_packet_t *packet;
+	switch_frame_t frame;
+	uint8_t *buf;
+	uint32_t buflen = SWITCH_RECOMMENDED_BUFFER_SIZE;
+	void *pop;
+
+	buf = malloc(buflen);
+	switch_assert(buf);
+
+	while (viewer->running) {
+		if (switch_queue_pop_timeout(viewer->queue, &pop, 100000) != SWITCH_STATUS_SUCCESS || !pop) {
+			continue;
+		}
+
+		packet = (conference_video_packet_t *) pop;
+
+		if (switch_channel_test_flag(channel, CF_VIDEO_REFRESH_REQ)) {
+			switch_channel_clear_flag(channel, CF_VIDEO_REFRESH_REQ);
+			viewer->want_refresh = 1;
+		}
+
+		if (switch_channel_test_flag(channel, CF_VIDEO)) {
+			uint32_t len = packet->frame.packetlen + (packet->data_offset == (int) packet->frame.packetlen ? packet->frame.datalen : 0);
+
+			if (len > buflen) {
+				buflen = len;
+				buf = realloc(buf, buflen);
+				switch_assert(buf);
+			}
+
+			memcpy(buf, packet->buf, len);
+			frame = packet->frame;
+			frame.packet = packet->frame.packet ? buf : NULL;
+			frame.data = packet->data_offset < 0 ? NULL : buf + packet->data_offset;
+			switch_core_session_write_video_frame(viewer->session, &frame, SWITCH_IO_FLAG_NONE, 0);
+		}
+
+		conference_video_packet_release(packet);
+	}
+
+	free(buf);
+
+	return NULL;
+}
+
+static void conference_video_snapshot_release(conference_video_snapshot_t *snapshot)
+{
+	int i;
+
+	if (switch_atomic_dec(&snapshot->refs)) {
+		return;
+	}
+
+	for (i = 0; i < snapshot->count; i++) {
+		conference_video_viewer_release(snapshot->viewers[i]);
+	}
+
+	free(snapshot);
+}
+
+/* Rebuild conference->video_snapshot from the members list, call with member_mutex held */
+static void conference_video_snapshot_rebuild(conference_obj_t *conference)
+{
+	conference_video_snapshot_t *snapshot, *old;
+	conference_member_t *imember;
+	int count = 0;
+
+	for (imember = conference->members; imember; imember = imember->next) {
+		if (imember->video_viewer) {
+			count++;
+		}
+	}
+
+	switch_zmalloc(snapshot, sizeof(*snapshot) + count * sizeof(snapshot->viewers[0]));
+	switch_atomic_set(&snapshot->refs, 1);
+
+	for (imember = conference->members; imember; imember = imember->next) {
+		if (imember->video_viewer) {
+			switch_atomic_inc(&imember->video_viewer->refs);
+			snapshot->viewers[snapshot->count++] = imember->video_viewer;
+		}
+	}
+
+	old = conference->video_snapshot;
+	conference->video_snapshot = snapshot;
+
+	if (old) {
+		conference_video_snapshot_release(old);
+	}
+}
+
+static conference_video_snapshot_t *conference_video_snapshot_get(conference_obj_t *conference)
+{
+	conference_video_snapshot_t *snapshot;
+
+	switch_mutex_lock(conference->member_mutex);
+	if ((snapshot = conference->video_snapshot)) {
+		switch_atomic_inc(&snapshot->refs);
+	}
+	switch_mutex_unlock(conference->member_mutex);
+
+	return snapshot;
+}
+
+/* Give a member that has video its viewer, the member must be in the conference */
+static void conference_video_viewer_start(conference_member_t *member)
+{
+	conference_video_viewer_t *viewer;
+	switch_memory_pool_t *pool;
+	switch_threadattr_t *thd_attr = NULL;
+
+	if (member->video_viewer || !member->session || switch_test_flag(member->conference, CFLAG_VIDEO_BRIDGE) ||
+		!switch_channel_test_flag(member->channel, CF_VIDEO)) {
+		return;
+	}
+
+	if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	viewer = switch_core_alloc(pool, sizeof(*viewer));
+	viewer->pool = pool;
+	viewer->session = member->session;
+	viewer->running = 1;
+	switch_atomic_set(&viewer->refs, 1);
+	switch_queue_create(&viewer->queue, CONF_VIDEO_QUEUE_LEN, pool);
+
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	if (switch_thread_create(&viewer->thread, thd_attr, conference_video_viewer_run, viewer, pool) != SWITCH_STATUS_SUCCESS) {
+		switch_core_destroy_memory_pool(&pool);
+		return;
+	}
+
+	switch_mutex_lock(member->conference->member_mutex);
+	member->video_viewer = viewer;
+	if (switch_test_flag(member, MFLAG_INTREE)) {
+		conference_video_snapshot_rebuild(member->conference);
+	}
+	switch_mutex_unlock(member->conference->member_mutex);
+}
+
+/* Stop writing video to a member that left, the queue goes away with the last snapshot still listing it */
+static void conference_video_viewer_stop(conference_member_t *member)
+{
+	conference_video_viewer_t *viewer = member->video_viewer;
+	switch_status_t st;
+
+	if (!viewer) {
+		return;
+	}
+
+	member->video_viewer = NULL;
+	viewer->running = 0;
+	switch_queue_trypush(viewer->queue, NULL);
+	switch_thread_join(&st, viewer->thread);
+
+	if (viewer->dropped) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_DEBUG, "Video viewer dropped %u packets\n", viewer->dropped);
+	}
+
+	conference_video_viewer_release(viewer);
+}
+
 /* Main video monitor thread (1 per distinct conference room) */
+/* Reads the video of the floor holder and hands every packet to the queues of the viewers in the current
+   snapshot, neither the conference mutex nor any viewer session is held while doing so. */
 static void *SWITCH_THREAD_FUNC conference_video_thread_run(switch_thread_t *thread, void *obj)
 {
 	conference_obj_t *conference = (conference_obj_t *) obj;
-	conference_member_t *imember;
+	conference_video_snapshot_t *snapshot;
+	conference_video_packet_t *packet;
 	switch_frame_t *vid_frame = NULL;
 	switch_status_t status;
 	int want_refresh = 0;
 	int yield = 0;
+	int i;
+	switch_time_t now, last_refresh = 0;
 	switch_core_session_t *session;
-	char buf[65536];
 	conference_member_t *floor_holder = NULL;
 
 	conference->video_running = 1;
@@ -2406,36 +2696,36 @@ static void *SWITCH_THREAD_FUNC conference_video_thread_run(switch_thread_t *thr
 			yield = 0;
 		}
 
+		session = NULL;
 		switch_mutex_lock(conference->mutex);
 
-		if (conference->video_floor_holder) {
-			floor_holder = conference->video_floor_holder;
-		} else {
-			floor_holder = NULL;
+		if ((floor_holder = conference->video_floor_holder) && floor_holder->session && floor_holder->channel &&
+			switch_channel_test_flag(floor_holder->channel, CF_VIDEO) &&
+			switch_core_session_read_lock(floor_holder->session) == SWITCH_STATUS_SUCCESS) {
+			session = floor_holder->session;
 		}
 
-
-		if (!floor_holder) {
-			yield = 100000;
-			goto do_continue;
+		if (switch_test_flag(conference, CFLAG_FLOOR_CHANGE)) {
+			switch_clear_flag(conference, CFLAG_FLOOR_CHANGE);
+			/* the new floor holder was just asked for a keyframe, it serves whoever asked so far */
+			want_refresh = 0;
+			last_refresh = switch_micro_time_now();
 		}
 
-		if (!floor_holder->session || !floor_holder->channel || !switch_channel_test_flag(floor_holder->channel, CF_VIDEO)) {
-			yield = 100000;
-			goto do_continue;
-		}
+		switch_mutex_unlock(conference->mutex);
 
-		session = floor_holder->session;
+		if (!session) {
+			/* woken up early by a floor change */
+			switch_mutex_lock(conference->video_cond_mutex);
+			switch_thread_cond_timedwait(conference->video_cond, conference->video_cond_mutex, 100000);
+			switch_mutex_unlock(conference->video_cond_mutex);
+			continue;
+		}
 
-		if ((status = switch_core_session_read_lock(session)) == SWITCH_STATUS_SUCCESS) {
-			switch_mutex_unlock(conference->mutex);
-			if (!switch_channel_ready(switch_core_session_get_channel(session))) {
-				status = SWITCH_STATUS_FALSE;
-			} else {
-				status = switch_core_session_read_video_frame(session, &vid_frame, SWITCH_IO_FLAG_NONE, 0);
-			}
-			switch_mutex_lock(conference->mutex);
-			switch_core_session_rwunlock(session);
+		if (!switch_channel_ready(switch_core_session_get_channel(session))) {
+			status = SWITCH_STATUS_FALSE;
+		} else {
+			status = switch_core_session_read_video_frame(session, &vid_frame, SWITCH_IO_FLAG_NONE, 0);
 		}
 
 		if (!SWITCH_READ_ACCEPTABLE(status)) {
@@ -2448,46 +2738,43 @@ static void *SWITCH_THREAD_FUNC conference_video_thread_run(switch_thread_t *thr
 			goto do_continue;
 		}
 
-		memcpy(buf, vid_frame->packet, vid_frame->packetlen);
-		
-		switch_mutex_unlock(conference->mutex);
-		switch_mutex_lock(conference->mutex);
-		want_refresh = 0;
-
-		if (switch_test_flag(conference, CFLAG_FLOOR_CHANGE)) {
-			switch_clear_flag(conference, CFLAG_FLOOR_CHANGE);
-		}
+		if ((snapshot = conference_video_snapshot_get(conference))) {
+			packet = conference_video_packet_create(vid_frame);
 
-		for (imember = conference->members; imember; imember = imember->next) {
-			switch_core_session_t *isession = imember->session;
-			switch_channel_t *ichannel;
+			for (i = 0; i < snapshot->count; i++) {
+				conference_video_viewer_t *viewer = snapshot->viewers[i];
 
-			if (!isession || switch_core_session_read_lock(isession) != SWITCH_STATUS_SUCCESS) {
-				continue;
-			}
+				if (!viewer->running) {
+					continue;
+				}
 
-			ichannel = switch_core_session_get_channel(imember->session);
+				switch_atomic_inc(&packet->refs);
 
-			if (switch_channel_test_flag(ichannel, CF_VIDEO_REFRESH_REQ)) {
-				want_refresh++;
-				switch_channel_clear_flag(ichannel, CF_VIDEO_REFRESH_REQ);
-			}
+				if (switch_queue_trypush(viewer->queue, packet) != SWITCH_STATUS_SUCCESS) {
+					/* too far behind, what it gets next is useless without a new keyframe */
+					conference_video_packet_release(packet);
+					viewer->dropped++;
+					viewer->want_refresh = 1;
+				}
 
-			if (isession && switch_channel_test_flag(ichannel, CF_VIDEO)) {
-				memcpy(vid_frame->packet, buf, vid_frame->packetlen);
-				switch_core_session_write_video_frame(imember->session, vid_frame, SWITCH_IO_FLAG_NONE, 0);
+				if (viewer->want_refresh) {
+					viewer->want_refresh = 0;
+					want_refresh++;
+				}
 			}
 
-			switch_core_session_rwunlock(isession);
+			conference_video_packet_release(packet);
+			conference_video_snapshot_release(snapshot);
 		}
-		
-		if (want_refresh && session) {
+
+		if (want_refresh && ((now = switch_micro_time_now()) - last_refresh) / 1000 >= CONF_VIDEO_REFRESH_INTERVAL) {
 			switch_core_session_refresh_video(session);
+			last_refresh = now;
 			want_refresh = 0;
 		}
 
 	do_continue:
-		switch_mutex_unlock(conference->mutex);
+		switch_core_session_rwunlock(session);
 	}
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Video thread ending for conference %s\n", conference->name);
@@ -2778,6 +3065,9 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 			/* Use more bits in the main_frame to preserve the exact sum of the audio samples. */
 			int main_frame[SWITCH_RECOMMENDED_BUFFER_SIZE / 2] = { 0 };
 			int16_t write_frame[SWITCH_RECOMMENDED_BUFFER_SIZE / 2] = { 0 };
+			int16_t rec_frame[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+			int16_t *out_frame;
+			int rec_ready = 0;
 
 
 			/* Init the main frame with file data if there is any. */
@@ -2850,50 +3140,66 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 					continue;
 				}
 
-				bptr = (int16_t *) omember->frame;
-				for (x = 0; x < bytes / 2; x++) {
-					z = main_frame[x];
-					/* bptr[x] represents my own contribution to this audio sample */
-					if (switch_test_flag(omember, MFLAG_HAS_AUDIO) && x <= omember->read / 2) {
-						z -= (int32_t) bptr[x];
+				/* Recording pseudo members have no audio of their own, so without relationships they all hear
+				   the same thing.  Mix it once on the first one and hand every recorder that frame. */
+				if (switch_test_flag(omember, MFLAG_NOCHANNEL) && !conference->relationship_total) {
+					if (!rec_ready) {
+						for (x = 0; x < bytes / 2; x++) {
+							z = main_frame[x];
+							switch_normalize_to_16bit(z);
+							rec_frame[x] = (int16_t) z;
+						}
+						rec_ready = 1;
 					}
+					out_frame = rec_frame;
+				} else {
+					bptr = (int16_t *) omember->frame;
+					for (x = 0; x < bytes / 2; x++) {
+						z = main_frame[x];
+						/* bptr[x] represents my own contribution to this audio sample */
+						if (switch_test_flag(omember, MFLAG_HAS_AUDIO) && x <= omember->read / 2) {
+							z -= (int32_t) bptr[x];
+						}
 
-					/* when there are relationships, we have to do more work by scouring all the members to see if there are any 
-					   reasons why we should not be hearing a paticular member, and if not, delete their samples as well.
-					 */
-					if (conference->relationship_total) {
-						for (imember = conference->members; imember; imember = imember->next) {
-							if (imember != omember && switch_test_flag(imember, MFLAG_HAS_AUDIO)) {
-								conference_relationship_t *rel;
-								switch_size_t found = 0;
-								int16_t *rptr = (int16_t *) imember->frame;
-								for (rel = imember->relationships; rel; rel = rel->next) {
-									if ((rel->id == omember->id || rel->id == 0) && !switch_test_flag(rel, RFLAG_CAN_SPEAK)) {
-										z -= (int32_t) rptr[x];
-										found = 1;
-										break;
-									}
-								}
-								if (!found) {
-									for (rel = omember->relationships; rel; rel = rel->next) {
-										if ((rel->id == imember->id || rel->id == 0) && !switch_test_flag(rel, RFLAG_CAN_HEAR)) {
+						/* when there are relationships, we have to do more work by scouring all the members to see if there are any 
+						   reasons why we should not be hearing a paticular member, and if not, delete their samples as well.
+						 */
+						if (conference->relationship_total) {
+							for (imember = conference->members; imember; imember = imember->next) {
+								if (imember != omember && switch_test_flag(imember, MFLAG_HAS_AUDIO)) {
+									conference_relationship_t *rel;
+									switch_size_t found = 0;
+									int16_t *rptr = (int16_t *) imember->frame;
+									for (rel = imember->relationships; rel; rel = rel->next) {
+										if ((rel->id == omember->id || rel->id == 0) && !switch_test_flag(rel, RFLAG_CAN_SPEAK)) {
 											z -= (int32_t) rptr[x];
+											found = 1;
 											break;
 										}
 									}
-								}
+									if (!found) {
+										for (rel = omember->relationships; rel; rel = rel->next) {
+											if ((rel->id == imember->id || rel->id == 0) && !switch_test_flag(rel, RFLAG_CAN_HEAR)) {
+												z -= (int32_t) rptr[x];
+												break;
+											}
+										}
+									}
 
+								}
 							}
 						}
+
+						/* Now we can convert to 16 bit. */
+						switch_normalize_to_16bit(z);
+						write_frame[x] = (int16_t) z;
 					}
 
-					/* Now we can convert to 16 bit. */
-					switch_normalize_to_16bit(z);
-					write_frame[x] = (int16_t) z;
+					out_frame = write_frame;
 				}
-				
+
 				switch_mutex_lock(omember->audio_out_mutex);
-				ok = switch_buffer_write(omember->mux_buffer, write_frame, bytes);
+				ok = switch_buffer_write(omember->mux_buffer, out_frame, bytes);
 				switch_mutex_unlock(omember->audio_out_mutex);
 
 				if (!ok) {
@@ -3031,6 +3337,13 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 		}
 	}
 
+	switch_mutex_lock(conference->member_mutex);
+	if (conference->video_snapshot) {
+		conference_video_snapshot_release(conference->video_snapshot);
+		conference->video_snapshot = NULL;
+	}
+	switch_mutex_unlock(conference->member_mutex);
+
 
 	switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT);
 	conference_add_event_data(conference, event); 
@@ -3656,340 +3969,349 @@ static void check_agc_levels(conference_member_t *member)
 
 
 /* marshall frames from the call leg to the conference thread for muxing to other call legs */
-static void *SWITCH_THREAD_FUNC conference_loop_input(switch_thread_t *thread, void *obj)
-{
-    switch_event_t *event;
-	conference_member_t *member = obj;
-	switch_channel_t *channel;
-	switch_status_t status;
-	switch_frame_t *read_frame = NULL;
-	uint32_t hangover = 40, hangunder = 5, hangover_hits = 0, hangunder_hits = 0, diff_level = 400;
-	switch_core_session_t *session = member->session;
-	uint32_t flush_len, loops = 0;
-
-	if (switch_core_session_read_lock(session) != SWITCH_STATUS_SUCCESS) {
-		goto end;
-	}
+/* Talk detection state carried from one frame read for a member to the next */
+typedef struct {
+	uint32_t hangover;
+	uint32_t hangunder;
+	uint32_t hangover_hits;
+	uint32_t hangunder_hits;
+	uint32_t diff_level;
+	uint32_t flush_len;
+	uint32_t loops;
+} member_input_state_t;
 
-	switch_assert(member != NULL);
+static void conference_member_input_init(conference_member_t *member, member_input_state_t *st)
+{
+	memset(st, 0, sizeof(*st));
+	st->hangover = 40;
+	st->hangunder = 5;
+	st->diff_level = 400;
+	st->flush_len = switch_samples_per_packet(member->conference->rate, member->conference->interval) * 6;
 
 	switch_clear_flag_locked(member, MFLAG_TALKING);
 
-	channel = switch_core_session_get_channel(session);
-
-	switch_core_session_get_read_impl(session, &member->read_impl);
+	switch_core_session_get_read_impl(member->session, &member->read_impl);
 
-	switch_channel_audio_sync(channel);
+	switch_channel_audio_sync(switch_core_session_get_channel(member->session));
+}
 
-	flush_len = switch_samples_per_packet(member->conference->rate, member->conference->interval) * 6;
+/* Read one frame from the call leg, run talk detection, dtmf and agc on it and feed it into the input
+   buffer where the conference thread will take it and mux it with any audio from other channels.
+   With SWITCH_IO_FLAG_NOBLOCK there may be nothing to read yet, then only the digits are handled.
+   Returns SWITCH_STATUS_FALSE when the member should stop reading. */
+static switch_status_t conference_member_read_input(conference_member_t *member, member_input_state_t *st, switch_io_flag_t flags)
+{
+	switch_event_t *event;
+	switch_core_session_t *session = member->session;
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	switch_frame_t *read_frame = NULL;
+	switch_status_t status, ret = SWITCH_STATUS_SUCCESS;
 
-	/* As long as we have a valid read, feed that data into an input buffer where the conference thread will take it 
-	   and mux it with any audio from other channels. */
+	/* Read a frame. */
+	status = switch_core_session_read_frame(session, &read_frame, flags, 0);
 
-	while (switch_test_flag(member, MFLAG_RUNNING) && switch_channel_ready(channel)) {
+	switch_mutex_lock(member->read_mutex);
 
-		if (switch_channel_ready(channel) && switch_channel_test_app_flag(channel, CF_APP_TAGGED)) {
-			switch_yield(100000);
-			continue;
-		}
+	/* end the loop, if appropriate */
+	if (!SWITCH_READ_ACCEPTABLE(status) || !switch_test_flag(member, MFLAG_RUNNING)) {
+		ret = SWITCH_STATUS_FALSE;
+		goto end;
+	}
 
-		/* Read a frame. */
-		status = switch_core_session_read_frame(session, &read_frame, SWITCH_IO_FLAG_NONE, 0);
+	if (switch_channel_test_flag(channel, CF_VIDEO) && !switch_test_flag(member, MFLAG_ACK_VIDEO)) {
+		switch_set_flag_locked(member, MFLAG_ACK_VIDEO);
+		switch_channel_clear_flag(channel, CF_VIDEO_ECHO);
+		switch_core_session_refresh_video(member->session);
+		conference_set_video_floor_holder(member->conference, member, SWITCH_FALSE);
+	}
 
-		switch_mutex_lock(member->read_mutex);
+	/* if we have caller digits, feed them to the parser to find an action */
+	if (switch_channel_has_dtmf(channel)) {
+		char dtmf[128] = "";
+	
+		switch_channel_dequeue_dtmf_string(channel, dtmf, sizeof(dtmf));
 
-		/* end the loop, if appropriate */
-		if (!SWITCH_READ_ACCEPTABLE(status) || !switch_test_flag(member, MFLAG_RUNNING)) {
-			switch_mutex_unlock(member->read_mutex);
-			break;
+		if (switch_test_flag(member, MFLAG_DIST_DTMF)) {
+			conference_send_all_dtmf(member, member->conference, dtmf);
+		} else if (member->dmachine) {
+			char *p;
+			char str[2] = "";
+			for (p = dtmf; p && *p; p++) {
+				str[0] = *p;
+				switch_ivr_dmachine_feed(member->dmachine, str, NULL);
+			}
 		}
-
-		if (switch_channel_test_flag(channel, CF_VIDEO) && !switch_test_flag(member, MFLAG_ACK_VIDEO)) {
-			switch_set_flag_locked(member, MFLAG_ACK_VIDEO);
-			switch_channel_clear_flag(channel, CF_VIDEO_ECHO);
-			switch_core_session_refresh_video(member->session);
-			conference_set_video_floor_holder(member->conference, member, SWITCH_FALSE);
+	} else if (member->dmachine) {
+		switch_ivr_dmachine_ping(member->dmachine, NULL);
+	}
+	
+	if (switch_queue_size(member->dtmf_queue)) {
+		switch_dtmf_t *dt;
+		void *pop;
+		
+		if (switch_queue_trypop(member->dtmf_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+			dt = (switch_dtmf_t *) pop;
+			switch_core_session_send_dtmf(member->session, dt);
+			free(dt);
 		}
+	}
 
-		/* if we have caller digits, feed them to the parser to find an action */
-		if (switch_channel_has_dtmf(channel)) {
-			char dtmf[128] = "";
-		
-			switch_channel_dequeue_dtmf_string(channel, dtmf, sizeof(dtmf));
+	if ((flags & SWITCH_IO_FLAG_NOBLOCK) && (status == SWITCH_STATUS_BREAK || !read_frame || !read_frame->datalen)) {
+		goto end;
+	}
+			
+	if (switch_test_flag(read_frame, SFF_CNG)) {
+		if (member->conference->agc_level) {
+			member->nt_tally++;
+		}
 
-			if (switch_test_flag(member, MFLAG_DIST_DTMF)) {
-				conference_send_all_dtmf(member, member->conference, dtmf);
-			} else if (member->dmachine) {
-				char *p;
-				char str[2] = "";
-				for (p = dtmf; p && *p; p++) {
-					str[0] = *p;
-					switch_ivr_dmachine_feed(member->dmachine, str, NULL);
-				}
-			}
-		} else if (member->dmachine) {
-			switch_ivr_dmachine_ping(member->dmachine, NULL);
+		if (st->hangunder_hits) {
+			st->hangunder_hits--;
 		}
-		
-		if (switch_queue_size(member->dtmf_queue)) {
-			switch_dtmf_t *dt;
-			void *pop;
-			
-			if (switch_queue_trypop(member->dtmf_queue, &pop) == SWITCH_STATUS_SUCCESS) {
-				dt = (switch_dtmf_t *) pop;
-				switch_core_session_send_dtmf(member->session, dt);
-				free(dt);
+		if (switch_test_flag(member, MFLAG_TALKING)) {
+			if (++st->hangover_hits >= st->hangover) {
+				st->hangover_hits = st->hangunder_hits = 0;
+				switch_clear_flag_locked(member, MFLAG_TALKING);
+				member_update_status_field(member);
+				check_agc_levels(member);
+				clear_avg(member);
+				member->score_iir = 0;
+
+				if (test_eflag(member->conference, EFLAG_STOP_TALKING) &&
+					switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
+					conference_add_event_member_data(member, event);
+					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "stop-talking");
+					switch_event_fire(&event);
+				}
 			}
 		}
-				
-		if (switch_test_flag(read_frame, SFF_CNG)) {
-			if (member->conference->agc_level) {
-				member->nt_tally++;
-			}
 
-			if (hangunder_hits) {
-				hangunder_hits--;
-			}
-			if (switch_test_flag(member, MFLAG_TALKING)) {
-				if (++hangover_hits >= hangover) {
-					hangover_hits = hangunder_hits = 0;
-					switch_clear_flag_locked(member, MFLAG_TALKING);
-					member_update_status_field(member);
-					check_agc_levels(member);
-					clear_avg(member);
-					member->score_iir = 0;
+		goto end;
+	}
 
-					if (test_eflag(member->conference, EFLAG_STOP_TALKING) &&
-						switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
-						conference_add_event_member_data(member, event);
-						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "stop-talking");
-						switch_event_fire(&event);
-					}
-				}
-			}
+	if (member->nt_tally > (int32_t)(member->read_impl.actual_samples_per_second / member->read_impl.samples_per_packet) * 3) {
+		member->agc_volume_in_level = 0;
+		clear_avg(member);
+	}
 
-			goto do_continue;
-		}
+	/* Check for input volume adjustments */
+	if (!member->conference->agc_level) {
+		member->conference->agc_level = 0;
+		clear_avg(member);
+	}
+	
+
+	/* if the member can speak, compute the audio energy level and */
+	/* generate events when the level crosses the threshold        */
+	if ((switch_test_flag(member, MFLAG_CAN_SPEAK) || switch_test_flag(member, MFLAG_MUTE_DETECT))) {
+		uint32_t energy = 0, i = 0, samples = 0, j = 0;
+		int16_t *data;
+		int agc_period = (member->read_impl.actual_samples_per_second / member->read_impl.samples_per_packet) / 4;
+		
 
-		if (member->nt_tally > (int32_t)(member->read_impl.actual_samples_per_second / member->read_impl.samples_per_packet) * 3) {
-			member->agc_volume_in_level = 0;
-			clear_avg(member);
+		data = read_frame->data;
+		member->score = 0;
+
+		if (member->volume_in_level) {
+			switch_change_sln_volume(read_frame->data, read_frame->datalen / 2, member->volume_in_level);
 		}
 
-		/* Check for input volume adjustments */
-		if (!member->conference->agc_level) {
-			member->conference->agc_level = 0;
-			clear_avg(member);
+		if (member->agc_volume_in_level) {
+			switch_change_sln_volume_granular(read_frame->data, read_frame->datalen / 2, member->agc_volume_in_level);
 		}
 		
-
-		/* if the member can speak, compute the audio energy level and */
-		/* generate events when the level crosses the threshold        */
-		if ((switch_test_flag(member, MFLAG_CAN_SPEAK) || switch_test_flag(member, MFLAG_MUTE_DETECT))) {
-			uint32_t energy = 0, i = 0, samples = 0, j = 0;
-			int16_t *data;
-			int agc_period = (member->read_impl.actual_samples_per_second / member->read_impl.samples_per_packet) / 4;
+		if ((samples = read_frame->datalen / sizeof(*data))) {
+			for (i = 0; i < samples; i++) {
+				energy += abs(data[j]);
+				j += member->read_impl.number_of_channels;
+			}
 			
+			member->score = energy / samples;
+		}
 
-			data = read_frame->data;
-			member->score = 0;
+		if (member->vol_period) {
+			member->vol_period--;
+		}
+		
+		if (member->conference->agc_level && member->score && 
+			switch_test_flag(member, MFLAG_CAN_SPEAK) &&
+			noise_gate_check(member)
+			) {
+			int last_shift = abs(member->last_score - member->score);
+			
+			if (member->score && member->last_score && last_shift > 900) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG7,
+								  "AGC %s:%d drop anomalous shift of %d\n", 
+								  member->conference->name,
+								  member->id, last_shift);
 
-			if (member->volume_in_level) {
-				switch_change_sln_volume(read_frame->data, read_frame->datalen / 2, member->volume_in_level);
+			} else {
+				member->avg_tally += member->score;
+				member->avg_itt++;
+				if (!member->avg_itt) member->avg_itt++;
+				member->avg_score = member->avg_tally / member->avg_itt;
 			}
 
-			if (member->agc_volume_in_level) {
-				switch_change_sln_volume_granular(read_frame->data, read_frame->datalen / 2, member->agc_volume_in_level);
-			}
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG7,
+							  "AGC %s:%d diff:%d level:%d cur:%d avg:%d vol:%d\n", 
+							  member->conference->name,
+							  member->id, member->conference->agc_level - member->avg_score, member->conference->agc_level, 
+							  member->score, member->avg_score, member->agc_volume_in_level);
 			
-			if ((samples = read_frame->datalen / sizeof(*data))) {
-				for (i = 0; i < samples; i++) {
-					energy += abs(data[j]);
-					j += member->read_impl.number_of_channels;
+			if (++member->agc_concur >= agc_period) {
+				if (!member->vol_period) {
+					check_agc_levels(member);
 				}
-				
-				member->score = energy / samples;
+				member->agc_concur = 0;
 			}
+		} else {
+			member->nt_tally++;
+		}
 
-			if (member->vol_period) {
-				member->vol_period--;
-			}
-			
-			if (member->conference->agc_level && member->score && 
-				switch_test_flag(member, MFLAG_CAN_SPEAK) &&
-				noise_gate_check(member)
-				) {
-				int last_shift = abs(member->last_score - member->score);
-				
-				if (member->score && member->last_score && last_shift > 900) {
-					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG7,
-									  "AGC %s:%d drop anomalous shift of %d\n", 
-									  member->conference->name,
-									  member->id, last_shift);
+		member->score_iir = (int) (((1.0 - SCORE_DECAY) * (float) member->score) + (SCORE_DECAY * (float) member->score_iir));
 
-				} else {
-					member->avg_tally += member->score;
-					member->avg_itt++;
-					if (!member->avg_itt) member->avg_itt++;
-					member->avg_score = member->avg_tally / member->avg_itt;
-				}
+		if (member->score_iir > SCORE_MAX_IIR) {
+			member->score_iir = SCORE_MAX_IIR;
+		}
 
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG7,
-								  "AGC %s:%d diff:%d level:%d cur:%d avg:%d vol:%d\n", 
-								  member->conference->name,
-								  member->id, member->conference->agc_level - member->avg_score, member->conference->agc_level, 
-								  member->score, member->avg_score, member->agc_volume_in_level);
-				
-				if (++member->agc_concur >= agc_period) {
-					if (!member->vol_period) {
-						check_agc_levels(member);
-					}
-					member->agc_concur = 0;
-				}
-			} else {
-				member->nt_tally++;
+		if (noise_gate_check(member)) {
+			uint32_t diff = member->score - member->energy_level;
+			if (st->hangover_hits) {
+				st->hangover_hits--;
 			}
 
-			member->score_iir = (int) (((1.0 - SCORE_DECAY) * (float) member->score) + (SCORE_DECAY * (float) member->score_iir));
-
-			if (member->score_iir > SCORE_MAX_IIR) {
-				member->score_iir = SCORE_MAX_IIR;
+			if (member->conference->agc_level) {
+				member->nt_tally = 0;
 			}
 
-			if (noise_gate_check(member)) {
-				uint32_t diff = member->score - member->energy_level;
-				if (hangover_hits) {
-					hangover_hits--;
-				}
+			if (diff >= st->diff_level || ++st->hangunder_hits >= st->hangunder) { 
 
-				if (member->conference->agc_level) {
-					member->nt_tally = 0;
-				}
+				st->hangover_hits = st->hangunder_hits = 0;
+				member->last_talking = switch_epoch_time_now(NULL);
+
+				if (!switch_test_flag(member, MFLAG_TALKING)) {
+					switch_set_flag_locked(member, MFLAG_TALKING);
+					member_update_status_field(member);
+					if (test_eflag(member->conference, EFLAG_START_TALKING) && switch_test_flag(member, MFLAG_CAN_SPEAK) &&
+						switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
+						conference_add_event_member_data(member, event);
+						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "start-talking");
+						switch_event_fire(&event);
+					}
 
-				if (diff >= diff_level || ++hangunder_hits >= hangunder) { 
+					if (switch_test_flag(member, MFLAG_MUTE_DETECT) && !switch_test_flag(member, MFLAG_CAN_SPEAK)) {
 
-					hangover_hits = hangunder_hits = 0;
-					member->last_talking = switch_epoch_time_now(NULL);
+						if (!zstr(member->conference->mute_detect_sound)) {
+							switch_set_flag(member, MFLAG_INDICATE_MUTE_DETECT);
+						}
 
-					if (!switch_test_flag(member, MFLAG_TALKING)) {
-						switch_set_flag_locked(member, MFLAG_TALKING);
-						member_update_status_field(member);
-						if (test_eflag(member->conference, EFLAG_START_TALKING) && switch_test_flag(member, MFLAG_CAN_SPEAK) &&
+						if (test_eflag(member->conference, EFLAG_MUTE_DETECT) &&
 							switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
 							conference_add_event_member_data(member, event);
-							switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "start-talking");
+							switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "mute-detect");
 							switch_event_fire(&event);
 						}
-
-						if (switch_test_flag(member, MFLAG_MUTE_DETECT) && !switch_test_flag(member, MFLAG_CAN_SPEAK)) {
-
-							if (!zstr(member->conference->mute_detect_sound)) {
-								switch_set_flag(member, MFLAG_INDICATE_MUTE_DETECT);
-							}
-
-							if (test_eflag(member->conference, EFLAG_MUTE_DETECT) &&
-								switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
-								conference_add_event_member_data(member, event);
-								switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "mute-detect");
-								switch_event_fire(&event);
-							}
-						}
 					}
 				}
-			} else {
-				if (hangunder_hits) {
-					hangunder_hits--;
-				}
+			}
+		} else {
+			if (st->hangunder_hits) {
+				st->hangunder_hits--;
+			}
 
-				if (member->conference->agc_level) {
-					member->nt_tally++;
-				}
+			if (member->conference->agc_level) {
+				member->nt_tally++;
+			}
 
-				if (switch_test_flag(member, MFLAG_TALKING) && switch_test_flag(member, MFLAG_CAN_SPEAK)) {
-					switch_event_t *event;
-					if (++hangover_hits >= hangover) {
-						hangover_hits = hangunder_hits = 0;
-						switch_clear_flag_locked(member, MFLAG_TALKING);
-						member_update_status_field(member);
-						check_agc_levels(member);
-						clear_avg(member);
-						
-						if (test_eflag(member->conference, EFLAG_STOP_TALKING) &&
-							switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
-							conference_add_event_member_data(member, event);
-							switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "stop-talking");
-							switch_event_fire(&event);
-						}
+			if (switch_test_flag(member, MFLAG_TALKING) && switch_test_flag(member, MFLAG_CAN_SPEAK)) {
+				switch_event_t *event;
+				if (++st->hangover_hits >= st->hangover) {
+					st->hangover_hits = st->hangunder_hits = 0;
+					switch_clear_flag_locked(member, MFLAG_TALKING);
+					member_update_status_field(member);
+					check_agc_levels(member);
+					clear_avg(member);
+					
+					if (test_eflag(member->conference, EFLAG_STOP_TALKING) &&
+						switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
+						conference_add_event_member_data(member, event);
+						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "stop-talking");
+						switch_event_fire(&event);
 					}
 				}
 			}
+		}
 
 
-			member->last_score = member->score;
-		}
+		member->last_score = member->score;
+	}
 
-		loops++;
+	st->loops++;
 
-		if (switch_channel_test_flag(member->channel, CF_CONFERENCE_RESET_MEDIA)) {
-			switch_channel_clear_flag(member->channel, CF_CONFERENCE_RESET_MEDIA);
+	if (switch_channel_test_flag(member->channel, CF_CONFERENCE_RESET_MEDIA)) {
+		switch_channel_clear_flag(member->channel, CF_CONFERENCE_RESET_MEDIA);
 
-			if (loops > 500) {
-				member->loop_loop = 1;
+		if (st->loops > 500) {
+			member->loop_loop = 1;
 
-				if (setup_media(member, member->conference)) {
-					break;
-				}
+			if (setup_media(member, member->conference)) {
+				ret = SWITCH_STATUS_FALSE;
+				goto end;
 			}
-
 		}
 
-		/* skip frames that are not actual media or when we are muted or silent */
-		if ((switch_test_flag(member, MFLAG_TALKING) || member->energy_level == 0 || switch_test_flag(member->conference, CFLAG_AUDIO_ALWAYS)) 
-			&& switch_test_flag(member, MFLAG_CAN_SPEAK) &&	!switch_test_flag(member->conference, CFLAG_WAIT_MOD)
-			&& (member->conference->count > 1 || (member->conference->record_count && member->conference->count >= member->conference->min_recording_participants))) {
-			switch_audio_resampler_t *read_resampler = member->read_resampler;
-			void *data;
-			uint32_t datalen;
+	}
 
-			if (read_resampler) {
-				int16_t *bptr = (int16_t *) read_frame->data;
-				int len = (int) read_frame->datalen;
+	/* skip frames that are not actual media or when we are muted or silent */
+	if ((switch_test_flag(member, MFLAG_TALKING) || member->energy_level == 0 || switch_test_flag(member->conference, CFLAG_AUDIO_ALWAYS)) 
+		&& switch_test_flag(member, MFLAG_CAN_SPEAK) &&	!switch_test_flag(member->conference, CFLAG_WAIT_MOD)
+		&& (member->conference->count > 1 || (member->conference->record_count && member->conference->count >= member->conference->min_recording_participants))) {
+		switch_audio_resampler_t *read_resampler = member->read_resampler;
+		void *data;
+		uint32_t datalen;
 
-				switch_resample_process(read_resampler, bptr, len / 2);
-				memcpy(member->resample_out, read_resampler->to, read_resampler->to_len * 2);
-				len = read_resampler->to_len * 2;
-				datalen = len;
-				data = member->resample_out;
-			} else {
-				data = read_frame->data;
-				datalen = read_frame->datalen;
-			}
+		if (read_resampler) {
+			int16_t *bptr = (int16_t *) read_frame->data;
+			int len = (int) read_frame->datalen;
 
+			switch_resample_process(read_resampler, bptr, len / 2);
+			memcpy(member->resample_out, read_resampler->to, read_resampler->to_len * 2);
+			len = read_resampler->to_len * 2;
+			datalen = len;
+			data = member->resample_out;
+		} else {
+			data = read_frame->data;
+			datalen = read_frame->datalen;
+		}
 
-			if (datalen) {
-				switch_size_t ok = 1;
 
-				/* Write the audio into the input buffer */
-				switch_mutex_lock(member->audio_in_mutex);
-				if (switch_buffer_inuse(member->audio_buffer) > flush_len) {
-					switch_buffer_zero(member->audio_buffer);
-					switch_channel_audio_sync(channel);
-				}
-				ok = switch_buffer_write(member->audio_buffer, data, datalen);
-				switch_mutex_unlock(member->audio_in_mutex);
-				if (!ok) {
-					switch_mutex_unlock(member->read_mutex);
-					break;
-				}
+		if (datalen) {
+			switch_size_t ok = 1;
+
+			/* Write the audio into the input buffer */
+			switch_mutex_lock(member->audio_in_mutex);
+			if (switch_buffer_inuse(member->audio_buffer) > st->flush_len) {
+				switch_buffer_zero(member->audio_buffer);
+				switch_channel_audio_sync(channel);
+			}
+			ok = switch_buffer_write(member->audio_buffer, data, datalen);
+			switch_mutex_unlock(member->audio_in_mutex);
+			if (!ok) {
+				ret = SWITCH_STATUS_FALSE;
+				goto end;
 			}
 		}
+	}
 
-	  do_continue:
+  end:
 
-		switch_mutex_unlock(member->read_mutex);
+	switch_mutex_unlock(member->read_mutex);
 
-	}
+	return ret;
+}
 
+static void conference_member_input_destroy(conference_member_t *member)
+{
 	if (switch_queue_size(member->dtmf_queue)) {
 		switch_dtmf_t *dt;
 		void *pop;
@@ -4000,8 +4322,39 @@ static void *SWITCH_THREAD_FUNC conference_loop_input(switch_thread_t *thread, v
 		}
 	}
 
-
 	switch_resample_destroy(&member->read_resampler);
+}
+
+static void *SWITCH_THREAD_FUNC conference_loop_input(switch_thread_t *thread, void *obj)
+{
+	conference_member_t *member = obj;
+	switch_channel_t *channel;
+	switch_core_session_t *session = member->session;
+	member_input_state_t st;
+
+	if (switch_core_session_read_lock(session) != SWITCH_STATUS_SUCCESS) {
+		goto end;
+	}
+
+	switch_assert(member != NULL);
+
+	channel = switch_core_session_get_channel(session);
+
+	conference_member_input_init(member, &st);
+
+	while (switch_test_flag(member, MFLAG_RUNNING) && switch_channel_ready(channel)) {
+
+		if (switch_channel_ready(channel) && switch_channel_test_app_flag(channel, CF_APP_TAGGED)) {
+			switch_yield(100000);
+			continue;
+		}
+
+		if (conference_member_read_input(member, &st, SWITCH_IO_FLAG_NONE) != SWITCH_STATUS_SUCCESS) {
+			break;
+		}
+	}
+
+	conference_member_input_destroy(member);
 	switch_core_session_rwunlock(session);
 
  end:
@@ -4106,9 +4459,13 @@ static void launch_conference_loop_input(conference_member_t *member, switch_mem
 
 /* marshall frames from the conference (or file or tts output) to the call leg */
 /* NB. this starts the input thread after some initial setup for the call leg */
+/* With single-thread-members there is no input thread, this loop reads from the call leg itself before each write.
+   That read doesn't block so the loop stays on its timer no matter how the inbound RTP arrives */
 static void conference_loop_output(conference_member_t *member)
 {
 	switch_channel_t *channel;
+	member_input_state_t input_state = { 0 };
+	int single_thread = switch_test_flag(member->conference, CFLAG_SINGLE_THREAD_MEMBERS);
 	switch_frame_t write_frame = { 0 };
 	uint8_t *data = NULL;
 	switch_timer_t timer = { 0 };
@@ -4159,7 +4516,11 @@ static void conference_loop_output(conference_member_t *member)
 	write_frame.codec = &member->write_codec;
 
 	/* Start the input thread */
-	launch_conference_loop_input(member, switch_core_session_get_pool(member->session));
+	if (single_thread) {
+		conference_member_input_init(member, &input_state);
+	} else {
+		launch_conference_loop_input(member, switch_core_session_get_pool(member->session));
+	}
 
 	if ((call_list = switch_channel_get_private(channel, "_conference_autocall_list_"))) {
 		const char *cid_name = switch_channel_get_variable(channel, "conference_auto_outcall_caller_id_name");
@@ -4243,20 +4604,35 @@ static void conference_loop_output(conference_member_t *member)
 
 
 	sanity = 2000;
-	while(!switch_test_flag(member, MFLAG_ITHREAD) && sanity > 0) {
+	while(!single_thread && !switch_test_flag(member, MFLAG_ITHREAD) && sanity > 0) {
 		switch_cond_next();
 		sanity--;
 	}
 
 	/* Fair WARNING, If you expect the caller to hear anything or for digit handling to be processed,      */
 	/* you better not block this thread loop for more than the duration of member->conference->timer_name!  */
-	while (!member->loop_loop && switch_test_flag(member, MFLAG_RUNNING) && switch_test_flag(member, MFLAG_ITHREAD)
+	while (!member->loop_loop && switch_test_flag(member, MFLAG_RUNNING) && (single_thread || switch_test_flag(member, MFLAG_ITHREAD))
 		   && switch_channel_ready(channel)) {
 		switch_event_t *event;
 		int use_timer = 0;
 		switch_buffer_t *use_buffer = NULL;
 		uint32_t mux_used = 0;
 
+		/* also catches video negotiated after joining */
+		if (!member->video_viewer && switch_channel_test_flag(channel, CF_VIDEO)) {
+			conference_video_viewer_start(member);
+		}
+
+		if (single_thread && !switch_channel_test_app_flag(channel, CF_APP_TAGGED)) {
+			if (conference_member_read_input(member, &input_state, SWITCH_IO_FLAG_NOBLOCK) != SWITCH_STATUS_SUCCESS) {
+				break;
+			}
+
+			if (member->loop_loop) {
+				break;
+			}
+		}
+
 		switch_mutex_lock(member->write_mutex);
 
 		
@@ -4457,6 +4833,10 @@ static void conference_loop_output(conference_member_t *member)
 		if (member->input_thread) {
 			switch_thread_join(&st, member->input_thread);
 		}
+
+		if (single_thread) {
+			conference_member_input_destroy(member);
+		}
 	}
 
 	switch_core_timer_destroy(&timer);
@@ -4654,6 +5034,14 @@ static void *SWITCH_THREAD_FUNC conference_record_thread_run(switch_thread_t *th
 			}
 		}
 
+		/* The mixer keeps filling our buffer while the file is busy encoding or waiting on disk,
+		   write out the backlog now instead of carrying it as lag until the end of the recording. */
+		if (len && switch_test_flag(member, MFLAG_RUNNING) && switch_buffer_inuse(member->mux_buffer) > data_buf_len) {
+			mux_used = (uint32_t) switch_buffer_inuse(member->mux_buffer);
+			len = 0;
+			goto again;
+		}
+
 	loop:
 
 		switch_core_timer_next(&timer);
@@ -7914,6 +8302,8 @@ static void set_cflags(const char *flags, uint32_t *f)
 				*f |= CFLAG_LIVEARRAY_SYNC;
 			} else if (!strcasecmp(argv[i], "rfc-4579")) {
 				*f |= CFLAG_RFC4579;
+			} else if (!strcasecmp(argv[i], "single-thread-members")) {
+				*f |= CFLAG_SINGLE_THREAD_MEMBERS;
 			}
 
 			
@@ -9531,6 +9921,8 @@ static conference_obj_t *conference_new(char *name, conf_xml_cfg_t cfg, switch_c
 	switch_mutex_init(&conference->flag_mutex, SWITCH_MUTEX_NESTED, conference->pool);
 	switch_thread_rwlock_create(&conference->rwlock, conference->pool);
 	switch_mutex_init(&conference->member_mutex, SWITCH_MUTEX_NESTED, conference->pool);
+	switch_mutex_init(&conference->video_cond_mutex, SWITCH_MUTEX_NESTED, conference->pool);
+	switch_thread_cond_create(&conference->video_cond, conference->pool);
 
 	switch_mutex_lock(globals.hash_mutex);
 	switch_set_flag(conference, CFLAG_INHASH);
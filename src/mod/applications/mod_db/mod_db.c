@@ -39,22 +39,39 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_db_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_db_shutdown);
 SWITCH_MODULE_DEFINITION(mod_db, mod_db_load, mod_db_shutdown, NULL);
 
+#define LIMIT_SHARDS 16
+
+/* Usage of one realm/resource pair. Our own usage is counted here and is authoritative,
+   limit_data only follows it. Other hosts sharing the database are counted from SQL now and then. */
+typedef struct {
+	uint32_t local_usage;
+	uint32_t remote_usage;
+	time_t remote_checked;
+} limit_db_item_t;
+
+typedef struct {
+	switch_mutex_t *mutex;
+	switch_hash_t *hash;
+} limit_db_shard_t;
+
+/* What a channel holds, realm_resource keys to the number of times it was counted */
+typedef struct {
+	switch_hash_t *hash;
+} limit_db_private_t;
+
 static struct {
 	switch_memory_pool_t *pool;
 	char hostname[256];
 	char *dbname;
 	char *odbc_dsn;
+	int remote_usage_refresh;
 	switch_mutex_t *mutex;
 	switch_mutex_t *db_hash_mutex;
 	switch_hash_t *db_hash;
+	limit_db_shard_t limit_shards[LIMIT_SHARDS];
+	switch_sql_queue_manager_t *qm;
 } globals;
 
-typedef struct {
-	uint32_t total_usage;
-	uint32_t rate_usage;
-	time_t last_check;
-} limit_hash_item_t;
-
 struct callback {
 	char *buf;
 	size_t len;
@@ -161,6 +178,99 @@ static char * limit_execute_sql2str(char *sql, char *str, size_t len)
 	return cbt.buf;
 }
 
+static limit_db_shard_t *limit_get_shard(const char *hashkey)
+{
+	switch_ssize_t klen = -1;
+
+	return &globals.limit_shards[switch_ci_hashfunc_default(hashkey, &klen) % LIMIT_SHARDS];
+}
+
+/* Write-behind, limit_data is updated in batches by the queue manager */
+static void limit_queue_sql(char *sql)
+{
+	if (globals.qm) {
+		switch_sql_queue_manager_push(globals.qm, sql, 0, SWITCH_FALSE);
+	} else {
+		limit_execute_sql(sql);
+		switch_safe_free(sql);
+	}
+}
+
+static uint32_t limit_remote_usage(const char *realm, const char *resource)
+{
+	char usagestr[128] = "";
+	char *sql;
+
+	sql = switch_mprintf("select count(hostname) from limit_data where realm='%q' and id='%q' and hostname!='%q'", realm, resource, globals.hostname);
+	limit_execute_sql2str(sql, usagestr, sizeof(usagestr));
+	switch_safe_free(sql);
+
+	return (uint32_t) atoi(usagestr);
+}
+
+static limit_db_item_t *limit_item_find(limit_db_shard_t *shard, const char *hashkey, switch_bool_t create)
+{
+	limit_db_item_t *item;
+
+	if (!(item = switch_core_hash_find(shard->hash, hashkey)) && create) {
+		switch_zmalloc(item, sizeof(*item));
+		switch_core_hash_insert(shard->hash, hashkey, item);
+	}
+
+	return item;
+}
+
+/* Forget an item once it counts nothing, a remote count is kept so it need not be asked for again */
+static void limit_item_check_unused(limit_db_shard_t *shard, const char *hashkey, limit_db_item_t *item)
+{
+	if (!item->local_usage && !item->remote_usage) {
+		switch_core_hash_delete(shard->hash, hashkey);
+		free(item);
+	}
+}
+
+/* Current usage of a realm/resource across all hosts, called and returning with the shard locked.
+   Other hosts are only asked for when remote-usage-refresh is on and the last answer is too old,
+   the lock is dropped meanwhile so the item is looked up again (and created again if asked to). */
+static limit_db_item_t *limit_item_usage(limit_db_shard_t *shard, const char *hashkey, const char *realm, const char *resource,
+										 switch_bool_t create, uint32_t *usage)
+{
+	limit_db_item_t *item = limit_item_find(shard, hashkey, create);
+	time_t now = switch_epoch_time_now(NULL);
+	uint32_t remote;
+
+	if (item && globals.remote_usage_refresh > 0 && item->remote_checked + globals.remote_usage_refresh <= now) {
+		/* the others keep the last answer until ours is in */
+		item->remote_checked = now;
+		switch_mutex_unlock(shard->mutex);
+
+		remote = limit_remote_usage(realm, resource);
+
+		switch_mutex_lock(shard->mutex);
+		if ((item = limit_item_find(shard, hashkey, create))) {
+			item->remote_usage = remote;
+			item->remote_checked = now;
+		}
+	}
+
+	*usage = item ? item->local_usage + item->remote_usage : 0;
+
+	return item;
+}
+
+static void limit_item_release(const char *hashkey, uint32_t count)
+{
+	limit_db_shard_t *shard = limit_get_shard(hashkey);
+	limit_db_item_t *item;
+
+	switch_mutex_lock(shard->mutex);
+	if ((item = switch_core_hash_find(shard->hash, hashkey))) {
+		item->local_usage = item->local_usage > count ? item->local_usage - count : 0;
+		limit_item_check_unused(shard, hashkey, item);
+	}
+	switch_mutex_unlock(shard->mutex);
+}
+
 /* \brief Enforces limit restrictions
  * \param session current session
  * \param realm limit realm
@@ -171,21 +281,24 @@ static char * limit_execute_sql2str(char *sql, char *str, size_t len)
 SWITCH_LIMIT_INCR(limit_incr_db)
 {
 	switch_channel_t *channel = switch_core_session_get_channel(session);
-	int got = 0;
+	uint32_t got = 0;
 	char *sql = NULL;
-	char gotstr[128];
+	char *hashkey = NULL;
+	limit_db_shard_t *shard;
+	limit_db_item_t *item;
+	limit_db_private_t *pvt;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
 
-	switch_mutex_lock(globals.mutex);
-
 	switch_channel_set_variable(channel, "limit_realm", realm);
 	switch_channel_set_variable(channel, "limit_id", resource);
 	switch_channel_set_variable(channel, "limit_max", switch_core_session_sprintf(session, "%d", max));
 
-	sql = switch_mprintf("select count(hostname) from limit_data where realm='%q' and id='%q';", realm, resource);
-	limit_execute_sql2str(sql, gotstr, 128);
-	switch_safe_free(sql);
-	got = atoi(gotstr);
+	hashkey = switch_core_session_sprintf(session, "%s_%s", realm, resource);
+	shard = limit_get_shard(hashkey);
+
+	switch_mutex_lock(shard->mutex);
+
+	item = limit_item_usage(shard, hashkey, realm, resource, SWITCH_TRUE, &got);
 
 	if (max < 0) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s_%s is now %d\n", realm, resource, got + 1);
@@ -193,55 +306,116 @@ SWITCH_LIMIT_INCR(limit_incr_db)
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s_%s is now %d/%d\n", realm, resource, got + 1, max);
 	}
 
-	if (max >= 0 && got + 1 > max) {
-		status = SWITCH_STATUS_GENERR;
-		goto done;
+	if (max >= 0 && got + 1 > (uint32_t) max) {
+		limit_item_check_unused(shard, hashkey, item);
+		switch_mutex_unlock(shard->mutex);
+		return SWITCH_STATUS_GENERR;
+	}
+
+	item->local_usage++;
+	got++;
+
+	switch_mutex_unlock(shard->mutex);
+
+	if (!(pvt = switch_channel_get_private(channel, "limit_db"))) {
+		pvt = switch_core_session_alloc(session, sizeof(*pvt));
+		switch_channel_set_private(channel, "limit_db", pvt);
+	}
+
+	if (!pvt->hash) {
+		switch_core_hash_init(&pvt->hash);
+	}
+
+	/* every increment is a row in limit_data, so a channel may hold the same pair more than once.
+	   The hash keeps duplicate keys side by side, drop the old count before storing the new one. */
+	{
+		intptr_t count = (intptr_t) switch_core_hash_find(pvt->hash, hashkey);
+
+		if (count) {
+			switch_core_hash_delete(pvt->hash, hashkey);
+		}
+		switch_core_hash_insert(pvt->hash, hashkey, (void *) (count + 1));
 	}
 
 	sql =
 		switch_mprintf("insert into limit_data (hostname, realm, id, uuid) values('%q','%q','%q','%q');", globals.hostname, realm, resource,
 					   switch_core_session_get_uuid(session));
-	limit_execute_sql(sql);
-	switch_safe_free(sql);
+	limit_queue_sql(sql);
 
 	{
-		const char *susage = switch_core_session_sprintf(session, "%d", ++got);
+		const char *susage = switch_core_session_sprintf(session, "%d", got);
 
 		switch_channel_set_variable(channel, "limit_usage", susage);
 		switch_channel_set_variable(channel, switch_core_session_sprintf(session, "limit_usage_%s_%s", realm, resource), susage);
 	}
 	switch_limit_fire_event("db", realm, resource, got, 0, max, 0);
 
-  done:
-	switch_mutex_unlock(globals.mutex);
 	return status;
 }
 
 SWITCH_LIMIT_RELEASE(limit_release_db)
 {
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	limit_db_private_t *pvt = switch_channel_get_private(channel, "limit_db");
+	switch_hash_index_t *hi;
 	char *sql = NULL;
+	char *hashkey = NULL;
+	intptr_t count;
+
+	if (!pvt || !pvt->hash) {
+		return SWITCH_STATUS_SUCCESS;
+	}
 
 	if (realm == NULL && resource == NULL) {
+		while ((hi = switch_core_hash_first(pvt->hash))) {
+			const void *key;
+			void *val;
+
+			switch_core_hash_this(hi, &key, NULL, &val);
+			limit_item_release((const char *) key, (uint32_t) (intptr_t) val);
+			switch_core_hash_delete(pvt->hash, (const char *) key);
+		}
+
+		switch_core_hash_destroy(&pvt->hash);
+
 		sql = switch_mprintf("delete from limit_data where uuid='%q'", switch_core_session_get_uuid(session));
 	} else {
+		hashkey = switch_core_session_sprintf(session, "%s_%s", realm, resource);
+
+		if (!(count = (intptr_t) switch_core_hash_find(pvt->hash, hashkey))) {
+			return SWITCH_STATUS_SUCCESS;
+		}
+
+		limit_item_release(hashkey, (uint32_t) count);
+		switch_core_hash_delete(pvt->hash, hashkey);
+
 		sql = switch_mprintf("delete from limit_data where uuid='%q' and realm='%q' and id = '%q'", switch_core_session_get_uuid(session), realm, resource);
 	}
-	limit_execute_sql(sql);
-	switch_safe_free(sql);
+
+	limit_queue_sql(sql);
 	
 	return SWITCH_STATUS_SUCCESS;
 }
 
 SWITCH_LIMIT_USAGE(limit_usage_db)
 {
-	char usagestr[128] = "";
+	char *hashkey = switch_mprintf("%s_%s", realm, resource);
+	limit_db_shard_t *shard = limit_get_shard(hashkey);
+	limit_db_item_t *item;
+	uint32_t got = 0;
 	int usage = 0;
-	char *sql = NULL;
-	
-	sql = switch_mprintf("select count(hostname) from limit_data where realm='%q' and id='%q'", realm, resource);
-	limit_execute_sql2str(sql, usagestr, sizeof(usagestr));
-	switch_safe_free(sql);
-	usage = atoi(usagestr);
+
+	switch_mutex_lock(shard->mutex);
+	if ((item = limit_item_usage(shard, hashkey, realm, resource, SWITCH_FALSE, &got))) {
+		usage = (int) got;
+	}
+	switch_mutex_unlock(shard->mutex);
+
+	if (!item && globals.remote_usage_refresh > 0) {
+		usage = (int) limit_remote_usage(realm, resource);
+	}
+
+	switch_safe_free(hashkey);
 	
 	return usage;
 }
@@ -249,24 +423,50 @@ SWITCH_LIMIT_USAGE(limit_usage_db)
 SWITCH_LIMIT_RESET(limit_reset_db)
 {
 	char *sql = NULL;
+	switch_hash_index_t *hi;
+	int i;
+
+	for (i = 0; i < LIMIT_SHARDS; i++) {
+		limit_db_shard_t *shard = &globals.limit_shards[i];
+
+		switch_mutex_lock(shard->mutex);
+		while ((hi = switch_core_hash_first(shard->hash))) {
+			const void *key;
+			void *val;
+
+			switch_core_hash_this(hi, &key, NULL, &val);
+			switch_core_hash_delete(shard->hash, (const char *) key);
+			free(val);
+		}
+		switch_mutex_unlock(shard->mutex);
+	}
+
 	sql = switch_mprintf("delete from limit_data where hostname='%q';", globals.hostname);
-	limit_execute_sql(sql);
-	switch_safe_free(sql);
+	limit_queue_sql(sql);
 	
 	return SWITCH_STATUS_SUCCESS;
 }
 
 SWITCH_LIMIT_STATUS(limit_status_db)
 {
-	char count[128] = "";
-	char *ret = NULL;
-	char *sql = NULL;
-	
-	sql = switch_mprintf("select count(hostname) from limit_data where hostname='%q'", globals.hostname);
-	limit_execute_sql2str(sql, count, sizeof(count));
-	switch_safe_free(sql);
-	ret = switch_mprintf("Tracking %s resources for hostname %s.", count, globals.hostname);
-	return ret;
+	switch_hash_index_t *hi;
+	uint32_t count = 0;
+	int i;
+
+	for (i = 0; i < LIMIT_SHARDS; i++) {
+		limit_db_shard_t *shard = &globals.limit_shards[i];
+
+		switch_mutex_lock(shard->mutex);
+		for (hi = switch_core_hash_first(shard->hash); hi; hi = switch_core_hash_next(hi)) {
+			void *val;
+
+			switch_core_hash_this(hi, NULL, NULL, &val);
+			count += ((limit_db_item_t *) val)->local_usage;
+		}
+		switch_mutex_unlock(shard->mutex);
+	}
+
+	return switch_mprintf("Tracking %u resources for hostname %s.", count, globals.hostname);
 }
 
 /* INIT / Config */
@@ -276,6 +476,8 @@ static switch_xml_config_string_options_t limit_config_dsn = { NULL, 0, "^pgsql|
 static switch_xml_config_item_t config_settings[] = {
 	SWITCH_CONFIG_ITEM("odbc-dsn", SWITCH_CONFIG_STRING, 0, &globals.odbc_dsn, NULL, &limit_config_dsn,
 					   "dsn:username:password", "If set, the ODBC DSN used by the limit and db applications"),
+	SWITCH_CONFIG_ITEM("remote-usage-refresh", SWITCH_CONFIG_INT, 0, &globals.remote_usage_refresh, (void *) 1, NULL,
+					   "seconds", "How often limit usage of other hosts sharing the ODBC DSN is counted, 0 to ignore them"),
 	SWITCH_CONFIG_ITEM_END()
 };
 
@@ -301,6 +503,8 @@ static switch_status_t do_config()
 	if (zstr(globals.odbc_dsn)) {
 		globals.dbname = "call_limit";
 		dbh = limit_get_db_handle();
+		/* nobody else writes to our own sqlite file */
+		globals.remote_usage_refresh = 0;
 	}
 
 
@@ -640,6 +844,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_db_load)
 	switch_application_interface_t *app_interface;
 	switch_api_interface_t *commands_api_interface;
 	switch_limit_interface_t *limit_interface;
+	int x;
 
 	memset(&globals, 0, sizeof(globals));
 	strncpy(globals.hostname, switch_core_get_switchname(), sizeof(globals.hostname));
@@ -654,6 +859,15 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_db_load)
 	switch_mutex_init(&globals.db_hash_mutex, SWITCH_MUTEX_NESTED, globals.pool);
 	switch_core_hash_init(&globals.db_hash);
 
+	for (x = 0; x < LIMIT_SHARDS; x++) {
+		switch_mutex_init(&globals.limit_shards[x].mutex, SWITCH_MUTEX_NESTED, globals.pool);
+		switch_core_hash_init(&globals.limit_shards[x].hash);
+	}
+
+	switch_sql_queue_manager_init_name("limit_db", &globals.qm, 1, !zstr(globals.odbc_dsn) ? globals.odbc_dsn : globals.dbname,
+									   SWITCH_MAX_TRANS, NULL, NULL, NULL, NULL);
+	switch_sql_queue_manager_start(globals.qm);
+
 	status = switch_event_reserve_subclass(LIMIT_EVENT_USAGE);
 	if (status != SWITCH_STATUS_SUCCESS && status != SWITCH_STATUS_INUSE) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't register event subclass \"%s\" (%d)\n", LIMIT_EVENT_USAGE, status);
@@ -689,8 +903,25 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_db_load)
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_db_shutdown)
 {
 
+	switch_hash_index_t *hi;
+	int x;
+
 	switch_xml_config_cleanup(config_settings);
 
+	if (globals.qm) {
+		switch_sql_queue_manager_destroy(&globals.qm);
+	}
+
+	for (x = 0; x < LIMIT_SHARDS; x++) {
+		for (hi = switch_core_hash_first(globals.limit_shards[x].hash); hi; hi = switch_core_hash_next(hi)) {
+			void *val;
+
+			switch_core_hash_this(hi, NULL, NULL, &val);
+			free(val);
+		}
+		switch_core_hash_destroy(&globals.limit_shards[x].hash);
+	}
+
 	switch_mutex_destroy(globals.mutex);
 	switch_mutex_destroy(globals.db_hash_mutex);
 
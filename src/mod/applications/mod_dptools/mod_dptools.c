@@ -3690,7 +3690,6 @@ SWITCH_STANDARD_APP(pickup_function)
 			switch_caller_profile_t *pickup_caller_profile = switch_channel_get_caller_profile(pickup_channel), 
 				*caller_profile = switch_channel_get_caller_profile(channel);
 			const char *name, *num;
-			switch_event_t *event;
 			switch_event_header_t *hp;
 			pickup_pvt_t *tech_pvt = switch_core_session_get_private(pickup_session);
 
@@ -3711,16 +3710,7 @@ SWITCH_STANDARD_APP(pickup_function)
 			caller_profile->callee_id_name = name;
 			caller_profile->callee_id_number = num;
 			
-			if (switch_event_create(&event, SWITCH_EVENT_CALL_UPDATE) == SWITCH_STATUS_SUCCESS) {
-				const char *uuid = switch_channel_get_partner_uuid(channel);
-				switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Direction", "RECV");
-				
-				if (uuid) {
-					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Bridged-To", uuid);
-				}
-				switch_channel_event_set_data(channel, event);
-				switch_event_fire(&event);
-			}
+			switch_channel_fire_call_update(channel, "RECV", NULL, NULL);
 
 
 			switch_channel_set_state(channel, CS_HIBERNATE);
@@ -44,7 +44,6 @@
  *
  * TODO: Fix what happens when the DB is not available
  * TODO: Fix what happens when the DB queries fail (right now, all are acting like success)
- * TODO: Add buffering abilities
  * TODO: Make error handling for database, such that when the database is down (or not installed) we just log to a text file
  * FUTURE: Possibly make the hooks not tied per-channel, and instead just do this as a supervision style application with one thread that watches all calls
  */
@@ -70,6 +69,17 @@ typedef struct nibblebill_results {
 } nibblebill_results_t;
 
 
+/* One entry per billed account while the batched ledger is enabled */
+typedef struct nibble_ledger_entry {
+	char *account;
+	double balance;				/* Balance as last read from the database */
+	double pending;				/* Deductions not yet reconciled to the database */
+	double flushing;			/* Deductions currently being written by the reconcile thread */
+	int loaded;					/* Set to 1 once balance holds a value read from the database */
+	switch_time_t last_used;	/* Last time a call billed or checked this account */
+} nibble_ledger_entry_t;
+
+
 /* Keep track of our config, event hooks and database connection variables, for this module only */
 static struct {
 	/* Memory */
@@ -92,6 +102,18 @@ static struct {
 	/* Other options */
 	int global_heartbeat;		/* Supervise and bill every X seconds, 0 means off */
 
+	/* Batched ledger */
+	int batch_interval;			/* Reconcile the ledger to the database every X seconds, 0 means bill every heartbeat */
+	char *journal_file;			/* Local journal of unreconciled deductions, replayed on load */
+	FILE *journal;
+	int64_t journal_seq;		/* Sequence number of the last deduction written to the journal */
+	int64_t applied_seq;		/* Last sequence number the database has applied */
+	uint32_t ledger_generation;	/* Bumped when a reconcile starts writing and when it commits */
+	switch_hash_t *ledger;
+	switch_mutex_t *ledger_mutex;
+	switch_thread_t *ledger_thread;
+	int running;
+
 	/* Channel variable name options */
 	char *var_name_rate;
 	char *var_name_account;
@@ -132,6 +154,7 @@ SWITCH_DECLARE_GLOBAL_STRING_FUNC(set_global_lowbal_action, globals.lowbal_actio
 SWITCH_DECLARE_GLOBAL_STRING_FUNC(set_global_nobal_action, globals.nobal_action);
 SWITCH_DECLARE_GLOBAL_STRING_FUNC(set_global_var_name_rate, globals.var_name_rate);
 SWITCH_DECLARE_GLOBAL_STRING_FUNC(set_global_var_name_account, globals.var_name_account);
+SWITCH_DECLARE_GLOBAL_STRING_FUNC(set_global_journal_file, globals.journal_file);
 
 static switch_cache_db_handle_t *nibblebill_get_db_handle(void)
 {
@@ -255,6 +278,10 @@ static switch_status_t nibblebill_load_config(void)
 				set_global_var_name_account(val);
 			} else if (!strcasecmp(var, "global_heartbeat")) {
 				globals.global_heartbeat = atoi(val);
+			} else if (!strcasecmp(var, "batch_interval")) {
+				globals.batch_interval = atoi(val);
+			} else if (!strcasecmp(var, "journal_file")) {
+				set_global_journal_file(val);
 			}
 		}
 	}
@@ -277,6 +304,14 @@ static switch_status_t nibblebill_load_config(void)
 	if (zstr(globals.var_name_account)) {
 		set_global_var_name_account("nibble_account");
 	}
+	if (globals.batch_interval < 0) {
+		globals.batch_interval = 0;
+	}
+	if (globals.batch_interval && zstr(globals.journal_file)) {
+		char *path = switch_mprintf("%s%snibblebill.journal", SWITCH_GLOBAL_dirs.db_dir, SWITCH_PATH_SEPARATOR);
+		set_global_journal_file(path);
+		switch_safe_free(path);
+	}
 
 	if (globals.odbc_dsn) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG
@@ -369,7 +404,7 @@ static void transfer_call(switch_core_session_t *session, char *destination)
 }
 
 /* At this time, billing never succeeds if you don't have a database. */
-static switch_bool_t bill_event(double billamount, const char *billaccount, switch_channel_t *channel)
+static switch_bool_t db_bill_event(double billamount, const char *billaccount, switch_channel_t *channel)
 {
 	char *sql = NULL, *dsql = NULL;
 	switch_bool_t status = SWITCH_FALSE;
@@ -395,7 +430,7 @@ static switch_bool_t bill_event(double billamount, const char *billaccount, swit
 	return status;
 }
 
-static double get_balance(const char *billaccount, switch_channel_t *channel)
+static double db_get_balance(const char *billaccount, switch_channel_t *channel)
 {
 	char *dsql = NULL, *sql = NULL;
 	nibblebill_results_t pdata;
@@ -430,6 +465,489 @@ static double get_balance(const char *billaccount, switch_channel_t *channel)
 	return balance;
 }
 
+/* Batched ledger
+   When batch_interval is set, deductions are aggregated per account in memory and written to the database
+   by the reconcile thread in one transaction every batch_interval seconds. Balance checks are answered from
+   the last balance read from the database minus everything not yet reconciled. Every deduction is appended
+   to the journal before it is accepted so unreconciled amounts survive a crash and are replayed on load.
+   Journal entries carry a sequence number and each reconcile stores the last one it covers in
+   nibblebill_ledger in the same transaction, so entries the database already applied are never replayed. */
+
+static char ledger_state_sql[] =
+	"CREATE TABLE nibblebill_ledger (\n"
+	"   hostname   VARCHAR(255),\n"
+	"   last_seq   BIGINT\n"
+	");\n";
+
+static nibble_ledger_entry_t *ledger_locate(const char *billaccount)
+{
+	nibble_ledger_entry_t *entry;
+
+	if (!(entry = (nibble_ledger_entry_t *) switch_core_hash_find(globals.ledger, billaccount))) {
+		switch_zmalloc(entry, sizeof(*entry));
+		entry->account = strdup(billaccount);
+		switch_core_hash_insert(globals.ledger, billaccount, entry);
+	}
+
+	entry->last_used = switch_micro_time_now();
+
+	return entry;
+}
+
+/* Called with ledger_mutex held */
+static void ledger_journal_write(const char *billaccount, double billamount)
+{
+	globals.journal_seq++;
+
+	if (!globals.journal) {
+		return;
+	}
+
+	fprintf(globals.journal, "%" SWITCH_INT64_T_FMT "\t%s\t%f\n", globals.journal_seq, billaccount, billamount);
+	fflush(globals.journal);
+}
+
+/* Called with ledger_mutex held; rewrites the journal so it only holds what is still unreconciled.
+   The new journal is written aside and renamed over the old one, a crash in between leaves the old
+   one in place and its applied entries are skipped by sequence number on replay. */
+static void ledger_journal_rewrite(void)
+{
+	switch_hash_index_t *hi;
+	switch_memory_pool_t *pool = NULL;
+	const void *var;
+	void *val;
+	char *tmp_file;
+	FILE *fp;
+
+	if (!globals.journal) {
+		return;
+	}
+
+	tmp_file = switch_mprintf("%s.tmp", globals.journal_file);
+
+	if (!(fp = fopen(tmp_file, "w"))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot write %s, journal %s keeps reconciled entries until next time\n",
+						  tmp_file, globals.journal_file);
+		goto end;
+	}
+
+	for (hi = switch_core_hash_first(globals.ledger); hi; hi = switch_core_hash_next(hi)) {
+		nibble_ledger_entry_t *entry;
+
+		switch_core_hash_this(hi, &var, NULL, &val);
+		entry = (nibble_ledger_entry_t *) val;
+
+		if (entry->pending + entry->flushing != 0) {
+			fprintf(fp, "%" SWITCH_INT64_T_FMT "\t%s\t%f\n", ++globals.journal_seq, entry->account, entry->pending + entry->flushing);
+		}
+	}
+
+	if (fflush(fp) || fclose(fp)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot write %s, journal %s keeps reconciled entries until next time\n",
+						  tmp_file, globals.journal_file);
+		goto end;
+	}
+
+	fclose(globals.journal);
+	globals.journal = NULL;
+
+	switch_core_new_memory_pool(&pool);
+	if (switch_file_rename(tmp_file, globals.journal_file, pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot rename %s to %s\n", tmp_file, globals.journal_file);
+	}
+	switch_core_destroy_memory_pool(&pool);
+
+	if (!(globals.journal = fopen(globals.journal_file, "a"))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Cannot reopen journal %s, unreconciled deductions are no longer crash-safe!\n",
+						  globals.journal_file);
+	}
+
+  end:
+	switch_safe_free(tmp_file);
+}
+
+/* Read which journal entries the database has already applied, creating our row on first use */
+static void ledger_load_state(void)
+{
+	switch_cache_db_handle_t *dbh = NULL;
+	char buf[64] = "";
+	char *sql;
+
+	if (!globals.odbc_dsn || !(dbh = nibblebill_get_db_handle())) {
+		return;
+	}
+
+	switch_cache_db_test_reactive(dbh, "select last_seq from nibblebill_ledger", NULL, ledger_state_sql);
+
+	sql = switch_mprintf("select last_seq from nibblebill_ledger where hostname='%q'", switch_core_get_switchname());
+	switch_cache_db_execute_sql2str(dbh, sql, buf, sizeof(buf), NULL);
+	switch_safe_free(sql);
+
+	if (zstr(buf)) {
+		sql = switch_mprintf("insert into nibblebill_ledger (hostname, last_seq) values('%q', 0)", switch_core_get_switchname());
+		switch_cache_db_execute_sql(dbh, sql, NULL);
+		switch_safe_free(sql);
+	} else {
+		globals.applied_seq = (int64_t) strtoll(buf, NULL, 10);
+	}
+
+	globals.journal_seq = globals.applied_seq;
+
+	switch_cache_db_release_db_handle(&dbh);
+}
+
+static void ledger_journal_replay(void)
+{
+	FILE *fp;
+	char *line = NULL;
+	switch_size_t len = 0;
+	int count = 0;
+
+	if (!(fp = fopen(globals.journal_file, "r"))) {
+		return;
+	}
+
+	while (switch_fp_read_dline(fp, &line, &len)) {
+		char *argv[3] = { 0 };
+		int argc;
+		int64_t seq = 0;
+		char *account, *amount;
+		nibble_ledger_entry_t *entry;
+
+		if ((argc = switch_separate_string(line, '\t', argv, (sizeof(argv) / sizeof(argv[0])))) < 2) {
+			continue;
+		}
+
+		if (argc == 3) {
+			seq = (int64_t) strtoll(argv[0], NULL, 10);
+			account = argv[1];
+			amount = argv[2];
+		} else {
+			/* journal written before entries were numbered */
+			account = argv[0];
+			amount = argv[1];
+		}
+
+		if (zstr(account)) {
+			continue;
+		}
+
+		if (seq) {
+			if (seq <= globals.applied_seq) {
+				continue;
+			}
+
+			if (seq > globals.journal_seq) {
+				globals.journal_seq = seq;
+			}
+		}
+
+		entry = ledger_locate(account);
+		entry->pending += atof(amount);
+		count++;
+	}
+
+	switch_safe_free(line);
+	fclose(fp);
+
+	if (count) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Replayed %d unreconciled deductions from journal %s\n", count, globals.journal_file);
+	}
+}
+
+static switch_bool_t ledger_bill_event(double billamount, const char *billaccount)
+{
+	nibble_ledger_entry_t *entry;
+
+	switch_mutex_lock(globals.ledger_mutex);
+	entry = ledger_locate(billaccount);
+	ledger_journal_write(billaccount, billamount);
+	entry->pending += billamount;
+	switch_mutex_unlock(globals.ledger_mutex);
+
+	return SWITCH_TRUE;
+}
+
+static double ledger_get_balance(const char *billaccount, switch_channel_t *channel)
+{
+	nibble_ledger_entry_t *entry;
+	double balance;
+
+	uint32_t generation;
+	int tries = 0;
+
+	switch_mutex_lock(globals.ledger_mutex);
+	entry = ledger_locate(billaccount);
+
+	while (!entry->loaded) {
+		if (entry->flushing != 0 && tries < 3) {
+			/* A reconcile is writing this account, the database may or may not have it yet */
+			tries++;
+			switch_mutex_unlock(globals.ledger_mutex);
+			switch_yield(100000);
+			switch_mutex_lock(globals.ledger_mutex);
+			entry = ledger_locate(billaccount);
+			continue;
+		}
+
+		generation = globals.ledger_generation;
+
+		/* Don't hold the ledger while we wait on the database */
+		switch_mutex_unlock(globals.ledger_mutex);
+		balance = db_get_balance(billaccount, channel);
+		switch_mutex_lock(globals.ledger_mutex);
+
+		if (balance == -1.0) {
+			/* Lookup failed, don't cache it and report it the same way the database path does */
+			switch_mutex_unlock(globals.ledger_mutex);
+			return balance;
+		}
+
+		entry = ledger_locate(billaccount);
+
+		/* A reconcile started or committed while we were reading, so the balance we got may or may not
+		   include what it flushed. Read again rather than count it twice or not at all. */
+		if (generation != globals.ledger_generation || entry->flushing != 0) {
+			if (++tries < 4) {
+				continue;
+			}
+
+			/* Still can't tell, take the lower figure and don't cache it */
+			balance -= entry->pending + entry->flushing;
+			switch_mutex_unlock(globals.ledger_mutex);
+			return balance;
+		}
+
+		entry->balance = balance;
+		entry->loaded = 1;
+	}
+
+	balance = entry->balance - entry->pending - entry->flushing;
+	switch_mutex_unlock(globals.ledger_mutex);
+
+	return balance;
+}
+
+static switch_bool_t ledger_idle_callback(const void *key, const void *val, void *pData)
+{
+	nibble_ledger_entry_t *entry = (nibble_ledger_entry_t *) val;
+	switch_time_t *cutoff = (switch_time_t *) pData;
+
+	if (entry->pending == 0 && entry->flushing == 0 && entry->last_used < *cutoff) {
+		switch_safe_free(entry->account);
+		free(entry);
+		return SWITCH_TRUE;
+	}
+
+	return SWITCH_FALSE;
+}
+
+static switch_bool_t ledger_free_callback(const void *key, const void *val, void *pData)
+{
+	nibble_ledger_entry_t *entry = (nibble_ledger_entry_t *) val;
+
+	switch_safe_free(entry->account);
+	free(entry);
+
+	return SWITCH_TRUE;
+}
+
+/* Write every pending deduction to the database in a single transaction */
+static void ledger_reconcile(void)
+{
+	switch_hash_index_t *hi;
+	switch_cache_db_handle_t *dbh = NULL;
+	switch_stream_handle_t stream = { 0 };
+	switch_time_t cutoff;
+	const void *var;
+	void *val;
+	int count = 0;
+	int64_t batch_seq;
+	switch_bool_t ok = SWITCH_FALSE;
+
+	SWITCH_STANDARD_STREAM(stream);
+
+	switch_mutex_lock(globals.ledger_mutex);
+	for (hi = switch_core_hash_first(globals.ledger); hi; hi = switch_core_hash_next(hi)) {
+		nibble_ledger_entry_t *entry;
+		char *sql;
+
+		switch_core_hash_this(hi, &var, NULL, &val);
+		entry = (nibble_ledger_entry_t *) val;
+
+		if (entry->pending == 0) {
+			continue;
+		}
+
+		if (globals.custom_sql_save) {
+			switch_event_t *vars;
+
+			/* There is no channel here, only nibble_account and nibble_bill can be expanded */
+			switch_event_create(&vars, SWITCH_EVENT_CLONE);
+			switch_event_add_header_string(vars, SWITCH_STACK_BOTTOM, globals.var_name_account, entry->account);
+			switch_event_add_header(vars, SWITCH_STACK_BOTTOM, "nibble_bill", "%f", entry->pending);
+			sql = switch_event_expand_headers(vars, globals.custom_sql_save);
+			stream.write_function(&stream, "%s;\n", sql);
+			if (sql != globals.custom_sql_save) {
+				free(sql);
+			}
+			switch_event_destroy(&vars);
+		} else {
+			sql = switch_mprintf("UPDATE %s SET %s=%s-%f WHERE %s='%q'", globals.db_table, globals.db_column_cash,
+								 globals.db_column_cash, entry->pending, globals.db_column_account, entry->account);
+			stream.write_function(&stream, "%s;\n", sql);
+			switch_safe_free(sql);
+		}
+
+		entry->flushing = entry->pending;
+		entry->pending = 0;
+		count++;
+	}
+
+	/* Every journal entry up to here is in this batch */
+	batch_seq = globals.journal_seq;
+
+	if (count) {
+		/* Balance reads already in flight can't tell whether they see this batch */
+		globals.ledger_generation++;
+	}
+	switch_mutex_unlock(globals.ledger_mutex);
+
+	if (count) {
+		stream.write_function(&stream, "UPDATE nibblebill_ledger SET last_seq=%" SWITCH_INT64_T_FMT " WHERE hostname='%q';\n",
+							  batch_seq, switch_core_get_switchname());
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Reconciling %d accounts\n[%s]\n", count, (char *) stream.data);
+
+		if (globals.odbc_dsn && (dbh = nibblebill_get_db_handle())) {
+			ok = switch_cache_db_persistant_execute_trans(dbh, (char *) stream.data, 1) == SWITCH_STATUS_SUCCESS ? SWITCH_TRUE : SWITCH_FALSE;
+		}
+		switch_cache_db_release_db_handle(&dbh);
+
+		if (!ok) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Failed to reconcile %d accounts to database, will retry in %d seconds!\n",
+							  count, globals.batch_interval);
+		}
+	}
+
+	cutoff = switch_micro_time_now() - (switch_time_t) globals.batch_interval * 1000000;
+
+	switch_mutex_lock(globals.ledger_mutex);
+	for (hi = switch_core_hash_first(globals.ledger); hi; hi = switch_core_hash_next(hi)) {
+		nibble_ledger_entry_t *entry;
+
+		switch_core_hash_this(hi, &var, NULL, &val);
+		entry = (nibble_ledger_entry_t *) val;
+
+		if (ok) {
+			/* Re-read the balance on next use so top-ups made in the database are picked up */
+			if (entry->flushing != 0) {
+				entry->loaded = 0;
+			}
+		} else {
+			entry->pending += entry->flushing;
+		}
+		entry->flushing = 0;
+	}
+
+	if (ok) {
+		globals.applied_seq = batch_seq;
+		globals.ledger_generation++;
+		ledger_journal_rewrite();
+	}
+
+	switch_core_hash_delete_multi(globals.ledger, ledger_idle_callback, &cutoff);
+	switch_mutex_unlock(globals.ledger_mutex);
+
+	switch_safe_free(stream.data);
+}
+
+static void *SWITCH_THREAD_FUNC ledger_thread_run(switch_thread_t *thread, void *obj)
+{
+	int ticks = 0;
+
+	while (globals.running) {
+		switch_yield(1000000);
+
+		if (++ticks >= globals.batch_interval) {
+			ledger_reconcile();
+			ticks = 0;
+		}
+	}
+
+	ledger_reconcile();
+
+	return NULL;
+}
+
+static void ledger_start(void)
+{
+	switch_threadattr_t *thd_attr = NULL;
+
+	switch_core_hash_init(&globals.ledger);
+	switch_mutex_init(&globals.ledger_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+
+	ledger_load_state();
+	ledger_journal_replay();
+
+	if (!(globals.journal = fopen(globals.journal_file, "a"))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot open journal %s, unreconciled deductions will be lost on crash!\n",
+						  globals.journal_file);
+	}
+
+	globals.running = 1;
+
+	switch_threadattr_create(&thd_attr, globals.pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	switch_thread_create(&globals.ledger_thread, thd_attr, ledger_thread_run, NULL, globals.pool);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Batched ledger enabled, reconciling every %d seconds (journal %s)\n",
+					  globals.batch_interval, globals.journal_file);
+}
+
+static void ledger_stop(void)
+{
+	switch_status_t st;
+
+	if (!globals.ledger_thread) {
+		return;
+	}
+
+	globals.running = 0;
+	switch_thread_join(&st, globals.ledger_thread);
+	globals.ledger_thread = NULL;
+
+	if (globals.journal) {
+		fclose(globals.journal);
+		globals.journal = NULL;
+	}
+
+	/* Anything still pending is in the journal and will be replayed on next load */
+	switch_mutex_lock(globals.ledger_mutex);
+	switch_core_hash_delete_multi(globals.ledger, ledger_free_callback, NULL);
+	switch_mutex_unlock(globals.ledger_mutex);
+
+	switch_core_hash_destroy(&globals.ledger);
+}
+
+static switch_bool_t bill_event(double billamount, const char *billaccount, switch_channel_t *channel)
+{
+	if (globals.ledger_thread) {
+		return ledger_bill_event(billamount, billaccount);
+	}
+
+	return db_bill_event(billamount, billaccount, channel);
+}
+
+static double get_balance(const char *billaccount, switch_channel_t *channel)
+{
+	if (globals.ledger_thread) {
+		return ledger_get_balance(billaccount, channel);
+	}
+
+	return db_get_balance(billaccount, channel);
+}
+
 /* This is where we actually charge the guy 
   This can be called anytime a call is in progress or at the end of a call before the session is destroyed */
 static switch_status_t do_billing(switch_core_session_t *session)
@@ -999,6 +1517,10 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_nibblebill_load)
 				   "Pause, resume, reset, adjust, flush, heartbeat commands to handle billing.", nibblebill_app_function, APP_SYNTAX,
 				   SAF_SUPPORT_NOMEDIA | SAF_ROUTING_EXEC);
 
+	if (globals.batch_interval) {
+		ledger_start();
+	}
+
 	/* register state handlers for billing */
 	switch_core_add_state_handler(&nibble_state_handler);
 
@@ -1017,6 +1539,7 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_nibblebill_shutdown)
 {
 	switch_event_unbind(&globals.node);
 	switch_core_remove_state_handler(&nibble_state_handler);
+	ledger_stop();
 	switch_odbc_handle_disconnect(globals.master_odbc);
 	
 	switch_safe_free(globals.dbname);
@@ -1031,6 +1554,7 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_nibblebill_shutdown)
 	switch_safe_free(globals.nobal_action);
 	switch_safe_free(globals.var_name_rate);
 	switch_safe_free(globals.var_name_account);
+	switch_safe_free(globals.journal_file);
 
 	return SWITCH_STATUS_UNLOAD;
 }
@@ -399,6 +399,77 @@ SWITCH_STANDARD_API(stop_tdd_detect_api)
 }
 
 
+SWITCH_STANDARD_API(t38_timers_api)
+{
+	mod_spandsp_fax_timer_status(stream, !zstr(cmd) && !strcasecmp(cmd, "reset"));
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_STANDARD_API(tiff_writers_api)
+{
+	mod_spandsp_fax_writer_status(stream, !zstr(cmd) && !strcasecmp(cmd, "reset"));
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define FAX_LOOPBACK_SYNTAX "<faxes> <tiff file> [inline]"
+SWITCH_STANDARD_API(fax_loopback_api)
+{
+	char *argv[3] = { 0 };
+	char *mycmd = NULL;
+	int argc, faxes;
+
+	if (!zstr(cmd)) {
+		mycmd = strdup(cmd);
+		argc = switch_split(mycmd, ' ', argv);
+	} else {
+		argc = 0;
+	}
+
+	if (argc < 2 || (faxes = atoi(argv[0])) < 1 || faxes > 1000) {
+		stream->write_function(stream, "-USAGE: %s\n", FAX_LOOPBACK_SYNTAX);
+		goto end;
+	}
+
+	mod_spandsp_fax_loopback_test(stream, faxes, argv[1], !(argc > 2 && !strcasecmp(argv[2], "inline")));
+
+ end:
+
+	switch_safe_free(mycmd);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define T38_LOOPBACK_SYNTAX "<faxes> <tiff file>"
+SWITCH_STANDARD_API(t38_loopback_api)
+{
+	char *argv[2] = { 0 };
+	char *mycmd = NULL;
+	int argc, faxes;
+
+	if (!zstr(cmd)) {
+		mycmd = strdup(cmd);
+		argc = switch_split(mycmd, ' ', argv);
+	} else {
+		argc = 0;
+	}
+
+	if (argc < 2 || (faxes = atoi(argv[0])) < 1 || faxes > 1000) {
+		stream->write_function(stream, "-USAGE: %s\n", T38_LOOPBACK_SYNTAX);
+		goto end;
+	}
+
+	mod_spandsp_t38_loopback_test(stream, faxes, argv[1]);
+
+ end:
+
+	switch_safe_free(mycmd);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+
 SWITCH_STANDARD_API(start_send_tdd_api)
 {
 	switch_core_session_t *psession = NULL;
@@ -512,6 +583,9 @@ switch_status_t load_configuration(switch_bool_t reload)
 	spandsp_globals.header = "SpanDSP Fax Header";
 	spandsp_globals.timezone = "";
 	spandsp_globals.tonedebug = 0;
+	spandsp_globals.t38_timer_threads = 1;
+	spandsp_globals.tiff_writer_threads = 2;
+	spandsp_globals.tiff_writer_queue_len = 16;
 
 	if ((xml = switch_xml_open_cfg("spandsp.conf", &cfg, NULL)) || (xml = switch_xml_open_cfg("fax.conf", &cfg, NULL))) {
 		status = SWITCH_STATUS_SUCCESS;
@@ -622,6 +696,38 @@ switch_status_t load_configuration(switch_bool_t reload)
 					spandsp_globals.spool = switch_core_strdup(spandsp_globals.config_pool, value);
 				} else if (!strcmp(name, "file-prefix")) {
 					spandsp_globals.prepend_string = switch_core_strdup(spandsp_globals.config_pool, value);
+				} else if (!strcmp(name, "t38-timer-threads")) {
+					/* The timer threads are started once at load */
+					if (!reload) {
+						int tmp = atoi(value);
+
+						if (tmp > 0 && tmp <= 64) {
+							spandsp_globals.t38_timer_threads = tmp;
+						} else {
+							switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid value [%d] for t38-timer-threads\n", tmp);
+						}
+					}
+				} else if (!strcmp(name, "tiff-writer-threads")) {
+					/* So are the TIFF writers, 0 writes the pages in the media path */
+					if (!reload) {
+						int tmp = atoi(value);
+
+						if (tmp >= 0 && tmp <= 64) {
+							spandsp_globals.tiff_writer_threads = tmp;
+						} else {
+							switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid value [%d] for tiff-writer-threads\n", tmp);
+						}
+					}
+				} else if (!strcmp(name, "tiff-writer-queue")) {
+					if (!reload) {
+						int tmp = atoi(value);
+
+						if (tmp > 0) {
+							spandsp_globals.tiff_writer_queue_len = tmp;
+						} else {
+							switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid value [%d] for tiff-writer-queue\n", tmp);
+						}
+					}
 				} else {
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Unknown parameter %s\n", name);
 				}
@@ -787,6 +893,11 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_spandsp_init)
 
 	SWITCH_ADD_API(api_interface, "uuid_send_tdd", "send tdd data to a uuid", start_send_tdd_api, "<uuid> <text>");
 
+	SWITCH_ADD_API(api_interface, "spandsp_t38_timers", "Show how the T.38 timer threads keep up", t38_timers_api, "[reset]");
+	SWITCH_ADD_API(api_interface, "spandsp_tiff_writers", "Show how the fax TIFF writer threads keep up", tiff_writers_api, "[reset]");
+	SWITCH_ADD_API(api_interface, "spandsp_fax_loopback", "Receive a file over fax to fax loopbacks and time it", fax_loopback_api, FAX_LOOPBACK_SYNTAX);
+	SWITCH_ADD_API(api_interface, "spandsp_t38_loopback", "Send a file over T.38 loopbacks and show how the timer threads keep up", t38_loopback_api, T38_LOOPBACK_SYNTAX);
+
 	switch_console_set_complete("add uuid_send_tdd ::console::list_uuid");
 
 
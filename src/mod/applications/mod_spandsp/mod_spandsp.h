@@ -72,8 +72,9 @@ struct spandsp_globals {
 	char *timezone;
 	char *prepend_string;
 	char *spool;
-	switch_thread_cond_t *cond;
-	switch_mutex_t *cond_mutex;
+	int t38_timer_threads;
+	int tiff_writer_threads;
+	int tiff_writer_queue_len;
 	int modem_count;
 	int modem_verbose;
 	char *modem_context;
@@ -128,6 +129,10 @@ switch_status_t mod_spandsp_codecs_load(switch_loadable_module_interface_t **mod
 switch_status_t mod_spandsp_dsp_load(switch_loadable_module_interface_t **module_interface, switch_memory_pool_t *pool);
 
 void mod_spandsp_fax_shutdown(void);
+void mod_spandsp_fax_timer_status(switch_stream_handle_t *stream, switch_bool_t reset);
+void mod_spandsp_fax_writer_status(switch_stream_handle_t *stream, switch_bool_t reset);
+void mod_spandsp_fax_loopback_test(switch_stream_handle_t *stream, int faxes, const char *file, switch_bool_t offload);
+void mod_spandsp_t38_loopback_test(switch_stream_handle_t *stream, int faxes, const char *file);
 void mod_spandsp_dsp_shutdown(void);
 
 void mod_spandsp_fax_event_handler(switch_event_t *event);
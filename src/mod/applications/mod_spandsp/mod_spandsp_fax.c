@@ -70,6 +70,29 @@ typedef enum {
 } t38_mode_t;
 
 
+#define TIFF_WRITER_MAX_THREADS 64
+
+/* A thread writing received pages to their TIFF files, so the T.30 engine doesn't have to in the media path */
+typedef struct tiff_writer_s {
+	int id;
+	switch_queue_t *queue;
+	switch_thread_t *thread;
+	/* Signalled whenever an output has nothing pending anymore, see tiff_output_drain() */
+	switch_mutex_t *drain_mutex;
+	switch_thread_cond_t *drain_cond;
+
+	/* Reported by mod_spandsp_fax_writer_status() */
+	switch_atomic_t jobs;
+	switch_atomic_t waits;
+	switch_time_t max_job;
+} tiff_writer_t;
+
+/* The TIFF output of one received fax. Its jobs all go to the same writer, which keeps them in order. */
+typedef struct tiff_output_s {
+	tiff_writer_t *writer;
+	switch_atomic_t pending;
+} tiff_output_t;
+
 struct pvt_s {
 	switch_core_session_t *session;
 
@@ -103,136 +126,215 @@ struct pvt_s {
 
 	t38_mode_t t38_mode;
 
+	tiff_output_t tiff_output;
+
+	struct t38_timer_shard_s *shard;
+	struct pvt_s *prev;
 	struct pvt_s *next;
+
+	/* The other end of a spandsp_t38_loopback fax, see mod_spandsp_t38_loopback_test() */
+	struct pvt_s *loopback_peer;
+	uint16_t loopback_seq;
 };
 
 typedef struct pvt_s pvt_t;
 
-static void launch_timer_thread(void);
+#define T38_TIMER_MAX_THREADS 64
 
-static struct {
+/* One timer thread and the T.38 faxes it drives */
+typedef struct t38_timer_shard_s {
+	int id;
 	pvt_t *head;
+	uint32_t count;
 	switch_mutex_t *mutex;
+	switch_mutex_t *cond_mutex;
+	switch_thread_cond_t *cond;
 	switch_thread_t *thread;
 	int thread_running;
-} t38_state_list;
+
+	/* How well the thread keeps up, reported by mod_spandsp_fax_timer_status(). Only touched under mutex. */
+	uint64_t ticks;
+	uint64_t late_ticks;
+	switch_time_t total_pass;
+	switch_time_t max_pass;
+	switch_time_t max_drift;
+} t38_timer_shard_t;
+
+static struct {
+	t38_timer_shard_t *shards;
+	int nshards;
+} t38_timers;
+
+static struct {
+	tiff_writer_t *writers;
+	int nwriters;
+	uint32_t next;
+} tiff_writers;
+
+typedef struct tiff_writer_job_s {
+	tiff_output_t *output;
+	t4_rx_deferred_t *job;
+} tiff_writer_job_t;
 
 
 
-static void wake_thread(int force)
+static void wake_thread(t38_timer_shard_t *shard, int force)
 {
 	if (force) {
-		switch_thread_cond_signal(spandsp_globals.cond);
+		switch_thread_cond_signal(shard->cond);
 		return;
 	}
 
-	if (switch_mutex_trylock(spandsp_globals.cond_mutex) == SWITCH_STATUS_SUCCESS) {
-		switch_thread_cond_signal(spandsp_globals.cond);
-		switch_mutex_unlock(spandsp_globals.cond_mutex);
+	if (switch_mutex_trylock(shard->cond_mutex) == SWITCH_STATUS_SUCCESS) {
+		switch_thread_cond_signal(shard->cond);
+		switch_mutex_unlock(shard->cond_mutex);
 	}
 }
 
 static int add_pvt(pvt_t *pvt)
 {
-	int r = 0;
+	t38_timer_shard_t *shard = NULL;
+	int i;
 
-	if (t38_state_list.thread_running) {
-		switch_mutex_lock(t38_state_list.mutex);
-		pvt->next = t38_state_list.head;
-		t38_state_list.head = pvt;
-		switch_mutex_unlock(t38_state_list.mutex);
-		r = 1;
-		wake_thread(0);
-	} else {
+	/* Pick the timer thread with the fewest faxes */
+	for (i = 0; i < t38_timers.nshards; i++) {
+		t38_timer_shard_t *s = &t38_timers.shards[i];
+
+		if (s->thread_running && (!shard || s->count < shard->count)) {
+			shard = s;
+		}
+	}
+
+	if (!shard) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Error launching thread\n");
+		return 0;
+	}
+
+	switch_mutex_lock(shard->mutex);
+	pvt->shard = shard;
+	pvt->prev = NULL;
+	pvt->next = shard->head;
+	if (shard->head) {
+		shard->head->prev = pvt;
 	}
+	shard->head = pvt;
+	shard->count++;
+	switch_mutex_unlock(shard->mutex);
 
-	return r;
+	wake_thread(shard, 0);
+
+	return 1;
 
 }
 
 
 static int del_pvt(pvt_t *del_pvt)
 {
-	pvt_t *p, *l = NULL;
-	int r = 0;
+	t38_timer_shard_t *shard = del_pvt->shard;
 
+	if (!shard) {
+		return 0;
+	}
 
-	switch_mutex_lock(t38_state_list.mutex);
+	switch_mutex_lock(shard->mutex);
 
-	for (p = t38_state_list.head; p; p = p->next) {
-		if (p == del_pvt) {
-			if (l) {
-				l->next = p->next;
-			} else {
-				t38_state_list.head = p->next;
-			}
-			p->next = NULL;
-			r = 1;
-			break;
-		}
+	if (del_pvt->prev) {
+		del_pvt->prev->next = del_pvt->next;
+	} else {
+		shard->head = del_pvt->next;
+	}
 
-		l = p;
+	if (del_pvt->next) {
+		del_pvt->next->prev = del_pvt->prev;
 	}
 
-	switch_mutex_unlock(t38_state_list.mutex);
+	del_pvt->next = del_pvt->prev = NULL;
+	del_pvt->shard = NULL;
+	shard->count--;
+
+	switch_mutex_unlock(shard->mutex);
 
-	wake_thread(0);
+	wake_thread(shard, 0);
 
-	return r;
+	return 1;
 }
 
 static void *SWITCH_THREAD_FUNC timer_thread_run(switch_thread_t *thread, void *obj)
 {
+	t38_timer_shard_t *shard = (t38_timer_shard_t *) obj;
 	switch_timer_t timer = { 0 };
+	switch_time_t start, pass, last = 0;
 	pvt_t *pvt;
 	int samples = 160;
 	int ms = 20;
 
-	switch_mutex_lock(t38_state_list.mutex);
-	t38_state_list.thread_running = 1;
-	switch_mutex_unlock(t38_state_list.mutex);
+	switch_mutex_lock(shard->mutex);
+	shard->thread_running = 1;
+	switch_mutex_unlock(shard->mutex);
 
-	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "FAX timer thread started.\n");
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "FAX timer thread %d started.\n", shard->id);
 
 	if (switch_core_timer_init(&timer, "soft", ms, samples, NULL) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "timer init failed.\n");
 		goto end;
 	}
 
-	switch_mutex_lock(spandsp_globals.cond_mutex);
+	switch_mutex_lock(shard->cond_mutex);
 
-	while(t38_state_list.thread_running) {
+	while(shard->thread_running) {
 
-		switch_mutex_lock(t38_state_list.mutex);
+		switch_mutex_lock(shard->mutex);
 
-		if (!t38_state_list.head) {
-			switch_mutex_unlock(t38_state_list.mutex);
-			switch_thread_cond_wait(spandsp_globals.cond, spandsp_globals.cond_mutex);
+		if (!shard->head) {
+			switch_mutex_unlock(shard->mutex);
+			switch_thread_cond_wait(shard->cond, shard->cond_mutex);
 			switch_core_timer_sync(&timer);
+			last = 0;
 			continue;
 		}
 
-		for (pvt = t38_state_list.head; pvt; pvt = pvt->next) {
-			if (pvt->udptl_state && pvt->session && switch_channel_ready(switch_core_session_get_channel(pvt->session))) {
+		start = switch_micro_time_now();
+
+		/* How much later than one interval after the previous one this tick started */
+		if (last && start - last > ms * 1000 && start - last - ms * 1000 > shard->max_drift) {
+			shard->max_drift = start - last - ms * 1000;
+		}
+		last = start;
+
+		for (pvt = shard->head; pvt; pvt = pvt->next) {
+			if (pvt->loopback_peer) {
+				/* Both ends of a loopback fax tick here, so only this thread ever runs them */
+				t38_terminal_send_timeout(pvt->t38_state, samples);
+				t38_terminal_send_timeout(pvt->loopback_peer->t38_state, samples);
+			} else if (pvt->udptl_state && pvt->session && switch_channel_ready(switch_core_session_get_channel(pvt->session))) {
 				t38_terminal_send_timeout(pvt->t38_state, samples);
 			}
 		}
 
-		switch_mutex_unlock(t38_state_list.mutex);
+		pass = switch_micro_time_now() - start;
+		shard->ticks++;
+		shard->total_pass += pass;
+		if (pass > shard->max_pass) {
+			shard->max_pass = pass;
+		}
+		if (pass >= ms * 1000) {
+			shard->late_ticks++;
+		}
+
+		switch_mutex_unlock(shard->mutex);
 
 		switch_core_timer_next(&timer);
 	}
 
-	switch_mutex_unlock(spandsp_globals.cond_mutex);
+	switch_mutex_unlock(shard->cond_mutex);
 
  end:
 
-	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "FAX timer thread ended.\n");
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "FAX timer thread %d ended.\n", shard->id);
 
-	switch_mutex_lock(t38_state_list.mutex);
-	t38_state_list.thread_running = 0;
-	switch_mutex_unlock(t38_state_list.mutex);
+	switch_mutex_lock(shard->mutex);
+	shard->thread_running = 0;
+	switch_mutex_unlock(shard->mutex);
 
 	if (timer.timer_interface) {
 		switch_core_timer_destroy(&timer);
@@ -241,14 +343,453 @@ static void *SWITCH_THREAD_FUNC timer_thread_run(switch_thread_t *thread, void *
 	return NULL;
 }
 
-static void launch_timer_thread(void)
+static void launch_timer_thread(t38_timer_shard_t *shard)
 {
 
 	switch_threadattr_t *thd_attr = NULL;
 
 	switch_threadattr_create(&thd_attr, spandsp_globals.pool);
 	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
-	switch_thread_create(&t38_state_list.thread, thd_attr, timer_thread_run, NULL, spandsp_globals.pool);
+	switch_thread_create(&shard->thread, thd_attr, timer_thread_run, shard, spandsp_globals.pool);
+}
+
+static void timer_shard_reset_stats(t38_timer_shard_t *shard)
+{
+	shard->ticks = shard->late_ticks = 0;
+	shard->total_pass = shard->max_pass = shard->max_drift = 0;
+}
+
+void mod_spandsp_fax_timer_status(switch_stream_handle_t *stream, switch_bool_t reset)
+{
+	int i;
+
+	stream->write_function(stream, "thread,faxes,ticks,late_ticks,avg_pass_us,max_pass_us,max_drift_us\n");
+
+	for (i = 0; i < t38_timers.nshards; i++) {
+		t38_timer_shard_t *shard = &t38_timers.shards[i];
+
+		switch_mutex_lock(shard->mutex);
+		stream->write_function(stream, "%d,%u,%"SWITCH_UINT64_T_FMT",%"SWITCH_UINT64_T_FMT",%"SWITCH_TIME_T_FMT",%"SWITCH_TIME_T_FMT",%"SWITCH_TIME_T_FMT"\n",
+							   shard->id, shard->count, shard->ticks, shard->late_ticks,
+							   shard->ticks ? shard->total_pass / (switch_time_t) shard->ticks : 0, shard->max_pass, shard->max_drift);
+		if (reset) {
+			timer_shard_reset_stats(shard);
+		}
+		switch_mutex_unlock(shard->mutex);
+	}
+}
+
+
+static void *SWITCH_THREAD_FUNC tiff_writer_run(switch_thread_t *thread, void *obj)
+{
+	tiff_writer_t *writer = (tiff_writer_t *) obj;
+	tiff_writer_job_t *wjob;
+	switch_time_t start, took;
+	void *pop;
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "FAX TIFF writer thread %d started.\n", writer->id);
+
+	while (switch_queue_pop(writer->queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		wjob = (tiff_writer_job_t *) pop;
+
+		start = switch_micro_time_now();
+		t4_rx_deferred_run(wjob->job);
+		took = switch_micro_time_now() - start;
+
+		if (took > writer->max_job) {
+			writer->max_job = took;
+		}
+		switch_atomic_inc(&writer->jobs);
+
+		if (!switch_atomic_dec(&wjob->output->pending)) {
+			switch_mutex_lock(writer->drain_mutex);
+			switch_thread_cond_broadcast(writer->drain_cond);
+			switch_mutex_unlock(writer->drain_mutex);
+		}
+		free(wjob);
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "FAX TIFF writer thread %d ended.\n", writer->id);
+
+	return NULL;
+}
+
+/* Deferred handler of the T.4 receive context, runs in the media path */
+static int tiff_output_handler(void *user_data, t4_rx_deferred_t *job)
+{
+	tiff_output_t *output = (tiff_output_t *) user_data;
+	tiff_writer_job_t *wjob;
+
+	if (!output->writer) {
+		return -1;
+	}
+
+	switch_zmalloc(wjob, sizeof(*wjob));
+	wjob->output = output;
+	wjob->job = job;
+
+	switch_atomic_inc(&output->pending);
+
+	if (switch_queue_trypush(output->writer->queue, wjob) != SWITCH_STATUS_SUCCESS) {
+		/* Writing it here would put it ahead of the pages still queued, wait for room instead */
+		switch_atomic_inc(&output->writer->waits);
+		switch_queue_push(output->writer->queue, wjob);
+	}
+
+	return 0;
+}
+
+/* Have the received pages of a T.30 context written by one of the writer threads, if there are any */
+static void tiff_output_start(tiff_output_t *output, t30_state_t *t30)
+{
+	if (!tiff_writers.nwriters) {
+		return;
+	}
+
+	switch_mutex_lock(spandsp_globals.mutex);
+	output->writer = &tiff_writers.writers[tiff_writers.next++ % tiff_writers.nwriters];
+	switch_mutex_unlock(spandsp_globals.mutex);
+
+	t30_set_rx_deferred_handler(t30, tiff_output_handler, output);
+}
+
+/* Wait until everything handed over is on disk and the file is closed */
+static void tiff_output_drain(tiff_output_t *output)
+{
+	tiff_writer_t *writer = output->writer;
+
+	if (!writer) {
+		return;
+	}
+
+	switch_mutex_lock(writer->drain_mutex);
+	while (switch_atomic_read(&output->pending)) {
+		switch_thread_cond_wait(writer->drain_cond, writer->drain_mutex);
+	}
+	switch_mutex_unlock(writer->drain_mutex);
+}
+
+static void launch_tiff_writer(tiff_writer_t *writer)
+{
+	switch_threadattr_t *thd_attr = NULL;
+
+	switch_threadattr_create(&thd_attr, spandsp_globals.pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	switch_thread_create(&writer->thread, thd_attr, tiff_writer_run, writer, spandsp_globals.pool);
+}
+
+void mod_spandsp_fax_writer_status(switch_stream_handle_t *stream, switch_bool_t reset)
+{
+	int i;
+
+	stream->write_function(stream, "thread,queued,jobs,waits,max_job_us\n");
+
+	for (i = 0; i < tiff_writers.nwriters; i++) {
+		tiff_writer_t *writer = &tiff_writers.writers[i];
+
+		stream->write_function(stream, "%d,%u,%u,%u,%"SWITCH_TIME_T_FMT"\n", writer->id, switch_queue_size(writer->queue),
+							   switch_atomic_read(&writer->jobs), switch_atomic_read(&writer->waits), writer->max_job);
+		if (reset) {
+			switch_atomic_set(&writer->jobs, 0);
+			switch_atomic_set(&writer->waits, 0);
+			writer->max_job = 0;
+		}
+	}
+}
+
+/* Two faxes talking to each other through a buffer, one sending file, the other receiving it */
+typedef struct loopback_fax_s {
+	fax_state_t *tx;
+	fax_state_t *rx;
+	tiff_output_t output;
+	const char *file;
+	char rx_file[512];
+	int offload;
+	int done;
+	int result;
+	int pages;
+	switch_time_t max_step;
+	switch_thread_t *thread;
+} loopback_fax_t;
+
+static void loopback_phase_e_handler(t30_state_t *s, void *user_data, int result)
+{
+	loopback_fax_t *lb = (loopback_fax_t *) user_data;
+
+	if (result != T30_ERR_OK) {
+		lb->result = result;
+	}
+	lb->done++;
+}
+
+static void *SWITCH_THREAD_FUNC loopback_fax_run(switch_thread_t *thread, void *obj)
+{
+	loopback_fax_t *lb = (loopback_fax_t *) obj;
+	t30_state_t *t30;
+	t30_stats_t stats;
+	int16_t amp[160];
+	int len;
+	uint32_t samples = 0;
+	switch_time_t start, step;
+
+	lb->tx = fax_init(NULL, TRUE);
+	lb->rx = fax_init(NULL, FALSE);
+
+	if (!lb->tx || !lb->rx) {
+		lb->result = T30_ERR_CANNOT_TRAIN;
+		goto end;
+	}
+
+	fax_set_transmit_on_idle(lb->tx, TRUE);
+	fax_set_transmit_on_idle(lb->rx, TRUE);
+
+	t30 = fax_get_t30_state(lb->tx);
+	t30_set_tx_ident(t30, "loopback tx");
+	t30_set_ecm_capability(t30, TRUE);
+	t30_set_tx_file(t30, lb->file, -1, -1);
+	t30_set_phase_e_handler(t30, loopback_phase_e_handler, lb);
+
+	t30 = fax_get_t30_state(lb->rx);
+	t30_set_tx_ident(t30, "loopback rx");
+	t30_set_ecm_capability(t30, TRUE);
+	t30_set_rx_file(t30, lb->rx_file, -1);
+	t30_set_phase_e_handler(t30, loopback_phase_e_handler, lb);
+
+	if (lb->offload) {
+		tiff_output_start(&lb->output, t30);
+	}
+
+	/* Give up after half an hour worth of audio */
+	while (lb->done < 2 && samples < 8000 * 1800) {
+		len = fax_tx(lb->tx, amp, 160);
+
+		/* Only the receiving side writes pages, time what it costs the media path */
+		start = switch_micro_time_now();
+		fax_rx(lb->rx, amp, len);
+		step = switch_micro_time_now() - start;
+		if (step > lb->max_step) {
+			lb->max_step = step;
+		}
+
+		len = fax_tx(lb->rx, amp, 160);
+		fax_rx(lb->tx, amp, len);
+
+		samples += 160;
+	}
+
+	t30_get_transfer_statistics(t30, &stats);
+	lb->pages = stats.pages_rx;
+
+ end:
+
+	if (lb->rx) {
+		fax_free(lb->rx);
+	}
+
+	if (lb->tx) {
+		fax_free(lb->tx);
+	}
+
+	tiff_output_drain(&lb->output);
+	unlink(lb->rx_file);
+
+	return NULL;
+}
+
+/* Run faxes fax to fax loopbacks of file at once, as fast as they go, and report the pages received per second */
+void mod_spandsp_fax_loopback_test(switch_stream_handle_t *stream, int faxes, const char *file, switch_bool_t offload)
+{
+	switch_memory_pool_t *pool;
+	switch_threadattr_t *thd_attr = NULL;
+	switch_status_t tstatus;
+	loopback_fax_t *lbs;
+	switch_time_t start, elapsed, max_step = 0;
+	char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
+	int i, pages = 0, failed = 0;
+
+	if (switch_file_exists(file, NULL) != SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "-ERR Cannot find %s\n", file);
+		return;
+	}
+
+	switch_core_new_memory_pool(&pool);
+	lbs = switch_core_alloc(pool, sizeof(*lbs) * faxes);
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	start = switch_micro_time_now();
+
+	for (i = 0; i < faxes; i++) {
+		loopback_fax_t *lb = &lbs[i];
+
+		switch_uuid_str(uuid_str, sizeof(uuid_str));
+		switch_snprintf(lb->rx_file, sizeof(lb->rx_file), "%s%sloopback-%s.tif", spandsp_globals.spool, SWITCH_PATH_SEPARATOR, uuid_str);
+		lb->file = file;
+		lb->offload = offload;
+		switch_thread_create(&lb->thread, thd_attr, loopback_fax_run, lb, pool);
+	}
+
+	for (i = 0; i < faxes; i++) {
+		switch_thread_join(&tstatus, lbs[i].thread);
+	}
+
+	elapsed = switch_micro_time_now() - start;
+
+	for (i = 0; i < faxes; i++) {
+		pages += lbs[i].pages;
+		failed += lbs[i].result != T30_ERR_OK;
+		if (lbs[i].max_step > max_step) {
+			max_step = lbs[i].max_step;
+		}
+	}
+
+	stream->write_function(stream, "faxes: %d (%d failed)\n", faxes, failed);
+	stream->write_function(stream, "tiff writing: %s\n", offload && tiff_writers.nwriters ? "writer threads" : "in the media path");
+	stream->write_function(stream, "pages received: %d in %0.3fs, %0.2f pages/s\n", pages, elapsed / 1000000.0,
+						   elapsed ? pages * 1000000.0 / elapsed : 0);
+	stream->write_function(stream, "slowest 20ms of received audio: %"SWITCH_TIME_T_FMT"us\n", max_step);
+
+	switch_core_destroy_memory_pool(&pool);
+}
+
+/* Two T.38 terminals sending file to each other over the timer threads, without udptl or a session */
+typedef struct t38_loopback_s {
+	pvt_t tx;
+	pvt_t rx;
+	char rx_file[512];
+	int done;
+	int result;
+} t38_loopback_t;
+
+static int t38_loopback_tx_packet_handler(t38_core_state_t *s, void *user_data, const uint8_t *buf, int len, int count)
+{
+	pvt_t *pvt = (pvt_t *) user_data;
+
+	/* A lossless link, redundant copies would only be dropped as repeats */
+	return t38_core_rx_ifp_packet(pvt->loopback_peer->t38_core, buf, len, pvt->loopback_seq++);
+}
+
+static void t38_loopback_phase_e_handler(t30_state_t *s, void *user_data, int result)
+{
+	t38_loopback_t *lb = (t38_loopback_t *) user_data;
+
+	if (result != T30_ERR_OK) {
+		lb->result = result;
+	}
+	lb->done++;
+}
+
+static switch_bool_t t38_loopback_init(t38_loopback_t *lb, pvt_t *pvt, int caller, const char *file)
+{
+	t30_state_t *t30;
+
+	if (!(pvt->t38_state = t38_terminal_init(NULL, caller, t38_loopback_tx_packet_handler, pvt))) {
+		return SWITCH_FALSE;
+	}
+
+	pvt->t38_core = t38_terminal_get_t38_core_state(pvt->t38_state);
+	pvt->caller = caller;
+
+	t30 = t38_terminal_get_t30_state(pvt->t38_state);
+	t30_set_tx_ident(t30, caller ? "loopback tx" : "loopback rx");
+	t30_set_ecm_capability(t30, TRUE);
+	t30_set_phase_e_handler(t30, t38_loopback_phase_e_handler, lb);
+
+	if (caller) {
+		t30_set_tx_file(t30, file, -1, -1);
+	} else {
+		t30_set_rx_file(t30, lb->rx_file, -1);
+	}
+
+	return SWITCH_TRUE;
+}
+
+/* Send file over faxes T.38 loopbacks at once, in real time on the timer threads, and report how the threads kept up */
+void mod_spandsp_t38_loopback_test(switch_stream_handle_t *stream, int faxes, const char *file)
+{
+	switch_memory_pool_t *pool;
+	t38_loopback_t *lbs;
+	switch_time_t start, elapsed;
+	char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
+	int i, running, pages = 0, failed = 0;
+
+	if (switch_file_exists(file, NULL) != SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "-ERR Cannot find %s\n", file);
+		return;
+	}
+
+	switch_core_new_memory_pool(&pool);
+	lbs = switch_core_alloc(pool, sizeof(*lbs) * faxes);
+
+	for (i = 0; i < t38_timers.nshards; i++) {
+		switch_mutex_lock(t38_timers.shards[i].mutex);
+		timer_shard_reset_stats(&t38_timers.shards[i]);
+		switch_mutex_unlock(t38_timers.shards[i].mutex);
+	}
+
+	start = switch_micro_time_now();
+
+	for (i = 0; i < faxes; i++) {
+		t38_loopback_t *lb = &lbs[i];
+
+		switch_uuid_str(uuid_str, sizeof(uuid_str));
+		switch_snprintf(lb->rx_file, sizeof(lb->rx_file), "%s%st38-loopback-%s.tif", spandsp_globals.spool, SWITCH_PATH_SEPARATOR, uuid_str);
+		lb->tx.loopback_peer = &lb->rx;
+		lb->rx.loopback_peer = &lb->tx;
+
+		if (!t38_loopback_init(lb, &lb->tx, TRUE, file) || !t38_loopback_init(lb, &lb->rx, FALSE, file) || !add_pvt(&lb->tx)) {
+			lb->result = T30_ERR_CANNOT_TRAIN;
+			lb->done = 2;
+		}
+	}
+
+	/* T.38 runs in real time, give up after half an hour */
+	do {
+		switch_yield(100000);
+		running = 0;
+
+		for (i = 0; i < faxes; i++) {
+			t38_timer_shard_t *shard = lbs[i].tx.shard;
+
+			if (shard) {
+				switch_mutex_lock(shard->mutex);
+				running += lbs[i].done < 2;
+				switch_mutex_unlock(shard->mutex);
+			}
+		}
+	} while (running && switch_micro_time_now() - start < 1800 * 1000000LL);
+
+	elapsed = switch_micro_time_now() - start;
+
+	for (i = 0; i < faxes; i++) {
+		t38_loopback_t *lb = &lbs[i];
+		t30_stats_t stats;
+
+		del_pvt(&lb->tx);
+
+		if (lb->rx.t38_state) {
+			t30_get_transfer_statistics(t38_terminal_get_t30_state(lb->rx.t38_state), &stats);
+			pages += stats.pages_rx;
+		}
+
+		failed += lb->done < 2 || lb->result != T30_ERR_OK;
+
+		if (lb->tx.t38_state) {
+			t38_terminal_free(lb->tx.t38_state);
+		}
+
+		if (lb->rx.t38_state) {
+			t38_terminal_free(lb->rx.t38_state);
+		}
+
+		unlink(lb->rx_file);
+	}
+
+	stream->write_function(stream, "faxes: %d (%d failed)\n", faxes, failed);
+	stream->write_function(stream, "pages received: %d in %0.3fs\n", pages, elapsed / 1000000.0);
+	mod_spandsp_fax_timer_status(stream, SWITCH_FALSE);
+
+	switch_core_destroy_memory_pool(&pool);
 }
 
 
@@ -504,6 +1045,11 @@ static void phase_e_handler(t30_state_t *s, void *user_data, int result)
 	channel = switch_core_session_get_channel(session);
 	switch_assert(channel);
 
+	if (pvt->app_mode == FUNCTION_RX) {
+		/* Pages still queued for the writer would be missing from the file the result scripts look at */
+		tiff_output_drain(&pvt->tiff_output);
+	}
+
 	t30_get_transfer_statistics(s, &t);
 	local_ident = switch_str_nil(t30_get_tx_ident(s));
 	far_ident = switch_str_nil(t30_get_rx_ident(s));
@@ -935,6 +1481,7 @@ static switch_status_t spanfax_init(pvt_t *pvt, transport_mode_t trans_mode)
 		t30_set_tx_file(t30, pvt->filename, pvt->tx_page_start, pvt->tx_page_end);
 	} else {
 		t30_set_rx_file(t30, pvt->filename, -1);
+		tiff_output_start(&pvt->tiff_output, t30);
 	}
 	switch_channel_set_variable(channel, "fax_filename", pvt->filename);
 
@@ -990,6 +1537,10 @@ static switch_status_t spanfax_destroy(pvt_t *pvt)
 	if (pvt->udptl_state) {
 		udptl_release(pvt->udptl_state);
 	}
+
+	/* Releasing the T.30 context closed the received file, or handed that over too */
+	tiff_output_drain(&pvt->tiff_output);
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -1622,29 +2173,86 @@ void mod_spandsp_fax_process_fax(switch_core_session_t *session, const char *dat
 void mod_spandsp_fax_load(switch_memory_pool_t *pool)
 {
 	uint32_t sanity = 200;
+	int i, running;
 
-	memset(&t38_state_list, 0, sizeof(t38_state_list));
+	memset(&t38_timers, 0, sizeof(t38_timers));
 
 	switch_mutex_init(&spandsp_globals.mutex, SWITCH_MUTEX_NESTED, spandsp_globals.pool);
-	switch_mutex_init(&t38_state_list.mutex, SWITCH_MUTEX_NESTED, spandsp_globals.pool);
 
-	switch_mutex_init(&spandsp_globals.cond_mutex, SWITCH_MUTEX_NESTED, spandsp_globals.pool);
-	switch_thread_cond_create(&spandsp_globals.cond, spandsp_globals.pool);
+	t38_timers.nshards = spandsp_globals.t38_timer_threads;
+	if (t38_timers.nshards < 1) {
+		t38_timers.nshards = 1;
+	} else if (t38_timers.nshards > T38_TIMER_MAX_THREADS) {
+		t38_timers.nshards = T38_TIMER_MAX_THREADS;
+	}
+	t38_timers.shards = switch_core_alloc(spandsp_globals.pool, sizeof(t38_timer_shard_t) * t38_timers.nshards);
 
-	launch_timer_thread();
+	for (i = 0; i < t38_timers.nshards; i++) {
+		t38_timer_shard_t *shard = &t38_timers.shards[i];
 
-	while(--sanity && !t38_state_list.thread_running) {
-		switch_yield(20000);
+		shard->id = i;
+		switch_mutex_init(&shard->mutex, SWITCH_MUTEX_NESTED, spandsp_globals.pool);
+		switch_mutex_init(&shard->cond_mutex, SWITCH_MUTEX_NESTED, spandsp_globals.pool);
+		switch_thread_cond_create(&shard->cond, spandsp_globals.pool);
+
+		launch_timer_thread(shard);
+	}
+
+	memset(&tiff_writers, 0, sizeof(tiff_writers));
+
+	tiff_writers.nwriters = spandsp_globals.tiff_writer_threads;
+	if (tiff_writers.nwriters > TIFF_WRITER_MAX_THREADS) {
+		tiff_writers.nwriters = TIFF_WRITER_MAX_THREADS;
+	}
+
+	if (tiff_writers.nwriters > 0) {
+		tiff_writers.writers = switch_core_alloc(spandsp_globals.pool, sizeof(tiff_writer_t) * tiff_writers.nwriters);
+	}
+
+	for (i = 0; i < tiff_writers.nwriters; i++) {
+		tiff_writer_t *writer = &tiff_writers.writers[i];
+
+		writer->id = i;
+		switch_queue_create(&writer->queue, spandsp_globals.tiff_writer_queue_len, spandsp_globals.pool);
+		switch_mutex_init(&writer->drain_mutex, SWITCH_MUTEX_NESTED, spandsp_globals.pool);
+		switch_thread_cond_create(&writer->drain_cond, spandsp_globals.pool);
+		launch_tiff_writer(writer);
 	}
+
+	do {
+		switch_yield(20000);
+
+		for (running = i = 0; i < t38_timers.nshards; i++) {
+			running += !!t38_timers.shards[i].thread_running;
+		}
+	} while(--sanity && running < t38_timers.nshards);
 }
 
 void mod_spandsp_fax_shutdown(void)
 {
 	switch_status_t tstatus = SWITCH_STATUS_SUCCESS;
+	int i;
+
+	for (i = 0; i < t38_timers.nshards; i++) {
+		t38_timers.shards[i].thread_running = 0;
+		wake_thread(&t38_timers.shards[i], 1);
+	}
+
+	for (i = 0; i < t38_timers.nshards; i++) {
+		switch_thread_join(&tstatus, t38_timers.shards[i].thread);
+	}
+
+	/* Writers finish what is queued before they see the end marker */
+	for (i = 0; i < tiff_writers.nwriters; i++) {
+		switch_queue_push(tiff_writers.writers[i].queue, NULL);
+	}
+
+	for (i = 0; i < tiff_writers.nwriters; i++) {
+		switch_thread_join(&tstatus, tiff_writers.writers[i].thread);
+	}
+
+	memset(&tiff_writers, 0, sizeof(tiff_writers));
 
-	t38_state_list.thread_running = 0;
-	wake_thread(1);
-	switch_thread_join(&tstatus, t38_state_list.thread);
 	memset(&spandsp_globals, 0, sizeof(spandsp_globals));
 }
 
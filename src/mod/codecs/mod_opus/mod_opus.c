@@ -32,10 +32,12 @@
 
 #include "switch.h"
 #include "opus.h"
+#include <math.h>
 
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_opus_load);
-SWITCH_MODULE_DEFINITION(mod_opus, mod_opus_load, NULL, NULL);
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_opus_shutdown);
+SWITCH_MODULE_DEFINITION(mod_opus, mod_opus_load, mod_opus_shutdown, NULL);
 
 /*! \brief Various codec settings */
 struct opus_codec_settings {
@@ -71,12 +73,39 @@ struct opus_context {
 	OpusEncoder *encoder_object;
 	OpusDecoder *decoder_object;
 	int frame_size;
+	int useinbandfec;
+	int usedtx;
+	uint32_t adapt_generation;
+	switch_time_t last_encode;
 };
 
 struct {
     int use_vbr;
     int complexity;
     switch_mutex_t *mutex;
+
+	/* load adaptive complexity, see opus_adapt_run() */
+	int adaptive;
+	int adapt_min_complexity;
+	int adapt_max_complexity;
+	int adapt_min_idle_cpu;
+	int adapt_restore_idle_cpu;
+	int adapt_max_late_pct;
+	int adapt_shed_fec_dtx;
+	int adapt_interval;
+
+	/* moved by the controller under mutex, encoders pick them up on their next frame once adapt_generation changes */
+	int adapt_complexity;
+	int adapt_shed;
+	volatile uint32_t adapt_generation;
+
+	switch_atomic_t frames;
+	switch_atomic_t late_frames;
+	double last_idle_cpu;
+	double last_late_pct;
+
+	int running;
+	switch_thread_t *adapt_thread;
 } opus_prefs;
 
 
@@ -264,6 +293,7 @@ static switch_status_t switch_opus_init(switch_codec_t *codec, switch_codec_flag
 		int use_vbr = opus_prefs.use_vbr;
 		int complexity = opus_prefs.complexity;
 		int err;
+		uint32_t generation;
 		int samplerate = opus_codec_settings.samplerate ? opus_codec_settings.samplerate : codec->implementation->actual_samples_per_second;
         
 		context->encoder_object = opus_encoder_create(samplerate,
@@ -287,6 +317,17 @@ static switch_status_t switch_opus_init(switch_codec_t *codec, switch_codec_flag
 		if (use_vbr) {
 			opus_encoder_ctl(context->encoder_object, OPUS_SET_VBR(use_vbr));
 		}
+
+		context->useinbandfec = opus_codec_settings.useinbandfec;
+		context->usedtx = opus_codec_settings.usedtx;
+
+		switch_mutex_lock(opus_prefs.mutex);
+		generation = opus_prefs.adapt_generation;
+		if (opus_prefs.adaptive) {
+			complexity = opus_prefs.adapt_complexity;
+		}
+		switch_mutex_unlock(opus_prefs.mutex);
+
 		if (complexity) {
 			opus_encoder_ctl(context->encoder_object, OPUS_SET_COMPLEXITY(complexity));
         }
@@ -298,6 +339,9 @@ static switch_status_t switch_opus_init(switch_codec_t *codec, switch_codec_flag
 		if (opus_codec_settings.usedtx) {
 			opus_encoder_ctl(context->encoder_object, OPUS_SET_DTX(opus_codec_settings.usedtx));
 		}
+
+		/* have the first frame apply a shed FEC/DTX state */
+		context->adapt_generation = generation - 1;
 	}
 	
 	if (decoding) {
@@ -344,6 +388,51 @@ static switch_status_t switch_opus_destroy(switch_codec_t *codec)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* Runs in the thread of the encoder, the encoder object itself is never touched from elsewhere */
+static void opus_adapt_encoder(struct opus_context *context)
+{
+	int complexity, shed;
+
+	switch_mutex_lock(opus_prefs.mutex);
+	context->adapt_generation = opus_prefs.adapt_generation;
+	complexity = opus_prefs.adaptive ? opus_prefs.adapt_complexity : opus_prefs.complexity;
+	shed = opus_prefs.adaptive && opus_prefs.adapt_shed;
+	switch_mutex_unlock(opus_prefs.mutex);
+
+	if (complexity) {
+		opus_encoder_ctl(context->encoder_object, OPUS_SET_COMPLEXITY(complexity));
+	}
+
+	if (context->useinbandfec) {
+		opus_encoder_ctl(context->encoder_object, OPUS_SET_INBAND_FEC(shed ? 0 : 1));
+	}
+
+	if (!context->usedtx) {
+		opus_encoder_ctl(context->encoder_object, OPUS_SET_DTX(shed));
+	}
+}
+
+/* A frame is late when it follows the previous one by more than its ptime plus half a frame (10ms at least).
+   Gaps of ten frames or more are a pause in the media (hold, a muted source), not load. */
+static void opus_adapt_track(switch_codec_t *codec, struct opus_context *context)
+{
+	switch_time_t now = switch_micro_time_now();
+	switch_time_t ptime = codec->implementation->microseconds_per_packet;
+
+	if (context->last_encode) {
+		switch_time_t gap = now - context->last_encode;
+		switch_time_t slack = ptime / 2 > 10000 ? ptime / 2 : 10000;
+
+		switch_atomic_inc(&opus_prefs.frames);
+
+		if (gap > ptime + slack && gap < ptime * 10) {
+			switch_atomic_inc(&opus_prefs.late_frames);
+		}
+	}
+
+	context->last_encode = now;
+}
+
 static switch_status_t switch_opus_encode(switch_codec_t *codec,
 										  switch_codec_t *other_codec,
 										  void *decoded_data,
@@ -360,7 +449,15 @@ static switch_status_t switch_opus_encode(switch_codec_t *codec,
 	}
     
 	if (len > 1275) len = 1275;
-    
+
+	if (opus_prefs.adaptive) {
+		opus_adapt_track(codec, context);
+	}
+
+	if (context->adapt_generation != opus_prefs.adapt_generation) {
+		opus_adapt_encoder(context);
+	}
+
 	bytes = opus_encode(context->encoder_object, (void *) decoded_data, decoded_data_len / 2, (unsigned char *) encoded_data, len);
     
 	if (bytes > 0) {
@@ -408,19 +505,77 @@ static switch_status_t opus_load_config(switch_bool_t reload)
 		return status;
 	}
     
+	switch_mutex_lock(opus_prefs.mutex);
+
+	opus_prefs.adaptive = 0;
+	opus_prefs.adapt_min_complexity = 3;
+	opus_prefs.adapt_max_complexity = 0;
+	opus_prefs.adapt_min_idle_cpu = 25;
+	opus_prefs.adapt_restore_idle_cpu = 50;
+	opus_prefs.adapt_max_late_pct = 2;
+	opus_prefs.adapt_shed_fec_dtx = 0;
+	opus_prefs.adapt_interval = 2000;
+
 	if ((settings = switch_xml_child(cfg, "settings"))) {
 		for (param = switch_xml_child(settings, "param"); param; param = param->next) {
 			char *key = (char *) switch_xml_attr_soft(param, "name");
 			char *val = (char *) switch_xml_attr_soft(param, "value");
-			
+
 			if (!strcasecmp(key, "use-vbr") && !zstr(val)) {
 				opus_prefs.use_vbr = atoi(val);
 			} else if (!strcasecmp(key, "complexity")) {
 				opus_prefs.complexity = atoi(val);
+			} else if (!strcasecmp(key, "adaptive-complexity")) {
+				opus_prefs.adaptive = switch_true(val);
+			} else if (!strcasecmp(key, "adaptive-min-complexity") && !zstr(val)) {
+				opus_prefs.adapt_min_complexity = atoi(val);
+			} else if (!strcasecmp(key, "adaptive-max-complexity") && !zstr(val)) {
+				opus_prefs.adapt_max_complexity = atoi(val);
+			} else if (!strcasecmp(key, "adaptive-min-idle-cpu") && !zstr(val)) {
+				opus_prefs.adapt_min_idle_cpu = atoi(val);
+			} else if (!strcasecmp(key, "adaptive-restore-idle-cpu") && !zstr(val)) {
+				opus_prefs.adapt_restore_idle_cpu = atoi(val);
+			} else if (!strcasecmp(key, "adaptive-max-late-pct") && !zstr(val)) {
+				opus_prefs.adapt_max_late_pct = atoi(val);
+			} else if (!strcasecmp(key, "adaptive-shed-fec-dtx")) {
+				opus_prefs.adapt_shed_fec_dtx = switch_true(val);
+			} else if (!strcasecmp(key, "adaptive-interval") && !zstr(val)) {
+				opus_prefs.adapt_interval = atoi(val);
 			}
 		}
 	}
-    
+
+	if (!opus_prefs.adapt_max_complexity) {
+		opus_prefs.adapt_max_complexity = opus_prefs.complexity ? opus_prefs.complexity : 10;
+	}
+
+	if (opus_prefs.adapt_max_complexity > 10) {
+		opus_prefs.adapt_max_complexity = 10;
+	}
+
+	if (opus_prefs.adapt_min_complexity < 0) {
+		opus_prefs.adapt_min_complexity = 0;
+	}
+
+	if (opus_prefs.adapt_min_complexity > opus_prefs.adapt_max_complexity) {
+		opus_prefs.adapt_min_complexity = opus_prefs.adapt_max_complexity;
+	}
+
+	if (opus_prefs.adapt_restore_idle_cpu < opus_prefs.adapt_min_idle_cpu) {
+		opus_prefs.adapt_restore_idle_cpu = opus_prefs.adapt_min_idle_cpu;
+	}
+
+	if (opus_prefs.adapt_interval < 100) {
+		opus_prefs.adapt_interval = 100;
+	}
+
+	/* start over at full complexity, live encoders follow on their next frame */
+	opus_prefs.adapt_complexity = opus_prefs.adapt_max_complexity;
+	opus_prefs.adapt_shed = 0;
+	opus_prefs.adapt_generation++;
+
+	switch_mutex_unlock(opus_prefs.mutex);
+
     if (xml) {
         switch_xml_free(xml);
     }
@@ -428,9 +583,190 @@ static switch_status_t opus_load_config(switch_bool_t reload)
     return status;
 }
 
+/* One controller step: under pressure (idle cpu below adaptive-min-idle-cpu or too many late frames) drop the
+   complexity, by half the way to the floor when far below, one step otherwise; at the floor optionally shed FEC
+   and turn on DTX. With room to spare (idle cpu above adaptive-restore-idle-cpu) undo one step at a time. */
+static void opus_adapt_step(void)
+{
+	uint32_t frames = switch_atomic_read(&opus_prefs.frames);
+	uint32_t late = switch_atomic_read(&opus_prefs.late_frames);
+	double idle = switch_core_idle_cpu();
+	double late_pct;
+	int complexity, shed;
+
+	/* a few frames counted in between get lost, it's a ratio */
+	switch_atomic_set(&opus_prefs.frames, 0);
+	switch_atomic_set(&opus_prefs.late_frames, 0);
+
+	late_pct = frames ? (late * 100.0) / frames : 0;
+
+	switch_mutex_lock(opus_prefs.mutex);
+
+	complexity = opus_prefs.adapt_complexity;
+	shed = opus_prefs.adapt_shed;
+	opus_prefs.last_idle_cpu = idle;
+	opus_prefs.last_late_pct = late_pct;
+
+	if (idle < opus_prefs.adapt_min_idle_cpu || late_pct > opus_prefs.adapt_max_late_pct) {
+		if (complexity > opus_prefs.adapt_min_complexity) {
+			complexity -= idle < opus_prefs.adapt_min_idle_cpu / 2 ? (complexity - opus_prefs.adapt_min_complexity + 1) / 2 : 1;
+		} else if (opus_prefs.adapt_shed_fec_dtx) {
+			shed = 1;
+		}
+	} else if (idle > opus_prefs.adapt_restore_idle_cpu && late_pct <= opus_prefs.adapt_max_late_pct / 2.0) {
+		if (shed) {
+			shed = 0;
+		} else if (complexity < opus_prefs.adapt_max_complexity) {
+			complexity++;
+		}
+	}
+
+	if (complexity != opus_prefs.adapt_complexity || shed != opus_prefs.adapt_shed) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, complexity < opus_prefs.adapt_complexity || shed ? SWITCH_LOG_NOTICE : SWITCH_LOG_INFO,
+						  "Encoder complexity %d -> %d%s (idle cpu %0.2f%%, late frames %0.2f%%)\n",
+						  opus_prefs.adapt_complexity, complexity, shed ? ", FEC off DTX on" : "", idle, late_pct);
+		opus_prefs.adapt_complexity = complexity;
+		opus_prefs.adapt_shed = shed;
+		opus_prefs.adapt_generation++;
+	}
+
+	switch_mutex_unlock(opus_prefs.mutex);
+}
+
+static void *SWITCH_THREAD_FUNC opus_adapt_run(switch_thread_t *thread, void *obj)
+{
+	int elapsed = 0;
+
+	while (opus_prefs.running) {
+		switch_yield(100000);
+
+		if ((elapsed += 100) < opus_prefs.adapt_interval) {
+			continue;
+		}
+
+		elapsed = 0;
+
+		if (opus_prefs.adaptive) {
+			opus_adapt_step();
+		}
+	}
+
+	return NULL;
+}
+
+SWITCH_STANDARD_API(opus_status_function)
+{
+	switch_mutex_lock(opus_prefs.mutex);
+
+	if (!opus_prefs.adaptive) {
+		stream->write_function(stream, "adaptive complexity: off\ncomplexity: %d\n", opus_prefs.complexity);
+	} else {
+		stream->write_function(stream, "adaptive complexity: on\n");
+		stream->write_function(stream, "complexity: %d (%d-%d)\n",
+							   opus_prefs.adapt_complexity, opus_prefs.adapt_min_complexity, opus_prefs.adapt_max_complexity);
+		stream->write_function(stream, "fec/dtx shed: %s\n", opus_prefs.adapt_shed ? "yes" : "no");
+		stream->write_function(stream, "idle cpu: %0.2f%% (lower under %d%%, raise over %d%%)\n",
+							   opus_prefs.last_idle_cpu, opus_prefs.adapt_min_idle_cpu, opus_prefs.adapt_restore_idle_cpu);
+		stream->write_function(stream, "late frames: %0.2f%% (max %d%%)\n", opus_prefs.last_late_pct, opus_prefs.adapt_max_late_pct);
+	}
+
+	switch_mutex_unlock(opus_prefs.mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define OPUS_BENCH_SYNTAX "[<frames>] [8000|48000]"
+/* Encode the same synthetic voice-like second of audio at every complexity and report what a 20ms channel costs.
+   Runs on the calling thread, so the channels per core figure is wall clock based and wants an idle box. */
+SWITCH_STANDARD_API(opus_bench_function)
+{
+	char *mydata = NULL, *argv[2] = { 0 };
+	int frames = 2500, rate = 48000, samples, complexity, i, err;
+	int16_t *pcm = NULL;
+	unsigned char out[1275];
+	double phase = 0, usec, top = 0;
+	uint32_t seed = 1;
+
+	if (!zstr(cmd) && (mydata = strdup(cmd))) {
+		switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+
+		if (argv[0] && atoi(argv[0]) > 0) {
+			frames = atoi(argv[0]);
+		}
+
+		if (argv[1]) {
+			rate = atoi(argv[1]);
+		}
+	}
+
+	if (rate != 8000 && rate != 48000) {
+		stream->write_function(stream, "-USAGE: %s\n", OPUS_BENCH_SYNTAX);
+		goto end;
+	}
+
+	/* one second of a gliding tone with a harmonic and some noise, played in a loop */
+	samples = rate / 50;
+	switch_zmalloc(pcm, samples * 50 * sizeof(*pcm));
+
+	for (i = 0; i < samples * 50; i++) {
+		double freq = 220 + 180 * sin(2 * M_PI * 3 * i / rate);
+
+		phase += 2 * M_PI * freq / rate;
+		seed = seed * 1103515245 + 12345;
+		pcm[i] = (int16_t) (6000 * sin(phase) + 2500 * sin(2.5 * phase) + (int) ((seed >> 16) % 1000) - 500);
+	}
+
+	stream->write_function(stream, "%d frames of 20ms at %dhz\n", frames, rate);
+	stream->write_function(stream, "complexity  usec/frame  channels/core  vs complexity 10\n");
+
+	for (complexity = 10; complexity >= 0; complexity--) {
+		OpusEncoder *encoder = opus_encoder_create(rate, 1, OPUS_APPLICATION_VOIP, &err);
+		switch_time_t start;
+
+		if (err != OPUS_OK) {
+			stream->write_function(stream, "-ERR Cannot create encoder: %s\n", opus_strerror(err));
+			goto end;
+		}
+
+		opus_encoder_ctl(encoder, OPUS_SET_BITRATE(OPUS_AUTO));
+		opus_encoder_ctl(encoder, OPUS_SET_BANDWIDTH(rate == 8000 ? OPUS_BANDWIDTH_NARROWBAND : OPUS_BANDWIDTH_FULLBAND));
+		if (opus_prefs.use_vbr) {
+			opus_encoder_ctl(encoder, OPUS_SET_VBR(opus_prefs.use_vbr));
+		}
+		opus_encoder_ctl(encoder, OPUS_SET_COMPLEXITY(complexity));
+		opus_encoder_ctl(encoder, OPUS_SET_INBAND_FEC(1));
+
+		start = switch_time_ref();
+		for (i = 0; i < frames; i++) {
+			opus_encode(encoder, pcm + (i % 50) * samples, samples, out, sizeof(out));
+		}
+		usec = (double) (switch_time_ref() - start) / frames;
+
+		opus_encoder_destroy(encoder);
+
+		if (usec <= 0) {
+			usec = 0.001;
+		}
+
+		if (complexity == 10) {
+			top = usec;
+		}
+
+		stream->write_function(stream, "%10d  %10.1f  %13.0f  %15.2fx\n", complexity, usec, 20000 / usec, top / usec);
+	}
+
+  end:
+
+	switch_safe_free(pcm);
+	switch_safe_free(mydata);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_MODULE_LOAD_FUNCTION(mod_opus_load)
 {
 	switch_codec_interface_t *codec_interface;
+	switch_api_interface_t *api_interface;
 	int samples = 480;
 	int bytes = 960;
 	int mss = 10000;
@@ -440,7 +776,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_opus_load)
 	char *dft_fmtp = NULL;
 	opus_codec_settings_t settings = { 0 };
     switch_status_t status = SWITCH_FALSE;
-    
+
+	switch_mutex_init(&opus_prefs.mutex, SWITCH_MUTEX_NESTED, pool);
+
 	if ((status = opus_load_config(SWITCH_FALSE)) != SWITCH_STATUS_SUCCESS) {
 		return status;
 	}
@@ -522,13 +860,38 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_opus_load)
 		bytes += 160;
 		samples += 80;
 		mss += 10000;
-		
+
 	}
-    
+
+	SWITCH_ADD_API(api_interface, "opus_status", "Opus encoder adaptation status", opus_status_function, "");
+	SWITCH_ADD_API(api_interface, "opus_bench", "Opus encode cost per complexity", opus_bench_function, OPUS_BENCH_SYNTAX);
+
+	if (opus_prefs.adaptive) {
+		switch_threadattr_t *thd_attr = NULL;
+
+		opus_prefs.running = 1;
+		switch_threadattr_create(&thd_attr, pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&opus_prefs.adapt_thread, thd_attr, opus_adapt_run, NULL, pool);
+	}
+
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;
 }
 
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_opus_shutdown)
+{
+	switch_status_t st;
+
+	if (opus_prefs.adapt_thread) {
+		opus_prefs.running = 0;
+		switch_thread_join(&st, opus_prefs.adapt_thread);
+		opus_prefs.adapt_thread = NULL;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 /* For Emacs:
  * Local Variables:
  * mode:c
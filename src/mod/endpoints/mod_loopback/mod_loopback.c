@@ -38,6 +38,8 @@
 #include <string.h>
 
 #define FRAME_QUEUE_LEN 3
+/* One more slot than the queue holds, the reader keeps the frame it last returned */
+#define FRAME_RING_LEN (FRAME_QUEUE_LEN + 1)
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_loopback_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_loopback_shutdown);
@@ -61,6 +63,22 @@ typedef enum {
 	TFLAG_CLEAR = (1 << 10)
 } TFLAGS;
 
+/* Frames written by the partner leg wait here for our read thread. The partner's write
+   thread is the only producer and advances head, our read thread is the only consumer and
+   advances tail, so neither side needs the other's mutex or any allocation per frame. */
+typedef struct {
+	switch_frame_t frame;
+	unsigned char databuf[SWITCH_RECOMMENDED_BUFFER_SIZE];
+} loopback_slot_t;
+
+typedef struct {
+	loopback_slot_t slots[FRAME_RING_LEN];
+	switch_atomic_t head;
+	switch_atomic_t tail;
+	/* the reader still holds the slot at tail */
+	int held;
+} loopback_ring_t;
+
 struct loopback_private_object {
 	unsigned int flags;
 	switch_mutex_t *flag_mutex;
@@ -75,17 +93,13 @@ struct loopback_private_object {
 	switch_frame_t read_frame;
 	unsigned char databuf[SWITCH_RECOMMENDED_BUFFER_SIZE];
 
-	switch_frame_t *x_write_frame;
-	switch_frame_t *write_frame;
-	unsigned char write_databuf[SWITCH_RECOMMENDED_BUFFER_SIZE];
-
 	switch_frame_t cng_frame;
 	unsigned char cng_databuf[SWITCH_RECOMMENDED_BUFFER_SIZE];
 	switch_timer_t timer;
 	switch_caller_profile_t *caller_profile;
 	int32_t bowout_frame_count;
 	char *other_uuid;
-	switch_queue_t *frame_queue;
+	loopback_ring_t *frame_ring;
 	int64_t packet_count;
 	int first_cng;
 };
@@ -111,15 +125,74 @@ static switch_status_t channel_write_frame(switch_core_session_t *session, switc
 static switch_status_t channel_kill_channel(switch_core_session_t *session, int sig);
 
 
-static void clear_queue(loopback_private_t *tech_pvt)
+static void ring_create(loopback_private_t *tech_pvt, switch_memory_pool_t *pool)
+{
+	loopback_ring_t *ring;
+	int i;
+
+	ring = switch_core_alloc(pool, sizeof(*ring));
+
+	for (i = 0; i < FRAME_RING_LEN; i++) {
+		ring->slots[i].frame.data = ring->slots[i].databuf;
+		ring->slots[i].frame.buflen = sizeof(ring->slots[i].databuf);
+	}
+
+	tech_pvt->frame_ring = ring;
+}
+
+/* Producer side, called from the partner's write thread */
+static switch_status_t ring_push(loopback_ring_t *ring, switch_frame_t *frame)
 {
-	void *pop;
+	uint32_t head = switch_atomic_read(&ring->head);
+	switch_frame_t *slot;
 
-	while (switch_queue_trypop(tech_pvt->frame_queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
-		switch_frame_t *frame = (switch_frame_t *) pop;
-		switch_frame_free(&frame);
+	if (head - switch_atomic_read(&ring->tail) >= FRAME_RING_LEN || frame->datalen > SWITCH_RECOMMENDED_BUFFER_SIZE) {
+		return SWITCH_STATUS_FALSE;
 	}
 
+	slot = &ring->slots[head % FRAME_RING_LEN].frame;
+
+	memcpy(slot->data, frame->data, frame->datalen);
+	slot->datalen = frame->datalen;
+	slot->samples = frame->samples;
+	slot->rate = frame->rate;
+	slot->payload = frame->payload;
+	slot->seq = frame->seq;
+	slot->ssrc = frame->ssrc;
+	slot->m = frame->m;
+	slot->flags = frame->flags;
+
+	/* publishes the slot to the reader */
+	switch_atomic_inc(&ring->head);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* Consumer side, the returned frame stays valid until the next ring_pop or ring_clear */
+static switch_frame_t *ring_pop(loopback_ring_t *ring)
+{
+	uint32_t tail;
+
+	if (ring->held) {
+		switch_atomic_inc(&ring->tail);
+		ring->held = 0;
+	}
+
+	tail = switch_atomic_read(&ring->tail);
+
+	if (tail == switch_atomic_read(&ring->head)) {
+		return NULL;
+	}
+
+	ring->held = 1;
+
+	return &ring->slots[tail % FRAME_RING_LEN].frame;
+}
+
+static void ring_clear(loopback_ring_t *ring)
+{
+	ring->held = 0;
+	switch_atomic_set(&ring->tail, switch_atomic_read(&ring->head));
 }
 
 static switch_status_t tech_init(loopback_private_t *tech_pvt, switch_core_session_t *session, switch_codec_t *codec)
@@ -207,7 +280,7 @@ static switch_status_t tech_init(loopback_private_t *tech_pvt, switch_core_sessi
 		switch_mutex_init(&tech_pvt->flag_mutex, SWITCH_MUTEX_NESTED, switch_core_session_get_pool(session));
 		switch_mutex_init(&tech_pvt->mutex, SWITCH_MUTEX_NESTED, switch_core_session_get_pool(session));
 		switch_core_session_set_private(session, tech_pvt);
-		switch_queue_create(&tech_pvt->frame_queue, FRAME_QUEUE_LEN, switch_core_session_get_pool(session));
+		ring_create(tech_pvt, switch_core_session_get_pool(session));
 		tech_pvt->session = session;
 		tech_pvt->channel = switch_core_session_get_channel(session);
 	}
@@ -511,11 +584,7 @@ static switch_status_t channel_on_destroy(switch_core_session_t *session)
 			switch_core_codec_destroy(&tech_pvt->write_codec);
 		}
 
-		if (tech_pvt->write_frame) {
-			switch_frame_free(&tech_pvt->write_frame);
-		}
-
-		clear_queue(tech_pvt);
+		ring_clear(tech_pvt->frame_ring);
 	}
 
 
@@ -672,7 +741,7 @@ static switch_status_t channel_read_frame(switch_core_session_t *session, switch
 	loopback_private_t *tech_pvt = NULL;
 	switch_status_t status = SWITCH_STATUS_FALSE;
 	switch_mutex_t *mutex = NULL;
-	void *pop = NULL;
+	switch_frame_t *pop;
 
 	channel = switch_core_session_get_channel(session);
 	switch_assert(channel != NULL);
@@ -697,24 +766,18 @@ static switch_status_t channel_read_frame(switch_core_session_t *session, switch
 
 
 	if (switch_test_flag(tech_pvt, TFLAG_CLEAR)) {
-		clear_queue(tech_pvt);
+		ring_clear(tech_pvt->frame_ring);
 		switch_clear_flag(tech_pvt, TFLAG_CLEAR);
 	}
 
-	if (switch_queue_trypop(tech_pvt->frame_queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
-		if (tech_pvt->write_frame) {
-			switch_frame_free(&tech_pvt->write_frame);
-		}
-		
-		tech_pvt->write_frame = (switch_frame_t *) pop;
+	if ((pop = ring_pop(tech_pvt->frame_ring))) {
+		switch_clear_flag(pop, SFF_RAW_RTP);
+		pop->timestamp = 0;
 
-        switch_clear_flag(tech_pvt->write_frame, SFF_RAW_RTP);
-		tech_pvt->write_frame->timestamp = 0;                    
-
-		tech_pvt->write_frame->codec = &tech_pvt->read_codec;
-		*frame = tech_pvt->write_frame;
+		pop->codec = &tech_pvt->read_codec;
+		*frame = pop;
 		tech_pvt->packet_count++;
-		switch_clear_flag(tech_pvt->write_frame, SFF_CNG);
+		switch_clear_flag(pop, SFF_CNG);
 		tech_pvt->first_cng = 0;
 	} else {
 		*frame = &tech_pvt->cng_frame;
@@ -891,8 +954,6 @@ static switch_status_t channel_write_frame(switch_core_session_t *session, switc
 	}
 
 	if (switch_test_flag(tech_pvt, TFLAG_LINKED) && tech_pvt->other_tech_pvt) {
-		switch_frame_t *clone;
-		
 		if (frame->codec->implementation != tech_pvt->write_codec.implementation) {
 			/* change codecs to match */
 			tech_init(tech_pvt, session, frame->codec);
@@ -900,19 +961,11 @@ static switch_status_t channel_write_frame(switch_core_session_t *session, switc
 		}
 
 
-		if (switch_frame_dup(frame, &clone) != SWITCH_STATUS_SUCCESS) {
-			abort();
-		}
-		
-		if ((status = switch_queue_trypush(tech_pvt->other_tech_pvt->frame_queue, clone)) != SWITCH_STATUS_SUCCESS) { 
-			clear_queue(tech_pvt->other_tech_pvt);
-			status = switch_queue_trypush(tech_pvt->other_tech_pvt->frame_queue, clone);
-		}
-
-		if (status == SWITCH_STATUS_SUCCESS) {
+		if (ring_push(tech_pvt->other_tech_pvt->frame_ring, frame) == SWITCH_STATUS_SUCCESS) {
 			switch_set_flag_locked(tech_pvt->other_tech_pvt, TFLAG_WRITE);
 		} else {
-			switch_frame_free(&clone);
+			/* The reader fell behind, have it drop what is queued so it catches up with us */
+			switch_set_flag_locked(tech_pvt->other_tech_pvt, TFLAG_CLEAR);
 		}
 
 		status = SWITCH_STATUS_SUCCESS;
@@ -1387,6 +1387,18 @@ static switch_xml_config_item_t *get_instructions(rtmp_profile_t *profile) {
 		SWITCH_TRUE,
 		INT32_MAX
 	};
+	static switch_xml_config_int_options_t opt_iothreads = {
+		SWITCH_TRUE,
+		1,
+		SWITCH_TRUE,
+		64
+	};
+	static switch_xml_config_int_options_t opt_maxsessions = {
+		SWITCH_TRUE,
+		1,
+		SWITCH_FALSE,
+		0
+	};
 	switch_xml_config_item_t instructions[] = {
 		/* parameter name        type                 reloadable   pointer                         default value     options structure */
 		SWITCH_CONFIG_ITEM("context", SWITCH_CONFIG_STRING, CONFIG_RELOADABLE, &profile->context, "public", &switch_config_string_strdup,
@@ -1400,6 +1412,8 @@ static switch_xml_config_item_t *get_instructions(rtmp_profile_t *profile) {
 		SWITCH_CONFIG_ITEM("auth-calls", SWITCH_CONFIG_BOOL, CONFIG_RELOADABLE, &profile->auth_calls, SWITCH_FALSE, NULL, "true|false", "Set to true in order to reject unauthenticated calls"),
 		SWITCH_CONFIG_ITEM("chunksize", SWITCH_CONFIG_INT, CONFIG_RELOADABLE, &profile->chunksize, 128, &opt_chunksize, "", "RTMP Sending chunksize"),
 		SWITCH_CONFIG_ITEM("buffer-len", SWITCH_CONFIG_INT, CONFIG_RELOADABLE, &profile->buffer_len, 500, &opt_bufferlen, "", "Length of the receiving buffer to be used by the flash clients, in miliseconds"),
+		SWITCH_CONFIG_ITEM("io-threads", SWITCH_CONFIG_INT, 0, &profile->io_threads, 1, &opt_iothreads, "", "Number of I/O threads the client connections are spread across"),
+		SWITCH_CONFIG_ITEM("max-sessions", SWITCH_CONFIG_INT, 0, &profile->max_sessions, 1000, &opt_maxsessions, "", "Maximum number of connected clients"),
 		SWITCH_CONFIG_ITEM_END()
 	};
 	
@@ -1626,6 +1640,10 @@ SWITCH_STANDARD_API(rtmp_function)
 				stream->write_function(stream, "I/O Backend: %s\n", profile->io->name);
 				stream->write_function(stream, "Bind address: %s\n", profile->io->address);
 				stream->write_function(stream, "Active calls: %d\n", profile->calls);
+
+				if (profile->io->status) {
+					profile->io->status(profile->io, stream);
+				}
 				
 				if (!zstr(argv[3]) && !strcmp(argv[3], "sessions"))
 				{
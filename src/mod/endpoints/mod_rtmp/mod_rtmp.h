@@ -299,6 +299,7 @@ struct rtmp_io {
 	switch_status_t  (*read)(rtmp_session_t *rsession, unsigned char *buf, switch_size_t *len);
 	switch_status_t (*write)(rtmp_session_t *rsession, const unsigned char *buf, switch_size_t *len);
 	switch_status_t (*close)(rtmp_session_t *rsession);
+	void (*status)(struct rtmp_io *io, switch_stream_handle_t *stream);	/* < Optional, reports I/O statistics */
 	rtmp_profile_t *profile;
 	switch_memory_pool_t *pool;
 	int running;
@@ -358,6 +359,8 @@ struct rtmp_profile {
 	const char *io_name;		/* < Name of I/O module (from config) */
 	int chunksize;				/* < Override default chunksize (from config) */
 	int buffer_len;				/* < Receive buffer length the flash clients should use */ 
+	int io_threads;				/* < Number of I/O threads sessions are spread across (from config) */
+	int max_sessions;			/* < Maximum number of connected clients (from config) */
 	
 	switch_hash_t *reg_hash;	/* < Registration hashtable */
 	switch_thread_rwlock_t *reg_rwlock; /* < Registration hash rwlock */
@@ -429,6 +432,8 @@ struct rtmp_session {
 	rtmp_state_t amfstate_out[64];
 	
 	switch_mutex_t *socket_mutex;
+	unsigned char *sendbuf;		/* < Chunk header and payload are gathered here to go out in one write */
+	switch_size_t sendbuf_len;
 	switch_mutex_t *count_mutex;
 	int active_sessions;
 	
@@ -548,6 +548,28 @@ switch_status_t rtmp_send_invoke_v(rtmp_session_t *rsession, uint8_t amfnumber,
 	return rtmp_send_message(rsession, amfnumber, timestamp, type, stream_id, buf, helper.pos, 0);
 }
 
+/* Gather a chunk header and its payload so they leave in one write (and one TCP segment), socket_mutex must be held */
+static switch_status_t rtmp_send_chunk(rtmp_session_t *rsession, const uint8_t *hdr, switch_size_t hdrsize, const unsigned char *data, switch_size_t len)
+{
+	switch_size_t total = hdrsize + len;
+
+	if (total > rsession->sendbuf_len) {
+		rsession->sendbuf_len = total > (switch_size_t) 12 + rsession->out_chunksize ? total : (switch_size_t) 12 + rsession->out_chunksize;
+		rsession->sendbuf = switch_core_alloc(rsession->pool, rsession->sendbuf_len);
+	}
+
+	memcpy(rsession->sendbuf, hdr, hdrsize);
+	memcpy(rsession->sendbuf + hdrsize, data, len);
+
+	if (rsession->profile->io->write(rsession, rsession->sendbuf, &total) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	rsession->send += hdrsize + len;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 /* Break message down into 128 bytes chunks, add the appropriate headers and send it out */
 switch_status_t rtmp_send_message(rtmp_session_t *rsession, uint8_t amfnumber, uint32_t timestamp, uint8_t type, uint32_t stream_id, const unsigned char *message, switch_size_t len, uint32_t flags)
 {
@@ -638,16 +660,11 @@ switch_status_t rtmp_send_message(rtmp_session_t *rsession, uint8_t amfnumber, u
 
 	switch_mutex_lock(rsession->socket_mutex);
 	chunksize = (len - pos) < rsession->out_chunksize ? (len - pos) : rsession->out_chunksize;
-	if (rsession->profile->io->write(rsession, (unsigned char*)header, &hdrsize) != SWITCH_STATUS_SUCCESS) {
-		switch_goto_status(SWITCH_STATUS_FALSE, end);
-	}
-	rsession->send += hdrsize;
-	
-	/* Write one chunk of data */
-	if (rsession->profile->io->write(rsession, (unsigned char*)message, &chunksize) != SWITCH_STATUS_SUCCESS) {
+
+	/* Write the header and one chunk of data */
+	if (rtmp_send_chunk(rsession, header, hdrsize, message, chunksize) != SWITCH_STATUS_SUCCESS) {
 		switch_goto_status(SWITCH_STATUS_FALSE, end);
 	}
-	rsession->send += chunksize;
 	pos += chunksize;
 	
 	/* Send more chunks if we need to */
@@ -655,18 +672,12 @@ switch_status_t rtmp_send_message(rtmp_session_t *rsession, uint8_t amfnumber, u
 		switch_mutex_unlock(rsession->socket_mutex);
 		/* Let other threads send data on the socket */
 		switch_mutex_lock(rsession->socket_mutex);
-		hdrsize = 1;
-		if (rsession->profile->io->write(rsession, (unsigned char*)&microhdr, &hdrsize) != SWITCH_STATUS_SUCCESS) {
-			switch_goto_status(SWITCH_STATUS_FALSE, end);
-		}
-		rsession->send += hdrsize;
 		
 		chunksize = (len - pos) < rsession->out_chunksize ? (len - pos) : rsession->out_chunksize;
 				
-		if (rsession->profile->io->write(rsession, message + pos, &chunksize) != SWITCH_STATUS_SUCCESS) {
+		if (rtmp_send_chunk(rsession, &microhdr, 1, message + pos, chunksize) != SWITCH_STATUS_SUCCESS) {
 			switch_goto_status(SWITCH_STATUS_FALSE, end);
 		}
-		rsession->send += chunksize;
 		pos += chunksize;
 	}
 end:
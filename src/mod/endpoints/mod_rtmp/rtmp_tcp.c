@@ -31,16 +31,44 @@
 
 #include "mod_rtmp.h"
 
+#define RTMP_TCP_MAX_THREADS 64
+
+struct rtmp_io_tcp;
+
+/* One I/O thread and the sessions it polls */
+struct rtmp_tcp_reactor {
+	struct rtmp_io_tcp *io;
+	switch_pollset_t *pollset;
+	switch_mutex_t *mutex;		/* Held around poll when the pollset isn't thread safe */
+	switch_bool_t locked;
+	switch_thread_t *thread;
+	int id;
+
+	/* Statistics, written by the owning thread and by the session threads sending without locks
+	   so they are only approximate */
+	uint32_t sessions;
+	uint64_t accepted;
+	uint64_t polls;
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+	uint64_t bytes_queued;
+};
+
+typedef struct rtmp_tcp_reactor rtmp_tcp_reactor_t;
+
 /* Locally-extended version of rtmp_io_t */
 struct rtmp_io_tcp {
 	rtmp_io_t base;
 
-	switch_pollset_t *pollset;
+	rtmp_tcp_reactor_t *reactors;
+	int nreactors;
+	int live_reactors;
+	uint32_t max_sessions;
+	uint32_t sessions;
 	switch_pollfd_t *listen_pollfd;
 	switch_socket_t *listen_socket;
 	const char *ip;
 	switch_port_t port;
-	switch_thread_t *thread;
 	switch_mutex_t *mutex;
 };
 
@@ -51,14 +79,40 @@ struct rtmp_tcp_io_private {
 	switch_socket_t *socket;
 	switch_buffer_t *sendq;
 	switch_bool_t poll_send;
+	rtmp_tcp_reactor_t *reactor;
 };
 
 typedef struct rtmp_tcp_io_private rtmp_tcp_io_private_t;
 
+static void rtmp_tcp_pollset_remove(rtmp_tcp_reactor_t *reactor, switch_pollfd_t *pollfd)
+{
+	if (reactor->locked) {
+		switch_mutex_lock(reactor->mutex);
+	}
+	switch_pollset_remove(reactor->pollset, pollfd);
+	if (reactor->locked) {
+		switch_mutex_unlock(reactor->mutex);
+	}
+}
+
+static switch_status_t rtmp_tcp_pollset_add(rtmp_tcp_reactor_t *reactor, switch_pollfd_t *pollfd)
+{
+	switch_status_t status;
+
+	if (reactor->locked) {
+		switch_mutex_lock(reactor->mutex);
+	}
+	status = switch_pollset_add(reactor->pollset, pollfd);
+	if (reactor->locked) {
+		switch_mutex_unlock(reactor->mutex);
+	}
+
+	return status;
+}
+
 static void rtmp_tcp_alter_pollfd(rtmp_session_t *rsession, switch_bool_t pollout)
 {
 	rtmp_tcp_io_private_t *io_pvt = rsession->io_private;
-	rtmp_io_tcp_t *io = (rtmp_io_tcp_t*)rsession->profile->io;
 	
 	if (pollout && (io_pvt->pollfd->reqevents & SWITCH_POLLOUT)) {
 		return;
@@ -66,7 +120,7 @@ static void rtmp_tcp_alter_pollfd(rtmp_session_t *rsession, switch_bool_t pollou
 		return;
 	}
 	
-	switch_pollset_remove(io->pollset, io_pvt->pollfd);
+	rtmp_tcp_pollset_remove(io_pvt->reactor, io_pvt->pollfd);
 	io_pvt->pollfd->reqevents = SWITCH_POLLIN | SWITCH_POLLERR;
 	if (pollout) {
 		io_pvt->pollfd->reqevents |=  SWITCH_POLLOUT;
@@ -74,12 +128,32 @@ static void rtmp_tcp_alter_pollfd(rtmp_session_t *rsession, switch_bool_t pollou
 	switch_log_printf(SWITCH_CHANNEL_UUID_LOG(rsession->uuid), SWITCH_LOG_NOTICE, "Pollout: %s\n", 
 		pollout ? "true" : "false");
 	
-	switch_pollset_add(io->pollset, io_pvt->pollfd);
+	rtmp_tcp_pollset_add(io_pvt->reactor, io_pvt->pollfd);
+}
+
+/* Take the session's socket out of its reactor and close it */
+static void rtmp_tcp_detach(rtmp_session_t *rsession)
+{
+	rtmp_io_tcp_t *io = (rtmp_io_tcp_t*)rsession->profile->io;
+	rtmp_tcp_io_private_t *io_pvt = rsession->io_private;
+
+	if (!io_pvt->socket) {
+		return;
+	}
+
+	rtmp_tcp_pollset_remove(io_pvt->reactor, io_pvt->pollfd);
+
+	switch_socket_close(io_pvt->socket);
+	io_pvt->socket = NULL;
+
+	switch_mutex_lock(io->mutex);
+	io_pvt->reactor->sessions--;
+	io->sessions--;
+	switch_mutex_unlock(io->mutex);
 }
 
 static switch_status_t rtmp_tcp_read(rtmp_session_t *rsession, unsigned char *buf, switch_size_t *len)
 {
-	//rtmp_io_tcp_t *io = (rtmp_io_tcp_t*)rsession->profile->io;
 	rtmp_tcp_io_private_t *io_pvt = rsession->io_private;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
 #ifdef RTMP_DEBUG_IO
@@ -90,6 +164,8 @@ static switch_status_t rtmp_tcp_read(rtmp_session_t *rsession, unsigned char *bu
 	do {
 		status = switch_socket_recv(io_pvt->socket, (char*)buf, len);	
 	} while(status != SWITCH_STATUS_SUCCESS && SWITCH_STATUS_IS_BREAK(status));
+
+	io_pvt->reactor->bytes_in += *len;
 	
 #ifdef RTMP_DEBUG_IO
 	{
@@ -115,7 +191,6 @@ static switch_status_t rtmp_tcp_read(rtmp_session_t *rsession, unsigned char *bu
 
 static switch_status_t rtmp_tcp_write(rtmp_session_t *rsession, const unsigned char *buf, switch_size_t *len)
 {
-	//rtmp_io_tcp_t *io = (rtmp_io_tcp_t*)rsession->profile->io;
 	rtmp_tcp_io_private_t *io_pvt = rsession->io_private;
 	switch_status_t status;
 	switch_size_t orig_len = *len;	
@@ -138,16 +213,32 @@ static switch_status_t rtmp_tcp_write(rtmp_session_t *rsession, const unsigned c
 		fflush(rsession->io_debug_out);
 	}
 #endif
+
+	if (!io_pvt->socket) {
+		return SWITCH_STATUS_FALSE;
+	}
 	
-	if (io_pvt->sendq && switch_buffer_inuse(io_pvt->sendq) > 0) {
+	if (switch_buffer_inuse(io_pvt->sendq) > 0) {
 		/* We already have queued data, append it to the sendq */
 		switch_buffer_write(io_pvt->sendq, buf, *len);
+		io_pvt->reactor->bytes_queued += *len;
 		return SWITCH_STATUS_SUCCESS;
 	}
 	
 	status = switch_socket_send_nonblock(io_pvt->socket, (char*)buf, len);
+
+	if (status != SWITCH_STATUS_SUCCESS && !SWITCH_STATUS_IS_BREAK(status)) {
+		return status;
+	}
+
+	if (status != SWITCH_STATUS_SUCCESS) {
+		/* The socket buffer is full, nothing went out */
+		*len = 0;
+	}
+
+	io_pvt->reactor->bytes_out += *len;
 	
-	if (*len > 0 && *len < orig_len) {
+	if (*len < orig_len) {
 		
 		if (rsession->state >= RS_DESTROY) {
 			return SWITCH_STATUS_FALSE;
@@ -157,27 +248,21 @@ static switch_status_t rtmp_tcp_write(rtmp_session_t *rsession, const unsigned c
 		switch_log_printf(SWITCH_CHANNEL_UUID_LOG(rsession->uuid), SWITCH_LOG_DEBUG, "%"SWITCH_SIZE_T_FMT" bytes added to sendq.\n", (orig_len - *len));
 		
 		switch_buffer_write(io_pvt->sendq, (buf + *len), orig_len - *len);
+		io_pvt->reactor->bytes_queued += orig_len - *len;
+		*len = orig_len;
 
 		/* Make sure we poll-write */
 		rtmp_tcp_alter_pollfd(rsession, SWITCH_TRUE);
 	}
 	
-	return status;
+	return SWITCH_STATUS_SUCCESS;
 }
 
 static switch_status_t rtmp_tcp_close(rtmp_session_t *rsession)
 {
-	rtmp_io_tcp_t *io = (rtmp_io_tcp_t*)rsession->profile->io;
 	rtmp_tcp_io_private_t *io_pvt = rsession->io_private;	
 	
-	if (io_pvt->socket) {
-		switch_mutex_lock(io->mutex);
-		switch_pollset_remove(io->pollset, io_pvt->pollfd);
-		switch_mutex_unlock(io->mutex);
-
-		switch_socket_close(io_pvt->socket);
-		io_pvt->socket = NULL;
-	}
+	rtmp_tcp_detach(rsession);
 
 	if ( io_pvt->sendq ) {
 		switch_buffer_destroy(&(io_pvt->sendq));
@@ -186,13 +271,107 @@ static switch_status_t rtmp_tcp_close(rtmp_session_t *rsession)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static void rtmp_tcp_status(rtmp_io_t *base, switch_stream_handle_t *stream)
+{
+	rtmp_io_tcp_t *io = (rtmp_io_tcp_t*)base;
+	int i;
+
+	stream->write_function(stream, "I/O threads: %d\n", io->nreactors);
+	stream->write_function(stream, "Connected clients: %u/%u\n", io->sessions, io->max_sessions);
+	stream->write_function(stream, "\nthread,sessions,accepted,polls,bytes_in,bytes_out,bytes_queued\n");
+
+	for (i = 0; i < io->nreactors; i++) {
+		rtmp_tcp_reactor_t *reactor = &io->reactors[i];
+
+		stream->write_function(stream, "%d,%u,%"SWITCH_UINT64_T_FMT",%"SWITCH_UINT64_T_FMT",%"SWITCH_UINT64_T_FMT",%"SWITCH_UINT64_T_FMT",%"SWITCH_UINT64_T_FMT"\n",
+							   reactor->id, reactor->sessions, reactor->accepted, reactor->polls,
+							   reactor->bytes_in, reactor->bytes_out, reactor->bytes_queued);
+	}
+}
+
+/* Hand a freshly accepted socket to the I/O thread with the fewest sessions */
+static void rtmp_tcp_accept(rtmp_io_tcp_t *io, switch_socket_t *newsocket)
+{
+	rtmp_session_t *rsession;
+	rtmp_tcp_reactor_t *reactor = NULL;
+	int i;
+
+	switch_mutex_lock(io->mutex);
+	if (io->sessions < io->max_sessions) {
+		reactor = &io->reactors[0];
+		for (i = 1; i < io->nreactors; i++) {
+			if (io->reactors[i].sessions < reactor->sessions) {
+				reactor = &io->reactors[i];
+			}
+		}
+		reactor->sessions++;
+		reactor->accepted++;
+		io->sessions++;
+	}
+	switch_mutex_unlock(io->mutex);
+
+	if (!reactor) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "%s: Maximum of %u clients reached, rejecting connection\n",
+						  io->base.profile->name, io->max_sessions);
+		switch_socket_close(newsocket);
+		return;
+	}
+
+	if (switch_socket_opt_set(newsocket, SWITCH_SO_NONBLOCK, TRUE)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Couldn't set socket as non-blocking\n");
+	}
+
+	if (switch_socket_opt_set(newsocket, SWITCH_SO_TCP_NODELAY, 1)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Couldn't disable Nagle.\n");
+	}
+	
+	if (rtmp_session_request(io->base.profile, &rsession) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "RTMP session request failed\n");
+		switch_socket_close(newsocket);
+	} else {
+		switch_sockaddr_t *addr = NULL;
+		char ipbuf[200];
+		
+		/* Create out private data and attach it to the rtmp session structure */
+		rtmp_tcp_io_private_t *pvt = switch_core_alloc(rsession->pool, sizeof(*pvt));
+		rsession->io_private = pvt;
+		pvt->socket = newsocket;
+		pvt->reactor = reactor;
+		switch_buffer_create_dynamic(&pvt->sendq, 512, 1024, 0);
+		switch_socket_create_pollfd(&pvt->pollfd, newsocket, SWITCH_POLLIN | SWITCH_POLLERR, rsession, rsession->pool);
+		
+		/* Get the remote address/port info */
+		switch_socket_addr_get(&addr, SWITCH_TRUE, newsocket);
+		switch_get_addr(ipbuf, sizeof(ipbuf), addr);
+		rsession->remote_address = switch_core_strdup(rsession->pool, ipbuf);
+		rsession->remote_port = switch_sockaddr_get_port(addr);
+
+		if (rtmp_tcp_pollset_add(reactor, pvt->pollfd) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_UUID_LOG(rsession->uuid), SWITCH_LOG_ERROR, "Couldn't poll connection from %s:%i\n",
+							  rsession->remote_address, rsession->remote_port);
+			switch_socket_close(newsocket);
+			pvt->socket = NULL;
+			switch_buffer_destroy(&pvt->sendq);
+			rtmp_session_destroy(&rsession);
+		} else {
+			switch_log_printf(SWITCH_CHANNEL_UUID_LOG(rsession->uuid), SWITCH_LOG_INFO, "Rtmp connection from %s:%i (I/O thread %d)\n",
+							  rsession->remote_address, rsession->remote_port, reactor->id);
+			return;
+		}
+	}
+
+	switch_mutex_lock(io->mutex);
+	reactor->sessions--;
+	io->sessions--;
+	switch_mutex_unlock(io->mutex);
+}
 
 void *SWITCH_THREAD_FUNC rtmp_io_tcp_thread(switch_thread_t *thread, void *obj)
 {
-	rtmp_io_tcp_t *io = (rtmp_io_tcp_t*)obj;
-	io->base.running = 1;
+	rtmp_tcp_reactor_t *reactor = (rtmp_tcp_reactor_t*)obj;
+	rtmp_io_tcp_t *io = reactor->io;
 	
-	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s: I/O Thread starting\n", io->base.profile->name);
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s: I/O Thread %d starting\n", io->base.profile->name, reactor->id);
 	
 	
 	while(io->base.running) {
@@ -201,16 +380,25 @@ void *SWITCH_THREAD_FUNC rtmp_io_tcp_thread(switch_thread_t *thread, void *obj)
 		int32_t i;
 		switch_status_t status;
 		
-		switch_mutex_lock(io->mutex);
-		status = switch_pollset_poll(io->pollset, 500000, &numfds, &fds);
-		switch_mutex_unlock(io->mutex);
+		if (reactor->locked) {
+			switch_mutex_lock(reactor->mutex);
+		}
+		status = switch_pollset_poll(reactor->pollset, 500000, &numfds, &fds);
+		if (reactor->locked) {
+			switch_mutex_unlock(reactor->mutex);
+		}
 		
 		if (status != SWITCH_STATUS_SUCCESS && status != SWITCH_STATUS_TIMEOUT) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "pollset_poll failed\n");
+			if (!SWITCH_STATUS_IS_BREAK(status)) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "pollset_poll failed\n");
+			}
 			continue;
 		} else if (status == SWITCH_STATUS_TIMEOUT) {
 			switch_cond_next();
+			continue;
 		}
+
+		reactor->polls++;
 		
 		for (i = 0; i < numfds; i++) {
 			if (!fds[i].client_data) { 
@@ -220,78 +408,55 @@ void *SWITCH_THREAD_FUNC rtmp_io_tcp_thread(switch_thread_t *thread, void *obj)
 						/* Don't spam the logs if we are shutting down */
 						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Socket Error [%s]\n", strerror(errno));	
 					} else {
-						return NULL;
+						goto end;
 					}
 				} else {
-					rtmp_session_t *rsession;
-					
-					if (switch_socket_opt_set(newsocket, SWITCH_SO_NONBLOCK, TRUE)) {
-						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Couldn't set socket as non-blocking\n");
-					}
-
-					if (switch_socket_opt_set(newsocket, SWITCH_SO_TCP_NODELAY, 1)) {
-						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Couldn't disable Nagle.\n");
-					}
-					
-					if (rtmp_session_request(io->base.profile, &rsession) != SWITCH_STATUS_SUCCESS) {
-						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "RTMP session request failed\n");
-						switch_socket_close(newsocket);
-					} else {
-						switch_sockaddr_t *addr = NULL;
-						char ipbuf[200];
-						
-						/* Create out private data and attach it to the rtmp session structure */
-						rtmp_tcp_io_private_t *pvt = switch_core_alloc(rsession->pool, sizeof(*pvt));
-						rsession->io_private = pvt;
-						pvt->socket = newsocket;
-						switch_socket_create_pollfd(&pvt->pollfd, newsocket, SWITCH_POLLIN | SWITCH_POLLERR, rsession, rsession->pool);
-						switch_pollset_add(io->pollset, pvt->pollfd);
-						switch_buffer_create_dynamic(&pvt->sendq, 512, 1024, 0);
-						
-						/* Get the remote address/port info */
-						switch_socket_addr_get(&addr, SWITCH_TRUE, newsocket);
-						switch_get_addr(ipbuf, sizeof(ipbuf), addr);
-						rsession->remote_address = switch_core_strdup(rsession->pool, ipbuf);
-						rsession->remote_port = switch_sockaddr_get_port(addr);
-						switch_log_printf(SWITCH_CHANNEL_UUID_LOG(rsession->uuid), SWITCH_LOG_INFO, "Rtmp connection from %s:%i\n",
-										  rsession->remote_address, rsession->remote_port);
-					}
+					rtmp_tcp_accept(io, newsocket);
 				}
 			} else {
 				rtmp_session_t *rsession = (rtmp_session_t*)fds[i].client_data;
 				rtmp_tcp_io_private_t *io_pvt = (rtmp_tcp_io_private_t*)rsession->io_private;
 				
 				if (fds[i].rtnevents & SWITCH_POLLOUT && switch_buffer_inuse(io_pvt->sendq) > 0) {
-					/* Send as much remaining data as possible */
+					/* Send as much remaining data as possible, the queue is one contiguous block so a single send covers it */
 					switch_size_t sendlen;
 					const void *ptr;
+
+					switch_mutex_lock(rsession->socket_mutex);
 					sendlen = switch_buffer_peek_zerocopy(io_pvt->sendq, &ptr);
-					switch_socket_send_nonblock(io_pvt->socket, ptr, &sendlen);
+					if (switch_socket_send_nonblock(io_pvt->socket, ptr, &sendlen) != SWITCH_STATUS_SUCCESS) {
+						sendlen = 0;
+					}
 					switch_buffer_toss(io_pvt->sendq, sendlen);
+					reactor->bytes_out += sendlen;
 					if (switch_buffer_inuse(io_pvt->sendq) == 0) {
 						/* Remove our fd from OUT polling */
 						rtmp_tcp_alter_pollfd(rsession, SWITCH_FALSE);
 					}
+					switch_mutex_unlock(rsession->socket_mutex);
 				} else 	if (fds[i].rtnevents & SWITCH_POLLIN && rtmp_handle_data(rsession) != SWITCH_STATUS_SUCCESS) {
 					switch_log_printf(SWITCH_CHANNEL_UUID_LOG(rsession->uuid), SWITCH_LOG_DEBUG, "Closing socket\n");
 					
-					switch_mutex_lock(io->mutex);
-					switch_pollset_remove(io->pollset, io_pvt->pollfd);
-					switch_mutex_unlock(io->mutex);
-					
-					switch_socket_close(io_pvt->socket);
-					io_pvt->socket = NULL;
-
+					switch_mutex_lock(rsession->socket_mutex);
 					io->base.close(rsession);
+					switch_mutex_unlock(rsession->socket_mutex);
 					
 					rtmp_session_destroy(&rsession);
 				}
 			}
 		}
 	}
-	
-	io->base.running = -1;
-	switch_socket_close(io->listen_socket);
+
+  end:
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s: I/O Thread %d ending\n", io->base.profile->name, reactor->id);
+
+	switch_mutex_lock(io->mutex);
+	if (!--io->live_reactors) {
+		io->base.running = -1;
+		switch_socket_close(io->listen_socket);
+	}
+	switch_mutex_unlock(io->mutex);
 	
 	return NULL;
 }
@@ -302,6 +467,8 @@ switch_status_t rtmp_tcp_init(rtmp_profile_t *profile, const char *bindaddr, rtm
 	switch_sockaddr_t *sa;
 	switch_threadattr_t *thd_attr = NULL;
 	rtmp_io_tcp_t *io_tcp;
+	uint32_t pollset_size;
+	int i;
 		
 	io_tcp = (rtmp_io_tcp_t*)switch_core_alloc(pool, sizeof(rtmp_io_tcp_t));
 	io_tcp->base.pool = pool;
@@ -312,8 +479,16 @@ switch_status_t rtmp_tcp_init(rtmp_profile_t *profile, const char *bindaddr, rtm
 	io_tcp->base.read = rtmp_tcp_read;
 	io_tcp->base.write = rtmp_tcp_write;
 	io_tcp->base.close = rtmp_tcp_close;
+	io_tcp->base.status = rtmp_tcp_status;
 	io_tcp->base.name = "tcp";
 	io_tcp->base.address = switch_core_strdup(pool, io_tcp->ip);
+
+	io_tcp->nreactors = profile->io_threads > 0 ? profile->io_threads : 1;
+	if (io_tcp->nreactors > RTMP_TCP_MAX_THREADS) {
+		io_tcp->nreactors = RTMP_TCP_MAX_THREADS;
+	}
+	io_tcp->max_sessions = profile->max_sessions > 0 ? profile->max_sessions : 1000;
+	io_tcp->reactors = switch_core_alloc(pool, sizeof(rtmp_tcp_reactor_t) * io_tcp->nreactors);
 	
 	if ((szport = strchr(io_tcp->ip, ':'))) {
 		*szport++ = '\0';
@@ -346,25 +521,49 @@ switch_status_t rtmp_tcp_init(rtmp_profile_t *profile, const char *bindaddr, rtm
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Listening on %s:%u (tcp)\n", io_tcp->ip, io_tcp->port);
 	
-	io_tcp->base.running = 1;
-	
-	if (switch_pollset_create(&io_tcp->pollset, 1000 /* max poll fds */, pool, 0) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "pollset_create failed\n");
-		goto fail;
+	/* Sessions are spread evenly, leave some slack for the ones still being torn down */
+	pollset_size = io_tcp->max_sessions / io_tcp->nreactors + io_tcp->max_sessions / (io_tcp->nreactors * 10) + 2;
+
+	for (i = 0; i < io_tcp->nreactors; i++) {
+		rtmp_tcp_reactor_t *reactor = &io_tcp->reactors[i];
+
+		reactor->io = io_tcp;
+		reactor->id = i;
+		switch_mutex_init(&reactor->mutex, SWITCH_MUTEX_NESTED, pool);
+
+		/* Session threads change a session's poll events while its I/O thread sits in poll, only
+		   fall back to serializing them when the platform has no thread safe pollset */
+		if (switch_pollset_create(&reactor->pollset, pollset_size, pool, SWITCH_POLLSET_THREADSAFE) != SWITCH_STATUS_SUCCESS) {
+			reactor->locked = SWITCH_TRUE;
+			if (switch_pollset_create(&reactor->pollset, pollset_size, pool, 0) != SWITCH_STATUS_SUCCESS) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "pollset_create failed\n");
+				goto fail;
+			}
+		}
 	}
 	
+	/* The first I/O thread also accepts new connections */
 	switch_socket_create_pollfd(&(io_tcp->listen_pollfd), io_tcp->listen_socket, SWITCH_POLLIN | SWITCH_POLLERR, NULL, pool);
-	if (switch_pollset_add(io_tcp->pollset, io_tcp->listen_pollfd) != SWITCH_STATUS_SUCCESS) {
+	if (switch_pollset_add(io_tcp->reactors[0].pollset, io_tcp->listen_pollfd) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "pollset_add failed\n");
 		goto fail;
 	}
 	
 	switch_mutex_init(&io_tcp->mutex, SWITCH_MUTEX_NESTED, pool);
 	
+	io_tcp->base.running = 1;
+	io_tcp->live_reactors = io_tcp->nreactors;
+
 	switch_threadattr_create(&thd_attr, pool);
 	switch_threadattr_detach_set(thd_attr, 1);
 	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
-	switch_thread_create(&io_tcp->thread, thd_attr, rtmp_io_tcp_thread, *new_io, pool);
+
+	for (i = 0; i < io_tcp->nreactors; i++) {
+		switch_thread_create(&io_tcp->reactors[i].thread, thd_attr, rtmp_io_tcp_thread, &io_tcp->reactors[i], pool);
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s: %d I/O threads for up to %u clients\n",
+					  profile->name, io_tcp->nreactors, io_tcp->max_sessions);
 	
 	return SWITCH_STATUS_SUCCESS;
 fail:
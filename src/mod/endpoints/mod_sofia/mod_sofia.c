@@ -328,6 +328,8 @@ switch_status_t sofia_on_destroy(switch_core_session_t *session)
 			switch_yield(100000);
 		}
 
+		sofia_clear_lazy_header_vars(tech_pvt);
+
 		if (!zstr(tech_pvt->call_id)) {
 			switch_mutex_lock(tech_pvt->profile->flag_mutex);
 			if ((uuid = switch_core_hash_find(tech_pvt->profile->chat_hash, tech_pvt->call_id))) {
@@ -1587,7 +1589,6 @@ static switch_status_t sofia_receive_message(switch_core_session_t *session, swi
 			if (!zstr(name)) {
 				char message[256] = "";
 				const char *ua = switch_channel_get_variable(tech_pvt->channel, "sip_user_agent");
-				switch_event_t *event;
 
 				check_decode(name, tech_pvt->session);
 
@@ -1706,23 +1707,7 @@ static switch_status_t sofia_receive_message(switch_core_session_t *session, swi
 						tech_pvt->last_sent_callee_id_number = switch_core_session_strdup(tech_pvt->session, number);
 
 
-						if (switch_event_create(&event, SWITCH_EVENT_CALL_UPDATE) == SWITCH_STATUS_SUCCESS) {
-							const char *uuid = switch_channel_get_partner_uuid(channel);
-							switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Direction", "SEND");
-
-
-							switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Sent-Callee-ID-Name", name);
-							switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Sent-Callee-ID-Number", number);
-
-							//switch_channel_set_profile_var(channel, "callee_id_name", name);
-							//switch_channel_set_profile_var(channel, "callee_id_number", number);
-
-							if (uuid) {
-								switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Bridged-To", uuid);
-							}
-							switch_channel_event_set_data(channel, event);
-							switch_event_fire(&event);
-						}
+						switch_channel_fire_call_update(channel, "SEND", name, number);
 					} else {
 						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Not sending same id again \"%s\" <%s>\n", name, number);
 					}
@@ -2449,6 +2434,38 @@ static uint32_t sofia_profile_reg_count(sofia_profile_t *profile)
 	return strtoul(reg_count, NULL, 10);
 }
 
+static void sofia_profile_tls_stats(sofia_profile_t *profile, switch_stream_handle_t *stream, switch_bool_t xml)
+{
+	tport_tls_stats_t stats;
+	time_t uptime;
+
+	if (!profile->nua || tport_tls_stats(nta_agent_tports(profile->nua->nua_nta), &stats)) {
+		return;
+	}
+
+	uptime = switch_epoch_time_now(NULL) - profile->started;
+	if (uptime <= 0) {
+		uptime = 1;
+	}
+
+	if (xml) {
+		stream->write_function(stream, "    <tls-handshakes>%lu</tls-handshakes>\n", stats.tls_handshakes);
+		stream->write_function(stream, "    <tls-handshakes-resumed>%lu</tls-handshakes-resumed>\n", stats.tls_resumed);
+		stream->write_function(stream, "    <tls-handshakes-failed>%lu</tls-handshakes-failed>\n", stats.tls_failed);
+		stream->write_function(stream, "    <tls-handshakes-pending>%u</tls-handshakes-pending>\n", stats.tls_pending);
+		stream->write_function(stream, "    <tls-handshake-rate>%.2f</tls-handshake-rate>\n", (double) stats.tls_handshakes / uptime);
+		stream->write_function(stream, "    <tls-handshake-latency-avg>%lu</tls-handshake-latency-avg>\n",
+							   stats.tls_handshakes ? stats.tls_latency / stats.tls_handshakes : 0);
+		stream->write_function(stream, "    <tls-handshake-latency-max>%u</tls-handshake-latency-max>\n", stats.tls_latency_max);
+	} else {
+		stream->write_function(stream, "TLS-HANDSHAKES   \t%lu (%lu resumed, %lu failed, %u pending)\n",
+							   stats.tls_handshakes, stats.tls_resumed, stats.tls_failed, stats.tls_pending);
+		stream->write_function(stream, "TLS-HS-RATE      \t%.2f/sec\n", (double) stats.tls_handshakes / uptime);
+		stream->write_function(stream, "TLS-HS-LATENCY   \t%lums avg, %ums max\n",
+							   stats.tls_handshakes ? stats.tls_latency / stats.tls_handshakes : 0, stats.tls_latency_max);
+	}
+}
+
 static const char *status_names[] = { "DOWN", "UP", NULL };
 
 static switch_status_t cmd_status(char **argv, int argc, switch_stream_handle_t *stream)
@@ -2589,6 +2606,7 @@ static switch_status_t cmd_status(char **argv, int argc, switch_stream_handle_t
 					if (sofia_test_pflag(profile, PFLAG_TLS)) {
 						stream->write_function(stream, "TLS-URL          \t%s\n", switch_str_nil(profile->tls_url));
 						stream->write_function(stream, "TLS-BIND-URL     \t%s\n", switch_str_nil(profile->tls_bindurl));
+						sofia_profile_tls_stats(profile, stream, SWITCH_FALSE);
 					}
 					if (profile->ws_bindurl) {
 						stream->write_function(stream, "WS-BIND-URL     \t%s\n", switch_str_nil(profile->ws_bindurl));
@@ -2880,6 +2898,9 @@ static switch_status_t cmd_xml_status(char **argv, int argc, switch_stream_handl
 					stream->write_function(stream, "    <bind-url>%s</bind-url>\n", switch_str_nil(profile->bindurl));
 					stream->write_function(stream, "    <tls-url>%s</tls-url>\n", switch_str_nil(profile->tls_url));
 					stream->write_function(stream, "    <tls-bind-url>%s</tls-bind-url>\n", switch_str_nil(profile->tls_bindurl));
+					if (sofia_test_pflag(profile, PFLAG_TLS)) {
+						sofia_profile_tls_stats(profile, stream, SWITCH_TRUE);
+					}
 					stream->write_function(stream, "    <ws-bind-url>%s</ws-bind-url>\n", switch_str_nil(profile->ws_bindurl));
 					stream->write_function(stream, "    <wss-bind-url>%s</wss-bind-url>\n", switch_str_nil(profile->wss_bindurl));
 					stream->write_function(stream, "    <hold-music>%s</hold-music>\n", zstr(profile->hold_music) ? "N/A" : profile->hold_music);
@@ -3185,11 +3206,13 @@ static switch_status_t cmd_profile(char **argv, int argc, switch_stream_handle_t
 			for (gateway_ptr = profile->gateways; gateway_ptr; gateway_ptr = gateway_ptr->next) {
 				gateway_ptr->retry = 0;
 				gateway_ptr->state = REG_STATE_UNREGED;
+				sofia_reg_kick_gateway(gateway_ptr);
 			}
 			stream->write_function(stream, "+OK\n");
 		} else if ((gateway_ptr = sofia_reg_find_gateway(gname))) {
 			gateway_ptr->retry = 0;
 			gateway_ptr->state = REG_STATE_UNREGED;
+			sofia_reg_kick_gateway(gateway_ptr);
 			stream->write_function(stream, "+OK\n");
 			sofia_reg_release_gateway(gateway_ptr);
 		} else {
@@ -3212,11 +3235,13 @@ static switch_status_t cmd_profile(char **argv, int argc, switch_stream_handle_t
 			for (gateway_ptr = profile->gateways; gateway_ptr; gateway_ptr = gateway_ptr->next) {
 				gateway_ptr->retry = 0;
 				gateway_ptr->state = REG_STATE_UNREGISTER;
+				sofia_reg_kick_gateway(gateway_ptr);
 			}
 			stream->write_function(stream, "+OK\n");
 		} else if ((gateway_ptr = sofia_reg_find_gateway(gname))) {
 			gateway_ptr->retry = 0;
 			gateway_ptr->state = REG_STATE_UNREGISTER;
+			sofia_reg_kick_gateway(gateway_ptr);
 			stream->write_function(stream, "+OK\n");
 			sofia_reg_release_gateway(gateway_ptr);
 		} else {
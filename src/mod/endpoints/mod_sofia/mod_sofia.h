@@ -49,6 +49,7 @@
 #include <switch.h>
 #define SOFIA_NAT_SESSION_TIMEOUT 90
 #define SOFIA_MAX_ACL 100
+#define SOFIA_MAX_EAGER_HEADER_VARS 32
 #ifdef _MSC_VER
 #define HAVE_FUNCTION 1
 #else
@@ -128,7 +129,10 @@ typedef struct private_object private_object_t;
 #include <sofia-sip/nea.h>
 #include <sofia-sip/msg_addr.h>
 #include <sofia-sip/tport_tag.h>
+#include <sofia-sip/tport.h>
+#include <sofia-sip/nta_tport.h>
 #include <sofia-sip/sip_extra.h>
+#include <sofia-sip/heap.h>
 #include "nua_stack.h"
 #include "sofia-sip/msg_parser.h"
 #include "sofia-sip/sip_parser.h"
@@ -136,6 +140,9 @@ typedef struct private_object private_object_t;
 #include <sofia-sip/msg.h>
 #include <sofia-sip/uniqueid.h>
 
+/* Gateways ordered by the time they are next due, see sofia_reg_check_gateway() */
+typedef HEAP_TYPE sofia_gateway_heap_t;
+
 typedef enum {
 	SOFIA_CONFIG_LOAD = 0,
 	SOFIA_CONFIG_RESCAN,
@@ -273,6 +280,7 @@ typedef enum {
 	PFLAG_TCP_UNREG_ON_SOCKET_CLOSE,
 	PFLAG_TLS_ALWAYS_NAT,
 	PFLAG_TCP_ALWAYS_NAT,
+	PFLAG_LAZY_HEADER_VARS,
 	/* No new flags below this line */
 	PFLAG_MAX
 } PFLAGS;
@@ -498,6 +506,9 @@ struct sofia_gateway {
 	uint32_t ob_failed_calls;
 	char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
 	int failures;
+	size_t sched_index;			/* position in profile->gw_sched, 0 if not scheduled */
+	time_t sched_next;			/* when the worker next looks at this gateway */
+	struct sofia_gateway *sched_due;
 	struct sofia_gateway *next;
 	sofia_gateway_subscription_t *subscriptions;
 	int distinct_to;
@@ -594,6 +605,9 @@ struct sofia_profile {
 	char *tls_ciphers;
 	int tls_version;
 	unsigned int tls_timeout;
+	unsigned int tls_session_cache;
+	int tls_session_tickets;
+	unsigned int tls_handshake_threads;
 	char *inbound_codec_string;
 	char *outbound_codec_string;
 	int running;
@@ -677,6 +691,11 @@ struct sofia_profile {
 	uint32_t event_timeout;
 	int watchdog_enabled;
 	switch_mutex_t *gw_mutex;
+	switch_mutex_t *gw_sched_mutex;
+	sofia_gateway_heap_t gw_sched;
+	uint32_t gateway_jitter;
+	char *eager_header_vars[SOFIA_MAX_EAGER_HEADER_VARS];
+	int eager_header_var_count;
 	uint32_t queued_events;
 	uint32_t cseq_base;
 	int tls_only;
@@ -704,6 +723,7 @@ struct sofia_profile {
 	int tcp_keepalive;
 	int tcp_pingpong;
 	int tcp_ping2pong;
+	int udp_recv_threads;
 };
 
 
@@ -757,6 +777,7 @@ struct private_object {
 	nua_handle_t *nh;
 	nua_handle_t *nh2;
 	sip_contact_t *contact;
+	msg_t *lazy_msg;
 	int q850_cause;
 	int got_bye;
 	nua_event_t want_event;
@@ -868,6 +889,7 @@ void sofia_handle_sip_i_info(nua_t *nua, sofia_profile_t *profile, nua_handle_t
 								sofia_dispatch_event_t *de, tagi_t tags[]);
 
 void sofia_handle_sip_i_invite(switch_core_session_t *session, nua_t *nua, sofia_profile_t *profile, nua_handle_t *nh, sofia_private_t *sofia_private, sip_t const *sip, sofia_dispatch_event_t *de, tagi_t tags[]);
+void sofia_clear_lazy_header_vars(private_object_t *tech_pvt);
 
 
 void sofia_reg_handle_sip_i_register(nua_t *nua, sofia_profile_t *profile, nua_handle_t *nh, sofia_private_t **sofia_private, sip_t const *sip,
@@ -943,7 +965,10 @@ void sofia_glue_execute_sql_now(sofia_profile_t *profile, char **sqlp, switch_bo
 void sofia_glue_execute_sql_soon(sofia_profile_t *profile, char **sqlp, switch_bool_t sql_already_dynamic);
 void sofia_reg_check_expire(sofia_profile_t *profile, time_t now, int reboot);
 void sofia_reg_check_gateway(sofia_profile_t *profile, time_t now);
-void sofia_sub_check_gateway(sofia_profile_t *profile, time_t now);
+void sofia_reg_schedule_gateway(sofia_gateway_t *gateway, time_t when);
+#define sofia_reg_kick_gateway(gateway) sofia_reg_schedule_gateway(gateway, 0)
+uint32_t sofia_reg_gateway_jitter(sofia_gateway_t *gateway, uint32_t seconds);
+void sofia_reg_destroy_gateway_schedule(sofia_profile_t *profile);
 void sofia_reg_unregister(sofia_profile_t *profile);
 
 
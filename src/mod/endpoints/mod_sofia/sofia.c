@@ -174,10 +174,11 @@ static void extract_header_vars(sofia_profile_t *profile, sip_t const *sip,
 								switch_core_session_t *session, nua_handle_t *nh)
 {
 	switch_channel_t *channel = switch_core_session_get_channel(session);
+	private_object_t *tech_pvt = (private_object_t *) switch_core_session_get_private(session);
 	char *full;
 
 	if (sip) {
-		if (sip->sip_route) {
+		if (sip->sip_route && !(tech_pvt && tech_pvt->lazy_msg && sip_object(tech_pvt->lazy_msg) == sip)) {
 			if ((full = sip_header_as_string(nh->nh_home, (void *) sip->sip_route))) {
 				const char *v = switch_channel_get_variable(channel, "sip_full_route");
 				if (!v) {
@@ -326,20 +327,46 @@ static void extract_vars(sofia_profile_t *profile, sip_t const *sip,
 	}
 }
 
+/**
+ * Tell if a "sip_i_" variable is wanted, only is NULL when all of them are
+ */
+static int sofia_invite_var_wanted(const char *only, const char *var)
+{
+	return !only || !strcasecmp(only, var);
+}
+
+/**
+ * Tell if var is the "sip_i_" variable an unknown header is stored under: lower case, '-' turned into '_'
+ */
+static int sofia_invite_unknown_is_var(const char *name, const char *var)
+{
+	if (strncasecmp(var, "sip_i_", 6)) {
+		return 0;
+	}
+
+	for (var += 6; *name && *var; name++, var++) {
+		if (*name == '-' ? *var != '_' : tolower((unsigned char) *name) != tolower((unsigned char) *var)) {
+			return 0;
+		}
+	}
+
+	return !*name && !*var;
+}
+
 /**
  * Add a specific SIP INVITE header to the channel variables, prefixed with "sip_i_"
  */
-static void sofia_add_invite_header_to_chanvars(switch_channel_t *channel, nua_handle_t *nh, void *sip_header, const char *var)
+static void sofia_add_invite_header_to_chanvars(switch_channel_t *channel, su_home_t *home, const char *only, void *sip_header, const char *var)
 {
 	switch_assert(channel);
-	switch_assert(nh);
+	switch_assert(home);
 	switch_assert(var);
 
-	if (sip_header) {
+	if (sip_header && sofia_invite_var_wanted(only, var)) {
 		char *full;
-		if ((full = sip_header_as_string(nh->nh_home, sip_header))) {
+		if ((full = sip_header_as_string(home, sip_header))) {
 			switch_channel_set_variable(channel, var, full);
-			su_free(nh->nh_home, full);
+			su_free(home, full);
 		}
 	}
 }
@@ -350,12 +377,12 @@ static void sofia_add_invite_header_to_chanvars(switch_channel_t *channel, nua_h
  * Multiple headers will have the original internal order, though.
  *
  * @param sip A sip_t struct containing the parsed message
- * @param session A call session
- * @param nh A NUA handle for string allocation
+ * @param channel The channel of the call
+ * @param home A home for string allocation
+ * @param only Name of the one variable to set, NULL to set them all
  */
-static void sofia_parse_all_invite_headers(sip_t const *sip, switch_core_session_t *session, nua_handle_t *nh)
+static void sofia_parse_all_invite_headers(sip_t const *sip, switch_channel_t *channel, su_home_t *home, const char *only)
 {
-	switch_channel_t *channel = switch_core_session_get_channel(session);
 	sip_unknown_t *un;
 	sip_p_asserted_identity_t *passerted;
 	sip_p_preferred_identity_t *ppreferred;
@@ -366,136 +393,136 @@ static void sofia_parse_all_invite_headers(sip_t const *sip, switch_core_session
 	if (!sip) return;
 
 	/* Add simple (unique) headers first */
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_from, "sip_i_from");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_to, "sip_i_to");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_call_id, "sip_i_call_id");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_cseq, "sip_i_cseq");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_route, "sip_i_route");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_max_forwards, "sip_i_max_forwards");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_proxy_require, "sip_i_proxy_require");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_contact, "sip_i_contact");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_user_agent, "sip_i_user_agent");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_subject, "sip_i_subject");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_priority, "sip_i_priority");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_organization, "sip_i_organization");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_in_reply_to, "sip_i_in_reply_to");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_accept_encoding, "sip_i_accept_encoding");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_accept_language, "sip_i_accept_language");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_allow, "sip_i_allow");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_require, "sip_i_require");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_supported, "sip_i_supported");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_date, "sip_i_date");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_timestamp, "sip_i_timestamp");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_expires, "sip_i_expires");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_min_expires, "sip_i_min_expires");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_session_expires, "sip_i_session_expires");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_min_se, "sip_i_min_se");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_privacy, "sip_i_privacy");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_mime_version, "sip_i_mime_version");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_content_type, "sip_i_content_type");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_content_encoding, "sip_i_content_encoding");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_content_language, "sip_i_content_language");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_content_disposition, "sip_i_content_disposition");
-	sofia_add_invite_header_to_chanvars(channel, nh, sip->sip_content_length, "sip_i_content_length");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_from, "sip_i_from");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_to, "sip_i_to");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_call_id, "sip_i_call_id");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_cseq, "sip_i_cseq");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_route, "sip_i_route");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_max_forwards, "sip_i_max_forwards");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_proxy_require, "sip_i_proxy_require");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_contact, "sip_i_contact");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_user_agent, "sip_i_user_agent");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_subject, "sip_i_subject");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_priority, "sip_i_priority");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_organization, "sip_i_organization");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_in_reply_to, "sip_i_in_reply_to");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_accept_encoding, "sip_i_accept_encoding");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_accept_language, "sip_i_accept_language");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_allow, "sip_i_allow");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_require, "sip_i_require");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_supported, "sip_i_supported");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_date, "sip_i_date");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_timestamp, "sip_i_timestamp");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_expires, "sip_i_expires");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_min_expires, "sip_i_min_expires");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_session_expires, "sip_i_session_expires");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_min_se, "sip_i_min_se");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_privacy, "sip_i_privacy");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_mime_version, "sip_i_mime_version");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_content_type, "sip_i_content_type");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_content_encoding, "sip_i_content_encoding");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_content_language, "sip_i_content_language");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_content_disposition, "sip_i_content_disposition");
+	sofia_add_invite_header_to_chanvars(channel, home, only, sip->sip_content_length, "sip_i_content_length");
 
 	/* Add all other headers - which might exist more than once */
 
-	if (sip->sip_via) {
+	if (sip->sip_via && sofia_invite_var_wanted(only, "sip_i_via")) {
 		sip_via_t *vp;
 		for (vp = sip->sip_via; vp; vp = vp->v_next) {
-			char *v = sip_header_as_string(nh->nh_home, (void *) vp);
+			char *v = sip_header_as_string(home, (void *) vp);
 			switch_channel_add_variable_var_check(channel, "sip_i_via", v, SWITCH_FALSE, SWITCH_STACK_PUSH);
-			su_free(nh->nh_home, v);
+			su_free(home, v);
 		}
 	}
 
-	if (sip->sip_record_route) {
+	if (sip->sip_record_route && sofia_invite_var_wanted(only, "sip_i_record_route")) {
 		sip_record_route_t *rrp;
 		for (rrp = sip->sip_record_route; rrp; rrp = rrp->r_next) {
-			char *rr = sip_header_as_string(nh->nh_home, (void *) rrp);
+			char *rr = sip_header_as_string(home, (void *) rrp);
 			switch_channel_add_variable_var_check(channel, "sip_i_record_route", rr, SWITCH_FALSE, SWITCH_STACK_PUSH);
-			su_free(nh->nh_home, rr);
+			su_free(home, rr);
 		}
 	}
 
-	if (sip->sip_proxy_authorization) {
+	if (sip->sip_proxy_authorization && sofia_invite_var_wanted(only, "sip_i_proxy_authorization")) {
 		sip_proxy_authorization_t *vp;
 		for (vp = sip->sip_proxy_authorization; vp; vp = vp->au_next) {
-			char *v = sip_header_as_string(nh->nh_home, (void *) vp);
+			char *v = sip_header_as_string(home, (void *) vp);
 			switch_channel_add_variable_var_check(channel, "sip_i_proxy_authorization", v, SWITCH_FALSE, SWITCH_STACK_PUSH);
-			su_free(nh->nh_home, v);
+			su_free(home, v);
 		}
 	}
 
-	if (sip->sip_call_info) {
+	if (sip->sip_call_info && sofia_invite_var_wanted(only, "sip_i_call_info")) {
 		sip_call_info_t *vp;
 		for (vp = sip->sip_call_info; vp; vp = vp->ci_next) {
-			char *v = sip_header_as_string(nh->nh_home, (void *) vp);
+			char *v = sip_header_as_string(home, (void *) vp);
 			switch_channel_add_variable_var_check(channel, "sip_i_call_info", v, SWITCH_FALSE, SWITCH_STACK_PUSH);
-			su_free(nh->nh_home, v);
+			su_free(home, v);
 		}
 	}
 
-	if (sip->sip_accept) {
+	if (sip->sip_accept && sofia_invite_var_wanted(only, "sip_i_accept")) {
 		sip_accept_t *vp;
 		for (vp = sip->sip_accept; vp; vp = vp->ac_next) {
-			char *v = sip_header_as_string(nh->nh_home, (void *) vp);
+			char *v = sip_header_as_string(home, (void *) vp);
 			switch_channel_add_variable_var_check(channel, "sip_i_accept", v, SWITCH_FALSE, SWITCH_STACK_PUSH);
-			su_free(nh->nh_home, v);
+			su_free(home, v);
 		}
 	}
 
-	if (sip->sip_authorization) {
+	if (sip->sip_authorization && sofia_invite_var_wanted(only, "sip_i_authorization")) {
 		sip_authorization_t *vp;
 		for (vp = sip->sip_authorization; vp; vp = vp->au_next) {
-			char *v = sip_header_as_string(nh->nh_home, (void *) vp);
+			char *v = sip_header_as_string(home, (void *) vp);
 			switch_channel_add_variable_var_check(channel, "sip_i_authorization", v, SWITCH_FALSE, SWITCH_STACK_PUSH);
-			su_free(nh->nh_home, v);
+			su_free(home, v);
 		}
 	}
 
-	if ((alert_info = sip_alert_info(sip))) {
+	if (sofia_invite_var_wanted(only, "sip_i_alert_info") && (alert_info = sip_alert_info(sip))) {
 		sip_alert_info_t *vp;
 		for (vp = alert_info; vp; vp = vp->ai_next) {
-			char *v = sip_header_as_string(nh->nh_home, (void *) vp);
+			char *v = sip_header_as_string(home, (void *) vp);
 			switch_channel_add_variable_var_check(channel, "sip_i_alert_info", v, SWITCH_FALSE, SWITCH_STACK_PUSH);
-			su_free(nh->nh_home, v);
+			su_free(home, v);
 		}
 	}
 
-	if ((passerted = sip_p_asserted_identity(sip))) {
+	if (sofia_invite_var_wanted(only, "sip_i_p_asserted_identity") && (passerted = sip_p_asserted_identity(sip))) {
 		sip_p_asserted_identity_t *vp;
 		for (vp = passerted; vp; vp = vp->paid_next) {
-			char *v = sip_header_as_string(nh->nh_home, (void *) vp);
+			char *v = sip_header_as_string(home, (void *) vp);
 			switch_channel_add_variable_var_check(channel, "sip_i_p_asserted_identity", v, SWITCH_FALSE, SWITCH_STACK_PUSH);
-			su_free(nh->nh_home, v);
+			su_free(home, v);
 		}
 	}
 
-	if ((ppreferred = sip_p_preferred_identity(sip))) {
+	if (sofia_invite_var_wanted(only, "sip_i_p_preferred_identity") && (ppreferred = sip_p_preferred_identity(sip))) {
 		sip_p_preferred_identity_t *vp;
 		for (vp = ppreferred; vp; vp = vp->ppid_next) {
-			char *v = sip_header_as_string(nh->nh_home, (void *) vp);
+			char *v = sip_header_as_string(home, (void *) vp);
 			switch_channel_add_variable_var_check(channel, "sip_i_p_preferred_identity", v, SWITCH_FALSE, SWITCH_STACK_PUSH);
-			su_free(nh->nh_home, v);
+			su_free(home, v);
 		}
 	}
 
-	if ((rpid = sip_remote_party_id(sip))) {
+	if (sofia_invite_var_wanted(only, "sip_i_remote_party_id") && (rpid = sip_remote_party_id(sip))) {
 		sip_remote_party_id_t *vp;
 		for (vp = rpid; vp; vp = vp->rpid_next) {
-			char *v = sip_header_as_string(nh->nh_home, (void *) vp);
+			char *v = sip_header_as_string(home, (void *) vp);
 			switch_channel_add_variable_var_check(channel, "sip_i_remote_party_id", v, SWITCH_FALSE, SWITCH_STACK_PUSH);
-			su_free(nh->nh_home, v);
+			su_free(home, v);
 		}
 	}
 
-	if ((reply_to = sip_reply_to(sip))) {
+	if (sofia_invite_var_wanted(only, "sip_i_reply_to") && (reply_to = sip_reply_to(sip))) {
 		sip_reply_to_t *vp;
 		for (vp = reply_to; vp; vp = vp->rplyto_next) {
-			char *v = sip_header_as_string(nh->nh_home, (void *) vp);
+			char *v = sip_header_as_string(home, (void *) vp);
 			switch_channel_add_variable_var_check(channel, "sip_i_reply_to", v, SWITCH_FALSE, SWITCH_STACK_PUSH);
-			su_free(nh->nh_home, v);
+			su_free(home, v);
 		}
 	}
 
@@ -503,6 +530,11 @@ static void sofia_parse_all_invite_headers(sip_t const *sip, switch_core_session
 	for (un = sip->sip_unknown; un; un = un->un_next) {
 		if (!zstr(un->un_name) && !zstr(un->un_value)) {
 			char *parsed_name;
+
+			if (only && !sofia_invite_unknown_is_var(un->un_name, only)) {
+				continue;
+			}
+
 			if ((parsed_name = switch_mprintf("sip_i_%s", un->un_name))) {
 				char *p, *x = parsed_name;
 				switch_tolower_max(x);
@@ -517,6 +549,67 @@ static void sofia_parse_all_invite_headers(sip_t const *sip, switch_core_session
 	}
 }
 
+/**
+ * Variable resolver of channels with lazy-sip-header-vars: sets sip_full_route and,
+ * with parse-all-invite-headers, the "sip_i_" variables from the INVITE kept in
+ * tech_pvt->lazy_msg the first time they are looked up.
+ */
+static switch_status_t sofia_resolve_header_var(switch_channel_t *channel, const char *varname, void *user_data)
+{
+	private_object_t *tech_pvt = (private_object_t *) user_data;
+	su_home_t home[1] = { SU_HOME_INIT(home) };
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	sip_t const *sip;
+	char *full;
+
+	if (!tech_pvt->lazy_msg || !(sip = sip_object(tech_pvt->lazy_msg))) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!strcasecmp(varname, "sip_full_route")) {
+		if (sip->sip_route && (full = sip_header_as_string(home, (void *) sip->sip_route))) {
+			switch_channel_set_variable(channel, "sip_full_route", full);
+			status = SWITCH_STATUS_SUCCESS;
+		}
+	} else if (!strncasecmp(varname, "sip_i_", 6) && sofia_test_pflag(tech_pvt->profile, PFLAG_PARSE_ALL_INVITE_HEADERS)) {
+		sofia_parse_all_invite_headers(sip, channel, home, varname);
+		status = SWITCH_STATUS_SUCCESS;
+	}
+
+	su_home_deinit(home);
+
+	return status;
+}
+
+/**
+ * Keep the INVITE with the channel and build the header variables from it on demand,
+ * except for the eager-sip-header-vars of the profile which are set right away.
+ */
+static void sofia_set_lazy_header_vars(private_object_t *tech_pvt, sofia_dispatch_event_t *de)
+{
+	int i;
+
+	if (tech_pvt->lazy_msg || !de || !de->data->e_msg) {
+		return;
+	}
+
+	tech_pvt->lazy_msg = msg_ref_create(de->data->e_msg);
+	switch_channel_set_variable_resolver(tech_pvt->channel, sofia_resolve_header_var, tech_pvt);
+
+	for (i = 0; i < tech_pvt->profile->eager_header_var_count; i++) {
+		switch_channel_get_variable_dup(tech_pvt->channel, tech_pvt->profile->eager_header_vars[i], SWITCH_FALSE, -1);
+	}
+}
+
+void sofia_clear_lazy_header_vars(private_object_t *tech_pvt)
+{
+	if (tech_pvt->lazy_msg) {
+		switch_channel_set_variable_resolver(tech_pvt->channel, NULL, NULL);
+		msg_destroy(tech_pvt->lazy_msg);
+		tech_pvt->lazy_msg = NULL;
+	}
+}
+
 void sofia_handle_sip_i_notify(switch_core_session_t *session, int status,
 							   char const *phrase,
 							   nua_t *nua, sofia_profile_t *profile, nua_handle_t *nh, sofia_private_t *sofia_private, sip_t const *sip,
@@ -672,6 +765,7 @@ void sofia_handle_sip_i_notify(switch_core_session_t *session, int status,
 			delta = 1;
 		}
 		gw_sub_ptr->expires = switch_epoch_time_now(NULL) + delta;
+		sofia_reg_schedule_gateway(gateway, gw_sub_ptr->expires);
 	}
 
 	/* dispatch freeswitch event */
@@ -1064,7 +1158,6 @@ void sofia_update_callee_id(switch_core_session_t *session, sofia_profile_t *pro
 	const char *number = "unknown", *tmp;
 	switch_caller_profile_t *caller_profile;
 	char *dup = NULL;
-	switch_event_t *event;
 	const char *val;
 	int fs = 0, lazy = 0, att = 0;
 	const char *name_var = "callee_id_name";
@@ -1185,15 +1278,7 @@ void sofia_update_callee_id(switch_core_session_t *session, sofia_profile_t *pro
 
 	if (send) {
 
-		if (switch_event_create(&event, SWITCH_EVENT_CALL_UPDATE) == SWITCH_STATUS_SUCCESS) {
-			const char *uuid = switch_channel_get_partner_uuid(channel);
-			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Direction", "RECV");
-			if (uuid) {
-				switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Bridged-To", uuid);
-			}
-			switch_channel_event_set_data(channel, event);
-			switch_event_fire(&event);
-		}
+		switch_channel_fire_call_update(channel, "RECV", NULL, NULL);
 
 		sofia_send_callee_id(session, NULL, NULL);
 	}
@@ -1718,6 +1803,7 @@ static void our_sofia_event_callback(nua_event_t event,
 				if ((gateway = sofia_reg_find_gateway(sofia_private->gateway_name))) {
 					gateway->state = REG_STATE_FAILED;
 					gateway->failure_status = status;
+					sofia_reg_kick_gateway(gateway);
 					sofia_reg_release_gateway(gateway);
 				}
 			} else {
@@ -2546,7 +2632,6 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 
 			if (++gateway_loops >= GATEWAY_SECONDS) {
 				sofia_reg_check_gateway(profile, switch_epoch_time_now(NULL));
-				sofia_sub_check_gateway(profile, switch_epoch_time_now(NULL));
 				gateway_loops = 0;
 			}
 		}
@@ -2733,6 +2818,12 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 									 TPTAG_TLS_VERSION(profile->tls_version)),
 							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS) && profile->tls_timeout,
 									 TPTAG_TLS_TIMEOUT(profile->tls_timeout)),
+							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS),
+									 TPTAG_TLS_SESSION_CACHE(profile->tls_session_cache)),
+							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS),
+									 TPTAG_TLS_SESSION_TICKETS(profile->tls_session_tickets)),
+							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS) && profile->tls_handshake_threads,
+									 TPTAG_TLS_HANDSHAKE_THREADS(profile->tls_handshake_threads)),
 							  TAG_IF(!strchr(profile->sipip, ':'),
 									 NTATAG_UDP_MTU(65535)),
 							  TAG_IF(sofia_test_pflag(profile, PFLAG_DISABLE_SRV),
@@ -2749,6 +2840,8 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 									 TPTAG_KEEPALIVE(profile->socket_tcp_keepalive)),
 							  TAG_IF(sofia_test_pflag(profile, PFLAG_TCP_KEEPALIVE),
 									 TPTAG_KEEPALIVE(profile->tcp_keepalive)),
+							  TAG_IF(profile->udp_recv_threads,
+									 TPTAG_THRPSIZE(profile->udp_recv_threads)),
 							  NTATAG_DEFAULT_PROXY(profile->outbound_proxy),
 							  NTATAG_SERVER_RPORT(profile->server_rport_level),
 							  NTATAG_CLIENT_RPORT(profile->client_rport_level),
@@ -3010,6 +3103,7 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 	switch_core_hash_destroy(&profile->chat_hash);
 	switch_core_hash_destroy(&profile->reg_nh_hash);
 	switch_core_hash_destroy(&profile->mwi_debounce_hash);
+	sofia_reg_destroy_gateway_schedule(profile);
 
 	switch_thread_rwlock_unlock(profile->rwlock);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Write unlock %s\n", profile->name);
@@ -3933,6 +4027,7 @@ switch_status_t config_sofia(sofia_config_t reload, char *profile_name)
 
 
 					switch_mutex_init(&profile->gw_mutex, SWITCH_MUTEX_NESTED, pool);
+					switch_mutex_init(&profile->gw_sched_mutex, SWITCH_MUTEX_NESTED, pool);
 
 					profile->trans_timeout = 100;
 
@@ -3966,6 +4061,9 @@ switch_status_t config_sofia(sofia_config_t reload, char *profile_name)
 					profile->tls_version |= SOFIA_TLS_VERSION_TLSv1_1;
 					profile->tls_version |= SOFIA_TLS_VERSION_TLSv1_2;
 					profile->tls_timeout = 300;
+					profile->tls_session_cache = 20480;
+					profile->tls_session_tickets = 1;
+					profile->tls_handshake_threads = 0;
 					profile->mflags = MFLAG_REFER | MFLAG_REGISTER;
 					profile->server_rport_level = 1;
 					profile->client_rport_level = 1;
@@ -4036,6 +4134,14 @@ switch_status_t config_sofia(sofia_config_t reload, char *profile_name)
 					} else if (!strcasecmp(var, "tcp-keepalive") && !zstr(val)) {
 						profile->tcp_keepalive = atoi(val);
 						sofia_set_pflag(profile, PFLAG_TCP_KEEPALIVE);
+					} else if (!strcasecmp(var, "udp-recv-threads") && !zstr(val)) {
+						int threads = atoi(val);
+
+						if (threads >= 0 && threads <= 64) {
+							profile->udp_recv_threads = threads;
+						} else {
+							switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "udp-recv-threads must be between 0 and 64\n");
+						}
 					} else if (!strcasecmp(var, "tcp-pingpong") && !zstr(val)) {
 						profile->tcp_pingpong = atoi(val);
 						sofia_set_pflag(profile, PFLAG_TCP_PINGPONG);
@@ -4075,6 +4181,13 @@ switch_status_t config_sofia(sofia_config_t reload, char *profile_name)
 						if (profile->ireg_seconds < 0) {
 							profile->ireg_seconds = IREG_SECONDS;
 						}
+					} else if (!strcasecmp(var, "gateway-jitter")) {
+						int v = atoi(val);
+						if (v >= 0 && v <= 50) {
+							profile->gateway_jitter = (uint32_t) v;
+						} else {
+							switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "gateway-jitter must be a percentage between 0 and 50\n");
+						}
 					} else if (!strcasecmp(var, "user-agent-string")) {
 						profile->user_agent = switch_core_strdup(profile->pool, val);
 					} else if (!strcasecmp(var, "auto-restart")) {
@@ -4770,6 +4883,17 @@ switch_status_t config_sofia(sofia_config_t reload, char *profile_name)
 						} else {
 							sofia_clear_pflag(profile, PFLAG_PARSE_ALL_INVITE_HEADERS);
 						}
+					} else if (!strcasecmp(var, "lazy-sip-header-vars")) {
+						if (switch_true(val)) {
+							sofia_set_pflag(profile, PFLAG_LAZY_HEADER_VARS);
+						} else {
+							sofia_clear_pflag(profile, PFLAG_LAZY_HEADER_VARS);
+						}
+					} else if (!strcasecmp(var, "eager-sip-header-vars")) {
+						char *vars = switch_core_strdup(profile->pool, val);
+
+						profile->eager_header_var_count =
+							switch_separate_string(vars, ',', profile->eager_header_vars, SOFIA_MAX_EAGER_HEADER_VARS);
 					} else if (!strcasecmp(var, "bitpacking")) {
 						if (!strcasecmp(val, "aal2")) {
 							profile->codec_flags = SWITCH_CODEC_FLAG_AAL2;
@@ -4960,6 +5084,18 @@ switch_status_t config_sofia(sofia_config_t reload, char *profile_name)
 					} else if (!strcasecmp(var, "tls-timeout")) {
 						int v = atoi(val);
 						profile->tls_timeout = v > 0 ? (unsigned int)v : 300;
+					} else if (!strcasecmp(var, "tls-session-cache-size")) {
+						int v = atoi(val);
+						profile->tls_session_cache = v >= 0 ? (unsigned int)v : 20480;
+					} else if (!strcasecmp(var, "tls-session-tickets")) {
+						profile->tls_session_tickets = switch_true(val);
+					} else if (!strcasecmp(var, "tls-handshake-threads")) {
+						int v = atoi(val);
+						if (v >= 0 && v <= 64) {
+							profile->tls_handshake_threads = (unsigned int)v;
+						} else {
+							switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "tls-handshake-threads must be between 0 and 64\n");
+						}
 					} else if (!strcasecmp(var, "timer-T1")) {
 						int v = atoi(val);
 						if (v > 0) {
@@ -5343,9 +5479,10 @@ static void sofia_handle_sip_r_options(switch_core_session_t *session, int statu
 							  gateway->name, status, gateway->ping_min, gateway->ping_count, gateway->ping_max, sofia_gateway_status_name(gateway->status));
 		}
 
-		gateway->ping = switch_epoch_time_now(NULL) + gateway->ping_freq;
-		sofia_reg_release_gateway(gateway);
+		gateway->ping = switch_epoch_time_now(NULL) + gateway->ping_freq - sofia_reg_gateway_jitter(gateway, gateway->ping_freq);
 		gateway->pinging = 0;
+		sofia_reg_kick_gateway(gateway);
+		sofia_reg_release_gateway(gateway);
 	} else if (sofia_test_pflag(profile, PFLAG_UNREG_OPTIONS_FAIL) && (status != 200 && status != 486) &&
 			   sip && sip->sip_to && sip->sip_call_id && sip->sip_call_id->i_id && strchr(sip->sip_call_id->i_id, '_')) {
 		char *sql;
@@ -8719,6 +8856,10 @@ void sofia_handle_sip_i_invite(switch_core_session_t *session, nua_t *nua, sofia
 		}
 	}
 
+	if (sofia_test_pflag(profile, PFLAG_LAZY_HEADER_VARS)) {
+		sofia_set_lazy_header_vars(tech_pvt, de);
+	}
+
 	extract_header_vars(profile, sip, session, nh);
 
 	if (sip->sip_request->rq_url) {
@@ -9429,8 +9570,8 @@ void sofia_handle_sip_i_invite(switch_core_session_t *session, nua_t *nua, sofia
 		sofia_presence_set_chat_hash(tech_pvt, sip);
 	}
 
-	if (sofia_test_pflag(profile, PFLAG_PARSE_ALL_INVITE_HEADERS)) {
-		sofia_parse_all_invite_headers(sip, session, nh);
+	if (sofia_test_pflag(profile, PFLAG_PARSE_ALL_INVITE_HEADERS) && !tech_pvt->lazy_msg) {
+		sofia_parse_all_invite_headers(sip, channel, nh->nh_home, NULL);
 	}
 
 	if (sip->sip_to) {
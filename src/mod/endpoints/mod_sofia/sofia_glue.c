@@ -1634,6 +1634,7 @@ void sofia_glue_del_gateway(sofia_gateway_t *gp)
 		}
 
 		gp->deleted = 1;
+		sofia_reg_kick_gateway(gp);
 	}
 }
 
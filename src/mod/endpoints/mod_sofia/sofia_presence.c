@@ -4380,6 +4380,8 @@ void sofia_presence_handle_sip_r_subscribe(int status,
 		break;
 	}
 
+	sofia_reg_kick_gateway(gateway);
+
  end:
 
 	if (gateway) {
@@ -189,322 +189,517 @@ void sofia_reg_unregister(sofia_profile_t *profile)
 	switch_mutex_unlock(mod_sofia_globals.hash_mutex);
 }
 
-void sofia_sub_check_gateway(sofia_profile_t *profile, time_t now)
+static inline int sofia_reg_gateway_earlier(sofia_gateway_t const *a, sofia_gateway_t const *b)
 {
-	/* NOTE: A lot of the mechanism in place here for refreshing subscriptions is
-	 * pretty much redundant, as the sofia stack takes it upon itself to
-	 * refresh subscriptions on its own, based on the value of the Expires
-	 * header (which we control in the outgoing subscription request)
-	 */
-	sofia_gateway_t *gateway_ptr;
+	return a->sched_next < b->sched_next;
+}
 
-	switch_mutex_lock(profile->gw_mutex);
-	for (gateway_ptr = profile->gateways; gateway_ptr; gateway_ptr = gateway_ptr->next) {
-		sofia_gateway_subscription_t *gw_sub_ptr;
+static inline void sofia_reg_gateway_set(sofia_gateway_t **heap, size_t index, sofia_gateway_t *gateway)
+{
+	gateway->sched_index = index;
+	heap[index] = gateway;
+}
 
-		for (gw_sub_ptr = gateway_ptr->subscriptions; gw_sub_ptr; gw_sub_ptr = gw_sub_ptr->next) {
-			sub_state_t ostate = gw_sub_ptr->state;
+static inline void *sofia_reg_gateway_alloc(void *arg, void *memory, size_t bytes)
+{
+	if (!bytes) {
+		free(memory);
+		return NULL;
+	}
 
-			if (!now) {
-				gw_sub_ptr->state = ostate = SUB_STATE_UNSUBED;
-				gw_sub_ptr->expires_str = "0";
-			}
+	return realloc(memory, bytes);
+}
 
-			//gateway_ptr->sub_state = gw_sub_ptr->state;
+HEAP_DECLARE(static inline, sofia_gateway_heap_t, gateway_heap_, sofia_gateway_t *);
+HEAP_BODIES(static inline, sofia_gateway_heap_t, gateway_heap_, sofia_gateway_t *,
+			sofia_reg_gateway_earlier, sofia_reg_gateway_set, sofia_reg_gateway_alloc, NULL);
 
-			switch (ostate) {
-			case SUB_STATE_NOSUB:
-				break;
-			case SUB_STATE_SUBSCRIBE:
-				gw_sub_ptr->expires = now + gw_sub_ptr->freq;
-				gw_sub_ptr->state = SUB_STATE_SUBED;
-				break;
-			case SUB_STATE_UNSUBSCRIBE:
-				gw_sub_ptr->state = SUB_STATE_NOSUB;
-				sofia_reg_kill_sub(gw_sub_ptr);
-				break;
-			case SUB_STATE_UNSUBED:
+/* A random share of seconds, at most gateway-jitter percent of it. Taken off refresh and ping
+   intervals so that gateways configured alike drift apart instead of firing together. */
+uint32_t sofia_reg_gateway_jitter(sofia_gateway_t *gateway, uint32_t seconds)
+{
+	uint32_t max = (uint32_t) (((uint64_t) seconds * gateway->profile->gateway_jitter) / 100);
 
-				sofia_reg_new_sub_handle(gw_sub_ptr);
-				
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "subscribing to [%s] on gateway [%s]\n", gw_sub_ptr->event, gateway_ptr->name);
-				
-				if (now) {
-					nua_subscribe(gw_sub_ptr->nh,
-								  NUTAG_URL(gw_sub_ptr->request_uri),								  
-								  SIPTAG_EVENT_STR(gw_sub_ptr->event),
-								  TAG_IF(strcmp(gw_sub_ptr->content_type, "NO_CONTENT_TYPE"), SIPTAG_ACCEPT_STR(gw_sub_ptr->content_type)),
-								  SIPTAG_TO_STR(gateway_ptr->register_from),
-								  SIPTAG_FROM_STR(gateway_ptr->register_from),
-								  SIPTAG_CONTACT_STR(gateway_ptr->register_contact),
-								  SIPTAG_EXPIRES_STR(gw_sub_ptr->expires_str),	/* sofia stack bases its auto-refresh stuff on this */
-								  TAG_NULL());
-					gw_sub_ptr->retry = now + gw_sub_ptr->retry_seconds;
-				} else {
-					nua_unsubscribe(gw_sub_ptr->nh,									
-									NUTAG_URL(gw_sub_ptr->request_uri),
-									SIPTAG_EVENT_STR(gw_sub_ptr->event),
-									TAG_IF(strcmp(gw_sub_ptr->content_type, "NO_CONTENT_TYPE"), SIPTAG_ACCEPT_STR(gw_sub_ptr->content_type)),
-									SIPTAG_FROM_STR(gateway_ptr->register_from),
-									SIPTAG_TO_STR(gateway_ptr->register_from),
-									SIPTAG_CONTACT_STR(gateway_ptr->register_contact), SIPTAG_EXPIRES_STR(gw_sub_ptr->expires_str), TAG_NULL());
-				}
-				gw_sub_ptr->state = SUB_STATE_TRYING;
-				break;
+	return max ? (uint32_t) (rand() % (max + 1)) : 0;
+}
 
-			case SUB_STATE_FAILED:
-				gw_sub_ptr->expires = now;
-				gw_sub_ptr->retry = now + gw_sub_ptr->retry_seconds;
-				gw_sub_ptr->state = SUB_STATE_FAIL_WAIT;
-				break;
-			case SUB_STATE_FAIL_WAIT:
-				if (!gw_sub_ptr->retry || now >= gw_sub_ptr->retry) {
-					gw_sub_ptr->state = SUB_STATE_UNSUBED;
-				}
-				break;
-			case SUB_STATE_TRYING:
-				if (gw_sub_ptr->retry && now >= gw_sub_ptr->retry) {
-					gw_sub_ptr->state = SUB_STATE_UNSUBED;
-					gw_sub_ptr->retry = 0;
-				}
-				break;
-			default:
-				if (now >= gw_sub_ptr->expires) {
-					gw_sub_ptr->state = SUB_STATE_UNSUBED;
-				}
-				break;
-			}
+/* Have the worker look at the gateway no later than when, 0 means on the next tick.
+   An earlier time already scheduled is kept. */
+void sofia_reg_schedule_gateway(sofia_gateway_t *gateway, time_t when)
+{
+	sofia_profile_t *profile = gateway->profile;
 
+	switch_mutex_lock(profile->gw_sched_mutex);
+
+	if (gateway->sched_index) {
+		if (gateway->sched_next <= when) {
+			goto end;
 		}
+		gateway_heap_remove(profile->gw_sched, gateway->sched_index);
 	}
-	switch_mutex_unlock(profile->gw_mutex);
+
+	if (gateway_heap_is_full(profile->gw_sched) && gateway_heap_resize(NULL, &profile->gw_sched, 0) < 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Cannot schedule gateway %s\n", gateway->name);
+		goto end;
+	}
+
+	gateway->sched_next = when;
+	gateway_heap_add(profile->gw_sched, gateway);
+
+  end:
+
+	switch_mutex_unlock(profile->gw_sched_mutex);
 }
 
-void sofia_reg_check_gateway(sofia_profile_t *profile, time_t now)
+void sofia_reg_destroy_gateway_schedule(sofia_profile_t *profile)
 {
-	sofia_gateway_t *check, *gateway_ptr, *last = NULL;
-	switch_event_t *event;
-	int delta = 0;
+	switch_mutex_lock(profile->gw_sched_mutex);
+	gateway_heap_free(NULL, &profile->gw_sched);
+	switch_mutex_unlock(profile->gw_sched_mutex);
+}
 
-	switch_mutex_lock(profile->gw_mutex);
-	for (gateway_ptr = profile->gateways; gateway_ptr; gateway_ptr = gateway_ptr->next) {
-		if (gateway_ptr->deleted) {
-			if ((check = switch_core_hash_find(mod_sofia_globals.gateway_hash, gateway_ptr->name)) && check == gateway_ptr) {
-				char *pkey = switch_mprintf("%s::%s", profile->name, gateway_ptr->name);
-				switch_assert(pkey);
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Removing gateway %s from hash.\n", pkey);
-				switch_core_hash_delete(mod_sofia_globals.gateway_hash, pkey);
-				switch_core_hash_delete(mod_sofia_globals.gateway_hash, gateway_ptr->name);
-				free(pkey);
+static time_t sofia_reg_sooner(time_t next, time_t when)
+{
+	return !next || when < next ? when : next;
+}
+
+/* When the registration, ping or subscriptions of the gateway next need the worker, 0 if never */
+static time_t sofia_reg_gateway_next(sofia_gateway_t *gateway_ptr, time_t now)
+{
+	sofia_gateway_subscription_t *gw_sub_ptr;
+	time_t next = 0;
+
+	if (gateway_ptr->deleted) {
+		/* Keep coming back until it has unregistered and can be unlinked */
+		return now + 1;
+	}
+
+	switch (gateway_ptr->state) {
+	case REG_STATE_NOREG:
+		break;
+	case REG_STATE_TRYING:
+		next = gateway_ptr->reg_timeout;
+		break;
+	case REG_STATE_FAIL_WAIT:
+		next = gateway_ptr->retry ? gateway_ptr->retry : now;
+		break;
+	case REG_STATE_REGISTER:
+	case REG_STATE_UNREGISTER:
+	case REG_STATE_UNREGED:
+	case REG_STATE_TIMEOUT:
+	case REG_STATE_FAILED:
+		next = now;
+		break;
+	default:
+		next = gateway_ptr->expires;
+		break;
+	}
+
+	if (gateway_ptr->ping && !gateway_ptr->pinging &&
+		(gateway_ptr->state == REG_STATE_NOREG || gateway_ptr->state == REG_STATE_REGED)) {
+		next = sofia_reg_sooner(next, gateway_ptr->ping);
+	}
+
+	for (gw_sub_ptr = gateway_ptr->subscriptions; gw_sub_ptr; gw_sub_ptr = gw_sub_ptr->next) {
+		switch (gw_sub_ptr->state) {
+		case SUB_STATE_NOSUB:
+			break;
+		case SUB_STATE_TRYING:
+			if (gw_sub_ptr->retry) {
+				next = sofia_reg_sooner(next, gw_sub_ptr->retry);
 			}
-			
-			if (gateway_ptr->state == REG_STATE_NOREG) {
+			break;
+		case SUB_STATE_FAIL_WAIT:
+			next = sofia_reg_sooner(next, gw_sub_ptr->retry ? gw_sub_ptr->retry : now);
+			break;
+		case SUB_STATE_SUBSCRIBE:
+		case SUB_STATE_UNSUBSCRIBE:
+		case SUB_STATE_UNSUBED:
+		case SUB_STATE_FAILED:
+			next = sofia_reg_sooner(next, now);
+			break;
+		default:
+			next = sofia_reg_sooner(next, gw_sub_ptr->expires);
+			break;
+		}
+	}
 
-				if (last) {
-					last->next = gateway_ptr->next;
-				} else {
-					profile->gateways = gateway_ptr->next;
-				}
+	if (next && next <= now) {
+		next = now + 1;
+	}
+
+	return next;
+}
+
+static void sofia_sub_check_one_gateway(sofia_gateway_t *gateway_ptr, time_t now)
+{
+	/* NOTE: A lot of the mechanism in place here for refreshing subscriptions is
+	 * pretty much redundant, as the sofia stack takes it upon itself to
+	 * refresh subscriptions on its own, based on the value of the Expires
+	 * header (which we control in the outgoing subscription request)
+	 */
+	sofia_gateway_subscription_t *gw_sub_ptr;
+
+	for (gw_sub_ptr = gateway_ptr->subscriptions; gw_sub_ptr; gw_sub_ptr = gw_sub_ptr->next) {
+		sub_state_t ostate = gw_sub_ptr->state;
+
+		if (!now) {
+			gw_sub_ptr->state = ostate = SUB_STATE_UNSUBED;
+			gw_sub_ptr->expires_str = "0";
+		}
+
+		//gateway_ptr->sub_state = gw_sub_ptr->state;
+
+		switch (ostate) {
+		case SUB_STATE_NOSUB:
+			break;
+		case SUB_STATE_SUBSCRIBE:
+			gw_sub_ptr->expires = now + gw_sub_ptr->freq - sofia_reg_gateway_jitter(gateway_ptr, gw_sub_ptr->freq);
+			gw_sub_ptr->state = SUB_STATE_SUBED;
+			break;
+		case SUB_STATE_UNSUBSCRIBE:
+			gw_sub_ptr->state = SUB_STATE_NOSUB;
+			sofia_reg_kill_sub(gw_sub_ptr);
+			break;
+		case SUB_STATE_UNSUBED:
+
+			sofia_reg_new_sub_handle(gw_sub_ptr);
 			
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Deleted gateway %s\n", gateway_ptr->name);
-				if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, MY_EVENT_GATEWAY_DEL) == SWITCH_STATUS_SUCCESS) {
-					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "profile-name", gateway_ptr->profile->name);
-					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Gateway", gateway_ptr->name);
-					switch_event_fire(&event);
-				}
-				if (gateway_ptr->ob_vars) {
-					switch_event_destroy(&gateway_ptr->ob_vars);
-				}
-				if (gateway_ptr->ib_vars) {
-					switch_event_destroy(&gateway_ptr->ib_vars);
-				}
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "subscribing to [%s] on gateway [%s]\n", gw_sub_ptr->event, gateway_ptr->name);
+			
+			if (now) {
+				nua_subscribe(gw_sub_ptr->nh,
+							  NUTAG_URL(gw_sub_ptr->request_uri),								  
+							  SIPTAG_EVENT_STR(gw_sub_ptr->event),
+							  TAG_IF(strcmp(gw_sub_ptr->content_type, "NO_CONTENT_TYPE"), SIPTAG_ACCEPT_STR(gw_sub_ptr->content_type)),
+							  SIPTAG_TO_STR(gateway_ptr->register_from),
+							  SIPTAG_FROM_STR(gateway_ptr->register_from),
+							  SIPTAG_CONTACT_STR(gateway_ptr->register_contact),
+							  SIPTAG_EXPIRES_STR(gw_sub_ptr->expires_str),	/* sofia stack bases its auto-refresh stuff on this */
+							  TAG_NULL());
+				gw_sub_ptr->retry = now + gw_sub_ptr->retry_seconds;
 			} else {
-				last = gateway_ptr;
+				nua_unsubscribe(gw_sub_ptr->nh,									
+								NUTAG_URL(gw_sub_ptr->request_uri),
+								SIPTAG_EVENT_STR(gw_sub_ptr->event),
+								TAG_IF(strcmp(gw_sub_ptr->content_type, "NO_CONTENT_TYPE"), SIPTAG_ACCEPT_STR(gw_sub_ptr->content_type)),
+								SIPTAG_FROM_STR(gateway_ptr->register_from),
+								SIPTAG_TO_STR(gateway_ptr->register_from),
+								SIPTAG_CONTACT_STR(gateway_ptr->register_contact), SIPTAG_EXPIRES_STR(gw_sub_ptr->expires_str), TAG_NULL());
+			}
+			gw_sub_ptr->state = SUB_STATE_TRYING;
+			break;
+
+		case SUB_STATE_FAILED:
+			gw_sub_ptr->expires = now;
+			gw_sub_ptr->retry = now + gw_sub_ptr->retry_seconds;
+			gw_sub_ptr->state = SUB_STATE_FAIL_WAIT;
+			break;
+		case SUB_STATE_FAIL_WAIT:
+			if (!gw_sub_ptr->retry || now >= gw_sub_ptr->retry) {
+				gw_sub_ptr->state = SUB_STATE_UNSUBED;
 			}
-		} else {
-			last = gateway_ptr;
+			break;
+		case SUB_STATE_TRYING:
+			if (gw_sub_ptr->retry && now >= gw_sub_ptr->retry) {
+				gw_sub_ptr->state = SUB_STATE_UNSUBED;
+				gw_sub_ptr->retry = 0;
+			}
+			break;
+		default:
+			if (now >= gw_sub_ptr->expires) {
+				gw_sub_ptr->state = SUB_STATE_UNSUBED;
+			}
+			break;
 		}
+
 	}
+}
 
-	for (gateway_ptr = profile->gateways; gateway_ptr; gateway_ptr = gateway_ptr->next) {
-		reg_state_t ostate = gateway_ptr->state;
-		char *user_via = NULL;
-		char *register_host = NULL;
+/* Drop a deleted gateway from the hash, unlink it from the profile once it has unregistered */
+static void sofia_reg_check_deleted_gateway(sofia_profile_t *profile, sofia_gateway_t *gateway_ptr)
+{
+	sofia_gateway_t *check, **gpp;
+	switch_event_t *event;
 
-		if (!now) {
-			gateway_ptr->state = ostate = REG_STATE_UNREGED;
-			gateway_ptr->expires_str = "0";
+	if ((check = switch_core_hash_find(mod_sofia_globals.gateway_hash, gateway_ptr->name)) && check == gateway_ptr) {
+		char *pkey = switch_mprintf("%s::%s", profile->name, gateway_ptr->name);
+		switch_assert(pkey);
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Removing gateway %s from hash.\n", pkey);
+		switch_core_hash_delete(mod_sofia_globals.gateway_hash, pkey);
+		switch_core_hash_delete(mod_sofia_globals.gateway_hash, gateway_ptr->name);
+		free(pkey);
+	}
+	
+	if (gateway_ptr->state != REG_STATE_NOREG) {
+		return;
+	}
+
+	for (gpp = &profile->gateways; *gpp; gpp = &(*gpp)->next) {
+		if (*gpp == gateway_ptr) {
+			*gpp = gateway_ptr->next;
+			break;
 		}
+	}
 
-		if (gateway_ptr->ping && !gateway_ptr->pinging && (now >= gateway_ptr->ping && (ostate == REG_STATE_NOREG || ostate == REG_STATE_REGED)) &&
-			!gateway_ptr->deleted) {
-			nua_handle_t *nh = nua_handle(profile->nua, NULL, NUTAG_URL(gateway_ptr->register_url), TAG_END());
-			sofia_private_t *pvt;
+	switch_mutex_lock(profile->gw_sched_mutex);
+	if (gateway_ptr->sched_index) {
+		gateway_heap_remove(profile->gw_sched, gateway_ptr->sched_index);
+	}
+	switch_mutex_unlock(profile->gw_sched_mutex);
 
-			register_host = sofia_glue_get_register_host(gateway_ptr->register_proxy);
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Deleted gateway %s\n", gateway_ptr->name);
+	if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, MY_EVENT_GATEWAY_DEL) == SWITCH_STATUS_SUCCESS) {
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "profile-name", gateway_ptr->profile->name);
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Gateway", gateway_ptr->name);
+		switch_event_fire(&event);
+	}
+	if (gateway_ptr->ob_vars) {
+		switch_event_destroy(&gateway_ptr->ob_vars);
+	}
+	if (gateway_ptr->ib_vars) {
+		switch_event_destroy(&gateway_ptr->ib_vars);
+	}
+}
 
-			/* check for NAT and place a Via header if necessary (hostname or non-local IP) */
-			if (register_host && sofia_glue_check_nat(gateway_ptr->profile, register_host)) {
-				user_via = sofia_glue_create_external_via(NULL, gateway_ptr->profile, gateway_ptr->register_transport);
-			}
+static void sofia_reg_check_one_gateway(sofia_profile_t *profile, sofia_gateway_t *gateway_ptr, time_t now)
+{
+	int delta = 0;
+	reg_state_t ostate = gateway_ptr->state;
+	char *user_via = NULL;
+	char *register_host = NULL;
 
-			switch_safe_free(register_host);
+	if (!now) {
+		gateway_ptr->state = ostate = REG_STATE_UNREGED;
+		gateway_ptr->expires_str = "0";
+	}
 
-			pvt = malloc(sizeof(*pvt));
-			switch_assert(pvt);
-			memset(pvt, 0, sizeof(*pvt));
-			pvt->destroy_nh = 1;
-			pvt->destroy_me = 1;
-			switch_copy_string(pvt->gateway_name, gateway_ptr->name, sizeof(pvt->gateway_name));
-			nua_handle_bind(nh, pvt);
+	if (gateway_ptr->ping && !gateway_ptr->pinging && (now >= gateway_ptr->ping && (ostate == REG_STATE_NOREG || ostate == REG_STATE_REGED)) &&
+		!gateway_ptr->deleted) {
+		nua_handle_t *nh = nua_handle(profile->nua, NULL, NUTAG_URL(gateway_ptr->register_url), TAG_END());
+		sofia_private_t *pvt;
 
-			gateway_ptr->pinging = 1;
-			nua_options(nh,
-						TAG_IF(gateway_ptr->register_sticky_proxy, NUTAG_PROXY(gateway_ptr->register_sticky_proxy)),
-						TAG_IF(user_via, SIPTAG_VIA_STR(user_via)),
-						SIPTAG_TO_STR(gateway_ptr->options_to_uri), SIPTAG_FROM_STR(gateway_ptr->options_from_uri),
-						TAG_IF(gateway_ptr->options_user_agent, SIPTAG_USER_AGENT_STR(gateway_ptr->options_user_agent)),
-						TAG_END());
+		register_host = sofia_glue_get_register_host(gateway_ptr->register_proxy);
 
-			switch_safe_free(user_via);
-			user_via = NULL;
+		/* check for NAT and place a Via header if necessary (hostname or non-local IP) */
+		if (register_host && sofia_glue_check_nat(gateway_ptr->profile, register_host)) {
+			user_via = sofia_glue_create_external_via(NULL, gateway_ptr->profile, gateway_ptr->register_transport);
 		}
 
-		switch (ostate) {
-		case REG_STATE_NOREG:
-			if (!gateway_ptr->ping && !gateway_ptr->pinging) {
-				gateway_ptr->status = SOFIA_GATEWAY_UP;
-			}
-			break;
-		case REG_STATE_REGISTER:
-			if (profile->debug) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Registered %s\n", gateway_ptr->name);
-			}
+		switch_safe_free(register_host);
 
-			gateway_ptr->failures = 0;
+		pvt = malloc(sizeof(*pvt));
+		switch_assert(pvt);
+		memset(pvt, 0, sizeof(*pvt));
+		pvt->destroy_nh = 1;
+		pvt->destroy_me = 1;
+		switch_copy_string(pvt->gateway_name, gateway_ptr->name, sizeof(pvt->gateway_name));
+		nua_handle_bind(nh, pvt);
 
-			if (gateway_ptr->freq > 30) {
-				delta = (gateway_ptr->freq - 15);
-			} else {
-				delta = (gateway_ptr->freq / 2);
-			}
+		gateway_ptr->pinging = 1;
+		nua_options(nh,
+					TAG_IF(gateway_ptr->register_sticky_proxy, NUTAG_PROXY(gateway_ptr->register_sticky_proxy)),
+					TAG_IF(user_via, SIPTAG_VIA_STR(user_via)),
+					SIPTAG_TO_STR(gateway_ptr->options_to_uri), SIPTAG_FROM_STR(gateway_ptr->options_from_uri),
+					TAG_IF(gateway_ptr->options_user_agent, SIPTAG_USER_AGENT_STR(gateway_ptr->options_user_agent)),
+					TAG_END());
 
-			if (delta < 1) {
-				delta = 1;
-			}
-			
-			gateway_ptr->expires = now + delta;
+		switch_safe_free(user_via);
+		user_via = NULL;
+	}
 
-			gateway_ptr->state = REG_STATE_REGED;
+	switch (ostate) {
+	case REG_STATE_NOREG:
+		if (!gateway_ptr->ping && !gateway_ptr->pinging) {
 			gateway_ptr->status = SOFIA_GATEWAY_UP;
-			break;
+		}
+		break;
+	case REG_STATE_REGISTER:
+		if (profile->debug) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Registered %s\n", gateway_ptr->name);
+		}
 
-		case REG_STATE_UNREGISTER:
-			sofia_reg_kill_reg(gateway_ptr);
-			gateway_ptr->state = REG_STATE_NOREG;
+		gateway_ptr->failures = 0;
+
+		if (gateway_ptr->freq > 30) {
+			delta = (gateway_ptr->freq - 15);
+		} else {
+			delta = (gateway_ptr->freq / 2);
+		}
+
+		delta -= sofia_reg_gateway_jitter(gateway_ptr, delta);
+
+		if (delta < 1) {
+			delta = 1;
+		}
+		
+		gateway_ptr->expires = now + delta;
+
+		gateway_ptr->state = REG_STATE_REGED;
+		gateway_ptr->status = SOFIA_GATEWAY_UP;
+		break;
+
+	case REG_STATE_UNREGISTER:
+		sofia_reg_kill_reg(gateway_ptr);
+		gateway_ptr->state = REG_STATE_NOREG;
+		gateway_ptr->status = SOFIA_GATEWAY_DOWN;
+		break;
+	case REG_STATE_UNREGED:
+		gateway_ptr->retry = 0;
+
+		if (!gateway_ptr->nh) {
+			sofia_reg_new_handle(gateway_ptr, now ? 1 : 0);
+		}
+
+		register_host = sofia_glue_get_register_host(gateway_ptr->register_proxy);
+
+		/* check for NAT and place a Via header if necessary (hostname or non-local IP) */
+		if (register_host && sofia_glue_check_nat(gateway_ptr->profile, register_host)) {
+			user_via = sofia_glue_create_external_via(NULL, gateway_ptr->profile, gateway_ptr->register_transport);
+		}
+
+		switch_safe_free(register_host);
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Registering %s\n", gateway_ptr->name);
+
+		if (now) {
+			nua_register(gateway_ptr->nh,
+						 NUTAG_URL(gateway_ptr->register_url),
+						 TAG_IF(gateway_ptr->register_sticky_proxy, NUTAG_PROXY(gateway_ptr->register_sticky_proxy)),
+						 TAG_IF(user_via, SIPTAG_VIA_STR(user_via)),
+						 SIPTAG_TO_STR(gateway_ptr->distinct_to ? gateway_ptr->register_to : gateway_ptr->register_from),
+						 SIPTAG_CONTACT_STR(gateway_ptr->register_contact),
+						 SIPTAG_FROM_STR(gateway_ptr->register_from),
+						 SIPTAG_EXPIRES_STR(gateway_ptr->expires_str),
+						 NUTAG_REGISTRAR(gateway_ptr->register_proxy),
+						 NUTAG_OUTBOUND("no-options-keepalive"), NUTAG_OUTBOUND("no-validate"), NUTAG_KEEPALIVE(0), TAG_NULL());
+			gateway_ptr->retry = now + gateway_ptr->retry_seconds;
+		} else {
 			gateway_ptr->status = SOFIA_GATEWAY_DOWN;
-			break;
-		case REG_STATE_UNREGED:
-			gateway_ptr->retry = 0;
+			nua_unregister(gateway_ptr->nh,
+						   NUTAG_URL(gateway_ptr->register_url),
+						   TAG_IF(gateway_ptr->register_sticky_proxy, NUTAG_PROXY(gateway_ptr->register_sticky_proxy)),
+						   TAG_IF(user_via, SIPTAG_VIA_STR(user_via)),
+						   SIPTAG_FROM_STR(gateway_ptr->register_from),
+						   SIPTAG_TO_STR(gateway_ptr->distinct_to ? gateway_ptr->register_to : gateway_ptr->register_from),
+						   SIPTAG_EXPIRES_STR(gateway_ptr->expires_str),
+						   NUTAG_REGISTRAR(gateway_ptr->register_proxy),
+						   NUTAG_OUTBOUND("no-options-keepalive"), NUTAG_OUTBOUND("no-validate"), NUTAG_KEEPALIVE(0), TAG_NULL());
+		}
+		gateway_ptr->reg_timeout = now + gateway_ptr->reg_timeout_seconds;
+		gateway_ptr->state = REG_STATE_TRYING;
+		switch_safe_free(user_via);
+		user_via = NULL;
+		break;
+
+	case REG_STATE_TIMEOUT:
+		{
+			nua_handle_t *nh = gateway_ptr->nh;
+			
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Timeout Registering %s\n", gateway_ptr->name);
+
+			gateway_ptr->nh = NULL;
+			nua_handle_destroy(nh);
+			gateway_ptr->state = REG_STATE_FAILED;
+			gateway_ptr->failures++;
+			gateway_ptr->failure_status = 908;
+		}
+		break;
+	case REG_STATE_FAILED:
+		{
+			int sec;
 
-			if (!gateway_ptr->nh) {
-				sofia_reg_new_handle(gateway_ptr, now ? 1 : 0);
+			if (gateway_ptr->failure_status == 503 || gateway_ptr->failure_status == 908 || gateway_ptr->failures < 1) {
+				sec = gateway_ptr->retry_seconds;
+			} else {
+				sec = gateway_ptr->retry_seconds * gateway_ptr->failures;
 			}
 
-			register_host = sofia_glue_get_register_host(gateway_ptr->register_proxy);
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "%s Failed Registration [%d], setting retry to %d seconds.\n",
+							  gateway_ptr->name, gateway_ptr->failure_status, sec);
 
-			/* check for NAT and place a Via header if necessary (hostname or non-local IP) */
-			if (register_host && sofia_glue_check_nat(gateway_ptr->profile, register_host)) {
-				user_via = sofia_glue_create_external_via(NULL, gateway_ptr->profile, gateway_ptr->register_transport);
-			}
+			gateway_ptr->retry = switch_epoch_time_now(NULL) + sec;
+			gateway_ptr->status = SOFIA_GATEWAY_DOWN;
+			gateway_ptr->state = REG_STATE_FAIL_WAIT;
+			gateway_ptr->failure_status = 0;
 
-			switch_safe_free(register_host);
+		}
+		break;
+	case REG_STATE_FAIL_WAIT:
+		if (!gateway_ptr->retry || now >= gateway_ptr->retry) {
+			gateway_ptr->state = REG_STATE_UNREGED;
+		}
+		break;
+	case REG_STATE_TRYING:
+		if (now >= gateway_ptr->reg_timeout) {
+			gateway_ptr->state = REG_STATE_TIMEOUT;
+		}
+		break;
+	default:
+		if (now >= gateway_ptr->expires) {
+			gateway_ptr->state = REG_STATE_UNREGED;
+		}
+		break;
+	}
+	if (ostate != gateway_ptr->state) {
+		sofia_reg_fire_custom_gateway_state_event(gateway_ptr, 0, NULL);
+	}
+}
 
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Registering %s\n", gateway_ptr->name);
+/* Run the registration, ping and subscription state machines of the gateways that are due.
+   Gateways wait in profile->gw_sched ordered by when their state next needs attention, so a
+   tick only costs the due ones. Code changing the state of a gateway elsewhere must call
+   sofia_reg_kick_gateway(). With now == 0 every gateway is unregistered. */
+void sofia_reg_check_gateway(sofia_profile_t *profile, time_t now)
+{
+	sofia_gateway_t *gateway_ptr, *next, *due = NULL;
+	time_t when;
 
-			if (now) {
-				nua_register(gateway_ptr->nh,
-							 NUTAG_URL(gateway_ptr->register_url),
-							 TAG_IF(gateway_ptr->register_sticky_proxy, NUTAG_PROXY(gateway_ptr->register_sticky_proxy)),
-							 TAG_IF(user_via, SIPTAG_VIA_STR(user_via)),
-							 SIPTAG_TO_STR(gateway_ptr->distinct_to ? gateway_ptr->register_to : gateway_ptr->register_from),
-							 SIPTAG_CONTACT_STR(gateway_ptr->register_contact),
-							 SIPTAG_FROM_STR(gateway_ptr->register_from),
-							 SIPTAG_EXPIRES_STR(gateway_ptr->expires_str),
-							 NUTAG_REGISTRAR(gateway_ptr->register_proxy),
-							 NUTAG_OUTBOUND("no-options-keepalive"), NUTAG_OUTBOUND("no-validate"), NUTAG_KEEPALIVE(0), TAG_NULL());
-				gateway_ptr->retry = now + gateway_ptr->retry_seconds;
-			} else {
-				gateway_ptr->status = SOFIA_GATEWAY_DOWN;
-				nua_unregister(gateway_ptr->nh,
-							   NUTAG_URL(gateway_ptr->register_url),
-							   TAG_IF(gateway_ptr->register_sticky_proxy, NUTAG_PROXY(gateway_ptr->register_sticky_proxy)),
-							   TAG_IF(user_via, SIPTAG_VIA_STR(user_via)),
-							   SIPTAG_FROM_STR(gateway_ptr->register_from),
-							   SIPTAG_TO_STR(gateway_ptr->distinct_to ? gateway_ptr->register_to : gateway_ptr->register_from),
-							   SIPTAG_EXPIRES_STR(gateway_ptr->expires_str),
-							   NUTAG_REGISTRAR(gateway_ptr->register_proxy),
-							   NUTAG_OUTBOUND("no-options-keepalive"), NUTAG_OUTBOUND("no-validate"), NUTAG_KEEPALIVE(0), TAG_NULL());
-			}
-			gateway_ptr->reg_timeout = now + gateway_ptr->reg_timeout_seconds;
-			gateway_ptr->state = REG_STATE_TRYING;
-			switch_safe_free(user_via);
-			user_via = NULL;
-			break;
+	switch_mutex_lock(profile->gw_mutex);
 
-		case REG_STATE_TIMEOUT:
-			{
-				nua_handle_t *nh = gateway_ptr->nh;
-				
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Timeout Registering %s\n", gateway_ptr->name);
+	if (!now) {
+		for (gateway_ptr = profile->gateways; gateway_ptr; gateway_ptr = gateway_ptr->next) {
+			sofia_reg_check_one_gateway(profile, gateway_ptr, now);
+			sofia_sub_check_one_gateway(gateway_ptr, now);
+		}
+		switch_mutex_unlock(profile->gw_mutex);
+		return;
+	}
 
-				gateway_ptr->nh = NULL;
-				nua_handle_destroy(nh);
-				gateway_ptr->state = REG_STATE_FAILED;
-				gateway_ptr->failures++;
-				gateway_ptr->failure_status = 908;
-			}
+	switch_mutex_lock(profile->gw_sched_mutex);
+	while (gateway_heap_used(profile->gw_sched) > 0) {
+		gateway_ptr = gateway_heap_get(profile->gw_sched, 1);
+
+		if (gateway_ptr->sched_next > now) {
 			break;
-		case REG_STATE_FAILED:
-			{
-				int sec;
+		}
 
-				if (gateway_ptr->failure_status == 503 || gateway_ptr->failure_status == 908 || gateway_ptr->failures < 1) {
-					sec = gateway_ptr->retry_seconds;
-				} else {
-					sec = gateway_ptr->retry_seconds * gateway_ptr->failures;
-				}
+		gateway_heap_remove(profile->gw_sched, 1);
+		gateway_ptr->sched_due = due;
+		due = gateway_ptr;
+	}
+	switch_mutex_unlock(profile->gw_sched_mutex);
 
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "%s Failed Registration [%d], setting retry to %d seconds.\n",
-								  gateway_ptr->name, gateway_ptr->failure_status, sec);
+	for (gateway_ptr = due; gateway_ptr; gateway_ptr = next) {
+		next = gateway_ptr->sched_due;
+		gateway_ptr->sched_due = NULL;
 
-				gateway_ptr->retry = switch_epoch_time_now(NULL) + sec;
-				gateway_ptr->status = SOFIA_GATEWAY_DOWN;
-				gateway_ptr->state = REG_STATE_FAIL_WAIT;
-				gateway_ptr->failure_status = 0;
+		if (gateway_ptr->deleted) {
+			sofia_reg_check_deleted_gateway(profile, gateway_ptr);
 
+			if (gateway_ptr->state == REG_STATE_NOREG) {
+				continue;
 			}
-			break;
-		case REG_STATE_FAIL_WAIT:
-			if (!gateway_ptr->retry || now >= gateway_ptr->retry) {
-				gateway_ptr->state = REG_STATE_UNREGED;
-			}
-			break;
-		case REG_STATE_TRYING:
-			if (now >= gateway_ptr->reg_timeout) {
-				gateway_ptr->state = REG_STATE_TIMEOUT;
-			}
-			break;
-		default:
-			if (now >= gateway_ptr->expires) {
-				gateway_ptr->state = REG_STATE_UNREGED;
-			}
-			break;
 		}
-		if (ostate != gateway_ptr->state) {
-			sofia_reg_fire_custom_gateway_state_event(gateway_ptr, 0, NULL);
+
+		sofia_reg_check_one_gateway(profile, gateway_ptr, now);
+		sofia_sub_check_one_gateway(gateway_ptr, now);
+
+		if ((when = sofia_reg_gateway_next(gateway_ptr, now))) {
+			sofia_reg_schedule_gateway(gateway_ptr, when);
 		}
 	}
+
 	switch_mutex_unlock(profile->gw_mutex);
 }
 
@@ -2286,6 +2481,8 @@ void sofia_reg_handle_sip_r_register(int status,
 							  gateway->name, switch_str_nil(phrase), status, ++gateway->failures);
 			break;
 		}
+		sofia_reg_kick_gateway(gateway);
+
 		if (ostate != gateway->state) {
 			sofia_reg_fire_custom_gateway_state_event(gateway, status, phrase);
 		}
@@ -3032,6 +3229,7 @@ auth_res_t sofia_reg_parse_auth(sofia_profile_t *profile,
 									} else {
 										gateway_ptr->state = REG_STATE_UNREGISTER;
 									}
+									sofia_reg_kick_gateway(gateway_ptr);
 									if (ostate != gateway_ptr->state) {
 										sofia_reg_fire_custom_gateway_state_event(gateway_ptr, 0, NULL);
 									}
@@ -3058,6 +3256,7 @@ auth_res_t sofia_reg_parse_auth(sofia_profile_t *profile,
 								} else {
 									gateway_ptr->state = REG_STATE_UNREGISTER;
 								}
+								sofia_reg_kick_gateway(gateway_ptr);
 								if (ostate != gateway_ptr->state) {
 									sofia_reg_fire_custom_gateway_state_event(gateway_ptr, 0, NULL);
 								}
@@ -3212,6 +3411,7 @@ switch_status_t sofia_reg_add_gateway(sofia_profile_t *profile, const char *key,
 	switch_status_t status = SWITCH_STATUS_FALSE;
 	char *pkey = switch_mprintf("%s::%s", profile->name, key);
 	sofia_gateway_t *gp;
+	uint32_t delay;
 
 	switch_mutex_lock(profile->gw_mutex);
 
@@ -3220,6 +3420,17 @@ switch_status_t sofia_reg_add_gateway(sofia_profile_t *profile, const char *key,
 	
 	switch_mutex_unlock(profile->gw_mutex);
 
+	/* Spread the first register and ping of gateways loaded together, the register by no more than a retry interval */
+	if (gateway->ping) {
+		gateway->ping -= sofia_reg_gateway_jitter(gateway, gateway->ping_freq);
+	}
+
+	if ((delay = sofia_reg_gateway_jitter(gateway, gateway->freq)) > (uint32_t) gateway->retry_seconds) {
+		delay = gateway->retry_seconds;
+	}
+
+	sofia_reg_schedule_gateway(gateway, switch_epoch_time_now(NULL) + delay);
+
 	switch_mutex_lock(mod_sofia_globals.hash_mutex);
 
 	if ((gp = switch_core_hash_find(mod_sofia_globals.gateway_hash, key))) {
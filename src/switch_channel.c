@@ -175,9 +175,30 @@ struct switch_channel {
 	switch_hold_record_t *hold_record;
 	switch_device_node_t *device_node;
 	char *device_id;
+	switch_channel_variable_resolver_t var_resolver;
+	void *var_resolver_data;
+	switch_mutex_t *watcher_mutex;
+	switch_channel_watcher_t watcher;
+	void *watcher_data;
+	char *callee_direction;
+	char *sent_callee_id_name;
+	char *sent_callee_id_number;
 };
 
 static void process_device_hup(switch_channel_t *channel);
+
+static void switch_channel_notify_watcher(switch_channel_t *channel)
+{
+	if (!channel->watcher) {
+		return;
+	}
+
+	switch_mutex_lock(channel->watcher_mutex);
+	if (channel->watcher) {
+		channel->watcher(channel, channel->watcher_data);
+	}
+	switch_mutex_unlock(channel->watcher_mutex);
+}
 static void switch_channel_check_device_state(switch_channel_t *channel, switch_channel_callstate_t callstate);
 
 SWITCH_DECLARE(switch_hold_record_t *) switch_channel_get_hold_record(switch_channel_t *channel)
@@ -288,6 +309,8 @@ SWITCH_DECLARE(void) switch_channel_perform_set_callstate(switch_channel_t *chan
 		switch_channel_event_set_data(channel, event);
 		switch_event_fire(&event);
 	}
+
+	switch_channel_notify_watcher(channel);
 }
 
 SWITCH_DECLARE(switch_channel_callstate_t) switch_channel_get_callstate(switch_channel_t *channel)
@@ -425,6 +448,7 @@ SWITCH_DECLARE(switch_status_t) switch_channel_alloc(switch_channel_t **channel,
 	switch_mutex_init(&(*channel)->state_mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_mutex_init(&(*channel)->thread_mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_mutex_init(&(*channel)->profile_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_mutex_init(&(*channel)->watcher_mutex, SWITCH_MUTEX_NESTED, pool);
 	(*channel)->hangup_cause = SWITCH_CAUSE_NONE;
 	(*channel)->name = "";
 	(*channel)->direction = (*channel)->logical_direction = direction;
@@ -918,7 +942,18 @@ SWITCH_DECLARE(const char *) switch_channel_get_variable_dup(switch_channel_t *c
 		}
 	}
 
-	if (!v && (!channel->variables || !(v = switch_event_get_header_idx(channel->variables, varname, idx)))) {
+	if (!v && channel->variables && !(v = switch_event_get_header_idx(channel->variables, varname, idx)) && channel->var_resolver) {
+		switch_channel_variable_resolver_t resolver = channel->var_resolver;
+
+		/* cleared while running so lookups made by the resolver itself cannot recurse */
+		channel->var_resolver = NULL;
+		if (resolver(channel, varname, channel->var_resolver_data) == SWITCH_STATUS_SUCCESS) {
+			v = switch_event_get_header_idx(channel->variables, varname, idx);
+		}
+		channel->var_resolver = resolver;
+	}
+
+	if (!v) {
 		switch_caller_profile_t *cp = switch_channel_get_caller_profile(channel);
 
 		if (cp) {
@@ -951,6 +986,57 @@ SWITCH_DECLARE(const char *) switch_channel_get_variable_dup(switch_channel_t *c
 	return r;
 }
 
+SWITCH_DECLARE(const char *) switch_channel_get_variable_pdup(switch_channel_t *channel, const char *varname, switch_memory_pool_t *pool)
+{
+	const char *v = NULL;
+	char *r = NULL;
+	switch_assert(channel != NULL);
+
+	switch_mutex_lock(channel->profile_mutex);
+
+	if (channel->scope_variables) {
+		switch_event_t *ep;
+
+		for (ep = channel->scope_variables; ep; ep = ep->next) {
+			if ((v = switch_event_get_header(ep, varname))) {
+				break;
+			}
+		}
+	}
+
+	if (!v && channel->variables) {
+		v = switch_event_get_header(channel->variables, varname);
+	}
+
+	if (v) {
+		r = switch_core_strdup(pool, v);
+	}
+
+	switch_mutex_unlock(channel->profile_mutex);
+
+	return r;
+}
+
+SWITCH_DECLARE(void) switch_channel_set_variable_resolver(switch_channel_t *channel, switch_channel_variable_resolver_t resolver, void *user_data)
+{
+	switch_assert(channel != NULL);
+
+	switch_mutex_lock(channel->profile_mutex);
+	channel->var_resolver = resolver;
+	channel->var_resolver_data = user_data;
+	switch_mutex_unlock(channel->profile_mutex);
+}
+
+SWITCH_DECLARE(void) switch_channel_set_watcher(switch_channel_t *channel, switch_channel_watcher_t watcher, void *user_data)
+{
+	switch_assert(channel != NULL);
+
+	switch_mutex_lock(channel->watcher_mutex);
+	channel->watcher = watcher;
+	channel->watcher_data = user_data;
+	switch_mutex_unlock(channel->watcher_mutex);
+}
+
 SWITCH_DECLARE(const char *) switch_channel_get_variable_partner(switch_channel_t *channel, const char *varname)
 {
 	const char *uuid;
@@ -2191,6 +2277,8 @@ SWITCH_DECLARE(switch_channel_state_t) switch_channel_perform_set_running_state(
 
 	switch_mutex_unlock(channel->state_mutex);
 
+	switch_channel_notify_watcher(channel);
+
 	return (switch_channel_state_t) SWITCH_STATUS_SUCCESS;
 }
 
@@ -2412,6 +2500,11 @@ SWITCH_DECLARE(switch_channel_state_t) switch_channel_perform_set_state(switch_c
   done:
 
 	switch_mutex_unlock(channel->state_mutex);
+
+	if (ok) {
+		switch_channel_notify_watcher(channel);
+	}
+
 	return channel->state;
 }
 
@@ -2614,14 +2707,73 @@ SWITCH_DECLARE(void) switch_channel_event_set_extended_data(switch_channel_t *ch
 }
 
 
+static char *call_update_strdup(switch_channel_t *channel, char *old, const char *new)
+{
+	if (zstr(new)) {
+		return NULL;
+	}
+
+	if (old && !strcmp(old, new)) {
+		return old;
+	}
+
+	return switch_core_session_strdup(channel->session, new);
+}
+
 SWITCH_DECLARE(void) switch_channel_event_set_data(switch_channel_t *channel, switch_event_t *event)
 {
 	switch_mutex_lock(channel->profile_mutex);
+
+	if (event->event_id == SWITCH_EVENT_CALL_UPDATE) {
+		/* show channels/calls report the last update from here, no matter who raised it */
+		channel->callee_direction = call_update_strdup(channel, channel->callee_direction, switch_event_get_header(event, "Direction"));
+		channel->sent_callee_id_name = call_update_strdup(channel, channel->sent_callee_id_name, switch_event_get_header(event, "Sent-Callee-ID-Name"));
+		channel->sent_callee_id_number =
+			call_update_strdup(channel, channel->sent_callee_id_number, switch_event_get_header(event, "Sent-Callee-ID-Number"));
+	}
+
 	switch_channel_event_set_basic_data(channel, event);
 	switch_channel_event_set_extended_data(channel, event);
 	switch_mutex_unlock(channel->profile_mutex);
 }
 
+SWITCH_DECLARE(void) switch_channel_fire_call_update(switch_channel_t *channel, const char *direction, const char *sent_name, const char *sent_number)
+{
+	switch_event_t *event;
+	const char *uuid;
+
+	if (switch_event_create(&event, SWITCH_EVENT_CALL_UPDATE) != SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Direction", direction);
+
+	if (sent_name) {
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Sent-Callee-ID-Name", sent_name);
+	}
+
+	if (sent_number) {
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Sent-Callee-ID-Number", sent_number);
+	}
+
+	if ((uuid = switch_channel_get_partner_uuid(channel))) {
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Bridged-To", uuid);
+	}
+
+	switch_channel_event_set_data(channel, event);
+	switch_event_fire(&event);
+}
+
+SWITCH_DECLARE(void) switch_channel_get_call_update(switch_channel_t *channel, switch_memory_pool_t *pool,
+													const char **direction, const char **sent_name, const char **sent_number)
+{
+	switch_mutex_lock(channel->profile_mutex);
+	*direction = channel->callee_direction ? switch_core_strdup(pool, channel->callee_direction) : NULL;
+	*sent_name = channel->sent_callee_id_name ? switch_core_strdup(pool, channel->sent_callee_id_name) : NULL;
+	*sent_number = channel->sent_callee_id_number ? switch_core_strdup(pool, channel->sent_callee_id_number) : NULL;
+	switch_mutex_unlock(channel->profile_mutex);
+}
+
 SWITCH_DECLARE(void) switch_channel_step_caller_profile(switch_channel_t *channel)
 {
 	switch_caller_profile_t *cp;
@@ -3009,7 +3161,6 @@ SWITCH_DECLARE(void) switch_channel_invert_cid(switch_channel_t *channel)
 
 SWITCH_DECLARE(void) switch_channel_flip_cid(switch_channel_t *channel)
 {
-	switch_event_t *event;
 	const char *tmp = NULL;
 
 	switch_mutex_lock(channel->profile_mutex);
@@ -3040,16 +3191,7 @@ SWITCH_DECLARE(void) switch_channel_flip_cid(switch_channel_t *channel)
 	switch_mutex_unlock(channel->profile_mutex);
 
 
-	if (switch_event_create(&event, SWITCH_EVENT_CALL_UPDATE) == SWITCH_STATUS_SUCCESS) {
-		const char *uuid = switch_channel_get_partner_uuid(channel);
-		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Direction", "RECV");
-
-		if (uuid) {
-			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Bridged-To", uuid);
-		}
-		switch_channel_event_set_data(channel, event);
-		switch_event_fire(&event);
-	}
+	switch_channel_fire_call_update(channel, "RECV", NULL, NULL);
 
 
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(channel->session), SWITCH_LOG_INFO, "%s Flipping CID from \"%s\" <%s> to \"%s\" <%s>\n", 
@@ -3215,6 +3357,7 @@ SWITCH_DECLARE(switch_channel_state_t) switch_channel_perform_hangup(switch_chan
 		switch_core_session_kill_channel(channel->session, SWITCH_SIG_KILL);
 		switch_core_session_signal_state_change(channel->session);
 		switch_core_session_hangup_state(channel->session, SWITCH_FALSE);
+		switch_channel_notify_watcher(channel);
 	}
 
 	return channel->state;
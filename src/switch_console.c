@@ -651,48 +651,31 @@ SWITCH_DECLARE_NONSTD(switch_status_t) switch_console_list_interfaces(const char
 }
 #endif
 
-static int uuid_callback(void *pArg, int argc, char **argv, char **columnNames)
-{
-	struct match_helper *h = (struct match_helper *) pArg;
-
-	switch_console_push_match(&h->my_matches, argv[0]);
-	return 0;
-
-}
-
 SWITCH_DECLARE_NONSTD(switch_status_t) switch_console_list_uuid(const char *line, const char *cursor, switch_console_callback_match_t **matches)
 {
-	char *sql;
-	struct match_helper h = { 0 };
-	switch_cache_db_handle_t *db = NULL;
-	switch_status_t status = SWITCH_STATUS_FALSE;
-	char *errmsg;
+	switch_console_callback_match_t *all, *my_matches = NULL;
+	switch_console_callback_match_node_t *m;
+	switch_size_t len = zstr(cursor) ? 0 : strlen(cursor);
 
-
-	if (switch_core_db_handle(&db) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Database Error\n");
-		return SWITCH_STATUS_GENERR;
+	/* straight from the session table, the channels table may not be maintained */
+	if (!(all = switch_core_session_findall())) {
+		return SWITCH_STATUS_FALSE;
 	}
 
-	if (!zstr(cursor)) {
-		sql = switch_mprintf("select distinct uuid from channels where uuid like '%q%%' and hostname='%q' order by uuid",
-							 cursor, switch_core_get_switchname());
-	} else {
-		sql = switch_mprintf("select distinct uuid from channels where hostname='%q' order by uuid", switch_core_get_switchname());
+	for (m = all->head; m; m = m->next) {
+		if (!len || !strncasecmp(m->val, cursor, len)) {
+			switch_console_push_match(&my_matches, m->val);
+		}
 	}
 
-	switch_cache_db_execute_sql_callback(db, sql, uuid_callback, &h, &errmsg);
-	free(sql);
+	switch_console_free_matches(&all);
 
-	switch_cache_db_release_db_handle(&db);
-
-	if (h.my_matches) {
-		*matches = h.my_matches;
-		status = SWITCH_STATUS_SUCCESS;
+	if (my_matches) {
+		*matches = my_matches;
+		return SWITCH_STATUS_SUCCESS;
 	}
 
-
-	return status;
+	return SWITCH_STATUS_FALSE;
 }
 
 
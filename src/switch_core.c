@@ -1701,6 +1701,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 	switch_load_core_config("switch.conf");
 
 	switch_core_state_machine_init(runtime.memory_pool);
+	switch_ivr_phrase_init(runtime.memory_pool);
 
 	if (switch_core_sqldb_start(runtime.memory_pool, switch_test_flag((&runtime), SCF_USE_SQL) ? SWITCH_TRUE : SWITCH_FALSE) != SWITCH_STATUS_SUCCESS) {
 		*err = "Error activating database";
@@ -1883,6 +1884,18 @@ static void switch_load_core_config(const char *file)
 					} else {
 						switch_clear_flag((&runtime), SCF_SESSION_THREAD_POOL);
 					}
+				} else if (!strcasecmp(var, "session-thread-release")) {
+					if (switch_true(val)) {
+						switch_set_flag((&runtime), SCF_SESSION_THREAD_RELEASE);
+					} else {
+						switch_clear_flag((&runtime), SCF_SESSION_THREAD_RELEASE);
+					}
+				} else if (!strcasecmp(var, "core-db-channels")) {
+					if (switch_true(val)) {
+						switch_clear_flag((&runtime), SCF_NO_CHANNEL_SQL);
+					} else {
+						switch_set_flag((&runtime), SCF_NO_CHANNEL_SQL);
+					}
 				} else if (!strcasecmp(var, "auto-clear-sql")) {
 					if (switch_true(val)) {
 						switch_set_flag((&runtime), SCF_CLEAR_SQL);
@@ -2628,6 +2641,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 	if (switch_test_flag((&runtime), SCF_USE_AUTO_NAT)) {
 		switch_nat_shutdown();
 	}
+	switch_ivr_phrase_shutdown();
 	switch_xml_destroy();
 	switch_console_shutdown();
 	switch_channel_global_uninit();
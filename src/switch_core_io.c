@@ -746,20 +746,27 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 			switch_media_bug_t *bp;
 			switch_bool_t ok = SWITCH_TRUE;
 			int prune = 0;
+			uint32_t tapped;
 			switch_thread_rwlock_rdlock(session->bug_rwlock);
 
+			/* Copied once for all the bugs, each reads it through its own cursor */
+			tapped = switch_core_media_tap_write(session, SWITCH_MEDIA_TAP_READ, read_frame->data, read_frame->datalen);
+
 			for (bp = session->bugs; bp; bp = bp->next) {
 				ok = SWITCH_TRUE;
 
 				if (switch_channel_test_flag(session->channel, CF_PAUSE_BUGS) && !switch_core_media_bug_test_flag(bp, SMBF_NO_PAUSE)) {
+					switch_core_media_tap_skip(bp, SWITCH_MEDIA_TAP_READ, tapped);
 					continue;
 				}
 
 				if (!switch_channel_test_flag(session->channel, CF_ANSWERED) && switch_core_media_bug_test_flag(bp, SMBF_ANSWER_REQ)) {
+					switch_core_media_tap_skip(bp, SWITCH_MEDIA_TAP_READ, tapped);
 					continue;
 				}
 
 				if (!switch_channel_test_flag(session->channel, CF_BRIDGED) && switch_core_media_bug_test_flag(bp, SMBF_BRIDGE_REQ)) {
+					switch_core_media_tap_skip(bp, SWITCH_MEDIA_TAP_READ, tapped);
 					continue;
 				}
 
@@ -769,22 +776,24 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 				}
 
 				if (ok && bp->ready && switch_test_flag(bp, SMBF_READ_STREAM)) {
-					switch_mutex_lock(bp->read_mutex);
-					if (bp->read_demux_frame) {
-						uint8_t data[SWITCH_RECOMMENDED_BUFFER_SIZE];
-						int bytes = read_frame->datalen / 2;
-
-						memcpy(data, read_frame->data, read_frame->datalen);
-						switch_unmerge_sln((int16_t *)data, bytes, bp->read_demux_frame->data, bytes);
-						switch_buffer_write(bp->raw_read_buffer, data, read_frame->datalen);
-					} else {
-						switch_buffer_write(bp->raw_read_buffer, read_frame->data, read_frame->datalen);
+					if (bp->raw_read_buffer) {
+						switch_mutex_lock(bp->read_mutex);
+						if (bp->read_demux_frame) {
+							uint8_t data[SWITCH_RECOMMENDED_BUFFER_SIZE];
+							int bytes = read_frame->datalen / 2;
+
+							memcpy(data, read_frame->data, read_frame->datalen);
+							switch_unmerge_sln((int16_t *)data, bytes, bp->read_demux_frame->data, bytes);
+							switch_buffer_write(bp->raw_read_buffer, data, read_frame->datalen);
+						} else {
+							switch_buffer_write(bp->raw_read_buffer, read_frame->data, read_frame->datalen);
+						}
+						switch_mutex_unlock(bp->read_mutex);
 					}
 
 					if (bp->callback) {
 						ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_READ);
 					}
-					switch_mutex_unlock(bp->read_mutex);
 				}
 
 				if ((bp->stop_time && bp->stop_time <= switch_epoch_time_now(NULL)) || ok == SWITCH_FALSE) {
@@ -1307,20 +1316,27 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 	if (session->bugs) {
 		switch_media_bug_t *bp;
 		int prune = 0;
+		uint32_t tapped;
 
 		switch_thread_rwlock_rdlock(session->bug_rwlock);
+
+		tapped = switch_core_media_tap_write(session, SWITCH_MEDIA_TAP_WRITE, write_frame->data, write_frame->datalen);
+
 		for (bp = session->bugs; bp; bp = bp->next) {
 			switch_bool_t ok = SWITCH_TRUE;
 
 			if (!bp->ready) {
+				switch_core_media_tap_skip(bp, SWITCH_MEDIA_TAP_WRITE, tapped);
 				continue;
 			}
 
 			if (switch_channel_test_flag(session->channel, CF_PAUSE_BUGS) && !switch_core_media_bug_test_flag(bp, SMBF_NO_PAUSE)) {
+				switch_core_media_tap_skip(bp, SWITCH_MEDIA_TAP_WRITE, tapped);
 				continue;
 			}
 
 			if (!switch_channel_test_flag(session->channel, CF_ANSWERED) && switch_core_media_bug_test_flag(bp, SMBF_ANSWER_REQ)) {
+				switch_core_media_tap_skip(bp, SWITCH_MEDIA_TAP_WRITE, tapped);
 				continue;
 			}
 
@@ -1330,10 +1346,6 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 			}
 
 			if (switch_test_flag(bp, SMBF_WRITE_STREAM)) {
-				switch_mutex_lock(bp->write_mutex);
-				switch_buffer_write(bp->raw_write_buffer, write_frame->data, write_frame->datalen);
-				switch_mutex_unlock(bp->write_mutex);
-				
 				if (bp->callback) {
 					ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_WRITE);
 				}
@@ -35,18 +35,164 @@
 #include "switch.h"
 #include "private/switch_core_pvt.h"
 
+#define MAX_BUG_BUFFER 1024 * 512
+
+/* Called with the bug_rwlock of the session write locked, the tap lives as long as the session */
+static void media_tap_create(switch_core_session_t *session)
+{
+	switch_media_tap_t *tap;
+	switch_codec_implementation_t impl = { 0 };
+	uint32_t size, want;
+	int i;
+
+	if (session->media_tap) {
+		return;
+	}
+
+	tap = switch_core_session_alloc(session, sizeof(*tap));
+
+	for (i = 0; i < 2; i++) {
+		if (i == SWITCH_MEDIA_TAP_READ) {
+			switch_core_session_get_read_impl(session, &impl);
+		} else {
+			switch_core_session_get_write_impl(session, &impl);
+		}
+
+		/* A power of 2 holding a few seconds, enough for a bug pre buffering or read from another thread */
+		want = impl.decoded_bytes_per_packet * SWITCH_MEDIA_TAP_FRAMES;
+		for (size = SWITCH_RECOMMENDED_BUFFER_SIZE * 4; size < want; size <<= 1);
+
+		tap->ring[i].size = size;
+		tap->ring[i].data = switch_core_session_alloc(session, size);
+	}
+
+	switch_mutex_init(&tap->view_mutex, SWITCH_MUTEX_NESTED, session->pool);
+
+	session->media_tap = tap;
+}
+
+static void media_tap_attach(switch_media_bug_t *bug, switch_media_tap_dir_t dir)
+{
+	switch_media_tap_ring_t *ring;
+
+	if (bug->tap_attached[dir] || !bug->session->media_tap) {
+		return;
+	}
+
+	ring = &bug->session->media_tap->ring[dir];
+
+	switch_atomic_set(&bug->tap_pos[dir], switch_atomic_read(&ring->head));
+	bug->tap_attached[dir] = 1;
+	switch_atomic_inc(&ring->readers);
+}
+
+static void media_tap_detach(switch_media_bug_t *bug, switch_media_tap_dir_t dir)
+{
+	if (!bug->tap_attached[dir]) {
+		return;
+	}
+
+	bug->tap_attached[dir] = 0;
+	switch_atomic_dec(&bug->session->media_tap->ring[dir].readers);
+}
+
+/* Bytes waiting for the bug. One fallen so far behind that the writer is about to lap it starts over with what comes next. */
+static uint32_t media_tap_inuse(switch_media_bug_t *bug, switch_media_tap_dir_t dir)
+{
+	switch_media_tap_ring_t *ring = &bug->session->media_tap->ring[dir];
+	uint32_t head = switch_atomic_read(&ring->head);
+	uint32_t inuse = head - switch_atomic_read(&bug->tap_pos[dir]);
+
+	if (inuse > ring->size - SWITCH_RECOMMENDED_BUFFER_SIZE) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(bug->session), SWITCH_LOG_DEBUG, "%s media bug %s fell %u bytes behind, skipping them\n",
+						  switch_channel_get_name(bug->session->channel), bug->function, inuse);
+		switch_atomic_set(&bug->tap_pos[dir], head);
+		return 0;
+	}
+
+	return inuse;
+}
+
+static switch_bool_t media_tap_read(switch_media_bug_t *bug, switch_media_tap_dir_t dir, void *data, uint32_t datalen)
+{
+	switch_media_tap_ring_t *ring = &bug->session->media_tap->ring[dir];
+	uint32_t pos = switch_atomic_read(&bug->tap_pos[dir]);
+	uint32_t off = pos & (ring->size - 1);
+	uint32_t part = ring->size - off;
+
+	if (part > datalen) {
+		part = datalen;
+	}
+
+	memcpy(data, ring->data + off, part);
+	if (part < datalen) {
+		memcpy((uint8_t *) data + part, ring->data, datalen - part);
+	}
+
+	/* The writer never waits, make sure it didn't overwrite what was just copied */
+	if (switch_atomic_read(&ring->head) - pos > ring->size - SWITCH_RECOMMENDED_BUFFER_SIZE) {
+		switch_atomic_set(&bug->tap_pos[dir], switch_atomic_read(&ring->head));
+		return SWITCH_FALSE;
+	}
+
+	switch_atomic_add(&bug->tap_pos[dir], datalen);
+
+	return SWITCH_TRUE;
+}
+
+/* Copy a frame into the tap once for all the bugs reading it, called by the only thread doing this direction of I/O.
+   Returns the bytes added to the tap. */
+uint32_t switch_core_media_tap_write(switch_core_session_t *session, switch_media_tap_dir_t dir, const void *data, uint32_t datalen)
+{
+	switch_media_tap_ring_t *ring;
+	uint32_t off, part;
+
+	if (!session->media_tap || !datalen || datalen > SWITCH_RECOMMENDED_BUFFER_SIZE) {
+		return 0;
+	}
+
+	ring = &session->media_tap->ring[dir];
+
+	if (!switch_atomic_read(&ring->readers)) {
+		return 0;
+	}
+
+	off = switch_atomic_read(&ring->head) & (ring->size - 1);
+	part = ring->size - off;
+
+	if (part > datalen) {
+		part = datalen;
+	}
+
+	memcpy(ring->data + off, data, part);
+	if (part < datalen) {
+		memcpy(ring->data, (const uint8_t *) data + part, datalen - part);
+	}
+
+	switch_atomic_add(&ring->head, datalen);
+
+	return datalen;
+}
+
+/* A bug not taking this frame (paused, not answered yet...) steps over it */
+void switch_core_media_tap_skip(switch_media_bug_t *bug, switch_media_tap_dir_t dir, uint32_t datalen)
+{
+	if (datalen && bug->tap_attached[dir]) {
+		switch_atomic_add(&bug->tap_pos[dir], datalen);
+	}
+}
+
 static void switch_core_media_bug_destroy(switch_media_bug_t *bug)
 {
 	switch_event_t *event = NULL;
 
+	media_tap_detach(bug, SWITCH_MEDIA_TAP_READ);
+	media_tap_detach(bug, SWITCH_MEDIA_TAP_WRITE);
+
 	if (bug->raw_read_buffer) {
 		switch_buffer_destroy(&bug->raw_read_buffer);
 	}
 
-	if (bug->raw_write_buffer) {
-		switch_buffer_destroy(&bug->raw_write_buffer);
-	}
-
 	if (switch_event_create(&event, SWITCH_EVENT_MEDIA_BUG_STOP) == SWITCH_STATUS_SUCCESS) {
 		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Media-Bug-Function", "%s", bug->function);
 		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Media-Bug-Target", "%s", bug->target);
@@ -75,11 +221,28 @@ SWITCH_DECLARE(uint32_t) switch_core_media_bug_set_flag(switch_media_bug_t *bug,
 	if ((flag & SMBF_PRUNE)) {
 		switch_clear_flag(bug, SMBF_LOCK);
 	}
+
+	if ((flag & SMBF_READ_STREAM) && !bug->raw_read_buffer) {
+		media_tap_attach(bug, SWITCH_MEDIA_TAP_READ);
+	}
+
+	if ((flag & SMBF_WRITE_STREAM)) {
+		media_tap_attach(bug, SWITCH_MEDIA_TAP_WRITE);
+	}
+
 	return switch_set_flag(bug, flag);
 }
 
 SWITCH_DECLARE(uint32_t) switch_core_media_bug_clear_flag(switch_media_bug_t *bug, uint32_t flag)
 {
+	if ((flag & SMBF_READ_STREAM)) {
+		media_tap_detach(bug, SWITCH_MEDIA_TAP_READ);
+	}
+
+	if ((flag & SMBF_WRITE_STREAM)) {
+		media_tap_detach(bug, SWITCH_MEDIA_TAP_WRITE);
+	}
+
 	return switch_clear_flag(bug, flag);
 }
 
@@ -120,7 +283,19 @@ SWITCH_DECLARE(void) switch_core_media_bug_set_read_replace_frame(switch_media_b
 
 SWITCH_DECLARE(void) switch_core_media_bug_set_read_demux_frame(switch_media_bug_t *bug, switch_frame_t *frame)
 {
+	switch_mutex_lock(bug->read_mutex);
+
+	/* What the bug reads is no longer what the others read, give it a buffer of its own */
+	if (frame && !bug->raw_read_buffer) {
+		switch_size_t bytes = bug->read_impl.decoded_bytes_per_packet;
+
+		switch_buffer_create_dynamic(&bug->raw_read_buffer, bytes * SWITCH_BUFFER_BLOCK_FRAMES, bytes * SWITCH_BUFFER_START_FRAMES, MAX_BUG_BUFFER);
+		media_tap_detach(bug, SWITCH_MEDIA_TAP_READ);
+	}
+
 	bug->read_demux_frame = frame;
+
+	switch_mutex_unlock(bug->read_mutex);
 }
 
 SWITCH_DECLARE(void *) switch_core_media_bug_get_user_data(switch_media_bug_t *bug)
@@ -139,10 +314,12 @@ SWITCH_DECLARE(void) switch_core_media_bug_flush(switch_media_bug_t *bug)
 		switch_mutex_unlock(bug->read_mutex);
 	}
 
-	if (bug->raw_write_buffer) {
-		switch_mutex_lock(bug->write_mutex);
-		switch_buffer_zero(bug->raw_write_buffer);
-		switch_mutex_unlock(bug->write_mutex);
+	if (bug->tap_attached[SWITCH_MEDIA_TAP_READ]) {
+		switch_atomic_set(&bug->tap_pos[SWITCH_MEDIA_TAP_READ], switch_atomic_read(&bug->session->media_tap->ring[SWITCH_MEDIA_TAP_READ].head));
+	}
+
+	if (bug->tap_attached[SWITCH_MEDIA_TAP_WRITE]) {
+		switch_atomic_set(&bug->tap_pos[SWITCH_MEDIA_TAP_WRITE], switch_atomic_read(&bug->session->media_tap->ring[SWITCH_MEDIA_TAP_WRITE].head));
 	}
 
 	bug->record_frame_size = 0;
@@ -153,16 +330,18 @@ SWITCH_DECLARE(void) switch_core_media_bug_inuse(switch_media_bug_t *bug, switch
 {
 	if (switch_test_flag(bug, SMBF_READ_STREAM)) {
 		switch_mutex_lock(bug->read_mutex);
-		*readp = bug->raw_read_buffer ? switch_buffer_inuse(bug->raw_read_buffer) : 0;
+		if (bug->raw_read_buffer) {
+			*readp = switch_buffer_inuse(bug->raw_read_buffer);
+		} else {
+			*readp = bug->tap_attached[SWITCH_MEDIA_TAP_READ] ? media_tap_inuse(bug, SWITCH_MEDIA_TAP_READ) : 0;
+		}
 		switch_mutex_unlock(bug->read_mutex);
 	} else {
 		*readp = 0;
 	}
 
 	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
-		switch_mutex_lock(bug->write_mutex);
-		*writep = bug->raw_write_buffer ? switch_buffer_inuse(bug->raw_write_buffer) : 0;
-		switch_mutex_unlock(bug->write_mutex);
+		*writep = bug->tap_attached[SWITCH_MEDIA_TAP_WRITE] ? media_tap_inuse(bug, SWITCH_MEDIA_TAP_WRITE) : 0;
 	} else {
 		*writep = 0;
 	}
@@ -187,6 +366,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 	int16_t *tp;
 	switch_size_t do_read = 0, do_write = 0;
 	int fill_read = 0, fill_write = 0;
+	switch_media_tap_t *tap = bug->session->media_tap;
+	switch_media_tap_view_t *view = NULL;
+	uint32_t read_pos = 0, write_pos = 0;
 
 
 	switch_core_session_get_read_impl(bug->session, &read_impl);
@@ -199,11 +381,12 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 		return SWITCH_STATUS_FALSE;
 	}
 
-	if ((!bug->raw_read_buffer && (!bug->raw_write_buffer || !switch_test_flag(bug, SMBF_WRITE_STREAM)))) {
+	if (!bug->raw_read_buffer && !bug->tap_attached[SWITCH_MEDIA_TAP_READ] &&
+		(!bug->tap_attached[SWITCH_MEDIA_TAP_WRITE] || !switch_test_flag(bug, SMBF_WRITE_STREAM))) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(switch_core_media_bug_get_session(bug)), SWITCH_LOG_ERROR, 
-				"%s Buffer Error (raw_read_buffer=%p, raw_write_buffer=%p, read=%s, write=%s)\n",
+				"%s Buffer Error (raw_read_buffer=%p, read tap=%d, write tap=%d, read=%s, write=%s)\n",
 			        switch_channel_get_name(bug->session->channel),
-				(void *)bug->raw_read_buffer, (void *)bug->raw_write_buffer, 
+				(void *)bug->raw_read_buffer, bug->tap_attached[SWITCH_MEDIA_TAP_READ], bug->tap_attached[SWITCH_MEDIA_TAP_WRITE],
 				switch_test_flag(bug, SMBF_READ_STREAM) ? "yes" : "no",
 				switch_test_flag(bug, SMBF_WRITE_STREAM) ? "yes" : "no");
 		return SWITCH_STATUS_FALSE;
@@ -213,15 +396,17 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 	frame->datalen = 0;
 
 	if (switch_test_flag(bug, SMBF_READ_STREAM)) {
-		switch_mutex_lock(bug->read_mutex);
-		do_read = switch_buffer_inuse(bug->raw_read_buffer);
-		switch_mutex_unlock(bug->read_mutex);
+		if (bug->raw_read_buffer) {
+			switch_mutex_lock(bug->read_mutex);
+			do_read = switch_buffer_inuse(bug->raw_read_buffer);
+			switch_mutex_unlock(bug->read_mutex);
+		} else if (bug->tap_attached[SWITCH_MEDIA_TAP_READ]) {
+			do_read = media_tap_inuse(bug, SWITCH_MEDIA_TAP_READ);
+		}
 	}
 
-	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
-		switch_mutex_lock(bug->write_mutex);
-		do_write = switch_buffer_inuse(bug->raw_write_buffer);
-		switch_mutex_unlock(bug->write_mutex);
+	if (switch_test_flag(bug, SMBF_WRITE_STREAM) && bug->tap_attached[SWITCH_MEDIA_TAP_WRITE]) {
+		do_write = media_tap_inuse(bug, SWITCH_MEDIA_TAP_WRITE);
 	}
 
 	if (bug->record_frame_size && bug->record_pre_buffer_max && (do_read || do_write) && bug->record_pre_buffer_count < bug->record_pre_buffer_max) {
@@ -289,33 +474,73 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 	if (do_write && do_write > SWITCH_RECOMMENDED_BUFFER_SIZE) {
 		do_write = 1280;
 	}
+
+	if (bug->tap_attached[SWITCH_MEDIA_TAP_READ]) {
+		read_pos = switch_atomic_read(&bug->tap_pos[SWITCH_MEDIA_TAP_READ]);
+	}
+
+	if (bug->tap_attached[SWITCH_MEDIA_TAP_WRITE]) {
+		write_pos = switch_atomic_read(&bug->tap_pos[SWITCH_MEDIA_TAP_WRITE]);
+	}
+
+	/* Bugs reading the same audio the same way get the same frame, have it mixed only once */
+	if (!bug->raw_read_buffer) {
+		int layout = 0;
+
+		if (switch_test_flag(bug, SMBF_STEREO)) {
+			layout = switch_test_flag(bug, SMBF_STEREO_SWAP) ? 2 : 1;
+		}
+
+		view = &tap->views[layout];
+
+		if (switch_mutex_trylock(tap->view_mutex) == SWITCH_STATUS_SUCCESS) {
+			if (view->valid && view->bytes == bytes && view->read_pos == read_pos && view->read_len == do_read &&
+				view->write_pos == write_pos && view->write_len == do_write) {
+				memcpy(frame->data, view->data, view->datalen);
+				switch_mutex_unlock(tap->view_mutex);
+
+				if (do_read) {
+					switch_atomic_add(&bug->tap_pos[SWITCH_MEDIA_TAP_READ], (uint32_t) do_read);
+				}
+
+				if (do_write) {
+					switch_atomic_add(&bug->tap_pos[SWITCH_MEDIA_TAP_WRITE], (uint32_t) do_write);
+				}
+
+				view = NULL;
+				goto mixed;
+			}
+			switch_mutex_unlock(tap->view_mutex);
+		}
+	}
 	
 	if (do_read) {
-		switch_mutex_lock(bug->read_mutex);
-		frame->datalen = (uint32_t) switch_buffer_read(bug->raw_read_buffer, frame->data, do_read);
+		if (bug->raw_read_buffer) {
+			switch_mutex_lock(bug->read_mutex);
+			frame->datalen = (uint32_t) switch_buffer_read(bug->raw_read_buffer, frame->data, do_read);
+			switch_mutex_unlock(bug->read_mutex);
+		} else if (media_tap_read(bug, SWITCH_MEDIA_TAP_READ, frame->data, (uint32_t) do_read)) {
+			frame->datalen = (uint32_t) do_read;
+		}
+
 		if (frame->datalen != do_read) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(switch_core_media_bug_get_session(bug)), SWITCH_LOG_ERROR, "Framing Error Reading!\n");
 			switch_core_media_bug_flush(bug);
-			switch_mutex_unlock(bug->read_mutex);
 			return SWITCH_STATUS_FALSE;
 		}
-		switch_mutex_unlock(bug->read_mutex);
 	} else if (fill_read) {
 		frame->datalen = (uint32_t)bytes;
 		memset(frame->data, 255, frame->datalen);
 	}
 
 	if (do_write) {
-		switch_assert(bug->raw_write_buffer);
-		switch_mutex_lock(bug->write_mutex);
-		datalen = (uint32_t) switch_buffer_read(bug->raw_write_buffer, bug->data, do_write);
-		if (datalen != do_write) {
+		if (media_tap_read(bug, SWITCH_MEDIA_TAP_WRITE, bug->data, (uint32_t) do_write)) {
+			datalen = do_write;
+		} else {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(switch_core_media_bug_get_session(bug)), SWITCH_LOG_ERROR, "Framing Error Writing!\n");
 			switch_core_media_bug_flush(bug);
-			switch_mutex_unlock(bug->write_mutex);
 			return SWITCH_STATUS_FALSE;
 		}
-		switch_mutex_unlock(bug->write_mutex);
 	} else if (fill_write) {
 		datalen = bytes;
 		memset(bug->data, 255, datalen);
@@ -380,6 +605,20 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 		}
 	}
 
+	if (view && switch_mutex_trylock(tap->view_mutex) == SWITCH_STATUS_SUCCESS) {
+		view->datalen = (uint32_t) (switch_test_flag(bug, SMBF_STEREO) ? bytes * 2 : bytes);
+		memcpy(view->data, frame->data, view->datalen);
+		view->bytes = (uint32_t) bytes;
+		view->read_pos = read_pos;
+		view->read_len = (uint32_t) do_read;
+		view->write_pos = write_pos;
+		view->write_len = (uint32_t) do_write;
+		view->valid = 1;
+		switch_mutex_unlock(tap->view_mutex);
+	}
+
+ mixed:
+
 	frame->datalen = (uint32_t)bytes;
 	frame->samples = (uint32_t)(bytes / sizeof(int16_t));
 	frame->rate = read_impl.actual_samples_per_second;
@@ -399,7 +638,6 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 	return SWITCH_STATUS_SUCCESS;
 }
 
-#define MAX_BUG_BUFFER 1024 * 512
 SWITCH_DECLARE(switch_status_t) switch_core_media_bug_add(switch_core_session_t *session,
 														  const char *function,
 														  const char *target,
@@ -409,7 +647,6 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_add(switch_core_session_t
 														  switch_media_bug_t **new_bug)
 {
 	switch_media_bug_t *bug, *bp;
-	switch_size_t bytes;
 	switch_event_t *event;
 	int tap_only = 1, punt = 0;
 
@@ -497,23 +734,13 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_add(switch_core_session_t
 	}
 	
 	bug->stop_time = stop_time;
-	bytes = bug->read_impl.decoded_bytes_per_packet;
 
 	if (!bug->flags) {
 		bug->flags = (SMBF_READ_STREAM | SMBF_WRITE_STREAM);
 	}
 
-	if (switch_test_flag(bug, SMBF_READ_STREAM) || switch_test_flag(bug, SMBF_READ_PING)) {
-		switch_buffer_create_dynamic(&bug->raw_read_buffer, bytes * SWITCH_BUFFER_BLOCK_FRAMES, bytes * SWITCH_BUFFER_START_FRAMES, MAX_BUG_BUFFER);
-		switch_mutex_init(&bug->read_mutex, SWITCH_MUTEX_NESTED, session->pool);
-	}
-
-	bytes = bug->write_impl.decoded_bytes_per_packet;
-
-	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
-		switch_buffer_create_dynamic(&bug->raw_write_buffer, bytes * SWITCH_BUFFER_BLOCK_FRAMES, bytes * SWITCH_BUFFER_START_FRAMES, MAX_BUG_BUFFER);
-		switch_mutex_init(&bug->write_mutex, SWITCH_MUTEX_NESTED, session->pool);
-	}
+	/* The streams themselves are read from the session's media tap once the bug is attached */
+	switch_mutex_init(&bug->read_mutex, SWITCH_MUTEX_NESTED, session->pool);
 
 	if ((bug->flags & SMBF_THREAD_LOCK)) {
 		bug->thread_id = switch_thread_self();
@@ -532,6 +759,18 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_add(switch_core_session_t
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Attaching BUG to %s\n", switch_channel_get_name(session->channel));
 	bug->ready = 1;
 	switch_thread_rwlock_wrlock(session->bug_rwlock);
+
+	/* Even for a bug not reading the streams yet, switch_core_media_bug_set_flag() may have it start */
+	media_tap_create(session);
+
+	if (switch_test_flag(bug, SMBF_READ_STREAM) && !bug->raw_read_buffer) {
+		media_tap_attach(bug, SWITCH_MEDIA_TAP_READ);
+	}
+
+	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
+		media_tap_attach(bug, SWITCH_MEDIA_TAP_WRITE);
+	}
+
 	bug->next = session->bugs;
 	session->bugs = bug;
 
@@ -35,14 +35,35 @@
 #include <switch.h>
 #include "private/switch_core_pvt.h"
 
+/* How long a freed port rests before it is handed out again, so late packets of the
+   previous call do not land on the next one */
+#define PORT_QUARANTINE_USEC 2000000
+
+typedef enum {
+	PORT_FREE,
+	PORT_USED,
+	PORT_QUARANTINED
+} port_state_t;
+
 struct switch_core_port_allocator {
 	char *ip;
 	switch_port_t start;
 	switch_port_t end;
 	switch_port_t next;
-	int8_t *track;
+	uint32_t step;
+	/* state of each port by index */
+	uint8_t *track;
 	uint32_t track_len;
 	uint32_t track_used;
+	/* indexes of the free ports, in no particular order */
+	uint32_t *free_list;
+	uint32_t free_len;
+	/* freed ports waiting out their quarantine, oldest first */
+	uint32_t *quarantine;
+	switch_time_t *quarantine_until;
+	uint32_t quarantine_head;
+	uint32_t quarantine_len;
+	uint32_t seed;
 	switch_port_flag_t flags;
 	switch_mutex_t *mutex;
 	switch_memory_pool_t *pool;
@@ -55,6 +76,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_new(const char *ip, s
 	switch_memory_pool_t *pool;
 	switch_core_port_allocator_t *alloc;
 	int even, odd;
+	uint32_t index;
 
 	if ((status = switch_core_new_memory_pool(&pool)) != SWITCH_STATUS_SUCCESS) {
 		return status;
@@ -92,16 +114,30 @@ SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_new(const char *ip, s
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Rounding even end port %d to %d\n", end, end - 1);
 				end--;
 			}
+		} else if ((start % 2) != 0) {
+			/* no parity asked for still hands out even ports */
+			start--;
 		}
 	}
 
-	alloc->track_len = (end - start) + 2;
+	if (end < start) {
+		end = start;
+	}
 
-	if (!(even && odd)) {
-		alloc->track_len /= 2;
+	alloc->step = (even && odd) ? 1 : 2;
+	alloc->track_len = ((end - start) / alloc->step) + 1;
+
+	alloc->track = switch_core_alloc(pool, alloc->track_len * sizeof(*alloc->track));
+	alloc->free_list = switch_core_alloc(pool, alloc->track_len * sizeof(*alloc->free_list));
+	alloc->quarantine = switch_core_alloc(pool, alloc->track_len * sizeof(*alloc->quarantine));
+	alloc->quarantine_until = switch_core_alloc(pool, alloc->track_len * sizeof(*alloc->quarantine_until));
+
+	for (index = 0; index < alloc->track_len; index++) {
+		alloc->free_list[index] = index;
 	}
+	alloc->free_len = alloc->track_len;
 
-	alloc->track = switch_core_alloc(pool, (alloc->track_len + 2) * sizeof(switch_byte_t));
+	alloc->seed = (uint32_t) ((intptr_t) alloc + switch_micro_time_now()) | 1;
 
 	alloc->start = start;
 	alloc->next = start;
@@ -140,69 +176,108 @@ static switch_bool_t test_port(switch_core_port_allocator_t *alloc, int family,
 	return r;
 }
 
-SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_request_port(switch_core_port_allocator_t *alloc, switch_port_t *port_ptr)
+/* xorshift, only there to keep the next port hard to guess; called with the mutex held */
+static uint32_t port_random(switch_core_port_allocator_t *alloc)
 {
-	switch_port_t port = 0;
-	switch_status_t status = SWITCH_STATUS_FALSE;
-	int even = switch_test_flag(alloc, SPF_EVEN);
-	int odd = switch_test_flag(alloc, SPF_ODD);
+	uint32_t x = alloc->seed;
 
-	switch_mutex_lock(alloc->mutex);
-	srand((unsigned) ((unsigned) (intptr_t) port_ptr + (unsigned) (intptr_t) switch_thread_self() + switch_micro_time_now()));
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
 
-	while (alloc->track_used < alloc->track_len) {
-		uint32_t index;
-		uint32_t tries = 0;
+	return alloc->seed = x;
+}
 
-		/* randomly pick a port */
-		index = rand() % alloc->track_len;
+static void quarantine_port(switch_core_port_allocator_t *alloc, uint32_t index)
+{
+	uint32_t tail = (alloc->quarantine_head + alloc->quarantine_len) % alloc->track_len;
 
-		/* if it is used walk up the list to find a free one */
-		while (alloc->track[index] && tries < alloc->track_len) {
-			tries++;
-			if (alloc->track[index] < 0) {
-				alloc->track[index]++;
-			}
-			if (++index >= alloc->track_len) {
-				index = 0;
-			}
-		}
+	alloc->track[index] = PORT_QUARANTINED;
+	alloc->quarantine[tail] = index;
+	alloc->quarantine_until[tail] = switch_micro_time_now() + PORT_QUARANTINE_USEC;
+	alloc->quarantine_len++;
+}
 
-		if (tries < alloc->track_len) {
-			switch_bool_t r = SWITCH_TRUE;
+static uint32_t unquarantine_port(switch_core_port_allocator_t *alloc)
+{
+	uint32_t index = alloc->quarantine[alloc->quarantine_head];
 
-			if ((even && odd)) {
-				port = (switch_port_t) (index + alloc->start);
-			} else {
-				port = (switch_port_t) (index + (alloc->start / 2));
-				port *= 2;
-			}
+	alloc->quarantine_head = (alloc->quarantine_head + 1) % alloc->track_len;
+	alloc->quarantine_len--;
 
-			if ((alloc->flags & SPF_ROBUST_UDP)) {
-				r = test_port(alloc, AF_INET, SOCK_DGRAM, port);
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "UDP port robustness check for port %d %s\n", port, r ? "pass" : "fail");
-			}
+	return index;
+}
 
-			if ((alloc->flags & SPF_ROBUST_TCP)) {
-				r = test_port(alloc, AF_INET, SOCK_STREAM, port);
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "TCP port robustness check for port %d %s\n", port, r ? "pass" : "fail");
-			}
+/* Take a port off the free list at random. Ports whose quarantine is over go back on the
+   list first, and when nothing else is left the port resting the longest is used early. */
+static switch_bool_t take_port(switch_core_port_allocator_t *alloc, uint32_t *index_ptr)
+{
+	switch_time_t now = switch_micro_time_now();
+	uint32_t pick;
 
-			if (r) {
-				alloc->track[index] = 1;
-				alloc->track_used++;
-				status = SWITCH_STATUS_SUCCESS;
-				goto end;
-			} else {
-				alloc->track[index] = -4;
-			}
-		}
+	while (alloc->quarantine_len && alloc->quarantine_until[alloc->quarantine_head] <= now) {
+		uint32_t index = unquarantine_port(alloc);
+
+		alloc->track[index] = PORT_FREE;
+		alloc->free_list[alloc->free_len++] = index;
+	}
+
+	if (alloc->free_len) {
+		pick = port_random(alloc) % alloc->free_len;
+		*index_ptr = alloc->free_list[pick];
+		alloc->free_list[pick] = alloc->free_list[--alloc->free_len];
+	} else if (alloc->quarantine_len) {
+		*index_ptr = unquarantine_port(alloc);
+	} else {
+		return SWITCH_FALSE;
 	}
 
+	alloc->track[*index_ptr] = PORT_USED;
+	alloc->track_used++;
 
-  end:
+	return SWITCH_TRUE;
+}
 
-	switch_mutex_unlock(alloc->mutex);
+SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_request_port(switch_core_port_allocator_t *alloc, switch_port_t *port_ptr)
+{
+	switch_port_t port = 0;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	uint32_t index, tries;
+
+	for (tries = 0; tries < alloc->track_len; tries++) {
+		switch_bool_t r = SWITCH_TRUE;
+
+		switch_mutex_lock(alloc->mutex);
+		r = take_port(alloc, &index);
+		switch_mutex_unlock(alloc->mutex);
+
+		if (!r) {
+			break;
+		}
+
+		port = (switch_port_t) (alloc->start + index * alloc->step);
+
+		/* the port is ours now, so the bind tests can run without holding up the other callers */
+		if ((alloc->flags & SPF_ROBUST_UDP)) {
+			r = test_port(alloc, AF_INET, SOCK_DGRAM, port);
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "UDP port robustness check for port %d %s\n", port, r ? "pass" : "fail");
+		}
+
+		if ((alloc->flags & SPF_ROBUST_TCP)) {
+			r = test_port(alloc, AF_INET, SOCK_STREAM, port);
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "TCP port robustness check for port %d %s\n", port, r ? "pass" : "fail");
+		}
+
+		if (r) {
+			status = SWITCH_STATUS_SUCCESS;
+			break;
+		}
+
+		switch_mutex_lock(alloc->mutex);
+		alloc->track_used--;
+		quarantine_port(alloc, index);
+		switch_mutex_unlock(alloc->mutex);
+	}
 
 	if (status == SWITCH_STATUS_SUCCESS) {
 		*port_ptr = port;
@@ -218,24 +293,18 @@ SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_request_port(switch_c
 SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_free_port(switch_core_port_allocator_t *alloc, switch_port_t port)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
-	int even = switch_test_flag(alloc, SPF_EVEN);
-	int odd = switch_test_flag(alloc, SPF_ODD);
-	int index;
+	uint32_t index;
 
-	if (port < alloc->start) {
+	if (port < alloc->start || port > alloc->end || (port - alloc->start) % alloc->step) {
 		return SWITCH_STATUS_GENERR;
 	}
 
-	index = port - alloc->start;
-
-	if (!(even && odd)) {
-		index /= 2;
-	}
+	index = (port - alloc->start) / alloc->step;
 
 	switch_mutex_lock(alloc->mutex);
-	if (alloc->track[index] > 0) {
-		alloc->track[index] = -4;
+	if (alloc->track[index] == PORT_USED) {
 		alloc->track_used--;
+		quarantine_port(alloc, index);
 		status = SWITCH_STATUS_SUCCESS;
 	}
 	switch_mutex_unlock(alloc->mutex);
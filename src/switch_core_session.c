@@ -409,6 +409,341 @@ SWITCH_DECLARE(switch_console_callback_match_t *) switch_core_session_findall(vo
 	return my_matches;
 }
 
+static const char *channel_row_names[] = {
+	"uuid", "direction", "created", "created_epoch", "name", "state", "cid_name", "cid_num", "ip_addr", "dest",
+	"application", "application_data", "dialplan", "context", "read_codec", "read_rate", "read_bit_rate",
+	"write_codec", "write_rate", "write_bit_rate", "secure", "hostname", "presence_id", "presence_data", "callstate",
+	"callee_name", "callee_num", "callee_direction", "call_uuid", "sent_callee_name", "sent_callee_num"
+};
+
+#define CHANNEL_ROW_COLS (sizeof(channel_row_names) / sizeof(channel_row_names[0]))
+
+/* Columns of the basic_calls view, as offsets into channel_row_names */
+static const int basic_call_a_cols[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 22, 23, 24, 25, 26, 27, 28, 21, 29, 30 };
+static const int basic_call_b_cols[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 22, 23, 24, 25, 26, 27, 29, 30 };
+
+#define COLS_OF(_a) ((int) (sizeof(_a) / sizeof(_a[0])))
+
+typedef struct {
+	switch_core_session_t *session;
+	switch_core_session_t *partner;
+	switch_time_t sort_key;
+	switch_bool_t listed;
+} channel_row_entry_t;
+
+/* Case insensitive SQL LIKE, % matches any run of characters and _ any single one */
+static switch_bool_t channel_row_like(const char *str, const char *pattern)
+{
+	if (!str) {
+		return SWITCH_FALSE;
+	}
+
+	for (; *pattern; pattern++, str++) {
+		if (*pattern == '%') {
+			while (*pattern == '%') {
+				pattern++;
+			}
+
+			if (!*pattern) {
+				return SWITCH_TRUE;
+			}
+
+			for (; *str; str++) {
+				if (channel_row_like(str, pattern)) {
+					return SWITCH_TRUE;
+				}
+			}
+
+			return SWITCH_FALSE;
+		}
+
+		if (!*str || (*pattern != '_' && switch_tolower(*pattern) != switch_tolower(*str))) {
+			return SWITCH_FALSE;
+		}
+	}
+
+	return *str == '\0';
+}
+
+static switch_bool_t channel_row_match(switch_core_session_t *session, const char *like, switch_memory_pool_t *pool)
+{
+	switch_channel_t *channel = session->channel;
+	switch_caller_profile_t *cp = switch_channel_get_caller_profile(channel);
+	const char *presence_data;
+
+	if (channel_row_like(session->uuid_str, like) || channel_row_like(switch_channel_get_name(channel), like)) {
+		return SWITCH_TRUE;
+	}
+
+	if (cp && (channel_row_like(cp->caller_id_name, like) || channel_row_like(cp->caller_id_number, like))) {
+		return SWITCH_TRUE;
+	}
+
+	presence_data = switch_channel_get_variable_pdup(channel, "presence_data", pool);
+
+	return channel_row_like(presence_data, like);
+}
+
+static int channel_row_cmp(const void *a, const void *b)
+{
+	const channel_row_entry_t *ea = (const channel_row_entry_t *) a, *eb = (const channel_row_entry_t *) b;
+
+	return ea->sort_key < eb->sort_key ? -1 : (ea->sort_key > eb->sort_key ? 1 : 0);
+}
+
+static void channel_row_fill(switch_core_session_t *session, switch_memory_pool_t *pool, char **row)
+{
+	switch_channel_t *channel = session->channel;
+	switch_caller_profile_t *cp = switch_channel_get_caller_profile(channel);
+	switch_codec_implementation_t impl = { 0 };
+	switch_time_t created = 0;
+	const char *v, *dir, *sent_name, *sent_number;
+
+	memset(row, 0, CHANNEL_ROW_COLS * sizeof(*row));
+
+	row[0] = session->uuid_str;
+	row[1] = switch_channel_direction(channel) == SWITCH_CALL_DIRECTION_OUTBOUND ? "outbound" : "inbound";
+
+	if (cp && cp->times) {
+		created = cp->times->created;
+	}
+
+	if (created) {
+		switch_time_exp_t tm;
+		switch_size_t retsize;
+		char date[80] = "";
+
+		switch_time_exp_lt(&tm, created);
+		switch_strftime_nocheck(date, &retsize, sizeof(date), "%Y-%m-%d %T", &tm);
+		row[2] = switch_core_strdup(pool, date);
+		row[3] = switch_core_sprintf(pool, "%ld", (long) (created / 1000000));
+	}
+
+	row[4] = switch_channel_get_name(channel);
+	row[5] = (char *) switch_channel_state_name(switch_channel_get_running_state(channel));
+
+	if (cp) {
+		row[6] = (char *) cp->caller_id_name;
+		row[7] = (char *) cp->caller_id_number;
+		row[8] = (char *) cp->network_addr;
+		row[9] = (char *) cp->destination_number;
+		row[12] = (char *) cp->dialplan;
+		row[13] = (char *) cp->context;
+		row[25] = (char *) cp->callee_id_name;
+		row[26] = (char *) cp->callee_id_number;
+	}
+
+	row[10] = (char *) switch_channel_get_variable_pdup(channel, SWITCH_CURRENT_APPLICATION_VARIABLE, pool);
+	row[11] = (char *) switch_channel_get_variable_pdup(channel, SWITCH_CURRENT_APPLICATION_DATA_VARIABLE, pool);
+
+	if (switch_core_session_get_read_impl(session, &impl) == SWITCH_STATUS_SUCCESS && impl.iananame) {
+		row[14] = switch_core_strdup(pool, impl.iananame);
+		row[15] = switch_core_sprintf(pool, "%u", impl.actual_samples_per_second);
+		row[16] = switch_core_sprintf(pool, "%d", impl.bits_per_second);
+	}
+
+	memset(&impl, 0, sizeof(impl));
+
+	if (switch_core_session_get_write_impl(session, &impl) == SWITCH_STATUS_SUCCESS && impl.iananame) {
+		row[17] = switch_core_strdup(pool, impl.iananame);
+		row[18] = switch_core_sprintf(pool, "%u", impl.actual_samples_per_second);
+		row[19] = switch_core_sprintf(pool, "%d", impl.bits_per_second);
+	}
+
+	row[20] = (char *) switch_channel_get_variable_pdup(channel, "secure_type", pool);
+	row[21] = (char *) switch_core_get_switchname();
+	row[22] = (char *) switch_channel_get_variable_pdup(channel, "presence_id", pool);
+	row[23] = (char *) switch_channel_get_variable_pdup(channel, "presence_data", pool);
+	row[24] = (char *) switch_channel_callstate2str(switch_channel_get_callstate(channel));
+	switch_channel_get_call_update(channel, pool, &dir, &sent_name, &sent_number);
+	row[27] = (char *) dir;
+
+	if (!(v = switch_channel_get_variable_pdup(channel, "call_uuid", pool))) {
+		v = session->uuid_str;
+	}
+	row[28] = (char *) v;
+
+	row[29] = (char *) sent_name;
+	row[30] = (char *) sent_number;
+}
+
+/* The bridged partner for a call row, looked up among the collected sessions.
+   SWITCH_FALSE if the session is the b leg of a call listed under its partner. */
+static switch_bool_t channel_row_call_leg(switch_core_session_t *session, switch_hash_t *collected, switch_core_session_t **partner)
+{
+	switch_channel_t *channel = session->channel;
+	switch_core_session_t *other;
+	const char *uuid;
+
+	*partner = NULL;
+
+	if (!switch_channel_test_flag(channel, CF_BRIDGED) || !(uuid = switch_channel_get_partner_uuid(channel))) {
+		return SWITCH_TRUE;
+	}
+
+	if (!(other = (switch_core_session_t *) switch_core_hash_find(collected, uuid))) {
+		return SWITCH_TRUE;
+	}
+
+	if (switch_channel_test_flag(channel, CF_BRIDGE_ORIGINATOR) ||
+		(!switch_channel_test_flag(other->channel, CF_BRIDGE_ORIGINATOR) && strcmp(session->uuid_str, other->uuid_str) < 0)) {
+		*partner = other;
+		return SWITCH_TRUE;
+	}
+
+	return SWITCH_FALSE;
+}
+
+SWITCH_DECLARE(uint32_t) switch_core_session_channel_rows(switch_channel_rows_t type, const char *like,
+														  switch_core_db_callback_func_t callback, void *pArg)
+{
+	switch_hash_index_t *hi;
+	void *val;
+	switch_core_session_t *session;
+	channel_row_entry_t *entries;
+	switch_memory_pool_t *pool = NULL;
+	switch_hash_t *collected = NULL;
+	uint32_t i, n = 0, total = 0;
+	int calls = type != SCR_CHANNELS, detailed = type == SCR_DETAILED_CALLS || type == SCR_DETAILED_BRIDGED_CALLS;
+	int bridged_only = type == SCR_BRIDGED_CALLS || type == SCR_DETAILED_BRIDGED_CALLS;
+	const int *a_cols = basic_call_a_cols, *b_cols = basic_call_b_cols;
+	int a_count = COLS_OF(basic_call_a_cols), b_count = COLS_OF(basic_call_b_cols);
+	char **names = NULL, **argv = NULL, *a_row[CHANNEL_ROW_COLS], *b_row[CHANNEL_ROW_COLS];
+	int argc = 0, x, stop = 0;
+
+	if (zstr(like)) {
+		like = NULL;
+	}
+
+	switch_mutex_lock(runtime.session_hash_mutex);
+
+	if (!callback && !calls && !like) {
+		total = session_manager.session_count;
+		switch_mutex_unlock(runtime.session_hash_mutex);
+		return total;
+	}
+
+	switch_zmalloc(entries, sizeof(*entries) * (session_manager.session_count + 1));
+
+	if (!calls && like && !strchr(like, '%') && !strchr(like, '_') && (session = switch_core_hash_find(session_manager.session_table, like))) {
+		/* an exact uuid, no need to look at the others */
+		if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
+			entries[n++].session = session;
+		}
+		like = NULL;
+	} else {
+		for (hi = switch_core_hash_first(session_manager.session_table); hi; hi = switch_core_hash_next(hi)) {
+			switch_core_hash_this(hi, NULL, NULL, &val);
+			if ((session = (switch_core_session_t *) val) && switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
+				entries[n++].session = session;
+			}
+		}
+	}
+
+	switch_mutex_unlock(runtime.session_hash_mutex);
+
+	/* Everything below runs without the session table locked, the collected sessions are read locked instead
+	   and stay so until the end, partners of call rows are picked among them */
+	switch_core_new_memory_pool(&pool);
+
+	if (calls) {
+		switch_core_hash_init(&collected);
+
+		for (i = 0; i < n; i++) {
+			switch_core_hash_insert(collected, entries[i].session->uuid_str, entries[i].session);
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		channel_row_entry_t *e = &entries[i];
+		switch_caller_profile_t *cp = switch_channel_get_caller_profile(e->session->channel);
+
+		if ((like && !channel_row_match(e->session, like, pool)) ||
+			(calls && (!channel_row_call_leg(e->session, collected, &e->partner) || (bridged_only && !e->partner)))) {
+			continue;
+		}
+
+		if (cp && cp->times) {
+			e->sort_key = type == SCR_CALLS ? (e->partner ? cp->times->bridged : 0) : cp->times->created;
+		}
+
+		e->listed = SWITCH_TRUE;
+		total++;
+	}
+
+	if (collected) {
+		switch_core_hash_destroy(&collected);
+	}
+
+	if (callback) {
+		qsort(entries, n, sizeof(*entries), channel_row_cmp);
+
+		if (!calls) {
+			argc = CHANNEL_ROW_COLS;
+			names = (char **) channel_row_names;
+		} else {
+			if (detailed) {
+				a_count = b_count = CHANNEL_ROW_COLS;
+				a_cols = b_cols = NULL;
+			}
+
+			argc = a_count + b_count + 1;
+			names = switch_core_alloc(pool, sizeof(*names) * argc);
+			argv = switch_core_alloc(pool, sizeof(*argv) * argc);
+
+			for (x = 0; x < a_count; x++) {
+				names[x] = (char *) channel_row_names[a_cols ? a_cols[x] : x];
+			}
+
+			for (x = 0; x < b_count; x++) {
+				names[a_count + x] = switch_core_sprintf(pool, "b_%s", channel_row_names[b_cols ? b_cols[x] : x]);
+			}
+
+			names[argc - 1] = "call_created_epoch";
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		channel_row_entry_t *e = &entries[i];
+		switch_caller_profile_t *cp;
+
+		if (e->listed && callback && !stop) {
+			channel_row_fill(e->session, pool, a_row);
+
+			if (!calls) {
+				stop = callback(pArg, argc, a_row, names);
+			} else {
+				memset(argv, 0, sizeof(*argv) * argc);
+
+				for (x = 0; x < a_count; x++) {
+					argv[x] = a_row[a_cols ? a_cols[x] : x];
+				}
+
+				if (e->partner) {
+					channel_row_fill(e->partner, pool, b_row);
+
+					for (x = 0; x < b_count; x++) {
+						argv[a_count + x] = b_row[b_cols ? b_cols[x] : x];
+					}
+
+					if ((cp = switch_channel_get_caller_profile(e->session->channel)) && cp->times && cp->times->bridged) {
+						argv[argc - 1] = switch_core_sprintf(pool, "%ld", (long) (cp->times->bridged / 1000000));
+					}
+				}
+
+				stop = callback(pArg, argc, argv, names);
+			}
+		}
+
+		switch_core_session_rwunlock(e->session);
+	}
+
+	switch_core_destroy_memory_pool(&pool);
+	free(entries);
+
+	return total;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_session_message_send(const char *uuid_str, switch_core_session_message_t *message)
 {
 	switch_core_session_t *session = NULL;
@@ -1329,6 +1664,8 @@ SWITCH_DECLARE(switch_mutex_t *) switch_core_session_get_mutex(switch_core_sessi
 	return session->mutex;
 }
 
+static int wake_queue(void);
+
 SWITCH_DECLARE(switch_status_t) switch_core_session_wake_session_thread(switch_core_session_t *session)
 {
 	switch_status_t status;
@@ -1341,12 +1678,33 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_wake_session_thread(switch_c
 	status = switch_mutex_trylock(session->mutex);
 	
 	if (status == SWITCH_STATUS_SUCCESS) {
-		switch_thread_cond_signal(session->cond);
+		if (switch_test_flag(session, SSF_THREAD_RELEASED)) {
+			/* The session gave its worker back while asleep, hand it to the pool again */
+			switch_clear_flag(session, SSF_THREAD_RELEASED);
+
+			switch_mutex_lock(session_manager.mutex);
+			session_manager.released--;
+			switch_mutex_unlock(session_manager.mutex);
+
+			switch_queue_push(session_manager.thread_queue, session->thread_data);
+			wake_queue();
+		} else {
+			switch_thread_cond_signal(session->cond);
+		}
 		switch_mutex_unlock(session->mutex);
 	} else {
 		if (switch_channel_state_thread_trylock(session->channel) == SWITCH_STATUS_SUCCESS) {
+			int released = switch_test_flag(session, SSF_THREAD_RELEASED);
+
 			/* We've beat them for sure, as soon as we release this lock, they will be checking their queue on the next line. */
 			switch_channel_state_thread_unlock(session->channel);
+
+			if (released) {
+				/* Unless the thread already decided to give its worker back and is only on its way to drop
+				   session->mutex: nobody would queue it again, so wait for the mutex and do it ourselves. */
+				switch_cond_next();
+				goto top;
+			}
 		} else {
 			/* What luck!  The channel has already started going to sleep *after* we checked if we need to wake it up.
 			   It will miss any messages in its queue because they were inserted after *it* checked its queue.  (catch-22)
@@ -1573,7 +1931,10 @@ static void *SWITCH_THREAD_FUNC switch_core_session_thread(switch_thread_t *thre
 	session->thread = thread;
 	session->thread_id = switch_thread_self();
 
-	switch_core_session_run(session);
+	if (switch_core_session_run_releasable(session)) {
+		return NULL;
+	}
+
 	switch_core_media_bug_remove_all(session);
 
 	if (session->soft_lock) {
@@ -1655,9 +2016,15 @@ static void *SWITCH_THREAD_FUNC switch_core_session_thread_pool_worker(switch_th
 
 		if (check_status == SWITCH_STATUS_SUCCESS && pop) {
 			switch_thread_data_t *td = (switch_thread_data_t *) pop;
-			
+			switch_memory_pool_t *td_pool;
+			int td_alloc;
+
 			if (!td) break;
 
+			/* td may be gone once func returns, a session allocates it from its own pool */
+			td_pool = td->pool;
+			td_alloc = td->alloc;
+
 			switch_mutex_lock(session_manager.mutex);
 			session_manager.busy++;
 			switch_mutex_unlock(session_manager.mutex);
@@ -1667,11 +2034,10 @@ static void *SWITCH_THREAD_FUNC switch_core_session_thread_pool_worker(switch_th
 
 			td->func(thread, td->obj);
 
-			if (td->pool) {
-				switch_memory_pool_t *pool = td->pool;
+			if (td_pool) {
 				td = NULL;
-				switch_core_destroy_memory_pool(&pool);
-			} else if (td->alloc) {
+				switch_core_destroy_memory_pool(&td_pool);
+			} else if (td_alloc) {
 				free(td);
 			}
 #ifdef DEBUG_THREAD_POOL
@@ -1815,7 +2181,8 @@ static void *SWITCH_THREAD_FUNC switch_core_session_thread_pool_manager(switch_t
 			if (session_manager.popping) {
 #ifdef DEBUG_THREAD_POOL
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG10, 
-								  "Thread pool: running:%d busy:%d popping:%d\n", session_manager.running, session_manager.busy, session_manager.popping);
+								  "Thread pool: running:%d busy:%d popping:%d released:%d\n", session_manager.running, session_manager.busy,
+								  session_manager.popping, session_manager.released);
 #endif
 				switch_queue_interrupt_all(session_manager.thread_queue);
 
@@ -1875,6 +2242,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_thread_pool_launch(switch_co
 		td = switch_core_session_alloc(session, sizeof(*td));
 		td->obj = session;
 		td->func = switch_core_session_thread;
+		session->thread_data = td;
 		switch_queue_push(session_manager.thread_queue, td);
 		wake_queue();
 	}
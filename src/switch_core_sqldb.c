@@ -37,6 +37,25 @@
 
 #define SWITCH_SQL_QUEUE_LEN 100000
 #define SWITCH_SQL_QUEUE_PAUSE_LEN 90000
+/* Prepared statements kept per SQLite handle, and the longest SQL text worth keeping */
+#define SQL_STMT_CACHE_MAX 64
+#define SQL_STMT_CACHE_LEN 1024
+/* Hashes of SQL texts seen once, a statement is only cached when its text comes again */
+#define SQL_STMT_SEEN_SLOTS 256
+
+struct switch_cache_db_handle;
+
+/* All the handles open on one database string. Idle ones are taken from the head of the
+   idle list, busy ones are only walked to find a handle the calling thread already holds. */
+typedef struct switch_cache_db_dsn_pool {
+	struct switch_cache_db_handle *idle;
+	struct switch_cache_db_handle *busy;
+} switch_cache_db_dsn_pool_t;
+
+/* A thread blocked on max-db-handles, served in arrival order */
+typedef struct switch_cache_db_waiter {
+	struct switch_cache_db_waiter *next;
+} switch_cache_db_waiter_t;
 
 struct switch_cache_db_handle {
 	char name[CACHE_DB_LEN];
@@ -54,6 +73,14 @@ struct switch_cache_db_handle {
 	uint32_t use_count;
 	uint64_t total_used_count;
 	struct switch_cache_db_handle *next;
+	switch_cache_db_dsn_pool_t *dsn_pool;
+	struct switch_cache_db_handle **dsn_list;
+	struct switch_cache_db_handle *dsn_prev;
+	struct switch_cache_db_handle *dsn_next;
+	switch_hash_t *stmt_cache;
+	uint32_t stmt_count;
+	uint64_t stmt_hits;
+	unsigned int stmt_seen[SQL_STMT_SEEN_SLOTS];
 };
 
 static struct {
@@ -65,8 +92,12 @@ static struct {
 	switch_mutex_t *dbh_mutex;
 	switch_mutex_t *ctl_mutex;
 	switch_cache_db_handle_t *handle_pool;
+	switch_hash_t *dsn_pools;
 	uint32_t total_handles;
 	uint32_t total_used_handles;
+	switch_mutex_t *wait_mutex;
+	switch_thread_cond_t *wait_cond;
+	switch_cache_db_waiter_t *waiters;
 	switch_cache_db_handle_t *dbh;
 	switch_sql_queue_manager_t *qm;
 	int paused;
@@ -90,9 +121,111 @@ static switch_cache_db_handle_t *create_handle(switch_cache_db_handle_type_t typ
 	return new_dbh;
 }
 
+static void dsn_list_add(switch_cache_db_handle_t **list, switch_cache_db_handle_t *dbh)
+{
+	dbh->dsn_list = list;
+	dbh->dsn_prev = NULL;
+
+	if ((dbh->dsn_next = *list)) {
+		dbh->dsn_next->dsn_prev = dbh;
+	}
+
+	*list = dbh;
+}
+
+static void dsn_list_del(switch_cache_db_handle_t *dbh)
+{
+	if (!dbh->dsn_list) {
+		return;
+	}
+
+	if (dbh->dsn_prev) {
+		dbh->dsn_prev->dsn_next = dbh->dsn_next;
+	} else {
+		*dbh->dsn_list = dbh->dsn_next;
+	}
+
+	if (dbh->dsn_next) {
+		dbh->dsn_next->dsn_prev = dbh->dsn_prev;
+	}
+
+	dbh->dsn_list = NULL;
+	dbh->dsn_prev = dbh->dsn_next = NULL;
+}
+
+static switch_bool_t handles_exhausted(void)
+{
+	return (runtime.max_db_handles && sql_manager.total_handles >= runtime.max_db_handles &&
+			sql_manager.total_used_handles >= sql_manager.total_handles) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+/* Let threads blocked on max-db-handles look again, call after a handle was released or dropped */
+static void wake_waiters(void)
+{
+	switch_mutex_lock(sql_manager.wait_mutex);
+	if (sql_manager.waiters) {
+		switch_thread_cond_broadcast(sql_manager.wait_cond);
+	}
+	switch_mutex_unlock(sql_manager.wait_mutex);
+}
+
+static switch_status_t wait_for_handle(const char *file, const char *func, int line)
+{
+	switch_cache_db_waiter_t waiter = { 0 }, **wp;
+	switch_time_t deadline = 0, now;
+	switch_interval_time_t wait;
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, NULL, SWITCH_LOG_WARNING, "Max handles %u exceeded, blocking....\n",
+					  runtime.max_db_handles);
+
+	if (runtime.db_handle_timeout) {
+		deadline = switch_micro_time_now() + runtime.db_handle_timeout;
+	}
+
+	switch_mutex_lock(sql_manager.wait_mutex);
+
+	for (wp = &sql_manager.waiters; *wp; wp = &(*wp)->next);
+	*wp = &waiter;
+
+	while (sql_manager.waiters != &waiter || handles_exhausted()) {
+		wait = 1000000;
+
+		if (deadline) {
+			if ((now = switch_micro_time_now()) >= deadline) {
+				status = SWITCH_STATUS_TIMEOUT;
+				break;
+			}
+
+			if (deadline - now < wait) {
+				wait = deadline - now;
+			}
+		}
+
+		switch_thread_cond_timedwait(sql_manager.wait_cond, sql_manager.wait_mutex, wait);
+	}
+
+	for (wp = &sql_manager.waiters; *wp; wp = &(*wp)->next) {
+		if (*wp == &waiter) {
+			*wp = waiter.next;
+			break;
+		}
+	}
+
+	/* the next in line may be able to go too */
+	if (sql_manager.waiters) {
+		switch_thread_cond_broadcast(sql_manager.wait_cond);
+	}
+
+	switch_mutex_unlock(sql_manager.wait_mutex);
+
+	return status;
+}
+
 static void add_handle(switch_cache_db_handle_t *dbh, const char *db_str, const char *db_callsite_str, const char *thread_str)
 {
 	switch_ssize_t hlen = -1;
+	switch_cache_db_dsn_pool_t *dsn_pool;
 
 	switch_mutex_lock(sql_manager.dbh_mutex);
 
@@ -109,6 +242,15 @@ static void add_handle(switch_cache_db_handle_t *dbh, const char *db_str, const
 
 	sql_manager.handle_pool = dbh;
 	sql_manager.total_handles++;
+
+	if (!(dsn_pool = switch_core_hash_find(sql_manager.dsn_pools, db_str))) {
+		dsn_pool = switch_core_alloc(sql_manager.memory_pool, sizeof(*dsn_pool));
+		switch_core_hash_insert(sql_manager.dsn_pools, db_str, dsn_pool);
+	}
+
+	dbh->dsn_pool = dsn_pool;
+	dsn_list_add(&dsn_pool->busy, dbh);
+
 	switch_mutex_lock(dbh->mutex);
 	switch_mutex_unlock(sql_manager.dbh_mutex);
 }
@@ -126,51 +268,62 @@ static void del_handle(switch_cache_db_handle_t *dbh)
 				sql_manager.handle_pool = dbh_ptr->next;
 			}
 			sql_manager.total_handles--;
+			dsn_list_del(dbh_ptr);
 			break;
 		}
 		
 		last = dbh_ptr;
 	}
 	switch_mutex_unlock(sql_manager.dbh_mutex);
+
+	wake_waiters();
 }
 
 static switch_cache_db_handle_t *get_handle(const char *db_str, const char *user_str, const char *thread_str)
 {
 	switch_ssize_t hlen = -1;
-	unsigned long hash = 0, thread_hash = 0;
+	unsigned long thread_hash = 0;
 	switch_cache_db_handle_t *dbh_ptr, *r = NULL;
+	switch_cache_db_dsn_pool_t *dsn_pool;
 
-	hash = switch_ci_hashfunc_default(db_str, &hlen);
 	thread_hash = switch_ci_hashfunc_default(thread_str, &hlen);
 	
 	switch_mutex_lock(sql_manager.dbh_mutex);
 
-	for (dbh_ptr = sql_manager.handle_pool; dbh_ptr; dbh_ptr = dbh_ptr->next) {
-		if (dbh_ptr->thread_hash == thread_hash && dbh_ptr->hash == hash && !dbh_ptr->use_count &&
-			!switch_test_flag(dbh_ptr, CDF_PRUNE) && switch_mutex_trylock(dbh_ptr->mutex) == SWITCH_STATUS_SUCCESS) {
+	if (!(dsn_pool = switch_core_hash_find(sql_manager.dsn_pools, db_str))) {
+		goto end;
+	}
+
+	/* A thread asking again while it holds a handle gets the same one back, except on PGSQL */
+	for (dbh_ptr = dsn_pool->busy; dbh_ptr; dbh_ptr = dbh_ptr->dsn_next) {
+		if (dbh_ptr->thread_hash == thread_hash && dbh_ptr->type != SCDB_TYPE_PGSQL && !switch_test_flag(dbh_ptr, CDF_PRUNE) &&
+			switch_mutex_trylock(dbh_ptr->mutex) == SWITCH_STATUS_SUCCESS) {
 			r = dbh_ptr;
+			break;
 		}
 	}
 
 	if (!r) {
-		for (dbh_ptr = sql_manager.handle_pool; dbh_ptr; dbh_ptr = dbh_ptr->next) {
-			if (dbh_ptr->hash == hash && (dbh_ptr->type != SCDB_TYPE_PGSQL || !dbh_ptr->use_count) && !switch_test_flag(dbh_ptr, CDF_PRUNE) && 
-				switch_mutex_trylock(dbh_ptr->mutex) == SWITCH_STATUS_SUCCESS) {
+		for (dbh_ptr = dsn_pool->idle; dbh_ptr; dbh_ptr = dbh_ptr->dsn_next) {
+			if (!switch_test_flag(dbh_ptr, CDF_PRUNE) && switch_mutex_trylock(dbh_ptr->mutex) == SWITCH_STATUS_SUCCESS) {
 				r = dbh_ptr;
+				dsn_list_del(r);
+				dsn_list_add(&dsn_pool->busy, r);
 				break;
 			}
-		}	
+		}
 	}
 	
 	if (r) {
 		r->use_count++;
 		r->total_used_count++;
 		sql_manager.total_used_handles++;
-		r->hash = switch_ci_hashfunc_default(db_str, &hlen);
 		r->thread_hash = thread_hash;
 		switch_set_string(r->last_user, user_str);
 	}
 
+ end:
+
 	switch_mutex_unlock(sql_manager.dbh_mutex);
 
 	return r;
@@ -208,6 +361,134 @@ SWITCH_DECLARE(switch_status_t) _switch_core_db_handle(switch_cache_db_handle_t
 #define SQL_REG_TIMEOUT 15
 
 
+static void stmt_cache_flush(switch_cache_db_handle_t *dbh)
+{
+	switch_hash_index_t *hi;
+	void *val;
+
+	if (!dbh->stmt_cache) {
+		return;
+	}
+
+	for (hi = switch_core_hash_first(dbh->stmt_cache); hi; hi = switch_core_hash_next(hi)) {
+		switch_core_hash_this(hi, NULL, NULL, &val);
+		switch_core_db_finalize((switch_core_db_stmt_t *) val);
+	}
+
+	switch_core_hash_destroy(&dbh->stmt_cache);
+	dbh->stmt_count = 0;
+}
+
+/* Run one SQLite statement through the prepared statements cached on the handle, keyed by
+   the SQL text. Most SQL carries its values as literals and never comes again, so a text is
+   only prepared for the cache the second time it is seen. SWITCH_STATUS_NOTFOUND means the
+   SQL is not something we cache (seen for the first time, several statements, or too long
+   to be reused) and the caller should fall back to exec. */
+static switch_status_t core_db_exec_cached(switch_cache_db_handle_t *dbh, const char *sql, char **errmsg)
+{
+	switch_core_db_t *db = dbh->native_handle.core_db_dbh;
+	switch_core_db_stmt_t *stmt = NULL;
+	const char *tail = NULL;
+	int ret, rc, sane, cached = 0, retried = 0;
+	switch_ssize_t len = (switch_ssize_t) strlen(sql);
+	unsigned int hash, *seen;
+
+	if (len > SQL_STMT_CACHE_LEN) {
+		return SWITCH_STATUS_NOTFOUND;
+	}
+
+ again:
+
+	if (dbh->stmt_cache && (stmt = switch_core_hash_find(dbh->stmt_cache, sql))) {
+		cached = 1;
+		dbh->stmt_hits++;
+	} else {
+		cached = 0;
+
+		hash = switch_hashfunc_default(sql, &len) | 1;
+		seen = &dbh->stmt_seen[hash % SQL_STMT_SEEN_SLOTS];
+
+		if (*seen != hash) {
+			*seen = hash;
+			return SWITCH_STATUS_NOTFOUND;
+		}
+
+		if ((ret = switch_core_db_prepare(db, sql, -1, &stmt, &tail)) != SWITCH_CORE_DB_OK) {
+			if (stmt) {
+				switch_core_db_finalize(stmt);
+			}
+
+			if (ret == SWITCH_CORE_DB_BUSY || ret == SWITCH_CORE_DB_LOCKED) {
+				/* switch_core_db_exec() knows how to wait for the lock */
+				return SWITCH_STATUS_NOTFOUND;
+			}
+
+			switch_strdup(*errmsg, switch_core_db_errmsg(db));
+			return SWITCH_STATUS_FALSE;
+		}
+
+		while (tail && *tail && switch_isspace(*tail)) {
+			tail++;
+		}
+
+		if (!stmt || (tail && *tail)) {
+			if (stmt) {
+				switch_core_db_finalize(stmt);
+			}
+			return SWITCH_STATUS_NOTFOUND;
+		}
+	}
+
+	/* wait for a locked database the way switch_core_db_exec() does */
+	for (sane = 300; ; ) {
+		while ((ret = switch_core_db_step(stmt)) == SWITCH_CORE_DB_ROW);
+
+		if ((rc = switch_core_db_reset(stmt)) != SWITCH_CORE_DB_OK && ret == SWITCH_CORE_DB_ERROR) {
+			ret = rc;
+		}
+
+		if ((ret == SWITCH_CORE_DB_BUSY || ret == SWITCH_CORE_DB_LOCKED) && --sane > 1) {
+			switch_yield(100000);
+			continue;
+		}
+
+		break;
+	}
+
+	if (ret != SWITCH_CORE_DB_DONE) {
+		if (cached) {
+			switch_core_hash_delete(dbh->stmt_cache, sql);
+			dbh->stmt_count--;
+		}
+
+		/* a cached statement goes stale when the schema changes, prepare it again once */
+		if (cached && ret != SWITCH_CORE_DB_BUSY && ret != SWITCH_CORE_DB_LOCKED && !retried++) {
+			switch_core_db_finalize(stmt);
+			goto again;
+		}
+
+		switch_strdup(*errmsg, switch_core_db_errmsg(db));
+		switch_core_db_finalize(stmt);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!cached) {
+		if (dbh->stmt_count >= SQL_STMT_CACHE_MAX) {
+			stmt_cache_flush(dbh);
+		}
+
+		if (!dbh->stmt_cache) {
+			switch_core_hash_init(&dbh->stmt_cache);
+		}
+
+		switch_core_hash_insert(dbh->stmt_cache, sql, stmt);
+		dbh->stmt_count++;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+
 static void sql_close(time_t prune)
 {
 	switch_cache_db_handle_t *dbh = NULL;
@@ -245,6 +526,7 @@ static void sql_close(time_t prune)
 				break;
 			case SCDB_TYPE_CORE_DB:
 				{
+					stmt_cache_flush(dbh);
 					switch_core_db_close(dbh->native_handle.core_db_dbh);
 					dbh->native_handle.core_db_dbh = NULL;
 				}
@@ -315,12 +597,19 @@ SWITCH_DECLARE(void) switch_cache_db_release_db_handle(switch_cache_db_handle_t
 		if ((*dbh)->use_count) {
 			if (--(*dbh)->use_count == 0) {
 				(*dbh)->thread_hash = 1;
+
+				if ((*dbh)->dsn_pool) {
+					dsn_list_del(*dbh);
+					dsn_list_add(&(*dbh)->dsn_pool->idle, *dbh);
+				}
 			}
 		}
 		switch_mutex_unlock((*dbh)->mutex);
 		sql_manager.total_used_handles--;
 		*dbh = NULL;
 		switch_mutex_unlock(sql_manager.dbh_mutex);
+
+		wake_waiters();
 	}
 }
 
@@ -390,28 +679,16 @@ SWITCH_DECLARE(switch_status_t) _switch_cache_db_get_db_handle(switch_cache_db_h
 	char db_str[CACHE_DB_LEN] = "";
 	char db_callsite_str[CACHE_DB_LEN] = "";
 	switch_cache_db_handle_t *new_dbh = NULL;
-	int waiting = 0;
-	uint32_t yield_len = 100000, total_yield = 0;
 
 	const char *db_name = NULL;
 	const char *odbc_user = NULL;
 	const char *odbc_pass = NULL;
 	const char *db_type = NULL;
 
-	while(runtime.max_db_handles && sql_manager.total_handles >= runtime.max_db_handles && sql_manager.total_used_handles >= sql_manager.total_handles) {
-		if (!waiting++) {
-			switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, NULL, SWITCH_LOG_WARNING, "Max handles %u exceeded, blocking....\n", 
-							  runtime.max_db_handles);
-		}
-
-		switch_yield(yield_len);
-		total_yield += yield_len;
-		
-		if (runtime.db_handle_timeout && total_yield > runtime.db_handle_timeout) {
-			switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, NULL, SWITCH_LOG_ERROR, "Error connecting\n");
-			*dbh = NULL;
-			return SWITCH_STATUS_FALSE;
-		}
+	if (handles_exhausted() && wait_for_handle(file, func, line) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, NULL, SWITCH_LOG_ERROR, "Error connecting\n");
+		*dbh = NULL;
+		return SWITCH_STATUS_FALSE;
 	}
 
 	switch (type) {
@@ -565,17 +842,18 @@ static switch_status_t switch_cache_db_execute_sql_real(switch_cache_db_handle_t
 		break;
 	case SCDB_TYPE_CORE_DB:
 		{
-			int ret = switch_core_db_exec(dbh->native_handle.core_db_dbh, sql, NULL, NULL, &errmsg);
 			type = "NATIVE";
 
-			if (ret == SWITCH_CORE_DB_OK) {
-				status = SWITCH_STATUS_SUCCESS;
-			}
+			if ((status = core_db_exec_cached(dbh, sql, &errmsg)) == SWITCH_STATUS_NOTFOUND) {
+				int ret = switch_core_db_exec(dbh->native_handle.core_db_dbh, sql, NULL, NULL, &errmsg);
 
-			if (errmsg) {
-				switch_strdup(tmp, errmsg);
-				switch_core_db_free(errmsg);
-				errmsg = tmp;
+				status = ret == SWITCH_CORE_DB_OK ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_FALSE;
+
+				if (errmsg) {
+					switch_strdup(tmp, errmsg);
+					switch_core_db_free(errmsg);
+					errmsg = tmp;
+				}
 			}
 		}
 		break;
@@ -2172,6 +2450,31 @@ static void core_event_handler(switch_event_t *event)
 
 	switch_assert(event);
 
+	if (switch_test_flag((&runtime), SCF_NO_CHANNEL_SQL)) {
+		switch (event->event_id) {
+		case SWITCH_EVENT_CHANNEL_DESTROY:
+		case SWITCH_EVENT_CHANNEL_UUID:
+		case SWITCH_EVENT_CHANNEL_CREATE:
+		case SWITCH_EVENT_CHANNEL_ANSWER:
+		case SWITCH_EVENT_CHANNEL_PROGRESS_MEDIA:
+		case SWITCH_EVENT_CHANNEL_HOLD:
+		case SWITCH_EVENT_CHANNEL_UNHOLD:
+		case SWITCH_EVENT_CHANNEL_EXECUTE:
+		case SWITCH_EVENT_CHANNEL_ORIGINATE:
+		case SWITCH_EVENT_CALL_UPDATE:
+		case SWITCH_EVENT_CHANNEL_CALLSTATE:
+		case SWITCH_EVENT_CHANNEL_STATE:
+		case SWITCH_EVENT_CHANNEL_BRIDGE:
+		case SWITCH_EVENT_CHANNEL_UNBRIDGE:
+		case SWITCH_EVENT_CALL_SECURE:
+		case SWITCH_EVENT_CODEC:
+			/* channels and calls are not mirrored, show channels/calls read the session table instead */
+			return;
+		default:
+			break;
+		}
+	}
+
 	switch (event->event_id) {
 	case SWITCH_EVENT_CHANNEL_UUID:
 	case SWITCH_EVENT_CHANNEL_CREATE:
@@ -3286,6 +3589,9 @@ switch_status_t switch_core_sqldb_start(switch_memory_pool_t *pool, switch_bool_
 	sql_manager.manage = manage;
 
 	switch_mutex_init(&sql_manager.dbh_mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
+	switch_mutex_init(&sql_manager.wait_mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
+	switch_thread_cond_create(&sql_manager.wait_cond, sql_manager.memory_pool);
+	switch_core_hash_init_nocase(&sql_manager.dsn_pools);
 	switch_mutex_init(&sql_manager.io_mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
 	switch_mutex_init(&sql_manager.ctl_mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
 
@@ -3531,27 +3837,29 @@ switch_status_t switch_core_sqldb_start(switch_memory_pool_t *pool, switch_bool_
 		switch_event_bind("core_db", SWITCH_EVENT_DEL_SCHEDULE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
 		switch_event_bind("core_db", SWITCH_EVENT_EXE_SCHEDULE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
 		switch_event_bind("core_db", SWITCH_EVENT_RE_SCHEDULE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_DESTROY, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_UUID, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_CREATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_ANSWER, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_PROGRESS_MEDIA, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_HOLD, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_UNHOLD, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_EXECUTE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_ORIGINATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CALL_UPDATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_CALLSTATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_STATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_BRIDGE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_UNBRIDGE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		if (!switch_test_flag((&runtime), SCF_NO_CHANNEL_SQL)) {
+			switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_DESTROY, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+			switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_UUID, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+			switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_CREATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+			switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_ANSWER, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+			switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_PROGRESS_MEDIA, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+			switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_HOLD, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+			switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_UNHOLD, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+			switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_EXECUTE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+			switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_ORIGINATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+			switch_event_bind("core_db", SWITCH_EVENT_CALL_UPDATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+			switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_CALLSTATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+			switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_STATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+			switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_BRIDGE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+			switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_UNBRIDGE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+			switch_event_bind("core_db", SWITCH_EVENT_CALL_SECURE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+			switch_event_bind("core_db", SWITCH_EVENT_CODEC, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		}
 		switch_event_bind("core_db", SWITCH_EVENT_SHUTDOWN, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
 		switch_event_bind("core_db", SWITCH_EVENT_LOG, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
 		switch_event_bind("core_db", SWITCH_EVENT_MODULE_LOAD, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
 		switch_event_bind("core_db", SWITCH_EVENT_MODULE_UNLOAD, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CALL_SECURE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
 		switch_event_bind("core_db", SWITCH_EVENT_NAT, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CODEC, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
 #endif	
 
 		switch_threadattr_create(&thd_attr, sql_manager.memory_pool);
@@ -3646,6 +3954,8 @@ void switch_core_sqldb_stop(void)
 
 	switch_cache_db_flush_handles();
 	sql_close(0);
+
+	switch_core_hash_destroy(&sql_manager.dsn_pools);
 }
 
 SWITCH_DECLARE(void) switch_cache_db_status(switch_stream_handle_t *stream)
@@ -3708,13 +4018,14 @@ SWITCH_DECLARE(void) switch_cache_db_status(switch_stream_handle_t *stream)
 		}
 		
 		stream->write_function(stream, "%s\n\tType: %s\n\tLast used: %d\n\tTotal used: %ld\n\tFlags: %s, %s(%d)\n"
-							   "\tCreator: %s\n\tLast User: %s\n",
+							   "\tCreator: %s\n\tLast User: %s\n\tStatements: %u cached, %ld reused\n",
 							   cleankey_str,
 							   switch_cache_db_type_name(dbh->type),
 							   diff,
 							   dbh->total_used_count,
 							   locked ? "Locked" : "Unlocked",
-							   dbh->use_count ? "Attached" : "Detached", dbh->use_count, dbh->creator, dbh->last_user);
+							   dbh->use_count ? "Attached" : "Detached", dbh->use_count, dbh->creator, dbh->last_user,
+							   dbh->stmt_count, dbh->stmt_hits);
 	}
 
 	stream->write_function(stream, "%d total. %d in use.\n", count, used);
@@ -411,7 +411,8 @@ static void check_presence(switch_core_session_t *session)
 
 
 
-SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
+/* Returns SWITCH_TRUE when the thread was given back while the session sleeps, see switch_core_session_run_releasable() */
+static switch_bool_t core_session_run(switch_core_session_t *session, switch_bool_t can_release)
 {
 	switch_channel_state_t state = CS_NEW, midstate = CS_DESTROY, endstate;
 	const switch_endpoint_interface_t *endpoint_interface;
@@ -446,6 +447,16 @@ SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
 
 	switch_mutex_lock(session->mutex);
 
+	if (switch_channel_test_flag(session->channel, CF_THREAD_SLEEPING)) {
+		/* Picked up again by a pool worker after the last one was released in the sleep below */
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG1, "%s session thread resume state: %s!\n",
+						  switch_channel_get_name(session->channel),
+						  switch_channel_state_name(switch_channel_get_running_state(session->channel)));
+		switch_channel_clear_flag(session->channel, CF_THREAD_SLEEPING);
+		switch_ivr_parse_all_events(session);
+		switch_ivr_parse_all_events(session);
+	}
+
 	while ((state = switch_channel_get_state(session->channel)) != CS_DESTROY) {
 
 		if (switch_channel_test_flag(session->channel, CF_BLOCK_STATE)) {
@@ -581,6 +592,16 @@ SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
 						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG1, "%s session thread sleep state: %s!\n", 
 										  switch_channel_get_name(session->channel),
 										  switch_channel_state_name(switch_channel_get_running_state(session->channel)));
+
+						if (can_release) {
+							/* Nothing to do until the state changes or something is queued: give the worker
+							   back to the pool, switch_core_session_wake_session_thread() queues us again. */
+							switch_set_flag(session, SSF_THREAD_RELEASED);
+							session->thread_id = 0;
+							switch_channel_state_thread_unlock(session->channel);
+							goto released;
+						}
+
 						switch_thread_cond_wait(session->cond, session->mutex);
 						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG1, "%s session thread wake state: %s!\n", 
 										  switch_channel_get_name(session->channel),
@@ -601,6 +622,32 @@ SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
 	switch_mutex_unlock(session->mutex);
 
 	switch_clear_flag(session, SSF_THREAD_RUNNING);
+
+	return SWITCH_FALSE;
+
+  released:
+	switch_mutex_lock(session_manager.mutex);
+	session_manager.released++;
+	switch_mutex_unlock(session_manager.mutex);
+
+	switch_mutex_unlock(session->mutex);
+
+	return SWITCH_TRUE;
+}
+
+SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
+{
+	core_session_run(session, SWITCH_FALSE);
+}
+
+/* Run the session on a pool worker. With session-thread-release the worker is handed back whenever the
+   session goes to sleep waiting for a state change or message, SWITCH_TRUE is returned then and the
+   session must not be touched anymore: it has been queued on the pool again or may be running elsewhere.
+   Only those signal-only sleeps release the worker. Media loops (park, audio bridge, playback, conference)
+   block in switch_core_session_read_frame() and keep it for as long as they run. */
+switch_bool_t switch_core_session_run_releasable(switch_core_session_t *session)
+{
+	return core_session_run(session, session->thread_data && switch_test_flag((&runtime), SCF_SESSION_THREAD_RELEASE) ? SWITCH_TRUE : SWITCH_FALSE);
 }
 
 SWITCH_DECLARE(void) switch_core_session_destroy_state(switch_core_session_t *session)
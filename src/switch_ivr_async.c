@@ -39,18 +39,42 @@
 
 struct switch_ivr_dmachine_binding {
 	char *digits;
+	switch_size_t len;
+	uint32_t seq;
 	int32_t key;
 	uint8_t rmatch;
 	switch_ivr_dmachine_callback_t callback;
 	switch_byte_t is_regex;
+	switch_regex_t *re;
 	void *user_data;
 	struct switch_ivr_dmachine_binding *next;
 };
 typedef struct switch_ivr_dmachine_binding switch_ivr_dmachine_binding_t;
 
+typedef struct dm_binding_ref {
+	switch_ivr_dmachine_binding_t *binding;
+	struct dm_binding_ref *next;
+} dm_binding_ref_t;
+
+/* Literal bindings are filed in a digit trie, every node lists in bind order the bindings
+   its digits are a prefix of. The bindings the digits collected so far can still match are
+   those of a single node, found in as many steps as there are digits. */
+typedef struct dm_trie_node {
+	char digit;
+	uint32_t count;
+	dm_binding_ref_t *bindings;
+	dm_binding_ref_t *tail;
+	struct dm_trie_node *children;
+	struct dm_trie_node *next;
+} dm_trie_node_t;
+
 typedef struct {
 	switch_ivr_dmachine_binding_t *binding_list;
 	switch_ivr_dmachine_binding_t *tail;
+	uint32_t seq;
+	dm_trie_node_t trie;
+	dm_binding_ref_t *regex_list;
+	dm_binding_ref_t *regex_tail;
 	char *name;
 	char *terminators;
 } dm_binding_head_t;
@@ -174,14 +198,30 @@ SWITCH_DECLARE(void) switch_ivr_dmachine_set_input_timeout_ms(switch_ivr_dmachin
 	dmachine->input_timeout_ms = input_timeout_ms;
 }
 
+static void dm_binding_head_free_regex(dm_binding_head_t *headp)
+{
+	dm_binding_ref_t *ref;
+
+	for (ref = headp->regex_list; ref; ref = ref->next) {
+		switch_regex_safe_free(ref->binding->re);
+	}
+}
+
 SWITCH_DECLARE(void) switch_ivr_dmachine_destroy(switch_ivr_dmachine_t **dmachine)
 {
 	switch_memory_pool_t *pool;
+	switch_hash_index_t *hi;
+	void *val;
 
 	if (!(dmachine && *dmachine)) return;
 	
 	pool = (*dmachine)->pool;
 
+	for (hi = switch_core_hash_first((*dmachine)->binding_hash); hi; hi = switch_core_hash_next(hi)) {
+		switch_core_hash_this(hi, NULL, NULL, &val);
+		dm_binding_head_free_regex((dm_binding_head_t *) val);
+	}
+
 	switch_core_hash_destroy(&(*dmachine)->binding_hash);
 	
 	if ((*dmachine)->my_pool) {
@@ -238,11 +278,71 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_dmachine_clear_realm(switch_ivr_dmach
 		dmachine->realm = NULL;
 	}
 
+	if (headp) {
+		dm_binding_head_free_regex(headp);
+	}
+
 	/* pool alloc'd just ditch it and it will give back the memory when we destroy ourselves */
 	switch_core_hash_delete(dmachine->binding_hash, realm);
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static dm_binding_ref_t *dm_binding_ref(switch_ivr_dmachine_t *dmachine, switch_ivr_dmachine_binding_t *binding,
+										 dm_binding_ref_t **list, dm_binding_ref_t **tail)
+{
+	dm_binding_ref_t *ref = switch_core_alloc(dmachine->pool, sizeof(*ref));
+
+	ref->binding = binding;
+
+	if (*tail) {
+		(*tail)->next = ref;
+	} else {
+		*list = ref;
+	}
+
+	*tail = ref;
+
+	return ref;
+}
+
+static void dm_trie_add(switch_ivr_dmachine_t *dmachine, dm_binding_head_t *headp, switch_ivr_dmachine_binding_t *binding)
+{
+	dm_trie_node_t *node = &headp->trie, *child;
+	const char *p;
+
+	for (p = binding->digits;; p++) {
+		dm_binding_ref(dmachine, binding, &node->bindings, &node->tail);
+		node->count++;
+
+		if (!*p) {
+			break;
+		}
+
+		for (child = node->children; child && child->digit != *p; child = child->next);
+
+		if (!child) {
+			child = switch_core_alloc(dmachine->pool, sizeof(*child));
+			child->digit = *p;
+			child->next = node->children;
+			node->children = child;
+		}
+
+		node = child;
+	}
+}
+
+static dm_trie_node_t *dm_trie_find(dm_binding_head_t *headp, const char *digits)
+{
+	dm_trie_node_t *node = &headp->trie;
+	const char *p;
+
+	for (p = digits; *p && node; p++) {
+		for (node = node->children; node && node->digit != *p; node = node->next);
+	}
+
+	return node;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_ivr_dmachine_bind(switch_ivr_dmachine_t *dmachine, 
 														 const char *realm,
 														 const char *digits, 
@@ -289,9 +389,30 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_dmachine_bind(switch_ivr_dmachine_t *
 
 	binding->key = key;
 	binding->digits = switch_core_strdup(dmachine->pool, digits);
+	binding->len = strlen(digits);
+	binding->seq = headp->seq++;
 	binding->callback = callback;
 	binding->user_data = user_data;
 
+	if (binding->is_regex) {
+		if (*digits == '_') {
+			/* switch_regex_match() takes no _ast patterns */
+			const char *err = NULL;
+			int erroffset = 0;
+
+			if (!(binding->re = switch_regex_compile(digits, 0, &err, &erroffset, NULL)) || err) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Regular Expression Error expression[%s] error[%s] location[%d]\n",
+								  digits, err, erroffset);
+				switch_regex_safe_free(binding->re);
+			}
+		} else {
+			binding->re = switch_regex_compile_expression(digits);
+		}
+		dm_binding_ref(dmachine, binding, &headp->regex_list, &headp->regex_tail);
+	} else {
+		dm_trie_add(dmachine, headp, binding);
+	}
+
 	if (headp->tail) {
 		headp->tail->next = binding;
 	} else {
@@ -338,29 +459,31 @@ static dm_match_t switch_ivr_dmachine_check_match(switch_ivr_dmachine_t *dmachin
 {
 	dm_match_t best = DM_MATCH_NONE;
 	switch_ivr_dmachine_binding_t *bp, *exact_bp = NULL, *partial_bp = NULL, *both_bp = NULL, *r_bp = NULL;
+	dm_binding_ref_t *rref, *lref;
+	dm_trie_node_t *node;
+	switch_size_t digits_len;
 	int pmatches = 0, ematches = 0, rmatches = 0;
 	
 	if (!dmachine->cur_digit_len || !dmachine->realm) goto end;
 
-	for(bp = dmachine->realm->binding_list; bp; bp = bp->next) {
-		if (bp->is_regex) {
-			switch_status_t r_status = switch_regex_match(dmachine->digits, bp->digits);
-			
-			if (r_status == SWITCH_STATUS_SUCCESS) {
-				bp->rmatch++;
-			} else {
-				bp->rmatch = 0;
-			}
+	for (rref = dmachine->realm->regex_list; rref; rref = rref->next) {
+		int ovector[255];
 
-			rmatches++;
-			pmatches++;
+		bp = rref->binding;
 
+		if (switch_regex_exec(bp->re, dmachine->digits, ovector, sizeof(ovector) / sizeof(ovector[0])) > 0) {
+			bp->rmatch++;
 		} else {
-			if (!strncmp(dmachine->digits, bp->digits, strlen(dmachine->digits))) {
-				pmatches++;
-				ematches = 1;
-			}
+			bp->rmatch = 0;
 		}
+
+		rmatches++;
+		pmatches++;
+	}
+
+	if ((node = dm_trie_find(dmachine->realm, dmachine->digits)) && node->count) {
+		pmatches += node->count;
+		ematches = 1;
 	}
 
 	if (!zstr(dmachine->realm->terminators)) {
@@ -377,7 +500,22 @@ static dm_match_t switch_ivr_dmachine_check_match(switch_ivr_dmachine_t *dmachin
 		}
 	}
 
-	for(bp = dmachine->realm->binding_list; bp; bp = bp->next) {
+	/* Walk the regex bindings and the literal ones the digits are a prefix of in bind order,
+	   the others could not match */
+	digits_len = strlen(dmachine->digits);
+	node = dm_trie_find(dmachine->realm, dmachine->digits);
+	rref = dmachine->realm->regex_list;
+	lref = node ? node->bindings : NULL;
+
+	while (rref || lref) {
+		if (rref && (!lref || rref->binding->seq < lref->binding->seq)) {
+			bp = rref->binding;
+			rref = rref->next;
+		} else {
+			bp = lref->binding;
+			lref = lref->next;
+		}
+
 		if (bp->is_regex) {
 			if (bp->rmatch) {
 				if (is_timeout || (bp == dmachine->realm->binding_list && !bp->next)) {
@@ -388,15 +526,13 @@ static dm_match_t switch_ivr_dmachine_check_match(switch_ivr_dmachine_t *dmachin
 				best = DM_MATCH_PARTIAL;
 			}
 		} else {
-			int pmatch = !strncmp(dmachine->digits, bp->digits, strlen(dmachine->digits));
-
-			if (!exact_bp && pmatch && (((pmatches == 1 || ematches == 1) && !rmatches) || is_timeout) && !strcmp(bp->digits, dmachine->digits)) {
+			if (!exact_bp && (((pmatches == 1 || ematches == 1) && !rmatches) || is_timeout) && bp->len == digits_len) {
 				best = DM_MATCH_EXACT;
 				exact_bp = bp;
 				if (dmachine->cur_digit_len == dmachine->max_digit_len) break;
 			} 
 
-			if (!(both_bp && partial_bp) && strlen(bp->digits) != strlen(dmachine->digits) && pmatch) {
+			if (!(both_bp && partial_bp) && bp->len != digits_len) {
 				
 				if (exact_bp) {
 					best = DM_MATCH_BOTH;
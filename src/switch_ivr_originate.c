@@ -92,6 +92,7 @@ typedef struct {
 	uint32_t per_channel_timelimit_sec;
 	uint32_t per_channel_progress_timelimit_sec;
 	uint32_t per_channel_delay_start;
+	uint8_t watched;
 } originate_status_t;
 
 
@@ -125,6 +126,11 @@ typedef struct {
 	switch_caller_profile_t *caller_profile_override;
 	switch_bool_t check_vars;
 	switch_memory_pool_t *pool;
+	/* Signalled by the watchers of the legs, so the originate sleeps until something happens */
+	switch_mutex_t *wait_mutex;
+	switch_thread_cond_t *wait_cond;
+	switch_atomic_t changes;
+	uint32_t seen_changes;
 } originate_global_t;
 
 
@@ -383,6 +389,57 @@ static switch_bool_t monitor_callback(switch_core_session_t *session, const char
 	return SWITCH_FALSE;
 }
 
+/* Runs in whichever thread changed the state of a leg */
+static void originate_leg_watcher(switch_channel_t *channel, void *user_data)
+{
+	originate_global_t *oglobals = (originate_global_t *) user_data;
+
+	switch_atomic_inc(&oglobals->changes);
+
+	switch_mutex_lock(oglobals->wait_mutex);
+	switch_thread_cond_signal(oglobals->wait_cond);
+	switch_mutex_unlock(oglobals->wait_mutex);
+}
+
+/* Sleep until one of the legs changes state, or ms at most for what nothing signals (timeouts, cancel, ringback) */
+static void originate_wait(originate_global_t *oglobals, uint32_t ms)
+{
+	switch_mutex_lock(oglobals->wait_mutex);
+	if (switch_atomic_read(&oglobals->changes) == oglobals->seen_changes) {
+		switch_thread_cond_timedwait(oglobals->wait_cond, oglobals->wait_mutex, ms * 1000);
+	}
+	oglobals->seen_changes = switch_atomic_read(&oglobals->changes);
+	switch_mutex_unlock(oglobals->wait_mutex);
+}
+
+static void originate_watch(originate_global_t *oglobals, originate_status_t *originate_status)
+{
+	switch_channel_set_watcher(originate_status->peer_channel, originate_leg_watcher, oglobals);
+	originate_status->watched = 1;
+}
+
+static void originate_unwatch(originate_status_t *originate_status)
+{
+	if (originate_status->watched) {
+		switch_channel_set_watcher(originate_status->peer_channel, NULL, NULL);
+		originate_status->watched = 0;
+	}
+}
+
+/* The most elements data split on sep can give, to size the per leg arrays */
+static int originate_max_legs(const char *data, const char *sep)
+{
+	size_t len = strlen(sep);
+	int n = 1;
+
+	while (data && (data = strstr(data, sep))) {
+		data += len;
+		n++;
+	}
+
+	return n;
+}
+
 static void inherit_codec(switch_channel_t *caller_channel, switch_core_session_t *session)
 {
 	const char *var = switch_channel_get_variable(caller_channel, "inherit_codec");
@@ -1335,8 +1392,6 @@ static switch_status_t setup_ringback(originate_global_t *oglobals, originate_st
 }
 
 
-#define MAX_PEERS 128
-
 typedef struct {
 	switch_core_session_t *session;
 	switch_core_session_t *bleg;
@@ -1438,8 +1493,9 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_enterprise_originate(switch_core_sess
 																switch_call_cause_t *cancel_cause)
 {
 	int x_argc = 0;
-	char *x_argv[MAX_PEERS] = { 0 };
-	enterprise_originate_handle_t *hp = NULL, handles[MAX_PEERS] = { {0} };
+	char **x_argv = NULL;
+	enterprise_originate_handle_t *hp = NULL, *handles = NULL;
+	int x_max;
 	int i;
 	switch_caller_profile_t *cp = NULL;
 	switch_channel_t *channel = NULL;
@@ -1540,7 +1596,11 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_enterprise_originate(switch_core_sess
 
 	switch_event_add_header_string(var_event, SWITCH_STACK_BOTTOM, "ignore_early_media", "true");
 
-	if (!(x_argc = switch_separate_string_string(data, SWITCH_ENT_ORIGINATE_DELIM, x_argv, MAX_PEERS))) {
+	x_max = originate_max_legs(data, SWITCH_ENT_ORIGINATE_DELIM);
+	x_argv = switch_core_alloc(pool, sizeof(*x_argv) * x_max);
+	handles = switch_core_alloc(pool, sizeof(*handles) * x_max);
+
+	if (!(x_argc = switch_separate_string_string(data, SWITCH_ENT_ORIGINATE_DELIM, x_argv, x_max))) {
 		*cause = SWITCH_CAUSE_DESTINATION_OUT_OF_ORDER;
 		getcause = 0;
 		switch_goto_status(SWITCH_STATUS_FALSE, end);
@@ -1618,13 +1678,13 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_enterprise_originate(switch_core_sess
 			} else {
 				over++;
 			}
-
-			switch_yield(10000);
 		}
 
 		if (!running || over == x_argc) {
 			break;
 		}
+
+		switch_yield(10000);
 	}
 
 
@@ -1708,6 +1768,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_enterprise_originate(switch_core_sess
 struct early_state {
 	originate_global_t *oglobals;
 	originate_status_t *originate_status;
+	int len;
 	switch_mutex_t *mutex;
 	switch_buffer_t *buffer;
 	int ready;
@@ -1715,16 +1776,19 @@ struct early_state {
 };
 typedef struct early_state early_state_t;
 
+#define EARLY_REFRESH_FRAMES 50
 
 static void *SWITCH_THREAD_FUNC early_thread_run(switch_thread_t *thread, void *obj)
 {
 	early_state_t *state = (early_state_t *) obj;
-	originate_status_t originate_status[MAX_PEERS] = { {0} };
+	originate_status_t *originate_status;
 	int16_t mux_data[SWITCH_RECOMMENDED_BUFFER_SIZE / 2] = { 0 };
 	int32_t sample;
 	switch_core_session_t *session;
-	switch_codec_t read_codecs[MAX_PEERS] = { {0} };
-	int i, x, ready = 0, answered = 0, ring_ready = 0;
+	switch_codec_t *read_codecs;
+	int *media_legs;
+	int i, j, x, ready = 0, answered = 0, ring_ready = 0, media_count = 0, frames = 0;
+	uint32_t seen_changes = 0;
 	int16_t *data;
 	uint32_t datalen = 0;
 	switch_status_t status;
@@ -1734,20 +1798,46 @@ static void *SWITCH_THREAD_FUNC early_thread_run(switch_thread_t *thread, void *
 	if (state->oglobals->session) {
 		switch_core_session_get_read_impl(state->oglobals->session, &read_impl);
 	}
+
+	switch_zmalloc(originate_status, sizeof(*originate_status) * state->len);
+	switch_zmalloc(read_codecs, sizeof(*read_codecs) * state->len);
+	switch_zmalloc(media_legs, sizeof(*media_legs) * state->len);
 	
-	for (i = 0; i < MAX_PEERS && (session = state->originate_status[i].peer_session); i++) {
-		originate_status[i].peer_session = session;
-		switch_core_session_read_lock(session);
+	for (i = 0; i < state->len; i++) {
+		if ((session = state->originate_status[i].peer_session) && switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
+			originate_status[i].peer_session = session;
+		}
 	}
 
+	/* Force a first look at the legs */
+	seen_changes = switch_atomic_read(&state->oglobals->changes) - 1;
+
 	while (state->ready) {
 		datalen = 0;
 		memset(mux_data, 0, sizeof(mux_data));
 		ready = 0;
 		answered = 0;
 
-		for (i = 0; i < MAX_PEERS && (session = originate_status[i].peer_session); i++) {
-			switch_channel_t *channel = switch_core_session_get_channel(session);
+		/* Only mix the legs with media, looking for new ones when the watchers report a change or once in a while */
+		if (switch_atomic_read(&state->oglobals->changes) != seen_changes || ++frames >= EARLY_REFRESH_FRAMES) {
+			seen_changes = switch_atomic_read(&state->oglobals->changes);
+			frames = 0;
+			media_count = 0;
+
+			for (i = 0; i < state->len; i++) {
+				if ((session = originate_status[i].peer_session) && switch_channel_media_ready(switch_core_session_get_channel(session))) {
+					media_legs[media_count++] = i;
+				}
+			}
+		}
+
+		for (j = 0; j < media_count; j++) {
+			switch_channel_t *channel;
+
+			i = media_legs[j];
+			session = originate_status[i].peer_session;
+			channel = switch_core_session_get_channel(session);
+
 			if (switch_channel_media_ready(channel)) {
 				ready++;
 
@@ -1815,7 +1905,10 @@ static void *SWITCH_THREAD_FUNC early_thread_run(switch_thread_t *thread, void *
 	}
 
 
-	for (i = 0; i < MAX_PEERS && (session = originate_status[i].peer_session); i++) {
+	for (i = 0; i < state->len; i++) {
+		if (!(session = originate_status[i].peer_session)) {
+			continue;
+		}
 		if (switch_core_codec_ready((&read_codecs[i]))) {
 			switch_core_session_set_read_codec(session, NULL);
 			switch_core_codec_destroy(&read_codecs[i]);
@@ -1824,6 +1917,10 @@ static void *SWITCH_THREAD_FUNC early_thread_run(switch_thread_t *thread, void *
 		switch_core_session_rwunlock(session);
 	}
 
+	free(media_legs);
+	free(read_codecs);
+	free(originate_status);
+
 	if (!ring_ready) {
 		state->oglobals->early_ok = 1;
 	}
@@ -1859,13 +1956,14 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 													 switch_caller_profile_t *caller_profile_override,
 													 switch_event_t *ovars, switch_originate_flag_t flags, switch_call_cause_t *cancel_cause)
 {
-	originate_status_t originate_status[MAX_PEERS] = { {0} };
+	originate_status_t *originate_status;
 	switch_originate_flag_t dftflags = SOF_NONE, myflags = dftflags;
-	char *pipe_names[MAX_PEERS] = { 0 };
+	char **pipe_names;
 	char *data = NULL;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
 	switch_channel_t *caller_channel = NULL;
-	char *peer_names[MAX_PEERS] = { 0 };
+	char **peer_names;
+	int or_max = 1, peer_max = 1;
 	switch_core_session_t *new_session = NULL, *peer_session;
 	switch_caller_profile_t *new_profile = NULL, *caller_caller_profile;
 	char *chan_type = NULL, *chan_data;
@@ -1926,6 +2024,13 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 	oglobals.file = NULL;
 	oglobals.error_file = NULL;
 	switch_core_new_memory_pool(&oglobals.pool);
+	switch_mutex_init(&oglobals.wait_mutex, SWITCH_MUTEX_NESTED, oglobals.pool);
+	switch_thread_cond_create(&oglobals.wait_cond, oglobals.pool);
+
+	/* Sized for the legs of the dial string once it is known */
+	pipe_names = switch_core_alloc(oglobals.pool, sizeof(*pipe_names) * or_max);
+	peer_names = switch_core_alloc(oglobals.pool, sizeof(*peer_names) * peer_max);
+	originate_status = switch_core_alloc(oglobals.pool, sizeof(*originate_status) * peer_max);
 
 	if (caller_profile_override) {
 		oglobals.caller_profile_override = switch_caller_profile_dup(oglobals.pool, caller_profile_override);
@@ -2412,11 +2517,18 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 		progress_timelimit_sec = timelimit_sec;
 	}
 
+	/* As many legs as the dial string has, no fixed limit */
+	or_max = originate_max_legs(data, "|");
+	peer_max = originate_max_legs(data, ",");
+	pipe_names = switch_core_alloc(oglobals.pool, sizeof(*pipe_names) * or_max);
+	peer_names = switch_core_alloc(oglobals.pool, sizeof(*peer_names) * peer_max);
+	originate_status = switch_core_alloc(oglobals.pool, sizeof(*originate_status) * peer_max);
+
 	for (try = 0; try < retries; try++) {
 		switch_safe_free(loop_data);
 		loop_data = strdup(data);
 		switch_assert(loop_data);
-		or_argc = switch_separate_string(loop_data, '|', pipe_names, (sizeof(pipe_names) / sizeof(pipe_names[0])));
+		or_argc = switch_separate_string(loop_data, '|', pipe_names, or_max);
 
 		if ((flags & SOF_NOBLOCK) && or_argc > 1) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "Only calling the first element in the list in this mode.\n");
@@ -2432,9 +2544,9 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 			oglobals.hups = 0;
 
 			reason = SWITCH_CAUSE_NONE;
-			memset(peer_names, 0, sizeof(peer_names));
+			memset(peer_names, 0, sizeof(*peer_names) * peer_max);
 			peer_session = NULL;
-			memset(originate_status, 0, sizeof(originate_status));
+			memset(originate_status, 0, sizeof(*originate_status) * peer_max);
 			new_profile = NULL;
 			new_session = NULL;
 			chan_type = NULL;
@@ -2497,7 +2609,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 				p++;
 			}
 
-			and_argc = switch_separate_string(pipe_names[r], ',', peer_names, (sizeof(peer_names) / sizeof(peer_names[0])));
+			and_argc = switch_separate_string(pipe_names[r], ',', peer_names, peer_max);
 
 			if ((flags & SOF_NOBLOCK) && and_argc > 1) {
 				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "Only calling the first element in the list in this mode.\n");
@@ -2737,6 +2849,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 				originate_status[i].peer_channel = switch_core_session_get_channel(new_session);
 				originate_status[i].caller_profile = switch_channel_get_caller_profile(originate_status[i].peer_channel);
 				originate_status[i].peer_session = new_session;
+				originate_watch(&oglobals, &originate_status[i]);
 
 				switch_channel_set_flag(originate_status[i].peer_channel, CF_ORIGINATING);
 				
@@ -2888,6 +3001,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 				switch_channel_add_state_handler(originate_status[i].peer_channel, &originate_state_handlers);
 
 				if ((flags & SOF_NOBLOCK) && originate_status[i].peer_session) {
+					originate_unwatch(&originate_status[i]);
 					status = SWITCH_STATUS_SUCCESS;
 					*bleg = originate_status[i].peer_session;
 					*cause = SWITCH_CAUSE_SUCCESS;
@@ -2947,8 +3061,6 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 						}
 						goto notready;
 					}
-
-					switch_cond_next();
 				}
 
 				check_per_channel_timeouts(&oglobals, originate_status, and_argc, start, &force_reason);
@@ -2959,6 +3071,8 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 					goto done;
 				}
 
+				/* A leg moving on wakes us up */
+				originate_wait(&oglobals, 10);
 			}
 
 		  endfor1:
@@ -3111,6 +3225,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 								switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
 								early_state.oglobals = &oglobals;
 								early_state.originate_status = originate_status;
+								early_state.len = and_argc;
 								early_state.ready = 1;
 								early_state.ringback = &ringback;
 								switch_mutex_init(&early_state.mutex, SWITCH_MUTEX_NESTED, switch_core_session_get_pool(session));
@@ -3232,7 +3347,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 			do_continue:
 
 				if (!read_packet) {
-					switch_yield(20000);
+					originate_wait(&oglobals, 20);
 				}
 			}
 
@@ -3785,6 +3900,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 				}
 				switch_channel_clear_flag(originate_status[i].peer_channel, CF_ORIGINATING);
 
+				originate_unwatch(&originate_status[i]);
 				switch_core_session_rwunlock(originate_status[i].peer_session);
 			}
 
@@ -3837,6 +3953,12 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 		}
 	}
   outer_for:
+
+	/* Legs left behind on the way out must not call back into this stack frame */
+	for (i = 0; i < peer_max; i++) {
+		originate_unwatch(&originate_status[i]);
+	}
+
 	switch_safe_free(loop_data);
 	switch_safe_free(odata);
 	switch_safe_free(oglobals.file);
@@ -35,19 +35,422 @@
  */
 
 #include <switch.h>
+#include "private/switch_core_pvt.h"
+
+/* Phrase macros compiled from the core root.
+
+   The languages and phrases sections are turned into hashes of macros whose input patterns are
+   compiled once and whose actions are already decoded, so playing a phrase no longer clones the
+   section nor compiles regexes. The index is built again when the root changes. When a search
+   function is bound to either section the macro comes from the binding on every call as before
+   and only that macro gets compiled. */
+
+typedef enum {
+	PHRASE_ACTION_OTHER,
+	PHRASE_ACTION_PLAY_FILE,
+	PHRASE_ACTION_PHRASE,
+	PHRASE_ACTION_BREAK,
+	PHRASE_ACTION_EXECUTE,
+	PHRASE_ACTION_SAY,
+	PHRASE_ACTION_SPEAK_TEXT
+} phrase_action_type_t;
+
+typedef struct phrase_action_s {
+	phrase_action_type_t type;
+	const char *function;
+	const char *data;
+	const char *phrase;
+	const char *tts_engine;
+	const char *tts_voice;
+	switch_say_args_t say_args;
+	switch_bool_t substitute;
+	struct phrase_action_s *next;
+} phrase_action_t;
+
+typedef struct phrase_input_s {
+	const char *field;
+	const char *pattern;
+	switch_regex_t *re;
+	switch_bool_t captures;
+	switch_bool_t break_on_match;
+	switch_bool_t has_match;
+	switch_bool_t has_nomatch;
+	phrase_action_t *match;
+	phrase_action_t *nomatch;
+	struct phrase_input_s *next;
+	struct phrase_input_s *next_compiled;
+} phrase_input_t;
+
+typedef struct {
+	int pause;
+	phrase_input_t *inputs;
+} phrase_macro_t;
+
+typedef struct {
+	const char *sound_path;
+	const char *sound_prefix_enforced;
+	switch_hash_t *macros;
+} phrase_group_t;
+
+typedef struct {
+	const char *module_name;
+	switch_bool_t deprecated_module;
+	const char *sound_path;
+	const char *tts_engine;
+	const char *tts_voice;
+	phrase_group_t *macros;		/* the first <macros>, or the language itself in the old layout */
+	switch_hash_t *groups;		/* <macros> by name, NULL in the old layout */
+} phrase_language_t;
+
+typedef struct phrase_hash_s {
+	switch_hash_t *hash;
+	struct phrase_hash_s *next;
+} phrase_hash_t;
+
+typedef struct {
+	switch_memory_pool_t *pool;
+	switch_hash_t *languages;
+	phrase_hash_t *hashes;
+	phrase_input_t *compiled;
+	uint32_t generation;
+	int refs;
+} phrase_index_t;
+
+static struct {
+	switch_mutex_t *mutex;
+	phrase_index_t *index;
+} PHRASES;
+
+static switch_hash_t *phrase_index_hash(phrase_index_t *index)
+{
+	phrase_hash_t *ph = switch_core_alloc(index->pool, sizeof(*ph));
+
+	switch_core_hash_init_nocase(&ph->hash);
+	ph->next = index->hashes;
+	index->hashes = ph;
+
+	return ph->hash;
+}
+
+static phrase_index_t *phrase_index_create(uint32_t generation)
+{
+	switch_memory_pool_t *pool = NULL;
+	phrase_index_t *index;
+
+	switch_core_new_memory_pool(&pool);
+	index = switch_core_alloc(pool, sizeof(*index));
+	index->pool = pool;
+	index->generation = generation;
+	index->refs = 1;
+	index->languages = phrase_index_hash(index);
+
+	return index;
+}
+
+static void phrase_index_destroy(phrase_index_t *index)
+{
+	switch_memory_pool_t *pool = index->pool;
+	phrase_input_t *input;
+	phrase_hash_t *ph;
+
+	for (input = index->compiled; input; input = input->next_compiled) {
+		switch_regex_safe_free(input->re);
+	}
+
+	for (ph = index->hashes; ph; ph = ph->next) {
+		switch_core_hash_destroy(&ph->hash);
+	}
+
+	switch_core_destroy_memory_pool(&pool);
+}
+
+static void phrase_index_release(phrase_index_t *index)
+{
+	int refs;
+
+	switch_mutex_lock(PHRASES.mutex);
+	refs = --index->refs;
+	switch_mutex_unlock(PHRASES.mutex);
+
+	if (!refs) {
+		phrase_index_destroy(index);
+	}
+}
+
+static phrase_action_t *phrase_compile_actions(phrase_index_t *index, switch_xml_t xmatch)
+{
+	phrase_action_t *actions = NULL, **tail = &actions, *action;
+	switch_xml_t xaction;
+
+	for (xaction = switch_xml_child(xmatch, "action"); xaction; xaction = xaction->next) {
+		action = switch_core_alloc(index->pool, sizeof(*action));
+		action->function = switch_core_strdup(index->pool, switch_xml_attr_soft(xaction, "function"));
+		action->data = switch_core_strdup(index->pool, switch_xml_attr_soft(xaction, "data"));
+		action->substitute = strchr(action->data, '$') ? SWITCH_TRUE : SWITCH_FALSE;
+
+		if (!strcasecmp(action->function, "play-file")) {
+			action->type = PHRASE_ACTION_PLAY_FILE;
+		} else if (!strcasecmp(action->function, "phrase")) {
+			action->type = PHRASE_ACTION_PHRASE;
+			action->phrase = switch_core_strdup(index->pool, switch_xml_attr_soft(xaction, "phrase"));
+		} else if (!strcasecmp(action->function, "break")) {
+			action->type = PHRASE_ACTION_BREAK;
+		} else if (!strcasecmp(action->function, "execute")) {
+			action->type = PHRASE_ACTION_EXECUTE;
+		} else if (!strcasecmp(action->function, "say")) {
+			action->type = PHRASE_ACTION_SAY;
+			action->say_args.type = switch_ivr_get_say_type_by_name(switch_xml_attr_soft(xaction, "type"));
+			action->say_args.method = switch_ivr_get_say_method_by_name(switch_xml_attr_soft(xaction, "method"));
+			action->say_args.gender = switch_ivr_get_say_gender_by_name(switch_xml_attr_soft(xaction, "gender"));
+		} else if (!strcasecmp(action->function, "speak-text")) {
+			action->type = PHRASE_ACTION_SPEAK_TEXT;
+			action->tts_engine = switch_core_strdup(index->pool, switch_xml_attr(xaction, "tts-engine"));
+			action->tts_voice = switch_core_strdup(index->pool, switch_xml_attr(xaction, "tts-voice"));
+		}
+
+		*tail = action;
+		tail = &action->next;
+	}
+
+	return actions;
+}
+
+static phrase_macro_t *phrase_compile_macro(phrase_index_t *index, switch_xml_t xmacro)
+{
+	phrase_macro_t *macro = switch_core_alloc(index->pool, sizeof(*macro));
+	phrase_input_t *input, **tail = &macro->inputs;
+	switch_xml_t xinput, xmatch;
+	const char *pause_val;
+
+	macro->pause = 100;
+
+	if ((pause_val = switch_xml_attr(xmacro, "pause"))) {
+		int tmp = atoi(pause_val);
+		if (tmp >= 0) {
+			macro->pause = tmp;
+		}
+	}
+
+	for (xinput = switch_xml_child(xmacro, "input"); xinput; xinput = xinput->next) {
+		const char *pattern = switch_xml_attr(xinput, "pattern");
+
+		if (!pattern) {
+			pattern = ".*";
+		}
+
+		input = switch_core_alloc(index->pool, sizeof(*input));
+		input->field = switch_core_strdup(index->pool, switch_xml_attr(xinput, "field"));
+		input->pattern = switch_core_strdup(index->pool, pattern);
+		input->re = switch_regex_compile_expression(pattern);
+		input->captures = strchr(pattern, '(') ? SWITCH_TRUE : SWITCH_FALSE;
+		input->break_on_match = switch_true(switch_xml_attr_soft(xinput, "break_on_match"));
+
+		if ((xmatch = switch_xml_child(xinput, "match"))) {
+			input->has_match = SWITCH_TRUE;
+			input->match = phrase_compile_actions(index, xmatch);
+		}
+
+		if ((xmatch = switch_xml_child(xinput, "nomatch"))) {
+			input->has_nomatch = SWITCH_TRUE;
+			input->nomatch = phrase_compile_actions(index, xmatch);
+		}
+
+		input->next_compiled = index->compiled;
+		index->compiled = input;
+
+		*tail = input;
+		tail = &input->next;
+	}
+
+	return macro;
+}
+
+static void phrase_add_macro(phrase_index_t *index, phrase_group_t *group, switch_xml_t xmacro)
+{
+	const char *name = switch_xml_attr(xmacro, "name");
+
+	/* the first macro of a name wins, as with switch_xml_find_child() */
+	if (name && !switch_core_hash_find(group->macros, name)) {
+		switch_core_hash_insert(group->macros, name, phrase_compile_macro(index, xmacro));
+	}
+}
+
+static phrase_group_t *phrase_compile_group(phrase_index_t *index, switch_xml_t xmacros, switch_bool_t all)
+{
+	phrase_group_t *group = switch_core_alloc(index->pool, sizeof(*group));
+	const char *sound_path;
+	switch_xml_t xmacro;
+
+	if ((sound_path = switch_xml_attr(xmacros, "sound-prefix")) || (sound_path = switch_xml_attr(xmacros, "sound-path")) ||
+		(sound_path = switch_xml_attr(xmacros, "sound_path"))) {
+		group->sound_path = switch_core_strdup(index->pool, sound_path);
+	}
+
+	group->sound_prefix_enforced = switch_core_strdup(index->pool, switch_xml_attr(xmacros, "sound-prefix-enforced"));
+	group->macros = phrase_index_hash(index);
+
+	if (all) {
+		for (xmacro = switch_xml_child(xmacros, "macro"); xmacro; xmacro = xmacro->next) {
+			phrase_add_macro(index, group, xmacro);
+		}
+	}
+
+	return group;
+}
+
+/* xlanguage == xmacros is the old layout where the macros sit right under the language */
+static phrase_language_t *phrase_compile_language(phrase_index_t *index, const char *name, switch_xml_t xlanguage,
+												  switch_xml_t xphrases, switch_xml_t xmacros, switch_bool_t all)
+{
+	phrase_language_t *language = switch_core_alloc(index->pool, sizeof(*language));
+	const char *val;
+	switch_xml_t xgroup;
+
+	if ((val = switch_xml_attr(xlanguage, "say-module"))) {
+	} else if ((val = switch_xml_attr(xlanguage, "module"))) {
+		language->deprecated_module = SWITCH_TRUE;
+	} else {
+		val = name;
+	}
+	language->module_name = switch_core_strdup(index->pool, val);
+
+	if (!(val = switch_xml_attr(xlanguage, "sound-prefix"))) {
+		if (!(val = switch_xml_attr(xlanguage, "sound-path"))) {
+			val = switch_xml_attr(xlanguage, "sound_path");
+		}
+	}
+	language->sound_path = switch_core_strdup(index->pool, val);
+
+	if (!(val = switch_xml_attr(xlanguage, "tts-engine"))) {
+		val = switch_xml_attr(xlanguage, "tts_engine");
+	}
+	language->tts_engine = switch_core_strdup(index->pool, val);
+
+	if (!(val = switch_xml_attr(xlanguage, "tts-voice"))) {
+		val = switch_xml_attr(xlanguage, "tts_voice");
+	}
+	language->tts_voice = switch_core_strdup(index->pool, val);
+
+	language->macros = phrase_compile_group(index, xmacros, all);
+
+	if (xlanguage != xmacros) {
+		language->groups = phrase_index_hash(index);
+
+		if (all) {
+			for (xgroup = switch_xml_child(xphrases, "macros"); xgroup; xgroup = xgroup->next) {
+				if ((val = switch_xml_attr(xgroup, "name")) && !switch_core_hash_find(language->groups, val)) {
+					switch_core_hash_insert(language->groups, val,
+											xgroup == xmacros ? language->macros : phrase_compile_group(index, xgroup, SWITCH_TRUE));
+				}
+			}
+		}
+	}
+
+	return language;
+}
+
+static void phrase_add_language(phrase_index_t *index, switch_xml_t xlanguage, switch_xml_t xphrases, switch_xml_t xmacros)
+{
+	const char *name = switch_xml_attr(xlanguage, "name");
+
+	if (name && !switch_core_hash_find(index->languages, name)) {
+		switch_core_hash_insert(index->languages, name, phrase_compile_language(index, name, xlanguage, xphrases, xmacros, SWITCH_TRUE));
+	}
+}
+
+static phrase_index_t *phrase_index_build(uint32_t generation)
+{
+	phrase_index_t *index = phrase_index_create(generation);
+	switch_xml_t xml, xsection, xlanguage, xphrases, xmacros;
+
+	if (!(xml = switch_xml_root())) {
+		return index;
+	}
+
+	if ((xsection = switch_xml_find_child(xml, "section", "name", "languages"))) {
+		for (xlanguage = switch_xml_child(xsection, "language"); xlanguage; xlanguage = xlanguage->next) {
+			if ((xphrases = switch_xml_child(xlanguage, "phrases")) && (xmacros = switch_xml_child(xphrases, "macros"))) {
+				phrase_add_language(index, xlanguage, xphrases, xmacros);
+			}
+		}
+	} else if ((xsection = switch_xml_find_child(xml, "section", "name", "phrases")) && (xmacros = switch_xml_child(xsection, "macros"))) {
+		for (xlanguage = switch_xml_child(xmacros, "language"); xlanguage; xlanguage = xlanguage->next) {
+			phrase_add_language(index, xlanguage, NULL, xlanguage);
+		}
+	} else {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Open of languages and phrases failed.\n");
+	}
+
+	switch_xml_free(xml);
+
+	return index;
+}
+
+/* The index of the current root, built again if the root was replaced. Release it when done. */
+static phrase_index_t *phrase_index_get(void)
+{
+	uint32_t generation = switch_xml_root_generation();
+	phrase_index_t *index, *old = NULL;
+
+	switch_mutex_lock(PHRASES.mutex);
+
+	if (!PHRASES.index || PHRASES.index->generation != generation) {
+		old = PHRASES.index;
+		PHRASES.index = phrase_index_build(generation);
+		if (old && --old->refs) {
+			old = NULL;
+		}
+	}
+
+	index = PHRASES.index;
+	index->refs++;
+
+	switch_mutex_unlock(PHRASES.mutex);
+
+	if (old) {
+		phrase_index_destroy(old);
+	}
+
+	return index;
+}
+
+void switch_ivr_phrase_init(switch_memory_pool_t *pool)
+{
+	memset(&PHRASES, 0, sizeof(PHRASES));
+	switch_mutex_init(&PHRASES.mutex, SWITCH_MUTEX_NESTED, pool);
+}
+
+void switch_ivr_phrase_shutdown(void)
+{
+	phrase_index_t *index;
+
+	switch_mutex_lock(PHRASES.mutex);
+	index = PHRASES.index;
+	PHRASES.index = NULL;
+	switch_mutex_unlock(PHRASES.mutex);
+
+	if (index) {
+		phrase_index_release(index);
+	}
+}
 
 SWITCH_DECLARE(switch_status_t) switch_ivr_phrase_macro_event(switch_core_session_t *session, const char *macro_name, const char *data, switch_event_t *event, const char *lang,
 														switch_input_args_t *args)
 {
 	switch_event_t *hint_data;
-	switch_xml_t cfg, xml = NULL, language = NULL, macros = NULL, phrases = NULL, macro, input, action;
+	switch_xml_t cfg, xml = NULL, xlanguage = NULL, xmacros = NULL, xphrases = NULL, xmacro;
+	phrase_index_t *index = NULL;
+	phrase_language_t *language = NULL;
+	phrase_group_t *macros = NULL;
+	phrase_macro_t *macro;
+	phrase_input_t *input;
+	phrase_action_t *action;
 	switch_status_t status = SWITCH_STATUS_GENERR;
 	const char *old_sound_prefix = NULL, *sound_path = NULL, *tts_engine = NULL, *tts_voice = NULL;
 	const char *module_name = NULL, *chan_lang = NULL;
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	uint8_t done = 0;
 	int matches = 0;
-	const char *pause_val;
 	int pause = 100;
 	const char *group_macro_name = NULL;
 	const char *local_macro_name = macro_name;
@@ -87,61 +490,69 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_phrase_macro_event(switch_core_sessio
 	}
 	switch_channel_event_set_data(channel, hint_data);
 
-	if (switch_xml_locate_language(&xml, &cfg, hint_data, &language, &phrases, &macros, chan_lang) != SWITCH_STATUS_SUCCESS) {
-		goto done;
-	}
+	if (!switch_xml_section_bound("languages") && !switch_xml_section_bound("phrases")) {
+		index = phrase_index_get();
 
-	if ((module_name = switch_xml_attr(language, "say-module"))) {
-	} else if ((module_name = switch_xml_attr(language, "module"))) {
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "Deprecated usage of module attribute. Use say-module instead\n");
+		if (!(language = switch_core_hash_find(index->languages, chan_lang))) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Can't find language %s.\n", chan_lang);
+			goto done;
+		}
 	} else {
-		module_name = chan_lang;
-	}
-
-	if (!(sound_path = (char *) switch_xml_attr(language, "sound-prefix"))) {
-		if (!(sound_path = (char *) switch_xml_attr(language, "sound-path"))) {
-			sound_path = (char *) switch_xml_attr(language, "sound_path");
+		if (switch_xml_locate_language(&xml, &cfg, hint_data, &xlanguage, &xphrases, &xmacros, chan_lang) != SWITCH_STATUS_SUCCESS) {
+			goto done;
 		}
-	}
 
-	if (!(tts_engine = (char *) switch_xml_attr(language, "tts-engine"))) {
-		tts_engine = (char *) switch_xml_attr(language, "tts_engine");
+		/* only what this call needs goes into a private index */
+		index = phrase_index_create(0);
+		language = phrase_compile_language(index, chan_lang, xlanguage, xphrases, xmacros, SWITCH_FALSE);
 	}
 
-	if (!(tts_voice = (char *) switch_xml_attr(language, "tts-voice"))) {
-		tts_voice = (char *) switch_xml_attr(language, "tts_voice");
+	if (language->deprecated_module) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "Deprecated usage of module attribute. Use say-module instead\n");
 	}
 
+	module_name = language->module_name;
+	sound_path = language->sound_path;
+	tts_engine = language->tts_engine;
+	tts_voice = language->tts_voice;
+	macros = language->macros;
+
 	/* If we use the new structure, check for a group name */
-	if (language != macros) {
+	if (language->groups) {
 		char *p;
 		char *macro_name_dup = switch_core_session_strdup(session, macro_name);
-		const char *group_sound_path;
-		const char *sound_prefix_enforced_str;
 
 		if ((p = strchr(macro_name_dup, '@'))) {
 			*p++ = '\0';
 			local_macro_name = macro_name_dup;
 			group_macro_name = p;
 
-			if (!(macros = switch_xml_find_child(phrases, "macros", "name", group_macro_name))) {
+			if (xml && (xmacros = switch_xml_find_child(xphrases, "macros", "name", group_macro_name))) {
+				switch_core_hash_insert(language->groups, group_macro_name, phrase_compile_group(index, xmacros, SWITCH_FALSE));
+			}
+
+			if (!(macros = switch_core_hash_find(language->groups, group_macro_name))) {
 				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Can't find macros group %s.\n", group_macro_name);
 				goto done;
 			}
 		}
 		/* Support override of certain language attribute */
-		if ((group_sound_path = (char *) switch_xml_attr(macros, "sound-prefix")) || (group_sound_path = (char *) switch_xml_attr(macros, "sound-path")) || (group_sound_path = (char *) switch_xml_attr(macros, "sound_path"))) {
-			sound_path = group_sound_path;
+		if (macros->sound_path) {
+			sound_path = macros->sound_path;
 		}
 
-		if (sound_prefix_enforced == SWITCH_FALSE && (sound_prefix_enforced_str = switch_xml_attr(macros, "sound-prefix-enforced"))
-				&& (local_sound_prefix_enforced = switch_true(sound_prefix_enforced_str)) == SWITCH_TRUE) {
-			switch_channel_set_variable(channel, "sound_prefix_enforced", sound_prefix_enforced_str);
+		if (sound_prefix_enforced == SWITCH_FALSE && macros->sound_prefix_enforced
+				&& (local_sound_prefix_enforced = switch_true(macros->sound_prefix_enforced)) == SWITCH_TRUE) {
+			switch_channel_set_variable(channel, "sound_prefix_enforced", macros->sound_prefix_enforced);
 		}
 
 	}
 
-	if (!(macro = switch_xml_find_child(macros, "macro", "name", local_macro_name))) {
+	if (xml && (xmacro = switch_xml_find_child(xmacros, "macro", "name", local_macro_name))) {
+		phrase_add_macro(index, macros, xmacro);
+	}
+
+	if (!(macro = switch_core_hash_find(macros->macros, local_macro_name))) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Can't find macro %s.\n", macro_name);
 		goto done;
 	}
@@ -154,14 +565,9 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_phrase_macro_event(switch_core_sessio
 		switch_channel_set_variable(channel, "sound_prefix", sound_path);
 	}
 
-	if ((pause_val = switch_xml_attr(macro, "pause"))) {
-		int tmp = atoi(pause_val);
-		if (tmp >= 0) {
-			pause = tmp;
-		}
-	}
+	pause = macro->pause;
 
-	if (!(input = switch_xml_child(macro, "input"))) {
+	if (!(input = macro->inputs)) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Can't find any input tags.\n");
 		goto done;
 	}
@@ -172,14 +578,12 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_phrase_macro_event(switch_core_sessio
 	}
 
 	while (input && !done) {
-		char *field = (char *) switch_xml_attr(input, "field");
-		char *pattern = (char *) switch_xml_attr(input, "pattern");
-		const char *do_break = switch_xml_attr_soft(input, "break_on_match");
+		const char *field = input->field;
 		char *field_expanded = NULL;
 		char *field_expanded_alloc = NULL;
 
 		if (!field) {
-			field = (char *) data;
+			field = data;
 		}
 		if (event) {
 			field_expanded_alloc = switch_event_expand_headers(event, field);
@@ -189,51 +593,44 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_phrase_macro_event(switch_core_sessio
 
 		if (field_expanded_alloc == field) {
 			field_expanded_alloc = NULL;
-			field_expanded = field;
+			field_expanded = (char *) field;
 		} else {
 			field_expanded = field_expanded_alloc;
 		}
 
-		if (!pattern) {
-			pattern = ".*";
-		}
-
-		if (pattern) {
-			switch_regex_t *re = NULL;
+		{
 			int proceed = 0, ovector[100];
 			char *substituted = NULL;
 			uint32_t len = 0;
-			char *odata = NULL;
+			const char *odata = NULL;
 			char *expanded = NULL;
-			switch_xml_t match = NULL;
+			switch_bool_t has_match;
 
 			status = SWITCH_STATUS_SUCCESS;
 
-			if ((proceed = switch_regex_perform(field_expanded, pattern, &re, ovector, sizeof(ovector) / sizeof(ovector[0])))) {
-				match = switch_xml_child(input, "match");
+			if ((proceed = switch_regex_exec(input->re, field_expanded, ovector, sizeof(ovector) / sizeof(ovector[0])))) {
+				has_match = input->has_match;
+				action = input->match;
 			} else {
-				match = switch_xml_child(input, "nomatch");
+				has_match = input->has_nomatch;
+				action = input->nomatch;
 			}
 
-			if (match) {
+			if (has_match) {
 				matches++;
-				for (action = switch_xml_child(match, "action"); action && status == SWITCH_STATUS_SUCCESS; action = action->next) {
-					char *adata = (char *) switch_xml_attr_soft(action, "data");
-					char *func = (char *) switch_xml_attr_soft(action, "function");
-
-					if (strchr(pattern, '(') && strchr(adata, '$') && proceed > 0) {
-						len = (uint32_t) (strlen(data) + strlen(adata) + 10) * proceed;
+				for (; action && status == SWITCH_STATUS_SUCCESS; action = action->next) {
+					if (input->captures && action->substitute && proceed > 0) {
+						len = (uint32_t) (strlen(data) + strlen(action->data) + 10) * proceed;
 						if (!(substituted = malloc(len))) {
 							switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Memory Error!\n");
-							switch_regex_safe_free(re);
 							switch_safe_free(expanded);
 							goto done;
 						}
 						memset(substituted, 0, len);
-						switch_perform_substitution(re, proceed, adata, field_expanded, substituted, len, ovector);
+						switch_perform_substitution(input->re, proceed, action->data, field_expanded, substituted, len, ovector);
 						odata = substituted;
 					} else {
-						odata = adata;
+						odata = action->data;
 					}
 
 					if (event) {
@@ -248,67 +645,74 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_phrase_macro_event(switch_core_sessio
 						odata = expanded;
 					}
 
-					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Handle %s:[%s] (%s:%s)\n", func, odata, chan_lang,
+					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Handle %s:[%s] (%s:%s)\n", action->function, odata, chan_lang,
 									  module_name);
 
-					if (!strcasecmp(func, "play-file")) {
+					switch (action->type) {
+					case PHRASE_ACTION_PLAY_FILE:
 						status = switch_ivr_play_file(session, NULL, odata, args);
-					} else if (!strcasecmp(func, "phrase")) {
-						char *name = (char *) switch_xml_attr_soft(action, "phrase");
-						status = switch_ivr_phrase_macro(session, name, odata, chan_lang, args);
-					} else if (!strcasecmp(func, "break")) {
+						break;
+					case PHRASE_ACTION_PHRASE:
+						status = switch_ivr_phrase_macro(session, action->phrase, odata, chan_lang, args);
+						break;
+					case PHRASE_ACTION_BREAK:
 						done = 1;
 						/* must allow the switch_safe_free below to execute or we leak - do not break here */
-					} else if (!strcasecmp(func, "execute")) {
-						switch_application_interface_t *app;
-						char *cmd, *cmd_args;
-						status = SWITCH_STATUS_FALSE;
-
-						cmd = switch_core_session_strdup(session, odata);
-						cmd_args = switch_separate_paren_args(cmd);
-
-						if (!cmd_args) {
-							cmd_args = "";
-						}
-
-						if ((app = switch_loadable_module_get_application_interface(cmd)) != NULL) {
-							status = switch_core_session_exec(session, app, cmd_args);
-							UNPROTECT_INTERFACE(app);
-						} else {
-							switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Invalid Application %s\n", cmd);
-						}
-					} else if (!strcasecmp(func, "say")) {
-						switch_say_interface_t *si;
-						if ((si = switch_loadable_module_get_say_interface(module_name))) {
-							char *say_type = (char *) switch_xml_attr_soft(action, "type");
-							char *say_method = (char *) switch_xml_attr_soft(action, "method");
-							char *say_gender = (char *) switch_xml_attr_soft(action, "gender");
-							switch_say_args_t say_args = {0};
-
-							say_args.type = switch_ivr_get_say_type_by_name(say_type);
-							say_args.method = switch_ivr_get_say_method_by_name(say_method);
-							say_args.gender = switch_ivr_get_say_gender_by_name(say_gender);
-
-							status = si->say_function(session, odata, &say_args, args);
-						} else {
-							switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Invalid SAY Interface [%s]!\n", module_name);
-						}
-					} else if (!strcasecmp(func, "speak-text")) {
-						const char *my_tts_engine = switch_xml_attr(action, "tts-engine");
-						const char *my_tts_voice = switch_xml_attr(action, "tts-voice");
-
-						if (!my_tts_engine) {
-							my_tts_engine = tts_engine;
+						break;
+					case PHRASE_ACTION_EXECUTE:
+						{
+							switch_application_interface_t *app;
+							char *cmd, *cmd_args;
+							status = SWITCH_STATUS_FALSE;
+
+							cmd = switch_core_session_strdup(session, odata);
+							cmd_args = switch_separate_paren_args(cmd);
+
+							if (!cmd_args) {
+								cmd_args = "";
+							}
+
+							if ((app = switch_loadable_module_get_application_interface(cmd)) != NULL) {
+								status = switch_core_session_exec(session, app, cmd_args);
+								UNPROTECT_INTERFACE(app);
+							} else {
+								switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Invalid Application %s\n", cmd);
+							}
 						}
-
-						if (!my_tts_voice) {
-							my_tts_voice = tts_voice;
+						break;
+					case PHRASE_ACTION_SAY:
+						{
+							switch_say_interface_t *si;
+							if ((si = switch_loadable_module_get_say_interface(module_name))) {
+								switch_say_args_t say_args = action->say_args;
+
+								status = si->say_function(session, (char *) odata, &say_args, args);
+							} else {
+								switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Invalid SAY Interface [%s]!\n", module_name);
+							}
 						}
-						if (zstr(tts_engine) || zstr(tts_voice)) {
-							switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "TTS is not configured\n");
-						} else {
-							status = switch_ivr_speak_text(session, my_tts_engine, my_tts_voice, odata, args);
+						break;
+					case PHRASE_ACTION_SPEAK_TEXT:
+						{
+							const char *my_tts_engine = action->tts_engine;
+							const char *my_tts_voice = action->tts_voice;
+
+							if (!my_tts_engine) {
+								my_tts_engine = tts_engine;
+							}
+
+							if (!my_tts_voice) {
+								my_tts_voice = tts_voice;
+							}
+							if (zstr(tts_engine) || zstr(tts_voice)) {
+								switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "TTS is not configured\n");
+							} else {
+								status = switch_ivr_speak_text(session, my_tts_engine, my_tts_voice, (char *) odata, args);
+							}
 						}
+						break;
+					default:
+						break;
 					}
 
 					switch_ivr_sleep(session, pause, SWITCH_FALSE, NULL);
@@ -318,9 +722,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_phrase_macro_event(switch_core_sessio
 				}
 			}
 
-			switch_regex_safe_free(re);
-
-			if ((match && do_break && switch_true(do_break)) || status == SWITCH_STATUS_BREAK) {
+			if ((has_match && input->break_on_match) || status == SWITCH_STATUS_BREAK) {
 				break;
 			}
 
@@ -355,6 +757,10 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_phrase_macro_event(switch_core_sessio
 		switch_channel_set_variable(channel, "sound_prefix_enforced", NULL);
 	}
 
+	if (index) {
+		phrase_index_release(index);
+	}
+
 	if (xml) {
 		switch_xml_free(xml);
 	}
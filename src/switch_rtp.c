@@ -1265,6 +1265,8 @@ static void zrtp_event_callback(zrtp_stream_t *stream, unsigned event)
 				}
 			}
 
+			switch_channel_set_variable_printf(channel, "secure_type", "zrtp:%s:%s", stream->session->sas1.buffer, stream->session->sas2.buffer);
+
 			if (switch_event_create(&fsevent, SWITCH_EVENT_CALL_SECURE) == SWITCH_STATUS_SUCCESS) {
 				switch_event_add_header(fsevent, SWITCH_STACK_BOTTOM, "secure_media_type", "%s", type);
 				switch_event_add_header(fsevent, SWITCH_STACK_BOTTOM, "secure_type", "zrtp:%s:%s", stream->session->sas1.buffer,
@@ -1382,6 +1384,9 @@ SWITCH_DECLARE(void) switch_rtp_init(switch_memory_pool_t *pool)
 #endif
 #ifdef ENABLE_SRTP
 	srtp_init();
+#ifndef OPENSSL
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "libsrtp was built without OpenSSL, SRTP will use the slow generic AES code and has no AES-GCM\n");
+#endif
 #endif
 	switch_mutex_init(&port_lock, SWITCH_MUTEX_NESTED, pool);
 	global_init = 1;
@@ -3163,6 +3168,12 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_add_crypto_key(switch_rtp_t *rtp_sess
 		break;
 	}
 
+	if (rtp_session->dtls) {
+		switch_channel_set_variable(channel, "secure_type", "srtp:dtls:AES_CM_128_HMAC_SHA1_80");
+	} else {
+		switch_channel_set_variable_printf(channel, "secure_type", "srtp:sdes:%s", switch_channel_get_variable(channel, "rtp_has_crypto"));
+	}
+
 	if (switch_event_create(&fsevent, SWITCH_EVENT_CALL_SECURE) == SWITCH_STATUS_SUCCESS) {
 		if (rtp_session->dtls) {
 			switch_event_add_header(fsevent, SWITCH_STACK_BOTTOM, "secure_type", "srtp:dtls:AES_CM_128_HMAC_SHA1_80");
@@ -58,6 +58,7 @@
 #include <switch.h>
 #ifndef WIN32
 #include <sys/wait.h>
+#include <sys/mman.h>
 #include <switch_private.h>
 #include <glob.h>
 #else /* we're on windoze :( */
@@ -141,7 +142,9 @@ static void preprocess_exec_set(char *keyval)
 	}
 }
 
-static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rlevel);
+typedef struct xml_pp_ctx xml_pp_ctx_t;
+
+static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rlevel, xml_pp_ctx_t *ctx);
 
 typedef struct switch_xml_root *switch_xml_root_t;
 struct switch_xml_root {		/* additional data for the root tag */
@@ -172,6 +175,7 @@ struct switch_xml_binding {
 
 static switch_xml_binding_t *BINDINGS = NULL;
 static switch_xml_t MAIN_XML_ROOT = NULL;
+static uint32_t MAIN_XML_GENERATION = 0;
 static switch_memory_pool_t *XML_MEMORY_POOL = NULL;
 
 static switch_thread_rwlock_t *B_RWLOCK = NULL;
@@ -1222,7 +1226,570 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_fd(int fd)
 	return &root->xml;
 }
 
-static char *expand_vars(char *buf, char *ebuf, switch_size_t elen, switch_size_t *newlen, const char **err)
+/* Preprocessor cache of the core root.
+
+   Every top level include of the root file is kept as a fragment holding its preprocessed text,
+   the files and glob patterns it was built from and the values of the $${vars} it expanded.
+   A reload copies a fragment whose inputs are all unchanged instead of preprocessing it again,
+   so only the includes that changed are read. Fragments that set variables or run exec are not
+   kept, their side effects have to happen on every load. Files are compared by size, inode and
+   mtime and ctime to the nanosecond, so an edit within the same second or a file replaced by
+   a rename is still seen. Where stat only has seconds "reloadxml full" drops the cache.
+
+   The cache is saved next to the preprocessed root so a restart only preprocesses what changed
+   while it was down. */
+
+#define XML_PP_MAGIC "FSXMLPP3"
+#define XML_PP_NONE 0xffffffff
+#define XML_PP_HASH_INIT 14695981039346656037ULL
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+typedef enum {
+	XML_PP_DEP_FILE,
+	XML_PP_DEP_GLOB
+} xml_pp_dep_type_t;
+
+typedef struct xml_pp_dep {
+	xml_pp_dep_type_t type;
+	char *path;
+	int64_t mtime;				/* in nanoseconds */
+	int64_t ctime;				/* in nanoseconds */
+	uint64_t ino;
+	int64_t size;				/* -1 when the file could not be opened, number of paths of a glob */
+	uint64_t hash;				/* of the paths a glob matched */
+	struct xml_pp_dep *next;
+} xml_pp_dep_t;
+
+typedef struct xml_pp_var {
+	char *name;
+	char *value;
+	struct xml_pp_var *next;
+} xml_pp_var_t;
+
+typedef struct xml_pp_frag {
+	char *key;
+	char *section;
+	char *text;
+	uint32_t len;
+	xml_pp_dep_t *deps;
+	xml_pp_var_t *vars;
+	int uncacheable;
+	struct xml_pp_frag *next;
+} xml_pp_frag_t;
+
+struct xml_pp_ctx {
+	xml_pp_frag_t *old;			/* fragments of the last load, taken as they are matched */
+	xml_pp_frag_t *frags;		/* fragments of this load */
+	xml_pp_frag_t **tail;
+	xml_pp_frag_t *cur;			/* fragment being preprocessed */
+	char section[128];
+	uint64_t hash;				/* of everything written */
+	uint64_t len;
+	uint64_t last_hash;
+	uint64_t last_len;
+	int can_keep;				/* the running root may be kept if the output did not change */
+	int unchanged;
+	int reused;
+	int rebuilt;
+	int dirty;					/* the saved cache is stale */
+};
+
+/* protected by XML_LOCK */
+static xml_pp_frag_t *PP_FRAGS = NULL;
+static uint64_t PP_HASH = 0;
+static uint64_t PP_LEN = 0;
+
+/* 64 bit FNV-1a, together with the length it stands in for comparing the bytes */
+static uint64_t xml_pp_hash(uint64_t hash, const char *buf, switch_size_t len)
+{
+	switch_size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash = (hash ^ (uint8_t) buf[i]) * 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+static uint64_t xml_pp_glob_hash(glob_t *glob_data)
+{
+	uint64_t hash = XML_PP_HASH_INIT;
+	size_t n;
+
+	for (n = 0; n < glob_data->gl_pathc; ++n) {
+		hash = xml_pp_hash(hash, glob_data->gl_pathv[n], strlen(glob_data->gl_pathv[n]) + 1);
+	}
+
+	return hash;
+}
+
+static void xml_pp_free_frags(xml_pp_frag_t *frag)
+{
+	xml_pp_frag_t *next;
+	xml_pp_dep_t *dep;
+	xml_pp_var_t *var;
+
+	for (; frag; frag = next) {
+		next = frag->next;
+
+		while ((dep = frag->deps)) {
+			frag->deps = dep->next;
+			free(dep->path);
+			free(dep);
+		}
+
+		while ((var = frag->vars)) {
+			frag->vars = var->next;
+			free(var->name);
+			switch_safe_free(var->value);
+			free(var);
+		}
+
+		switch_safe_free(frag->key);
+		switch_safe_free(frag->section);
+		switch_safe_free(frag->text);
+		free(frag);
+	}
+}
+
+/* What a file dependency is compared by, st is NULL when the file could not be opened */
+static void xml_pp_stat_dep(xml_pp_dep_t *dep, const struct stat *st)
+{
+	if (!st) {
+		dep->mtime = dep->ctime = 0;
+		dep->ino = 0;
+		dep->size = -1;
+		return;
+	}
+
+#if defined(HAVE_STRUCT_STAT_ST_MTIM) && defined(HAVE_STRUCT_STAT_ST_CTIM)
+	dep->mtime = (int64_t) st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+	dep->ctime = (int64_t) st->st_ctim.tv_sec * 1000000000 + st->st_ctim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC) && defined(HAVE_STRUCT_STAT_ST_CTIMESPEC)
+	dep->mtime = (int64_t) st->st_mtimespec.tv_sec * 1000000000 + st->st_mtimespec.tv_nsec;
+	dep->ctime = (int64_t) st->st_ctimespec.tv_sec * 1000000000 + st->st_ctimespec.tv_nsec;
+#else
+	dep->mtime = (int64_t) st->st_mtime * 1000000000;
+	dep->ctime = (int64_t) st->st_ctime * 1000000000;
+#endif
+	dep->ino = (uint64_t) st->st_ino;
+	dep->size = (int64_t) st->st_size;
+}
+
+static xml_pp_dep_t *xml_pp_add_dep(xml_pp_ctx_t *ctx, xml_pp_dep_type_t type, const char *path)
+{
+	xml_pp_dep_t *dep;
+
+	if (!ctx || !ctx->cur) {
+		return NULL;
+	}
+
+	dep = calloc(1, sizeof(*dep));
+	switch_assert(dep);
+	dep->type = type;
+	dep->path = strdup(path);
+	dep->next = ctx->cur->deps;
+	ctx->cur->deps = dep;
+
+	return dep;
+}
+
+static void xml_pp_add_var(xml_pp_ctx_t *ctx, const char *name, const char *value)
+{
+	xml_pp_var_t *var;
+
+	if (!ctx || !ctx->cur) {
+		return;
+	}
+
+	for (var = ctx->cur->vars; var; var = var->next) {
+		if (!strcmp(var->name, name)) {
+			return;
+		}
+	}
+
+	var = calloc(1, sizeof(*var));
+	switch_assert(var);
+	var->name = strdup(name);
+	var->value = value ? strdup(value) : NULL;
+	var->next = ctx->cur->vars;
+	ctx->cur->vars = var;
+}
+
+static void xml_pp_uncacheable(xml_pp_ctx_t *ctx)
+{
+	if (ctx && ctx->cur) {
+		ctx->cur->uncacheable = 1;
+	}
+}
+
+static switch_bool_t xml_pp_frag_valid(xml_pp_frag_t *frag)
+{
+	xml_pp_dep_t *dep;
+	xml_pp_var_t *var;
+	struct stat st;
+	glob_t glob_data;
+	uint64_t hash;
+	int64_t count;
+	char *val;
+	int same;
+
+	for (dep = frag->deps; dep; dep = dep->next) {
+		if (dep->type == XML_PP_DEP_GLOB) {
+			if (glob(dep->path, GLOB_NOCHECK, NULL, &glob_data) != 0) {
+				return SWITCH_FALSE;
+			}
+			hash = xml_pp_glob_hash(&glob_data);
+			count = (int64_t) glob_data.gl_pathc;
+			globfree(&glob_data);
+
+			if (count != dep->size || hash != dep->hash) {
+				return SWITCH_FALSE;
+			}
+		} else {
+			xml_pp_dep_t now = { 0 };
+
+			xml_pp_stat_dep(&now, stat(dep->path, &st) ? NULL : &st);
+
+			if (now.size != dep->size || now.mtime != dep->mtime || now.ctime != dep->ctime || now.ino != dep->ino) {
+				return SWITCH_FALSE;
+			}
+		}
+	}
+
+	for (var = frag->vars; var; var = var->next) {
+		val = switch_core_get_variable_dup(var->name);
+		same = val ? (var->value && !strcmp(val, var->value)) : !var->value;
+		switch_safe_free(val);
+
+		if (!same) {
+			return SWITCH_FALSE;
+		}
+	}
+
+	return SWITCH_TRUE;
+}
+
+static xml_pp_frag_t *xml_pp_take_frag(xml_pp_ctx_t *ctx, const char *key)
+{
+	xml_pp_frag_t *frag, **fp;
+
+	for (fp = &ctx->old; (frag = *fp); fp = &frag->next) {
+		if (!strcmp(frag->key, key)) {
+			*fp = frag->next;
+			frag->next = NULL;
+			return frag;
+		}
+	}
+
+	return NULL;
+}
+
+static void xml_pp_note_section(xml_pp_ctx_t *ctx, const char *line)
+{
+	const char *p, *e;
+	switch_size_t len;
+
+	if ((p = strstr(line, "<section")) && (p = strstr(p, "name=\"")) && (e = strchr(p += 6, '"'))) {
+		len = (switch_size_t) (e - p) + 1;
+		switch_copy_string(ctx->section, p, len < sizeof(ctx->section) ? len : sizeof(ctx->section));
+	}
+}
+
+static switch_size_t preprocess_write(xml_pp_ctx_t *ctx, const char *buf, switch_size_t len, FILE *write_fd)
+{
+	if (ctx) {
+		ctx->hash = xml_pp_hash(ctx->hash, buf, len);
+		ctx->len += len;
+	}
+
+	return fwrite(buf, 1, len, write_fd);
+}
+
+static void xml_pp_put(FILE *fp, const void *data, switch_size_t len, int *err)
+{
+	if (!*err && len && fwrite(data, 1, len, fp) != len) {
+		*err = 1;
+	}
+}
+
+static void xml_pp_put_str(FILE *fp, const char *str, uint32_t len, int *err)
+{
+	uint32_t none = XML_PP_NONE;
+
+	if (!str) {
+		xml_pp_put(fp, &none, sizeof(none), err);
+		return;
+	}
+
+	xml_pp_put(fp, &len, sizeof(len), err);
+	xml_pp_put(fp, str, len, err);
+}
+
+/* The cache is only ever read back by the host that wrote it, integers are in host order */
+static void xml_pp_save(const char *path)
+{
+	char *tmp = switch_mprintf("%s.tmp", path);
+	xml_pp_frag_t *frag;
+	xml_pp_dep_t *dep;
+	xml_pp_var_t *var;
+	uint32_t count;
+	uint8_t type;
+	FILE *fp;
+	int err = 0;
+
+	if (!(fp = fopen(tmp, "wb"))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Cannot write %s\n", tmp);
+		free(tmp);
+		return;
+	}
+
+	setvbuf(fp, (char *) NULL, _IOFBF, 65536);
+
+	xml_pp_put(fp, XML_PP_MAGIC, strlen(XML_PP_MAGIC), &err);
+
+	for (count = 0, frag = PP_FRAGS; frag; frag = frag->next) {
+		count++;
+	}
+	xml_pp_put(fp, &count, sizeof(count), &err);
+
+	for (frag = PP_FRAGS; frag; frag = frag->next) {
+		xml_pp_put_str(fp, frag->key, (uint32_t) strlen(frag->key), &err);
+		xml_pp_put_str(fp, frag->section, (uint32_t) strlen(frag->section), &err);
+		xml_pp_put_str(fp, frag->text, frag->len, &err);
+
+		for (count = 0, dep = frag->deps; dep; dep = dep->next) {
+			count++;
+		}
+		xml_pp_put(fp, &count, sizeof(count), &err);
+
+		for (dep = frag->deps; dep; dep = dep->next) {
+			type = (uint8_t) dep->type;
+			xml_pp_put(fp, &type, sizeof(type), &err);
+			xml_pp_put_str(fp, dep->path, (uint32_t) strlen(dep->path), &err);
+			xml_pp_put(fp, &dep->mtime, sizeof(dep->mtime), &err);
+			xml_pp_put(fp, &dep->ctime, sizeof(dep->ctime), &err);
+			xml_pp_put(fp, &dep->ino, sizeof(dep->ino), &err);
+			xml_pp_put(fp, &dep->size, sizeof(dep->size), &err);
+			xml_pp_put(fp, &dep->hash, sizeof(dep->hash), &err);
+		}
+
+		for (count = 0, var = frag->vars; var; var = var->next) {
+			count++;
+		}
+		xml_pp_put(fp, &count, sizeof(count), &err);
+
+		for (var = frag->vars; var; var = var->next) {
+			xml_pp_put_str(fp, var->name, (uint32_t) strlen(var->name), &err);
+			xml_pp_put_str(fp, var->value, var->value ? (uint32_t) strlen(var->value) : 0, &err);
+		}
+	}
+
+	if (fclose(fp) || err) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Short write on %s\n", tmp);
+		unlink(tmp);
+	} else {
+		unlink(path);
+		if (rename(tmp, path)) {
+			unlink(tmp);
+		}
+	}
+
+	free(tmp);
+}
+
+typedef struct {
+	const char *p;
+	const char *e;
+} xml_pp_reader_t;
+
+static int xml_pp_get(xml_pp_reader_t *r, void *data, switch_size_t len)
+{
+	if ((switch_size_t) (r->e - r->p) < len) {
+		return -1;
+	}
+
+	memcpy(data, r->p, len);
+	r->p += len;
+
+	return 0;
+}
+
+static int xml_pp_get_str(xml_pp_reader_t *r, char **str, uint32_t *lenp)
+{
+	uint32_t len;
+
+	*str = NULL;
+
+	if (xml_pp_get(r, &len, sizeof(len))) {
+		return -1;
+	}
+
+	if (len == XML_PP_NONE) {
+		return 0;
+	}
+
+	if ((switch_size_t) (r->e - r->p) < len) {
+		return -1;
+	}
+
+	*str = malloc(len + 1);
+	switch_assert(*str);
+	memcpy(*str, r->p, len);
+	(*str)[len] = '\0';
+	r->p += len;
+
+	if (lenp) {
+		*lenp = len;
+	}
+
+	return 0;
+}
+
+static xml_pp_frag_t *xml_pp_parse(xml_pp_reader_t *r)
+{
+	xml_pp_frag_t *frags = NULL, **tail = &frags, *frag;
+	xml_pp_dep_t *dep;
+	xml_pp_var_t *var;
+	uint32_t nfrags, count;
+	uint8_t type;
+
+	if ((switch_size_t) (r->e - r->p) < strlen(XML_PP_MAGIC) || memcmp(r->p, XML_PP_MAGIC, strlen(XML_PP_MAGIC))) {
+		return NULL;
+	}
+	r->p += strlen(XML_PP_MAGIC);
+
+	if (xml_pp_get(r, &nfrags, sizeof(nfrags))) {
+		return NULL;
+	}
+
+	while (nfrags--) {
+		frag = calloc(1, sizeof(*frag));
+		switch_assert(frag);
+		*tail = frag;
+		tail = &frag->next;
+
+		if (xml_pp_get_str(r, &frag->key, NULL) || !frag->key ||
+			xml_pp_get_str(r, &frag->section, NULL) || !frag->section ||
+			xml_pp_get_str(r, &frag->text, &frag->len) || !frag->text || xml_pp_get(r, &count, sizeof(count))) {
+			goto error;
+		}
+
+		while (count--) {
+			dep = calloc(1, sizeof(*dep));
+			switch_assert(dep);
+			dep->next = frag->deps;
+			frag->deps = dep;
+
+			if (xml_pp_get(r, &type, sizeof(type)) || xml_pp_get_str(r, &dep->path, NULL) || !dep->path ||
+				xml_pp_get(r, &dep->mtime, sizeof(dep->mtime)) || xml_pp_get(r, &dep->ctime, sizeof(dep->ctime)) ||
+				xml_pp_get(r, &dep->ino, sizeof(dep->ino)) || xml_pp_get(r, &dep->size, sizeof(dep->size)) ||
+				xml_pp_get(r, &dep->hash, sizeof(dep->hash))) {
+				goto error;
+			}
+			dep->type = type == XML_PP_DEP_GLOB ? XML_PP_DEP_GLOB : XML_PP_DEP_FILE;
+		}
+
+		if (xml_pp_get(r, &count, sizeof(count))) {
+			goto error;
+		}
+
+		while (count--) {
+			var = calloc(1, sizeof(*var));
+			switch_assert(var);
+			var->next = frag->vars;
+			frag->vars = var;
+
+			if (xml_pp_get_str(r, &var->name, NULL) || !var->name || xml_pp_get_str(r, &var->value, NULL)) {
+				goto error;
+			}
+		}
+	}
+
+	return frags;
+
+  error:
+
+	xml_pp_free_frags(frags);
+
+	return NULL;
+}
+
+/* Map the cache saved by the last run, any inconsistency just means a full preprocess */
+static xml_pp_frag_t *xml_pp_load(const char *path)
+{
+	xml_pp_frag_t *frags = NULL;
+	xml_pp_reader_t r;
+	struct stat st;
+	char *m = NULL;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY | O_BINARY, 0)) < 0) {
+		return NULL;
+	}
+
+	if (fstat(fd, &st) || !st.st_size) {
+		goto end;
+	}
+
+#ifndef WIN32
+	if ((m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		m = NULL;
+		goto end;
+	}
+#else
+	m = malloc(st.st_size);
+	switch_assert(m);
+	if (read(fd, m, st.st_size) != st.st_size) {
+		goto end;
+	}
+#endif
+
+	r.p = m;
+	r.e = m + st.st_size;
+
+	if (!(frags = xml_pp_parse(&r))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Ignoring unusable preprocessor cache %s\n", path);
+	}
+
+  end:
+
+#ifndef WIN32
+	if (m) {
+		munmap(m, st.st_size);
+	}
+#else
+	switch_safe_free(m);
+#endif
+	close(fd);
+
+	return frags;
+}
+
+static char *xml_pp_cache_path(void)
+{
+	return switch_mprintf("%s%s%s.fsxml.cache", SWITCH_GLOBAL_dirs.log_dir, SWITCH_PATH_SEPARATOR, SWITCH_GLOBAL_filenames.conf_name);
+}
+
+SWITCH_DECLARE(void) switch_xml_clear_preprocess_cache(void)
+{
+	char *path = xml_pp_cache_path();
+
+	switch_mutex_lock(XML_LOCK);
+	xml_pp_free_frags(PP_FRAGS);
+	PP_FRAGS = NULL;
+	PP_HASH = 0;
+	PP_LEN = 0;
+	unlink(path);
+	switch_mutex_unlock(XML_LOCK);
+
+	free(path);
+}
+
+static char *expand_vars(char *buf, char *ebuf, switch_size_t elen, switch_size_t *newlen, const char **err, xml_pp_ctx_t *ctx)
 {
 	char *var, *val;
 	char *rp = buf;
@@ -1244,7 +1811,9 @@ static char *expand_vars(char *buf, char *ebuf, switch_size_t elen, switch_size_
 				var = rp;
 				*e++ = '\0';
 				rp = e;
-				if ((val = switch_core_get_variable_dup(var))) {
+				val = switch_core_get_variable_dup(var);
+				xml_pp_add_var(ctx, var, val);
+				if (val) {
 					char *p;
 					for (p = val; p && *p && wp <= ep; p++) {
 						*wp++ = *p;
@@ -1265,17 +1834,19 @@ static char *expand_vars(char *buf, char *ebuf, switch_size_t elen, switch_size_
 	return ebuf;
 }
 
-static FILE *preprocess_exec(const char *cwd, const char *command, FILE *write_fd, int rlevel)
+static FILE *preprocess_exec(const char *cwd, const char *command, FILE *write_fd, int rlevel, xml_pp_ctx_t *ctx)
 {
 #ifdef WIN32
 	FILE *fp = NULL;
 	char buffer[1024];
 
+	xml_pp_uncacheable(ctx);
+
 	if (!command || !strlen(command)) goto end;
 
 	if ((fp = _popen(command, "r"))) {
 		while (fgets(buffer, sizeof(buffer), fp) != NULL) {
-			if (fwrite(buffer, 1, strlen(buffer), write_fd) <= 0) {
+			if (preprocess_write(ctx, buffer, strlen(buffer), write_fd) <= 0) {
 					break;
 			}
 		}
@@ -1287,11 +1858,13 @@ static FILE *preprocess_exec(const char *cwd, const char *command, FILE *write_f
 		}
 	} else {
 		switch_snprintf(buffer, sizeof(buffer), "<!-- exec can not execute [%s] -->", command);
-		fwrite( buffer, 1, strlen(buffer), write_fd);
+		preprocess_write(ctx, buffer, strlen(buffer), write_fd);
  	}
 #else
 	int fds[2], pid = 0;
 
+	xml_pp_uncacheable(ctx);
+
 	if (pipe(fds)) {
 		goto end;
 	} else {					/* good to go */
@@ -1306,7 +1879,7 @@ static FILE *preprocess_exec(const char *cwd, const char *command, FILE *write_f
 			int bytes;
 			close(fds[1]);
 			while ((bytes = read(fds[0], buf, sizeof(buf))) > 0) {
-				if (fwrite(buf, 1, bytes, write_fd) <= 0) {
+				if (preprocess_write(ctx, buf, bytes, write_fd) <= 0) {
 					break;
 				}
 			}
@@ -1328,11 +1901,12 @@ static FILE *preprocess_exec(const char *cwd, const char *command, FILE *write_f
 
 }
 
-static FILE *preprocess_glob(const char *cwd, const char *pattern, FILE *write_fd, int rlevel)
+static FILE *preprocess_glob(const char *cwd, const char *pattern, FILE *write_fd, int rlevel, xml_pp_ctx_t *ctx)
 {
 	char *full_path = NULL;
 	char *dir_path = NULL, *e = NULL;
 	glob_t glob_data;
+	xml_pp_dep_t *dep;
 	size_t n;
 
 	if (!switch_is_file_path(pattern)) {
@@ -1342,16 +1916,22 @@ static FILE *preprocess_glob(const char *cwd, const char *pattern, FILE *write_f
 
 	if (glob(pattern, GLOB_NOCHECK, NULL, &glob_data) != 0) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error including %s\n", pattern);
+		xml_pp_uncacheable(ctx);
 		goto end;
 	}
 
+	if ((dep = xml_pp_add_dep(ctx, XML_PP_DEP_GLOB, pattern))) {
+		dep->size = (int64_t) glob_data.gl_pathc;
+		dep->hash = xml_pp_glob_hash(&glob_data);
+	}
+
 	for (n = 0; n < glob_data.gl_pathc; ++n) {
 		dir_path = strdup(glob_data.gl_pathv[n]);
 		switch_assert(dir_path);
 		if ((e = strrchr(dir_path, *SWITCH_PATH_SEPARATOR))) {
 			*e = '\0';
 		}
-		if (preprocess(dir_path, glob_data.gl_pathv[n], write_fd, rlevel) < 0) {
+		if (preprocess(dir_path, glob_data.gl_pathv[n], write_fd, rlevel, ctx) < 0) {
 			if (rlevel > 100) {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error including %s (Maximum recursion limit reached)\n", pattern);
 			}
@@ -1367,7 +1947,77 @@ static FILE *preprocess_glob(const char *cwd, const char *pattern, FILE *write_f
 	return write_fd;
 }
 
-static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rlevel)
+/* An include of the root file goes through the cache, nested ones are part of its fragment */
+static void preprocess_include(const char *cwd, const char *pattern, FILE *write_fd, int rlevel, xml_pp_ctx_t *ctx)
+{
+	xml_pp_frag_t *frag;
+	long start, end;
+	char *key;
+
+	if (!ctx || ctx->cur) {
+		preprocess_glob(cwd, pattern, write_fd, rlevel, ctx);
+		return;
+	}
+
+	key = switch_mprintf("%s|%s", cwd, pattern);
+
+	if ((frag = xml_pp_take_frag(ctx, key))) {
+		if (xml_pp_frag_valid(frag)) {
+			if (preprocess_write(ctx, frag->text, frag->len, write_fd) != frag->len) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write!\n");
+			}
+			*ctx->tail = frag;
+			ctx->tail = &frag->next;
+			ctx->reused++;
+			free(key);
+			return;
+		}
+
+		xml_pp_free_frags(frag);
+		ctx->dirty = 1;
+	}
+
+	frag = calloc(1, sizeof(*frag));
+	switch_assert(frag);
+	frag->key = key;
+	frag->section = strdup(ctx->section);
+
+	start = ftell(write_fd);
+	ctx->cur = frag;
+	preprocess_glob(cwd, pattern, write_fd, rlevel, ctx);
+	ctx->cur = NULL;
+	end = ftell(write_fd);
+	ctx->rebuilt++;
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Preprocessed %s in section [%s]\n", pattern, frag->section);
+
+	if (frag->uncacheable || start < 0 || end < start || fseek(write_fd, start, SEEK_SET)) {
+		xml_pp_free_frags(frag);
+		return;
+	}
+
+	/* read back what was just written, a text mode stream may give back fewer bytes */
+	frag->text = malloc(end - start + 1);
+	switch_assert(frag->text);
+	frag->len = (uint32_t) fread(frag->text, 1, end - start, write_fd);
+	frag->text[frag->len] = '\0';
+
+	if (ferror(write_fd)) {
+		clearerr(write_fd);
+		xml_pp_free_frags(frag);
+		frag = NULL;
+	}
+
+	fseek(write_fd, end, SEEK_SET);
+
+	if (frag) {
+		*ctx->tail = frag;
+		ctx->tail = &frag->next;
+		ctx->dirty = 1;
+	}
+}
+
+static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rlevel, xml_pp_ctx_t *ctx)
 {
 	FILE *read_fd = NULL;
 	switch_size_t cur = 0, ml = 0;
@@ -1375,6 +2025,7 @@ static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rle
 	char *tcmd, *targ;
 	int line = 0;
 	switch_size_t len = 0, eblen = 0;
+	xml_pp_dep_t *dep;
 
 	if (rlevel > 100) {
 		return -1;
@@ -1383,9 +2034,22 @@ static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rle
 	if (!(read_fd = fopen(file, "r"))) {
 		const char *reason = strerror(errno);
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldnt open %s (%s)\n", file, reason);
+		if ((dep = xml_pp_add_dep(ctx, XML_PP_DEP_FILE, file))) {
+			xml_pp_stat_dep(dep, NULL);
+		}
 		return -1;
 	}
 
+	if (ctx && ctx->cur) {
+		struct stat st;
+
+		if (fstat(fileno(read_fd), &st)) {
+			xml_pp_uncacheable(ctx);
+		} else if ((dep = xml_pp_add_dep(ctx, XML_PP_DEP_FILE, file))) {
+			xml_pp_stat_dep(dep, &st);
+		}
+	}
+
 	setvbuf(read_fd, (char *) NULL, _IOFBF, 65536);
 
 	for(;;) {
@@ -1403,7 +2067,7 @@ static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rle
 		ebuf = malloc(eblen);
 		memset(ebuf, 0, eblen);
 
-		bp = expand_vars(buf, ebuf, eblen, &cur, &err);
+		bp = expand_vars(buf, ebuf, eblen, &cur, &err, ctx);
 		line++;
 
 		if (err) {
@@ -1432,7 +2096,7 @@ static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rle
 			if ((e = strstr(tcmd, "/>"))) {
 				*e += 2;
 				*e = '\0';
-				if (fwrite(e, 1, (unsigned) strlen(e), write_fd) != (int) strlen(e)) {
+				if (preprocess_write(ctx, e, strlen(e), write_fd) != strlen(e)) {
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write!\n");
 				}
 			}
@@ -1492,26 +2156,28 @@ static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rle
 				if (name && val) {
 					switch_core_set_variable(name, val);
 				}
+				xml_pp_uncacheable(ctx);
 
 			} else if (!strcasecmp(tcmd, "exec-set")) {
 				preprocess_exec_set(targ);
+				xml_pp_uncacheable(ctx);
 			} else if (!strcasecmp(tcmd, "include")) {
-				preprocess_glob(cwd, targ, write_fd, rlevel + 1);
+				preprocess_include(cwd, targ, write_fd, rlevel + 1, ctx);
 			} else if (!strcasecmp(tcmd, "exec")) {
-				preprocess_exec(cwd, targ, write_fd, rlevel + 1);
+				preprocess_exec(cwd, targ, write_fd, rlevel + 1, ctx);
 			}
 
 			continue;
 		}
 
 		if ((cmd = strstr(bp, "<!--#"))) {
-			if (fwrite(bp, 1, (unsigned) (cmd - bp), write_fd) != (unsigned) (cmd - bp)) {
+			if (preprocess_write(ctx, bp, (switch_size_t) (cmd - bp), write_fd) != (switch_size_t) (cmd - bp)) {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write!\n");
 			}
 			if ((e = strstr(cmd, "-->"))) {
 				*e = '\0';
 				e += 3;
-				if (fwrite(e, 1, (unsigned) strlen(e), write_fd) != (int) strlen(e)) {
+				if (preprocess_write(ctx, e, strlen(e), write_fd) != strlen(e)) {
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write!\n");
 				}
 			} else {
@@ -1552,20 +2218,26 @@ static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rle
 					if (name && val) {
 						switch_core_set_variable(name, val);
 					}
+					xml_pp_uncacheable(ctx);
 
 				} else if (!strcasecmp(cmd, "exec-set")) {
 					preprocess_exec_set(arg);
+					xml_pp_uncacheable(ctx);
 				} else if (!strcasecmp(cmd, "include")) {
-					preprocess_glob(cwd, arg, write_fd, rlevel + 1);
+					preprocess_include(cwd, arg, write_fd, rlevel + 1, ctx);
 				} else if (!strcasecmp(cmd, "exec")) {
-					preprocess_exec(cwd, arg, write_fd, rlevel + 1);
+					preprocess_exec(cwd, arg, write_fd, rlevel + 1, ctx);
 				}
 			}
 
 			continue;
 		}
 
-		if (fwrite(bp, 1, (unsigned) cur, write_fd) != (int) cur) {
+		if (ctx && !rlevel) {
+			xml_pp_note_section(ctx, bp);
+		}
+
+		if (preprocess_write(ctx, bp, cur, write_fd) != cur) {
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write!\n");
 		}
 
@@ -1606,7 +2278,7 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file_simple(const char *file)
 	return NULL;
 }
 
-SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
+static switch_xml_t xml_parse_file(const char *file, xml_pp_ctx_t *ctx)
 {
 	int fd = -1;
 	FILE *write_fd = NULL;
@@ -1639,9 +2311,17 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 
 	setvbuf(write_fd, (char *) NULL, _IOFBF, 65536);
 
-	if (preprocess(SWITCH_GLOBAL_dirs.conf_dir, file, write_fd, 0) > -1) {
+	if (preprocess(SWITCH_GLOBAL_dirs.conf_dir, file, write_fd, 0, ctx) > -1) {
 		fclose(write_fd);
 		write_fd = NULL;
+
+		if (ctx && ctx->can_keep && ctx->len == ctx->last_len && ctx->hash == ctx->last_hash) {
+			/* same output as the running root, no need to parse it again */
+			ctx->unchanged = 1;
+			unlink(new_file_tmp);
+			goto done;
+		}
+
 		unlink (new_file);
 
 		if ( rename(new_file_tmp,new_file) ) {
@@ -1678,6 +2358,11 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 	return xml;
 }
 
+SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
+{
+	return xml_parse_file(file, NULL);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
 												  const char *tag_name,
 												  const char *key_name,
@@ -2197,6 +2882,35 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_root(void)
 	return xml;
 }
 
+SWITCH_DECLARE(uint32_t) switch_xml_root_generation(void)
+{
+	uint32_t generation;
+
+	switch_mutex_lock(REFLOCK);
+	generation = MAIN_XML_GENERATION;
+	switch_mutex_unlock(REFLOCK);
+
+	return generation;
+}
+
+SWITCH_DECLARE(switch_bool_t) switch_xml_section_bound(const char *section)
+{
+	switch_xml_section_t sections = switch_xml_parse_section_string(section);
+	switch_xml_binding_t *binding;
+	switch_bool_t bound = SWITCH_FALSE;
+
+	switch_thread_rwlock_rdlock(B_RWLOCK);
+	for (binding = BINDINGS; binding; binding = binding->next) {
+		if (!binding->sections || (sections & binding->sections)) {
+			bound = SWITCH_TRUE;
+			break;
+		}
+	}
+	switch_thread_rwlock_unlock(B_RWLOCK);
+
+	return bound;
+}
+
 struct destroy_xml {
 	switch_xml_t xml;
 	switch_memory_pool_t *pool;
@@ -2242,6 +2956,7 @@ SWITCH_DECLARE(switch_status_t) switch_xml_set_root(switch_xml_t new_main)
 
 	old_root = MAIN_XML_ROOT;
 	MAIN_XML_ROOT = new_main;
+	MAIN_XML_GENERATION++;
 	switch_set_flag(MAIN_XML_ROOT, SWITCH_XML_ROOT);
 	MAIN_XML_ROOT->refs++;
 
@@ -2304,6 +3019,8 @@ SWITCH_DECLARE_NONSTD(switch_xml_t) __switch_xml_open_root(uint8_t reload, const
 	char path_buf[1024];
 	uint8_t errcnt = 0;
 	switch_xml_t new_main, r = NULL;
+	xml_pp_ctx_t ctx = { 0 };
+	char *cache_path = NULL;
 
 	if (MAIN_XML_ROOT) {
 		if (!reload) {
@@ -2312,8 +3029,24 @@ SWITCH_DECLARE_NONSTD(switch_xml_t) __switch_xml_open_root(uint8_t reload, const
 		}
 	}
 
+	cache_path = xml_pp_cache_path();
+
+	if (!PP_FRAGS && !MAIN_XML_ROOT) {
+		PP_FRAGS = xml_pp_load(cache_path);
+	}
+
+	ctx.old = PP_FRAGS;
+	ctx.tail = &ctx.frags;
+	ctx.hash = XML_PP_HASH_INIT;
+	ctx.last_hash = PP_HASH;
+	ctx.last_len = PP_LEN;
+	ctx.can_keep = MAIN_XML_ROOT && PP_HASH;
+	PP_FRAGS = NULL;
+	PP_HASH = 0;
+	PP_LEN = 0;
+
 	switch_snprintf(path_buf, sizeof(path_buf), "%s%s%s", SWITCH_GLOBAL_dirs.conf_dir, SWITCH_PATH_SEPARATOR, SWITCH_GLOBAL_filenames.conf_name);
-	if ((new_main = switch_xml_parse_file(path_buf))) {
+	if ((new_main = xml_parse_file(path_buf, &ctx))) {
 		*err = switch_xml_error(new_main);
 		switch_copy_string(not_so_threadsafe_error_buffer, *err, sizeof(not_so_threadsafe_error_buffer));
 		*err = not_so_threadsafe_error_buffer;
@@ -2326,15 +3059,33 @@ SWITCH_DECLARE_NONSTD(switch_xml_t) __switch_xml_open_root(uint8_t reload, const
 			switch_xml_set_root(new_main);
 
 		}
+	} else if (ctx.unchanged) {
+		*err = "Success";
 	} else {
 		*err = "Cannot Open log directory or XML Root!";
 		errcnt++;
 	}
 
 	if (errcnt == 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "XML root %s, preprocessed %d include(s), %d unchanged\n",
+						  ctx.unchanged ? "unchanged" : "loaded", ctx.rebuilt, ctx.reused);
+
+		PP_FRAGS = ctx.frags;
+		PP_HASH = ctx.hash;
+		PP_LEN = ctx.len;
+		ctx.frags = NULL;
+
+		if (ctx.dirty || ctx.old) {
+			xml_pp_save(cache_path);
+		}
+
 		r = switch_xml_root();
 	}
 
+	xml_pp_free_frags(ctx.frags);
+	xml_pp_free_frags(ctx.old);
+	switch_safe_free(cache_path);
+
  done:
 
 	return r;
@@ -2393,6 +3144,11 @@ SWITCH_DECLARE(switch_status_t) switch_xml_destroy(void)
 		status = SWITCH_STATUS_SUCCESS;
 	}
 
+	xml_pp_free_frags(PP_FRAGS);
+	PP_FRAGS = NULL;
+	PP_HASH = 0;
+	PP_LEN = 0;
+
 	switch_mutex_unlock(XML_LOCK);
 	switch_mutex_unlock(REFLOCK);
 